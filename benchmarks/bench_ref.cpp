@@ -0,0 +1,369 @@
+// Input data and reference results of the benchmark kernels.
+// Generates the input data of every kernel (included by the kernel sources) and the expected content of its result region in the
+// format of dump_mem_region() (one little-endian 32-bit word per line).  The inputs come from a fixed pseudo-random sequence per
+// kernel, so images and expected results can be regenerated at any time and always match.
+//
+// Usage: bench_ref data <kernel> <output .S>
+//        bench_ref expected <kernel> <output>
+//        bench_ref list
+
+#include <errno.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+/*
+*   Data and expected result of one kernel.  Inputs are placed in .data, the result region in .result (linked to a fixed address
+*   by link.ld, initialized with the words given to result()).
+*/
+class bench_image {
+public:
+    std::string           text;
+    std::vector<uint32_t> expected;
+
+    void define(const char *name, long value){
+        text += "#define " + std::string(name) + " " + std::to_string(value) + "\n";
+    }
+
+    void words(const char *label, const std::vector<uint32_t> &w)     { data(".data", label, ".word", 4, w.data(), w.size()); }
+    void halves(const char *label, const std::vector<uint16_t> &h)    { data(".data", label, ".half", 2, h.data(), h.size()); }
+    void bytes(const char *label, const std::vector<uint8_t> &b)      { data(".data", label, ".byte", 1, b.data(), b.size()); }
+
+    //result region, initialized with init and expected to hold exp after the kernel ran
+    void result(const std::vector<uint32_t> &init, const std::vector<uint32_t> &exp){
+        data(".result", "result", ".word", 4, init.data(), init.size());
+        expected = exp;
+    }
+
+private:
+    void data(const char *section, const char *label, const char *dir, int size, const void *values, size_t n){
+        char buf[64];
+        text += "    .section " + std::string(section) + ", \"aw\"\n    .balign 4\n    .globl " + label + "\n" + label + ":\n";
+        for (size_t i = 0; i < n; i++) {
+            uint32_t v = 0;
+            memcpy(&v, (const unsigned char *)values + i * size, size);
+            snprintf(buf, sizeof(buf), "%s%s 0x%0*x", (i % 8) ? "," : (i ? "\n    " : "    "), (i % 8) ? "" : dir, size * 2, v);
+            text += buf;
+        }
+        text += "\n";
+    }
+};
+
+//pseudo-random sequence, one per kernel
+class bench_rand {
+public:
+    explicit bench_rand(uint32_t seed) : state(seed) {}
+    uint32_t next()                             { state = state * 1664525u + 1013904223u; return state; }
+    int32_t  range(int32_t lo, int32_t hi)      { return lo + (int32_t)((next() >> 8) % (uint32_t)(hi - lo + 1)); }
+private:
+    uint32_t state;
+};
+
+static uint32_t f32_bits(float f)  { uint32_t b; memcpy(&b, &f, 4); return b; }
+
+//exact small integers only
+static uint16_t f16_bits(int v){
+    if (v == 0) {
+        return 0;
+    }
+    uint16_t sign = v < 0 ? 0x8000 : 0;
+    uint32_t mag  = v < 0 ? -v : v;
+    int exp = 31 - __builtin_clz(mag);
+    return sign | (uint16_t)((exp + 15) << 10) | (uint16_t)(((mag << (10 - exp)) & 0x3ff));
+}
+
+static uint32_t rev8(uint32_t x)    { return __builtin_bswap32(x); }
+static uint32_t brev8(uint32_t x){
+    uint32_t r = 0;
+    for (int i = 0; i < 32; i++) {
+        r |= ((x >> i) & 1) << ((i & ~7) | (7 - (i & 7)));
+    }
+    return r;
+}
+static uint32_t brev(uint32_t x)    { return rev8(brev8(x)); }
+static uint32_t rotl(uint32_t x, int s) { s &= 31; return s ? (x << s) | (x >> (32 - s)) : x; }
+
+//CRC-32 (polynomial 0x04c11db7, MSB first, no reflection, zero initial value and final xor) of one 32-bit word
+static uint32_t crc32_word(uint32_t x){
+    uint32_t crc = x;
+    for (int i = 0; i < 32; i++) {
+        crc = (crc & 0x80000000u) ? (crc << 1) ^ 0x04c11db7u : (crc << 1);
+    }
+    return crc;
+}
+
+static std::vector<uint32_t> zeros(size_t n)  { return std::vector<uint32_t>(n, 0); }
+
+/*
+*   Kernels.  The constants defined here are used by the kernel sources in benchmarks/kernels.
+*/
+static void gen_memcpy(bench_image &img){
+    const int N = 1024;
+    bench_rand rnd(1);
+    std::vector<uint8_t> src(N);
+    for (uint8_t &b : src) {
+        b = rnd.next() >> 24;
+    }
+    img.define("N", N);
+    img.bytes("src", src);
+    std::vector<uint32_t> exp(N / 4);
+    memcpy(exp.data(), src.data(), N);
+    img.result(zeros(N / 4), exp);
+}
+
+static void gen_gather_strided(bench_image &img){
+    const int N = 256, STRIDE = 5;
+    bench_rand rnd(2);
+    std::vector<uint32_t> src(N * STRIDE), exp(N);
+    for (uint32_t &w : src) {
+        w = rnd.next();
+    }
+    for (int i = 0; i < N; i++) {
+        exp[i] = src[i * STRIDE];
+    }
+    img.define("N", N);
+    img.define("STRIDE_BYTES", STRIDE * 4);
+    img.words("src", src);
+    img.result(zeros(N), exp);
+}
+
+static void gen_gather_indexed(bench_image &img){
+    const int N = 256, TABLE = 512;
+    bench_rand rnd(3);
+    std::vector<uint32_t> table(TABLE), offsets(N), exp(N);
+    for (uint32_t &w : table) {
+        w = rnd.next();
+    }
+    for (int i = 0; i < N; i++) {
+        uint32_t idx = rnd.range(0, TABLE - 1);
+        offsets[i] = idx * 4;
+        exp[i]     = table[idx];
+    }
+    img.define("N", N);
+    img.words("table", table);
+    img.words("offsets", offsets);
+    img.result(zeros(N), exp);
+}
+
+static void gen_saxpy(bench_image &img){
+    const int N = 256;
+    bench_rand rnd(4);
+    float alpha = rnd.range(-512, 512) / 128.0f;
+    std::vector<uint32_t> x(N), y(N), exp(N);
+    for (int i = 0; i < N; i++) {
+        float xf = rnd.range(-1024, 1024) / 256.0f;
+        float yf = rnd.range(-1024, 1024) / 256.0f;
+        x[i]   = f32_bits(xf);
+        y[i]   = f32_bits(yf);
+        exp[i] = f32_bits(fmaf(alpha, xf, yf));    //vfmacc is fused
+    }
+    img.define("N", N);
+    img.words("alpha", {f32_bits(alpha)});
+    img.words("x", x);
+    img.result(y, exp);
+}
+
+static void gen_gemm_i8(bench_image &img){
+    const int M = 16, N = 16, K = 16;
+    bench_rand rnd(5);
+    std::vector<uint8_t> a(M * K), b(K * N);
+    for (uint8_t &v : a) {
+        v = (uint8_t)rnd.range(-128, 127);
+    }
+    for (uint8_t &v : b) {
+        v = (uint8_t)rnd.range(-128, 127);
+    }
+    std::vector<uint32_t> exp(M * N);
+    for (int i = 0; i < M; i++) {
+        for (int j = 0; j < N; j++) {
+            int32_t acc = 0;
+            for (int k = 0; k < K; k++) {
+                acc += (int8_t)a[i * K + k] * (int8_t)b[k * N + j];
+            }
+            exp[i * N + j] = acc;
+        }
+    }
+    img.define("M", M);
+    img.define("N", N);
+    img.define("K", K);
+    img.bytes("a", a);
+    img.bytes("b", b);
+    img.result(zeros(M * N), exp);
+}
+
+static void gen_conv2d(bench_image &img){
+    const int H = 16, W = 16, W_IN = W + 2;
+    bench_rand rnd(6);
+    std::vector<uint32_t> in((H + 2) * W_IN), weights(9), exp(H * W);
+    for (uint32_t &v : in) {
+        v = rnd.range(-1000, 1000);
+    }
+    for (uint32_t &v : weights) {
+        v = rnd.range(-16, 16);
+    }
+    for (int r = 0; r < H; r++) {
+        for (int c = 0; c < W; c++) {
+            int32_t acc = 0;
+            for (int kr = 0; kr < 3; kr++) {
+                for (int kc = 0; kc < 3; kc++) {
+                    acc += (int32_t)in[(r + kr) * W_IN + c + kc] * (int32_t)weights[kr * 3 + kc];
+                }
+            }
+            exp[r * W + c] = acc;
+        }
+    }
+    img.define("H", H);
+    img.define("W", W);
+    img.define("W_IN_BYTES", W_IN * 4);
+    img.words("in", in);
+    img.words("weights", weights);
+    img.result(zeros(H * W), exp);
+}
+
+static void gen_reduce(bench_image &img){
+    const int N = 1024;
+    bench_rand rnd(7);
+    std::vector<uint32_t> src(N);
+    int32_t sum = 0, max = INT32_MIN, min = INT32_MAX;
+    uint32_t xr = 0;
+    for (uint32_t &w : src) {
+        w = rnd.next();
+        sum = (int32_t)((uint32_t)sum + w);
+        max = (int32_t)w > max ? (int32_t)w : max;
+        min = (int32_t)w < min ? (int32_t)w : min;
+        xr ^= w;
+    }
+    img.define("N", N);
+    img.words("src", src);
+    img.result(zeros(4), {(uint32_t)sum, (uint32_t)max, (uint32_t)min, xr});
+}
+
+static void gen_slide(bench_image &img){
+    const int N = 256;
+    bench_rand rnd(8);
+    //x[-1] and x[N] are 0
+    std::vector<uint32_t> x(N + 2, 0), exp(N);
+    for (int i = 1; i <= N; i++) {
+        x[i] = rnd.range(-100000, 100000);
+    }
+    for (int i = 0; i < N; i++) {
+        exp[i] = x[i + 2] - x[i];
+    }
+    img.define("N", N);
+    img.words("x_pad", x);
+    img.result(zeros(N), exp);
+}
+
+static void gen_fp16_dot(bench_image &img){
+    const int N = 256;
+    bench_rand rnd(9);
+    //small integers, all partial sums are exact in fp16 so the result does not depend on the summation order
+    std::vector<uint16_t> a(N), b(N);
+    int dot = 0;
+    for (int i = 0; i < N; i++) {
+        int av = rnd.range(-2, 2), bv = rnd.range(-2, 2);
+        a[i] = f16_bits(av);
+        b[i] = f16_bits(bv);
+        dot += av * bv;
+    }
+    img.define("N", N);
+    img.halves("a", a);
+    img.halves("b", b);
+    img.result(zeros(1), {f16_bits(dot)});
+}
+
+static void gen_crc_clmul(bench_image &img){
+    const int N = 256;
+    bench_rand rnd(10);
+    std::vector<uint32_t> src(N), exp(N);
+    for (int i = 0; i < N; i++) {
+        src[i] = rnd.next();
+        exp[i] = crc32_word(src[i]);
+    }
+    img.define("N", N);
+    img.words("src", src);
+    img.result(zeros(N), exp);
+}
+
+static void gen_bitmanip(bench_image &img){
+    const int N = 64, OPS = 9;
+    bench_rand rnd(11);
+    std::vector<uint32_t> x(N), y(N), exp(N * OPS);
+    for (int i = 0; i < N; i++) {
+        x[i] = rnd.next();
+        y[i] = rnd.next();
+        //one N word block per operation, in the order of the kernel
+        exp[0 * N + i] = x[i] & ~y[i];
+        exp[1 * N + i] = brev8(x[i]);
+        exp[2 * N + i] = rev8(x[i]);
+        exp[3 * N + i] = brev(x[i]);
+        exp[4 * N + i] = x[i] ? __builtin_clz(x[i]) : 32;
+        exp[5 * N + i] = x[i] ? __builtin_ctz(x[i]) : 32;
+        exp[6 * N + i] = __builtin_popcount(x[i]);
+        exp[7 * N + i] = rotl(x[i], 32 - 7);
+        exp[8 * N + i] = rotl(x[i], y[i]);
+    }
+    img.define("N", N);
+    img.words("x", x);
+    img.words("y", y);
+    img.result(zeros(N * OPS), exp);
+}
+
+struct bench_kernel {
+    const char *name;
+    void      (*gen)(bench_image &img);
+};
+
+static const bench_kernel kernels[] = {
+    {"memcpy",         gen_memcpy},
+    {"gather_strided", gen_gather_strided},
+    {"gather_indexed", gen_gather_indexed},
+    {"saxpy",          gen_saxpy},
+    {"gemm_i8",        gen_gemm_i8},
+    {"conv2d",         gen_conv2d},
+    {"reduce",         gen_reduce},
+    {"slide",          gen_slide},
+    {"fp16_dot",       gen_fp16_dot},
+    {"crc_clmul",      gen_crc_clmul},
+    {"bitmanip",       gen_bitmanip},
+};
+
+int main(int argc, char **argv){
+    if (argc == 2 && strcmp(argv[1], "list") == 0) {
+        for (const bench_kernel &k : kernels) {
+            printf("%s\n", k.name);
+        }
+        return 0;
+    }
+    if (argc != 4 || (strcmp(argv[1], "data") != 0 && strcmp(argv[1], "expected") != 0)) {
+        fprintf(stderr, "Usage: %s data|expected <kernel> <output>\n       %s list\n", argv[0], argv[0]);
+        return 1;
+    }
+    for (const bench_kernel &k : kernels) {
+        if (strcmp(k.name, argv[2]) != 0) {
+            continue;
+        }
+        bench_image img;
+        k.gen(img);
+        FILE *out = fopen(argv[3], "w");
+        if (out == NULL) {
+            fprintf(stderr, "ERROR: opening `%s': %s\n", argv[3], strerror(errno));
+            return 1;
+        }
+        if (argv[1][0] == 'd') {
+            fprintf(out, "// Generated by bench_ref, do not edit\n%s", img.text.c_str());
+        } else {
+            for (uint32_t w : img.expected) {
+                fprintf(out, "%08x\n", w);
+            }
+        }
+        fclose(out);
+        return 0;
+    }
+    fprintf(stderr, "ERROR: unknown kernel `%s'\n", argv[2]);
+    return 1;
+}
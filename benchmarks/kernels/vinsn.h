@@ -0,0 +1,19 @@
+// Encodings of vector instructions not known to all assemblers (Zvbb, Zvbc).  Operands are register numbers, e.g. VCLMUL_VX(8, 4, 6)
+// for vclmul.vx v8, v4, x6.
+
+#define VOP(funct6, funct3, vd, vs2, rs1) .word (((funct6) << 26) | (1 << 25) | ((vs2) << 20) | ((rs1) << 15) | ((funct3) << 12) | ((vd) << 7) | 0x57)
+
+// Zvbc, OPMVX
+#define VCLMUL_VX(vd, vs2, rs1)     VOP(0x0c, 6, vd, vs2, rs1)
+#define VCLMULH_VX(vd, vs2, rs1)    VOP(0x0d, 6, vd, vs2, rs1)
+
+// Zvbb
+#define VANDN_VV(vd, vs2, vs1)      VOP(0x01, 0, vd, vs2, vs1)
+#define VROL_VV(vd, vs2, vs1)       VOP(0x15, 0, vd, vs2, vs1)
+#define VROR_VI(vd, vs2, uimm)      VOP(0x14 | (((uimm) >> 5) & 1), 3, vd, vs2, (uimm) & 31)
+#define VBREV8_V(vd, vs2)           VOP(0x12, 2, vd, vs2, 0x08)
+#define VREV8_V(vd, vs2)            VOP(0x12, 2, vd, vs2, 0x09)
+#define VBREV_V(vd, vs2)            VOP(0x12, 2, vd, vs2, 0x0a)
+#define VCLZ_V(vd, vs2)             VOP(0x12, 2, vd, vs2, 0x0c)
+#define VCTZ_V(vd, vs2)             VOP(0x12, 2, vd, vs2, 0x0d)
+#define VCPOP_V(vd, vs2)            VOP(0x12, 2, vd, vs2, 0x0e)
@@ -368,6 +368,40 @@ module vproc_core import vproc_pkg::*; #(
     assign xif_issue_if.issue_resp.loadstore = dec_valid & (instr_unit == UNIT_LSU);
     assign xif_issue_if.issue_resp.exc       = dec_valid & (instr_unit == UNIT_LSU);
 
+    // Vector instructions accepted by the decoder, sampled by the simulation
+    // harness for instruction statistics (VL, SEW and LMUL are taken from the
+    // CSR outputs in the same cycle)
+    logic                   dec_issue_valid      /* verilator public */;
+    logic [XIF_ID_W   -1:0] dec_issue_id         /* verilator public */;
+    logic [3:0]             dec_issue_unit       /* verilator public */;
+    assign dec_issue_valid = xif_issue_if.issue_valid & xif_issue_if.issue_ready & dec_valid;
+    assign dec_issue_id    = xif_issue_if.issue_req.id;
+    assign dec_issue_unit  = instr_unit;
+
+    // Vector loads/stores accepted by the decoder and requests on the vector
+    // memory interface, sampled by the simulation harness for memory traffic
+    // statistics
+    logic                   lsu_issue_valid      /* verilator public */;
+    logic [XIF_ID_W   -1:0] lsu_issue_id         /* verilator public */;
+    logic                   lsu_issue_store      /* verilator public */;
+    logic [1:0]             lsu_issue_stride     /* verilator public */;
+    logic                   lsu_issue_misaligned /* verilator public */;
+    logic                   lsu_mem_valid        /* verilator public */;
+    logic [XIF_ID_W   -1:0] lsu_mem_id           /* verilator public */;
+    logic [31:0]            lsu_mem_addr         /* verilator public */;
+    logic                   lsu_mem_we           /* verilator public */;
+    logic [XIF_MEM_W/8-1:0] lsu_mem_be           /* verilator public */;
+    assign lsu_issue_valid      = xif_issue_if.issue_valid & xif_issue_if.issue_ready & dec_valid & (instr_unit == UNIT_LSU);
+    assign lsu_issue_id         = xif_issue_if.issue_req.id;
+    assign lsu_issue_store      = instr_mode.lsu.store;
+    assign lsu_issue_stride     = instr_mode.lsu.stride;
+    assign lsu_issue_misaligned = dec.misaligned_ls;
+    assign lsu_mem_valid        = xif_mem_if.mem_valid & xif_mem_if.mem_ready;
+    assign lsu_mem_id           = xif_mem_if.mem_req.id;
+    assign lsu_mem_addr         = xif_mem_if.mem_req.addr;
+    assign lsu_mem_we           = xif_mem_if.mem_req.we;
+    assign lsu_mem_be           = xif_mem_if.mem_req.be;
+
 
     ///////////////////////////////////////////////////////////////////////////
     // VECTOR INSTRUCTION COMMIT STATE
@@ -407,6 +441,17 @@ module vproc_core import vproc_pkg::*; #(
     logic [PIPE_CNT-1:0]               instr_complete_valid;
     logic [PIPE_CNT-1:0][XIF_ID_W-1:0] instr_complete_id;
 
+    // Instruction complete signals as unpacked arrays, sampled by the
+    // simulation harness for instruction statistics
+    logic                instr_done_valid[PIPE_CNT] /* verilator public */;
+    logic [XIF_ID_W-1:0] instr_done_id   [PIPE_CNT] /* verilator public */;
+    always_comb begin
+        for (int i = 0; i < PIPE_CNT; i++) begin
+            instr_done_valid[i] = instr_complete_valid[i];
+            instr_done_id   [i] = instr_complete_id   [i];
+        end
+    end
+
     // return an empty result or VL as result
     logic                result_empty_valid, result_csr_valid;
     logic                                    result_csr_ready;
@@ -424,6 +469,18 @@ module vproc_core import vproc_pkg::*; #(
     // the decode buffer is cleared without asserting dec_ready
     assign dec_ready = ~dec_buf_valid_q | (queue_ready & queue_push);
 
+    // Instruction queue enqueue and XIF result handshakes, sampled by the
+    // simulation harness for offload latency statistics together with the
+    // decoder, dispatch, commit and completion signals
+    logic                queue_enq_valid  /* verilator public */;
+    logic [XIF_ID_W-1:0] queue_enq_id     /* verilator public */;
+    logic                xif_result_valid /* verilator public */;
+    logic [XIF_ID_W-1:0] xif_result_id    /* verilator public */;
+    assign queue_enq_valid  = queue_push & queue_ready;
+    assign queue_enq_id     = dec_data_q.id;
+    assign xif_result_valid = xif_result_if.result_valid & xif_result_if.result_ready;
+    assign xif_result_id    = xif_result_if.result.id;
+
     // XIF instruction successfully offloaded
     logic instr_offload;
     assign instr_offload = xif_issue_if.issue_valid & xif_issue_if.issue_ready &
@@ -814,8 +871,8 @@ module vproc_core import vproc_pkg::*; #(
     ///////////////////////////////////////////////////////////////////////////
     // DISPATCHER
 
-    logic [PIPE_CNT-1:0] pipe_instr_valid;
-    logic [PIPE_CNT-1:0] pipe_instr_ready;
+    logic [PIPE_CNT-1:0] pipe_instr_valid /* verilator public */;
+    logic [PIPE_CNT-1:0] pipe_instr_ready /* verilator public */;
     decoder_data         pipe_instr_data;
     logic [31:0]         pend_vreg_wr_map;
     logic [31:0]         pend_vreg_wr_clr;
@@ -841,6 +898,62 @@ module vproc_core import vproc_pkg::*; #(
     );
     assign pend_vreg_wr_map_o = pend_vreg_wr_map;
 
+    // Stall attribution, sampled by the simulation harness: the reason the
+    // instruction at the head of the queue is not dispatched (every cycle is
+    // classified, DISPATCH_ISSUED when it is dispatched) and the reason an
+    // offloaded instruction is not accepted.  The ID of the instruction at the
+    // head of the queue and the XIF commit transactions allow the harness to
+    // charge the stall cycles to the PC of the stalled instruction.
+    dispatch_stall       pipe_stall_cause[PIPE_CNT];
+    dispatch_stall       dispatch_cause;
+    offload_stall        offload_cause;
+    logic [3:0]          dispatch_stall_cause /* verilator public */;
+    logic [XIF_ID_W-1:0] dispatch_stall_id    /* verilator public */;
+    logic [2:0]          offload_stall_cause  /* verilator public */;
+    logic                xif_commit_valid     /* verilator public */;
+    logic [XIF_ID_W-1:0] xif_commit_id        /* verilator public */;
+    logic                xif_commit_kill      /* verilator public */;
+    always_comb begin
+        dispatch_cause = DISPATCH_EMPTY;
+        if (queue_valid_q) begin
+            if (op_ack) begin
+                dispatch_cause = DISPATCH_ISSUED;
+            end
+            else if ((queue_pending_wr_q & pend_vreg_wr_map) != '0) begin
+                dispatch_cause = DISPATCH_WAW;
+            end else begin
+                dispatch_cause = DISPATCH_BUSY;
+                for (int i = 0; i < PIPE_CNT; i++) begin
+                    if (PIPE_UNITS[i][queue_data_q.unit]) begin
+                        dispatch_cause = pipe_stall_cause[i];
+                    end
+                end
+            end
+        end
+        else if (dec_buf_valid_q | queue_valid_d) begin
+            dispatch_cause = DISPATCH_DECODE;
+        end
+    end
+    always_comb begin
+        offload_cause = OFFLOAD_NONE;
+        if (xif_issue_if.issue_valid & ~xif_issue_if.issue_ready) begin
+            if (~dec_ready) begin
+                offload_cause = (dec_data_q.unit == UNIT_CFG) ? OFFLOAD_VSET : OFFLOAD_QUEUE;
+            end
+            else if (issue_id_used) begin
+                offload_cause = OFFLOAD_ID;
+            end else begin
+                offload_cause = OFFLOAD_XREG;
+            end
+        end
+    end
+    assign dispatch_stall_cause = dispatch_cause;
+    assign dispatch_stall_id    = queue_data_q.id;
+    assign offload_stall_cause  = offload_cause;
+    assign xif_commit_valid     = xif_commit_if.commit_valid;
+    assign xif_commit_id        = xif_commit_if.commit.id;
+    assign xif_commit_kill      = xif_commit_if.commit.commit_kill;
+
 
     ///////////////////////////////////////////////////////////////////////////
     // REGISTER FILE AND EXECUTION UNITS
@@ -854,8 +967,8 @@ module vproc_core import vproc_pkg::*; #(
     logic [VPORT_WR_CNT-1:0][VREG_W  -1:0] vregfile_wr_data_d;
     logic [VPORT_WR_CNT-1:0][VREG_W/8-1:0] vregfile_wr_mask_q /* verilator public */;
     logic [VPORT_WR_CNT-1:0][VREG_W/8-1:0] vregfile_wr_mask_d;
-    logic [VPORT_RD_CNT-1:0][4:0]          vregfile_rd_addr;
-    logic [VPORT_RD_CNT-1:0][VREG_W  -1:0] vregfile_rd_data;
+    logic [VPORT_RD_CNT-1:0][4:0]          vregfile_rd_addr /* verilator public */;
+    logic [VPORT_RD_CNT-1:0][VREG_W  -1:0] vregfile_rd_data /* verilator public */;
     vproc_vregfile #(
         .VREG_W       ( VREG_W             ),
         .MAX_PORT_W   ( MAX_VPORT_W        ),
@@ -945,6 +1058,12 @@ module vproc_core import vproc_pkg::*; #(
     logic [PIPE_CNT-1:0]               pipe_vreg_wr_clr;
     logic [PIPE_CNT-1:0][1:0]          pipe_vreg_wr_clr_cnt;
 
+    // unit configuration and activity of each pipeline, sampled by the simulation harness for statistics
+    logic [UNIT_CNT-1:0] pipe_units     [PIPE_CNT] /* verilator public */;
+    logic [UNIT_CNT-1:0] pipe_unit_busy [PIPE_CNT] /* verilator public */;
+    logic [UNIT_CNT-1:0] pipe_unit_stall[PIPE_CNT] /* verilator public */;
+    logic [31:0]         pipe_width     [PIPE_CNT] /* verilator public */;
+
     logic                lsu_trans_complete_valid;
     logic                lsu_trans_complete_ready;
     logic [XIF_ID_W-1:0] lsu_trans_complete_id;
@@ -1071,8 +1190,13 @@ module vproc_core import vproc_pkg::*; #(
                 .xreg_ready_i             ( xreg_ready                 ),
                 .xreg_id_o                ( xreg_id                    ),
                 .xreg_addr_o              ( xreg_addr                  ),
-                .xreg_data_o              ( xreg_data                  )
+                .xreg_data_o              ( xreg_data                  ),
+                .unit_busy_o              ( pipe_unit_busy      [i]    ),
+                .unit_stall_o             ( pipe_unit_stall     [i]    ),
+                .stall_cause_o            ( pipe_stall_cause    [i]    )
             );
+            assign pipe_units[i] = PIPE_UNITS[i];
+            assign pipe_width[i] = PIPE_W[i];
             if (PIPE_UNITS[i][UNIT_LSU]) begin
                 assign pending_load_lsu           = pending_load;
                 assign pending_store_lsu          = pending_store;
@@ -92,13 +92,13 @@ module vproc_decoder #(
 
         vl_override_o = 1'b0;
 
+        misaligned_ls = 1'b0;
+
         `ifdef RISCV_ZVE32F
 
         fpr_wr_req_valid = DONT_CARE_ZERO ? 1'b0 : 1'bx;
         fpr_wr_req_addr_o = DONT_CARE_ZERO ? '0 : 'x;
 
-        misaligned_ls = 1'b0;
-
         `endif
 
         unique case (instr_i[6:0])
@@ -40,6 +40,8 @@ module vproc_lsu import vproc_pkg::*; #(
 
         input  instr_state [XIF_ID_CNT-1:0] instr_state_i,
 
+        output dispatch_stall         stall_cause_o,          // request stage stall, for simulation statistics
+
         output logic                  trans_complete_valid_o,
         input  logic                  trans_complete_ready_i,
         output logic [XIF_ID_W-1:0]   trans_complete_id_o,
@@ -196,6 +198,29 @@ module vproc_lsu import vproc_pkg::*; #(
     assign state_req_stall = (~state_req_q.mode.lsu.store & state_req_q.res_store & vreg_pend_rd_i[state_req_q.res_vaddr]) |
                              ((instr_state_i[state_req_q.id] == INSTR_SPECULATIVE) | ~(state_req_q.id == deq_state.id)) | ~lsu_queue_ready;
 
+    // Reason the request stage does not advance (DISPATCH_ISSUED if it does),
+    // sampled through the pipeline by the simulation harness
+    always_comb begin
+        stall_cause_o = DISPATCH_ISSUED;
+        if (state_req_valid_q) begin
+            if (~state_req_q.mode.lsu.store & state_req_q.res_store & vreg_pend_rd_i[state_req_q.res_vaddr]) begin
+                stall_cause_o = DISPATCH_WAR;
+            end
+            else if (instr_state_i[state_req_q.id] == INSTR_SPECULATIVE) begin
+                stall_cause_o = DISPATCH_COMMIT;
+            end
+            else if (~lsu_queue_ready) begin
+                stall_cause_o = DISPATCH_VLSU_QUEUE;
+            end
+            else if (state_req_q.id != deq_state.id) begin
+                stall_cause_o = DISPATCH_BUSY;
+            end
+            else if (xif_mem_if.mem_valid & ~xif_mem_if.mem_ready) begin
+                stall_cause_o = DISPATCH_MEM;
+            end
+        end
+    end
+
     ///////////////////////////////////////////////////////////////////////////
     // LSU READ/WRITE
 
@@ -96,7 +96,11 @@ module vproc_pipeline import vproc_pkg::*; #(
         input  logic                    xreg_ready_i,
         output logic [XIF_ID_W-1:0]     xreg_id_o,
         output logic [4:0]              xreg_addr_o,
-        output logic [31:0]             xreg_data_o
+        output logic [31:0]             xreg_data_o,
+
+        output logic [UNIT_CNT-1:0]     unit_busy_o,          // unit activity for simulation statistics
+        output logic [UNIT_CNT-1:0]     unit_stall_o,
+        output dispatch_stall           stall_cause_o         // reason no instruction is accepted, for statistics
     );
 
     if ((MAX_OP_W & (MAX_OP_W - 1)) != 0 || MAX_OP_W < 32 || MAX_OP_W >= VREG_W) begin
@@ -879,6 +883,26 @@ module vproc_pipeline import vproc_pkg::*; #(
         end
     end
 
+    // Reason the pipeline does not accept a new instruction, sampled by the
+    // simulation harness: an operand read stalled on a pending write, else
+    // the stall of the stage exerting backpressure on the first stage, else
+    // the pipeline is still busy with the current instruction
+    dispatch_stall lsu_stall_cause, pack_stall_cause;
+    always_comb begin
+        stall_cause_o = DISPATCH_BUSY;
+        if (state_valid_q & state_stall) begin
+            stall_cause_o = DISPATCH_RAW;
+        end
+        else if (state_valid_q & ~unpack_ready) begin
+            if (pack_stall_cause != DISPATCH_ISSUED) begin
+                stall_cause_o = pack_stall_cause;
+            end
+            else if (UNITS[UNIT_LSU] & (lsu_stall_cause != DISPATCH_ISSUED)) begin
+                stall_cause_o = lsu_stall_cause;
+            end
+        end
+    end
+
 
     ///////////////////////////////////////////////////////////////////////////
     // UNIT CONTROL SIGNALS
@@ -1159,6 +1183,7 @@ module vproc_pipeline import vproc_pkg::*; #(
         .pending_store_o           ( lsu_pending_store        ),
         .vreg_pend_rd_i            ( vreg_pend_rd_i           ),
         .instr_state_i             ( instr_state_i            ),
+        .lsu_stall_cause_o         ( lsu_stall_cause          ),
         .xif_mem_if                ( xif_mem_if               ),
         .xif_memres_if             ( xif_memres_if            ),
         .trans_complete_valid_o    ( trans_complete_valid_o   ),
@@ -1173,7 +1198,9 @@ module vproc_pipeline import vproc_pkg::*; #(
         .xreg_ready_i              ( xreg_ready_i             ),
         .xreg_id_o                 ( xreg_id_o                ),
         .xreg_addr_o               ( xreg_addr_o              ),
-        .xreg_data_o               ( xreg_data_o              )
+        .xreg_data_o               ( xreg_data_o              ),
+        .unit_busy_o               ( unit_busy_o              ),
+        .unit_stall_o              ( unit_stall_o             )
     );
 
 
@@ -1221,7 +1248,8 @@ module vproc_pipeline import vproc_pkg::*; #(
         .pending_vreg_reads_i        ( vreg_pend_rd_i          ),
         .instr_state_i               ( instr_state_i           ),
         .instr_done_valid_o          ( instr_done_valid_o      ),
-        .instr_done_id_o             ( instr_done_id_o         )
+        .instr_done_id_o             ( instr_done_id_o         ),
+        .stall_cause_o               ( pack_stall_cause        )
     );
 
 
@@ -79,7 +79,11 @@ module vproc_pipeline_wrapper import vproc_pkg::*; #(
         input  logic                    xreg_ready_i,
         output logic [XIF_ID_W-1:0]     xreg_id_o,
         output logic [4:0]              xreg_addr_o,
-        output logic [31:0]             xreg_data_o
+        output logic [31:0]             xreg_data_o,
+
+        output logic [UNIT_CNT-1:0]     unit_busy_o,          // unit activity for simulation statistics
+        output logic [UNIT_CNT-1:0]     unit_stall_o,
+        output dispatch_stall           stall_cause_o         // reason no instruction is accepted, for statistics
     );
     
     import fpnew_pkg::*;
@@ -49,6 +49,33 @@ typedef enum logic [1:0] {
     INSTR_KILLED
 } instr_state;
 
+// Reason the instruction at the head of the instruction queue is not
+// dispatched in a cycle, only used for simulation statistics.  Causes from
+// DISPATCH_RAW on are reported by the target pipeline.
+typedef enum logic [3:0] {
+    DISPATCH_ISSUED,     // the instruction was dispatched (no stall)
+    DISPATCH_EMPTY,      // instruction queue and decode buffer are empty
+    DISPATCH_DECODE,     // instruction queue empty, an instruction is in the decode buffer
+    DISPATCH_WAW,        // destination has a pending write of an older instruction
+    DISPATCH_RAW,        // operand read waits for a pending vreg write
+    DISPATCH_WAR,        // result write waits for a pending vreg read of another pipeline
+    DISPATCH_PORT,       // result write waits for a vreg write port
+    DISPATCH_COMMIT,     // waits for the commit of a speculative instruction
+    DISPATCH_VLSU_QUEUE, // VLSU queue full
+    DISPATCH_MEM,        // vector memory interface not ready
+    DISPATCH_BUSY        // pipeline busy with an earlier instruction
+} dispatch_stall;
+
+// Reason an instruction offered on the XIF issue interface is not accepted,
+// only used for simulation statistics
+typedef enum logic [2:0] {
+    OFFLOAD_NONE,        // no instruction offered or the instruction was accepted
+    OFFLOAD_QUEUE,       // instruction queue full
+    OFFLOAD_VSET,        // decode buffer holds a vset[i]vl[i] waiting for its commit
+    OFFLOAD_ID,          // instruction ID still used by an incomplete instruction
+    OFFLOAD_XREG         // scalar source operand not yet valid
+} offload_stall;
+
 typedef enum logic [1:0] {
     VSEW_8       = 2'b00,
     VSEW_16      = 2'b01,
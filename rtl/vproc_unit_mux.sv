@@ -51,6 +51,8 @@ module vproc_unit_mux import vproc_pkg::*; #(
 
         input  instr_state [XIF_ID_CNT         -1:0] instr_state_i,
 
+        output dispatch_stall                        lsu_stall_cause_o,  // VLSU stall, for simulation statistics
+
         vproc_xif.coproc_mem                         xif_mem_if,
         vproc_xif.coproc_mem_result                  xif_memres_if,
 
@@ -67,7 +69,11 @@ module vproc_unit_mux import vproc_pkg::*; #(
         input  logic                                 xreg_ready_i,
         output logic    [XIF_ID_W              -1:0] xreg_id_o,
         output logic    [4:0]                        xreg_addr_o,
-        output logic    [31:0]                       xreg_data_o
+        output logic    [31:0]                       xreg_data_o,
+
+        // unit activity, only used for simulation statistics
+        output logic    [UNIT_CNT              -1:0] unit_busy_o,
+        output logic    [UNIT_CNT              -1:0] unit_stall_o
     );
 
     logic [UNIT_CNT-1:0] unit_in_valid;
@@ -111,6 +117,7 @@ module vproc_unit_mux import vproc_pkg::*; #(
                 ) unit_xif ();
                 logic                pending_load;
                 logic                pending_store;
+                dispatch_stall       lsu_stall_cause;
                 logic                trans_complete_valid;
                 logic                trans_complete_ready;
                 logic [XIF_ID_W-1:0] trans_complete_id;
@@ -165,6 +172,7 @@ module vproc_unit_mux import vproc_pkg::*; #(
                     .pending_store_o           ( pending_store              ),
                     .vreg_pend_rd_i            ( vreg_pend_rd_i             ),
                     .instr_state_i             ( instr_state_i              ),
+                    .lsu_stall_cause_o         ( lsu_stall_cause            ),
                     .xif_mem_if                ( unit_xif                   ),
                     .xif_memres_if             ( unit_xif                   ),
                     .trans_complete_valid_o    ( trans_complete_valid       ),
@@ -185,6 +193,7 @@ module vproc_unit_mux import vproc_pkg::*; #(
                 if (op_unit'(i) == UNIT_LSU) begin
                     assign pending_load_o            = pending_load;
                     assign pending_store_o           = pending_store;
+                    assign lsu_stall_cause_o         = lsu_stall_cause;
                     assign xif_mem_if.mem_valid      = unit_xif.mem_valid;
                     assign unit_xif.mem_ready        = xif_mem_if.mem_ready;
                     assign xif_mem_if.mem_req.id     = unit_xif.mem_req.id;
@@ -249,6 +258,24 @@ module vproc_unit_mux import vproc_pkg::*; #(
         {(UNIT_CNT-1){1'b0}}, unit_queue_deq_valid & pipe_out_ready_i
     } << unit_queue_deq_unit;
 
+    // Unit activity: a unit is busy in cycles in which it accepts an operation or
+    // hands a result to the output pipe and stalled in cycles in which an
+    // operation or a result is waiting for it without moving.
+    always_comb begin
+        unit_busy_o  = '0;
+        unit_stall_o = '0;
+        for (int i = 0; i < UNIT_CNT; i++) begin
+            if (UNITS[i]) begin
+                unit_busy_o [i] = (unit_in_valid [i] & unit_in_ready [i]) |
+                                  (unit_out_valid[i] & unit_out_ready[i]);
+                unit_stall_o[i] = ~unit_busy_o[i] & (
+                                      (pipe_in_valid_i & (pipe_in_ctrl_i.unit == op_unit'(i))) |
+                                      unit_out_valid[i]
+                                  );
+            end
+        end
+    end
+
     // Output logic
     always_comb begin
         pipe_out_valid_o          = '0;
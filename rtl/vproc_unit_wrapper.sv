@@ -50,6 +50,8 @@ module vproc_unit_wrapper import vproc_pkg::*; #(
 
         input  instr_state [XIF_ID_CNT         -1:0] instr_state_i,
 
+        output dispatch_stall                        lsu_stall_cause_o,
+
         vproc_xif.coproc_mem                         xif_mem_if,
         vproc_xif.coproc_mem_result                  xif_memres_if,
 
@@ -102,6 +104,7 @@ module vproc_unit_wrapper import vproc_pkg::*; #(
                 .pending_store_o          ( pending_store_o                             ),
                 .vreg_pend_rd_i           ( vreg_pend_rd_i                              ),
                 .instr_state_i            ( instr_state_i                               ),
+                .stall_cause_o            ( lsu_stall_cause_o                           ),
                 .trans_complete_valid_o   ( trans_complete_valid_o                      ),
                 .trans_complete_ready_i   ( trans_complete_ready_i                      ),
                 .trans_complete_id_o      ( trans_complete_id_o                         ),
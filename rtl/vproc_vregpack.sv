@@ -62,7 +62,10 @@ module vproc_vregpack #(
 
         // Signals that this instruction ID is done
         output logic                                instr_done_valid_o,
-        output logic   [INSTR_ID_W            -1:0] instr_done_id_o
+        output logic   [INSTR_ID_W            -1:0] instr_done_id_o,
+
+        // Reason the stage is stalled, only used for simulation statistics
+        output vproc_pkg::dispatch_stall            stall_cause_o
     );
 
     import vproc_pkg::*;
@@ -157,6 +160,23 @@ module vproc_vregpack #(
 
     assign pipe_in_ready_o = stage_ready;
 
+    // Reason the stage does not advance (DISPATCH_ISSUED if it does), sampled
+    // through the pipeline by the simulation harness
+    always_comb begin
+        stall_cause_o = DISPATCH_ISSUED;
+        if (stage_valid_q & (stage_state_q.res_store != '0)) begin
+            if (pending_vreg_reads_i[stage_state_q.vaddr]) begin
+                stall_cause_o = DISPATCH_WAR;
+            end
+            else if (instr_speculative) begin
+                stall_cause_o = DISPATCH_COMMIT;
+            end
+            else if (~vreg_wr_ready_i) begin
+                stall_cause_o = DISPATCH_PORT;
+            end
+        end
+    end
+
     assign instr_done_valid_o = stage_valid_q & stage_state_q.instr_done & stage_ready;
     assign instr_done_id_o    = stage_state_q.instr_id;
 
@@ -0,0 +1,45 @@
+// Check of the prebuilt benchmark images (benchmarks/images/): each must load with load_image() (verilator_memory.h) as the @addr hex
+// format, where addresses count words and every token is one little-endian word, and hold the startup code of benchmarks/crt0.S at
+// _start followed by main.
+//
+// Usage: bench_image_test <image>...
+
+#include "verilator_memory.h"
+#include "test_util.h"
+
+#include <stdio.h>
+
+//crt0.S: la sp, __stack_top; li t0, 0x6600; csrs mstatus, t0; call main; 1: j 1b
+static const uint32_t CRT0[] = {0x00020117, 0x00010113, 0x000062b7, 0x60028293, 0x3002a073, 0x00000097, 0x00c080e7, 0x0000006f};
+static const uint32_t MAIN        = sizeof(CRT0);
+static const uint32_t STACK_TOP   = 0x20000;    // __stack_top of benchmarks/link.ld
+
+static void check_image(const char *path){
+    paged_mem mem(STACK_TOP);
+    program_info info;
+    if (!load_image(&mem, path, &info)) {
+        fprintf(stderr, "FAIL: %s does not load\n", path);
+        test_failures++;
+        return;
+    }
+    int mismatches = 0;
+    for (uint32_t i = 0; i < sizeof(CRT0) / sizeof(CRT0[0]); i++) {
+        mismatches += mem.read32(4 * i) != CRT0[i];
+    }
+    //main follows _start and is 32-bit code
+    uint32_t main_insn = mem.read32(MAIN);
+    if (info.entry != 0 || info.load_lo != 0 || info.load_hi <= MAIN || info.load_hi > STACK_TOP || mismatches != 0 ||
+        (main_insn & 3) != 3) {
+        fprintf(stderr, "FAIL: %s: entry 0x%08x, loaded 0x%08x-0x%08x, %d words of _start differ, main 0x%08x\n", path, info.entry,
+                info.load_lo, info.load_hi, mismatches, main_insn);
+        test_failures++;
+    }
+}
+
+int main(int argc, char **argv){
+    CHECK(argc > 1);
+    for (int i = 1; i < argc; i++) {
+        check_image(argv[i]);
+    }
+    return test_result("benchmark images");
+}
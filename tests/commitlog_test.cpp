@@ -0,0 +1,216 @@
+// Self-check of the binary commit log (verilator_commitlog.h): a random stream of xreg, freg and masked vreg commits is written through
+// a small ring buffer, so the writer thread wraps around many times, and converted back to text, which must match the text written by
+// update_*_commit() for the same commits.  The same stream is then compared with commit_check against its text as reference: reordered
+// between register files, with masked bytes changed, with a wrong value and cut short.
+//
+// The logs are written to the working directory.
+
+#include "verilator_commitlog.h"
+#include "test_util.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+static const uint32_t VREG_W     = 256;
+static const uint32_t VREG_BYTES = VREG_W / 8;
+
+struct commit {
+    commit_kind                kind;
+    uint32_t                   reg;
+    uint32_t                   value;
+    std::vector<unsigned char> data;
+    std::vector<unsigned char> mask;
+};
+
+static std::vector<commit> random_commits(size_t n, uint32_t seed){
+    std::mt19937 rng(seed);
+    std::vector<commit> commits(n);
+    for (commit &c : commits) {
+        c.kind  = (commit_kind)(rng() % 3);
+        c.reg   = rng() % 32;
+        c.value = rng();
+        if (c.kind == COMMIT_VREG) {
+            c.data.resize(VREG_BYTES);
+            c.mask.resize((VREG_BYTES + 7) / 8);
+            for (unsigned char &b : c.data) {
+                b = (unsigned char)rng();
+            }
+            for (unsigned char &b : c.mask) {
+                b = (rng() % 4 == 0) ? (unsigned char)rng() : 0xff;
+            }
+        }
+    }
+    return commits;
+}
+
+//the text update_xreg_commit(), update_freg_commit() and update_vreg_commit() write for a commit
+static std::string commit_text(const commit &c){
+    char buf[16];
+    if (c.kind != COMMIT_VREG) {
+        snprintf(buf, sizeof(buf), "%c%d 0x%08x\n", c.kind == COMMIT_XREG ? 'x' : 'f', c.reg, c.value);
+        return buf;
+    }
+    snprintf(buf, sizeof(buf), "v%d 0x", c.reg);
+    std::string s = buf;
+    for (int i = VREG_BYTES - 1; i >= 0; i--) {
+        if (c.mask[i/8] & (1 << (i%8))) {
+            snprintf(buf, sizeof(buf), "%02x", c.data[i]);
+            s += buf;
+        } else {
+            s += "XX";
+        }
+    }
+    return s + "\n";
+}
+
+static std::string read_file(const char *path){
+    std::string s;
+    FILE *in = fopen(path, "rb");
+    if (in == NULL) {
+        return s;
+    }
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), in)) > 0) {
+        s.append(buf, n);
+    }
+    fclose(in);
+    return s;
+}
+
+static void check_round_trip(){
+    std::vector<commit> commits = random_commits(20000, 1);
+    commit_log log;
+    CHECK(log.open("commitlog_test.bin", VREG_W, 4096));
+    std::string expected;
+    for (const commit &c : commits) {
+        if (c.kind == COMMIT_XREG) {
+            log.xreg(c.reg, c.value);
+        } else if (c.kind == COMMIT_FREG) {
+            log.freg(c.reg, c.value);
+        } else {
+            log.vreg(c.reg, c.data.data(), c.mask.data());
+        }
+        expected += commit_text(c);
+    }
+    CHECK(log.close());
+
+    FILE *out = fopen("commitlog_test.txt", "wb");
+    CHECK(out != NULL);
+    if (out == NULL) {
+        return;
+    }
+    CHECK(commit_log_to_text("commitlog_test.bin", out));
+    fclose(out);
+    CHECK(read_file("commitlog_test.txt") == expected);
+}
+
+static bool feed(commit_check *check, const commit &c){
+    if (c.kind == COMMIT_XREG) {
+        return check->xreg(c.reg, c.value);
+    } else if (c.kind == COMMIT_FREG) {
+        return check->freg(c.reg, c.value);
+    }
+    return check->vreg(c.reg, c.data.data(), c.mask.data());
+}
+
+static void check_reference(){
+    std::vector<commit> commits = random_commits(5000, 2);
+    FILE *ref = fopen("commitlog_test_ref.txt", "wb");
+    CHECK(ref != NULL);
+    if (ref == NULL) {
+        return;
+    }
+    fprintf(ref, "core   0: 0x00001000 (0x00000013) addi zero, zero, 0\n");     //not a commit, skipped
+    for (const commit &c : commits) {
+        fputs(commit_text(c).c_str(), ref);
+    }
+    fclose(ref);
+
+    //only the order within a register file is checked
+    commit_check check;
+    CHECK(check.open("commitlog_test_ref.txt", VREG_W));
+    bool ok = true;
+    for (int kind : {COMMIT_VREG, COMMIT_FREG, COMMIT_XREG}) {
+        for (const commit &c : commits) {
+            if (c.kind == kind) {
+                ok &= feed(&check, c);
+            }
+        }
+    }
+    CHECK(ok);
+    CHECK(check.finish());
+    CHECK(!check.diverged());
+    CHECK(check.commits() == commits.size());
+
+    //bytes that are XX in the reference match any value
+    CHECK(check.open("commitlog_test_ref.txt", VREG_W));
+    ok = true;
+    for (commit c : commits) {
+        if (c.kind == COMMIT_VREG) {
+            for (uint32_t i = 0; i < VREG_BYTES; i++) {
+                if (!(c.mask[i/8] & (1 << (i%8)))) {
+                    c.data[i] ^= 0x5a;
+                }
+            }
+            std::fill(c.mask.begin(), c.mask.end(), 0xff);
+        }
+        ok &= feed(&check, c);
+    }
+    CHECK(ok);
+    CHECK(check.finish());
+
+    //the first wrong value diverges, later commits are ignored
+    size_t bad = commits.size() / 2;
+    while (commits[bad].kind != COMMIT_XREG) {
+        bad++;
+    }
+    CHECK(check.open("commitlog_test_ref.txt", VREG_W));
+    check.at(1234, 0x1000);
+    for (size_t i = 0; i < commits.size(); i++) {
+        commit c = commits[i];
+        if (i == bad) {
+            c.value ^= 1;
+        }
+        CHECK(feed(&check, c) == (i < bad));
+    }
+    CHECK(check.diverged());
+    CHECK(check.commits() == bad);
+    CHECK(!check.finish());
+
+    //commits left in the reference fail at the end
+    CHECK(check.open("commitlog_test_ref.txt", VREG_W));
+    for (size_t i = 0; i + 1 < commits.size(); i++) {
+        feed(&check, commits[i]);
+    }
+    CHECK(!check.diverged());
+    CHECK(!check.finish());
+    CHECK(check.diverged());
+}
+
+static void check_write_error(){
+#ifdef __linux__
+    //the header fits into the stdio buffer, the records do not
+    commit_log log;
+    if (!log.open("/dev/full", VREG_W, 4096)) {
+        return;
+    }
+    unsigned char data[VREG_BYTES] = {0}, mask[(VREG_BYTES + 7) / 8] = {0};
+    for (int i = 0; i < 10000; i++) {
+        log.vreg(1, data, mask);
+    }
+    CHECK(!log.close());
+#endif
+}
+
+int main(){
+    check_round_trip();
+    check_reference();
+    check_write_error();
+    return test_result("commit log");
+}
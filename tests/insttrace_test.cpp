@@ -0,0 +1,151 @@
+// Self-check of the binary instruction trace (verilator_insttrace.h): a synthetic write-back stream, in which the PC changes on every
+// retirement the way update_instructions() detects it, is traced with a gap and small chunks, decoded again and compared cycle by
+// cycle.  The retirements must come back as NEW PC records, and the index lookups must find the first retirement of a PC the way
+// insttrace_decode -p does.
+//
+// A trace written to a full disk must fail to close.  The traces are written to the working directory.
+
+#include "verilator_insttrace.h"
+#include "test_util.h"
+
+#include <stdio.h>
+
+#include <random>
+#include <vector>
+
+static const uint64_t CYCLES    = 200000;
+static const uint64_t GAP_BEGIN = 50000;    // cycles [GAP_BEGIN, GAP_END) are not traced, like a closed trigger window
+static const uint64_t GAP_END   = 60000;
+
+struct wb_state {
+    bool     traced;
+    bool     retired;
+    uint32_t pc;
+    uint32_t instr;
+    uint32_t vl;
+    uint32_t vtype;
+};
+
+static std::vector<wb_state> wb_stream(){
+    std::mt19937 rng(7);
+    std::vector<wb_state> stream(CYCLES);
+    uint32_t pc = 0x1000, last_pc = 0, vl = 0, vtype = 0;
+    for (uint64_t c = 0; c < CYCLES; c++) {
+        if (rng() % 3 == 0) {
+            pc = (rng() % 8 == 0) ? 0x1000 + (rng() % 1024) * 4 : pc + 4;
+        }
+        if (rng() % 500 == 0) {
+            vl    = rng() % 65;
+            vtype = rng() & 0xff;
+        }
+        //a retirement is a change of the write-back PC
+        stream[c] = {c < GAP_BEGIN || c >= GAP_END, pc != last_pc, pc, pc * 0x9e3779b1u, vl, vtype};
+        last_pc = pc;
+    }
+    return stream;
+}
+
+static void check_round_trip(const std::vector<wb_state> &stream, bool vcsr){
+    const char *path = vcsr ? "insttrace_test_vcsr.bin" : "insttrace_test.bin";
+    inst_trace_log log;
+    CHECK(log.open(path, vcsr, 4096));
+    for (uint64_t c = 0; c < CYCLES; c++) {
+        const wb_state &s = stream[c];
+        if (s.traced) {
+            log.cycle(c, s.retired, s.pc, s.instr, s.vl, s.vtype);
+        }
+    }
+    CHECK(log.close());
+
+    inst_trace_reader in;
+    CHECK(in.open(path));
+    CHECK(((in.flags() & INST_TRACE_VCSR) != 0) == vcsr);
+    CHECK(in.chunks().size() > 10);
+
+    std::vector<inst_trace_record> recs;
+    std::vector<bool> seen(CYCLES, false);
+    uint64_t retirements = 0, mismatches = 0;
+    for (size_t i = 0; i < in.chunks().size(); i++) {
+        CHECK(in.read_chunk(i, &recs));
+        CHECK(recs.size() == in.chunks()[i].records);
+        for (const inst_trace_record &rec : recs) {
+            CHECK(rec.run >= 1 && rec.cycle + rec.run <= CYCLES);
+            for (uint64_t c = rec.cycle; c < rec.cycle + rec.run && c < CYCLES; c++) {
+                const wb_state &s = stream[c];
+                bool retired = (c == rec.cycle) && rec.new_pc;
+                if (!s.traced || seen[c] || retired != s.retired || rec.pc != s.pc || rec.instr != s.instr ||
+                    rec.vl != (vcsr ? s.vl : 0) || rec.vtype != (vcsr ? s.vtype : 0)) {
+                    mismatches++;
+                }
+                seen[c] = true;
+                retirements += retired;
+            }
+        }
+    }
+    CHECK(mismatches == 0);
+    uint64_t traced = 0, expected_retirements = 0;
+    for (uint64_t c = 0; c < CYCLES; c++) {
+        traced               += stream[c].traced;
+        expected_retirements += stream[c].traced && stream[c].retired;
+        if (stream[c].traced && !seen[c]) {
+            mismatches++;
+        }
+    }
+    CHECK(mismatches == 0);
+    CHECK(traced == CYCLES - (GAP_END - GAP_BEGIN));
+    CHECK(retirements == expected_retirements);
+    CHECK(retirements > CYCLES / 4);
+
+    //first retirement of a PC at or after a cycle, looked up like insttrace_decode -p -b
+    for (uint64_t begin : {(uint64_t)0, GAP_BEGIN, CYCLES / 2}) {
+        uint32_t pc = stream[begin + 1000].pc;
+        uint64_t expected = CYCLES;
+        for (uint64_t c = begin; c < CYCLES; c++) {
+            if (stream[c].traced && stream[c].retired && stream[c].pc == pc) {
+                expected = c;
+                break;
+            }
+        }
+        uint64_t found = CYCLES;
+        for (size_t i = in.find_pc(pc, in.find_cycle(begin)); i < in.chunks().size() && found == CYCLES; i = in.find_pc(pc, i + 1)) {
+            CHECK(in.read_chunk(i, &recs));
+            for (const inst_trace_record &rec : recs) {
+                if (rec.new_pc && rec.pc == pc && rec.cycle >= begin) {
+                    found = rec.cycle;
+                    break;
+                }
+            }
+        }
+        CHECK(expected != CYCLES);
+        CHECK(found == expected);
+    }
+
+    //the chunk find_cycle() returns holds the cycle
+    for (uint64_t c : {(uint64_t)0, GAP_BEGIN - 1, GAP_END, CYCLES - 1}) {
+        size_t i = in.find_cycle(c);
+        CHECK(i < in.chunks().size() && in.chunks()[i].first_cycle <= c && in.chunks()[i].last_cycle >= c);
+    }
+    CHECK(in.find_cycle(CYCLES) == in.chunks().size());
+}
+
+static void check_write_error(){
+#ifdef __linux__
+    //the header fits into the stdio buffer, the chunks do not
+    inst_trace_log log;
+    if (!log.open("/dev/full", true, 4096)) {
+        return;
+    }
+    for (uint64_t c = 0; c < 100000; c++) {
+        log.cycle(c, true, 0x1000 + 4 * (uint32_t)c, (uint32_t)c * 0x9e3779b1u, 0, 0);
+    }
+    CHECK(!log.close());
+#endif
+}
+
+int main(){
+    std::vector<wb_state> stream = wb_stream();
+    check_round_trip(stream, true);
+    check_round_trip(stream, false);
+    check_write_error();
+    return test_result("instruction trace");
+}
@@ -0,0 +1,163 @@
+// Self-check of the memory hierarchy timing model (mem_timing in verilator_memory.h): the latencies of single accesses and of
+// accesses contending for ports, SRAM banks and bandwidth, cache hits, misses and LRU replacement, the write policies, latency
+// clamping and the configuration parser.
+
+#include "verilator_memory.h"
+#include "test_util.h"
+
+#include <stdio.h>
+
+//let all pending accesses complete
+static void idle(mem_timing *timing, int cycles = 64){
+    for (int i = 0; i < cycles; i++) {
+        timing->cycle();
+    }
+}
+
+static void check_ports(){
+    mem_timing_config cfg;
+    cfg.sram_lat = 4;
+    mem_timing timing(cfg);
+    int r = timing.add_requester("test");
+    CHECK(timing.access(r, 0x100, false, 4) == 4);
+    idle(&timing);
+
+    //one port: accesses of the same cycle are accepted one per cycle, the backlog carries over
+    CHECK(timing.access(r, 0x100, false, 4) == 4);
+    CHECK(timing.access(r, 0x200, false, 4) == 5);
+    CHECK(timing.access(r, 0x300, true,  4) == 6);
+    timing.cycle();
+    CHECK(timing.access(r, 0x400, false, 4) == 6);
+    idle(&timing);
+
+    cfg.ports = 2;
+    mem_timing dual(cfg);
+    r = dual.add_requester("test");
+    CHECK(dual.access(r, 0x100, false, 4) == 4);
+    CHECK(dual.access(r, 0x200, false, 4) == 4);
+    CHECK(dual.access(r, 0x300, false, 4) == 5);
+}
+
+static void check_sram(){
+    mem_timing_config cfg;
+    cfg.ports       = 4;
+    cfg.sram_lat    = 2;
+    cfg.sram_banks  = 4;
+    cfg.sram_bank_w = 4;
+    mem_timing timing(cfg);
+    int r = timing.add_requester("test");
+
+    //different banks start together, the same bank one word per cycle
+    CHECK(timing.access(r, 0x00, false, 4) == 2);
+    CHECK(timing.access(r, 0x04, false, 4) == 2);
+    CHECK(timing.access(r, 0x10, false, 4) == 3);
+    idle(&timing);
+    //16 bytes occupy all four banks for one cycle
+    CHECK(timing.access(r, 0x20, false, 16) == 2);
+    CHECK(timing.access(r, 0x48, false, 4) == 3);
+    idle(&timing);
+
+    cfg.sram_banks = 0;
+    cfg.sram_bw    = 4;
+    mem_timing bw(cfg);
+    r = bw.add_requester("test");
+    //16 bytes at 4 bytes per cycle take 4 cycles, the next access waits for the bandwidth
+    CHECK(bw.access(r, 0x00, false, 16) == 5);
+    CHECK(bw.access(r, 0x40, false, 4) == 6);
+}
+
+static void check_cache(){
+    mem_timing_config cfg;
+    cfg.cache_size = 1024;
+    cfg.cache_ways = 2;
+    cfg.cache_line = 32;
+    cfg.hit_lat    = 1;
+    cfg.sram_lat   = 4;
+    mem_timing timing(cfg);
+    int r = timing.add_requester("test");
+
+    //a miss fills the line after the lookup
+    CHECK(timing.access(r, 0x100, false, 4) == 5);
+    idle(&timing);
+    CHECK(timing.access(r, 0x11c, false, 4) == 1);
+    idle(&timing);
+    //an access crossing into a missing line waits for its fill
+    CHECK(timing.access(r, 0x11c, false, 8) == 5);
+    idle(&timing);
+    CHECK(timing.access(r, 0x120, false, 4) == 1);
+    idle(&timing);
+
+    //0x000, 0x200 and 0x400 map to the same set of 2 ways, the least recently used is replaced
+    CHECK(timing.access(r, 0x000, false, 4) == 5);
+    idle(&timing);
+    CHECK(timing.access(r, 0x200, false, 4) == 5);
+    idle(&timing);
+    CHECK(timing.access(r, 0x000, false, 4) == 1);
+    idle(&timing);
+    CHECK(timing.access(r, 0x400, false, 4) == 5);
+    idle(&timing);
+    CHECK(timing.access(r, 0x000, false, 4) == 1);
+    idle(&timing);
+    CHECK(timing.access(r, 0x200, false, 4) == 5);
+    idle(&timing);
+
+    //write-back allocates on a store miss
+    CHECK(timing.access(r, 0x800, true, 4) == 5);
+    idle(&timing);
+    CHECK(timing.access(r, 0x800, false, 4) == 1);
+    idle(&timing);
+
+    //write-through does not, stores complete after the lookup
+    cfg.write_back = false;
+    mem_timing wt(cfg);
+    r = wt.add_requester("test");
+    CHECK(wt.access(r, 0x800, true, 4) == 1);
+    idle(&wt);
+    CHECK(wt.access(r, 0x800, false, 4) == 5);
+    idle(&wt);
+    CHECK(wt.access(r, 0x800, true, 4) == 1);
+
+    //reset() invalidates the cache
+    wt.reset();
+    CHECK(wt.access(r, 0x800, false, 4) == 5);
+}
+
+static void check_clamp(){
+    mem_timing_config cfg;
+    cfg.sram_lat = 10;
+    cfg.max_lat  = 6;
+    mem_timing timing(cfg);
+    int r = timing.add_requester("test");
+    CHECK(timing.access(r, 0, false, 4) == 6);
+    CHECK(timing.max_latency() == 6);
+}
+
+static void check_parse(){
+    mem_timing_config cfg;
+    CHECK(parse_mem_timing("size=16k,ways=4,line=64,wt,hit_lat=2,sram_lat=5,banks=8,bank_w=8,bw=16,ports=2", &cfg));
+    CHECK(cfg.cache_size == 16384);
+    CHECK(cfg.cache_ways == 4);
+    CHECK(cfg.cache_line == 64);
+    CHECK(!cfg.write_back);
+    CHECK(cfg.hit_lat == 2);
+    CHECK(cfg.sram_lat == 5);
+    CHECK(cfg.sram_banks == 8);
+    CHECK(cfg.sram_bank_w == 8);
+    CHECK(cfg.sram_bw == 16);
+    CHECK(cfg.ports == 2);
+    //keys not given keep their value
+    CHECK(parse_mem_timing("wb", &cfg));
+    CHECK(cfg.write_back);
+    CHECK(cfg.cache_size == 16384);
+    CHECK(!parse_mem_timing("size", &cfg));
+    CHECK(!parse_mem_timing("nonsense=1", &cfg));
+}
+
+int main(){
+    check_ports();
+    check_sram();
+    check_cache();
+    check_clamp();
+    check_parse();
+    return test_result("mem_timing");
+}
@@ -0,0 +1,205 @@
+// Self-check of paged_mem (verilator_memory.h): reads of unwritten pages, accesses crossing page boundaries, masked writes, the
+// copy-on-write sharing of forks, dirty page tracking, and the placement of expected images by load_mem_image().
+//
+// The images are written to the working directory.
+
+#include "verilator_memory.h"
+#include "test_util.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <utility>
+#include <vector>
+
+static void check_zero_pages(){
+    paged_mem mem(1ull << 20);
+    CHECK(mem.read32(0x1234) == 0);
+    CHECK(mem.read32(0xffffc) == 0);
+    CHECK(mem.pages() == 0);
+    CHECK(mem.in_range(0xffffc, 4));
+    CHECK(!mem.in_range(0xffffd, 4));
+    CHECK(!mem.in_range(0x100000, 1));
+}
+
+static void check_page_crossing(){
+    paged_mem mem(1ull << 20);
+    std::vector<unsigned char> src(3 * paged_mem::PAGE_SIZE), dst(src.size());
+    for (size_t i = 0; i < src.size(); i++) {
+        src[i] = (unsigned char)(i * 7 + 1);
+    }
+    uint32_t address = paged_mem::PAGE_SIZE - 5;
+    mem.write(address, src.data(), (uint32_t)src.size());
+    CHECK(mem.pages() == 4);
+    mem.read(address, dst.data(), (uint32_t)dst.size());
+    CHECK(dst == src);
+    CHECK(mem.read32(address - 4) == 0);
+}
+
+static void check_masked_write(){
+    paged_mem mem(1ull << 20);
+    unsigned char src[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+    unsigned char be[1]  = {0xa5};
+    uint32_t address = paged_mem::PAGE_SIZE - 4;
+    mem.write_masked(address, src, be, 8);
+    unsigned char got[8];
+    mem.read(address, got, 8);
+    for (int i = 0; i < 8; i++) {
+        CHECK(got[i] == (((be[0] >> i) & 1) ? src[i] : 0));
+    }
+}
+
+static void check_fork(){
+    paged_mem mem(1ull << 20);
+    unsigned char a[16], b[16];
+    memset(a, 0xaa, sizeof(a));
+    memset(b, 0xbb, sizeof(b));
+    mem.write(0x1000, a, sizeof(a));
+    mem.write(0x3000, a, sizeof(a));
+
+    paged_mem *child = mem.fork();
+    CHECK(child->pages() == 2);
+    CHECK(child->read32(0x1000) == 0xaaaaaaaa);
+    CHECK(mem.page_rd(0x1000) == child->page_rd(0x1000));
+
+    //a write to a shared page copies it for the writer only
+    child->write(0x1004, b, 4);
+    CHECK(child->read32(0x1004) == 0xbbbbbbbb);
+    CHECK(child->read32(0x1000) == 0xaaaaaaaa);
+    CHECK(mem.read32(0x1004) == 0xaaaaaaaa);
+    CHECK(mem.page_rd(0x1000) != child->page_rd(0x1000));
+    CHECK(mem.page_rd(0x3000) == child->page_rd(0x3000));
+
+    //the parent breaks sharing the same way
+    mem.write(0x3000, b, 4);
+    CHECK(mem.read32(0x3000) == 0xbbbbbbbb);
+    CHECK(child->read32(0x3000) == 0xaaaaaaaa);
+
+    //pages allocated after the fork are private
+    child->write(0x5000, b, 4);
+    CHECK(mem.read32(0x5000) == 0);
+    CHECK(child->pages() == 3);
+
+    //the parent's pages outlive the fork
+    delete child;
+    CHECK(mem.read32(0x1004) == 0xaaaaaaaa);
+    CHECK(mem.read32(0x3000) == 0xbbbbbbbb);
+
+    mem.clear();
+    CHECK(mem.pages() == 0);
+    CHECK(mem.read32(0x1000) == 0);
+}
+
+static std::vector<std::pair<uint32_t, uint32_t>> dirty_ranges(const dirty_pages &dirty, uint32_t lo, uint64_t hi){
+    std::vector<std::pair<uint32_t, uint32_t>> ranges;
+    dirty.for_each_range(lo, hi, [&ranges](uint32_t address, uint32_t len) {
+        ranges.push_back({address, len});
+    });
+    return ranges;
+}
+
+static void check_dirty(){
+    typedef std::vector<std::pair<uint32_t, uint32_t>> range_list;
+    paged_mem mem(1ull << 20);
+    unsigned char data[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+    CHECK(mem.dirty().count() == 0);
+    mem.write(0x1000, data, 4);
+    mem.write(0x2ffe, data, 4);
+    CHECK(mem.dirty().count() == 3);
+    CHECK(mem.dirty().test(0x1000) && mem.dirty().test(0x2000) && mem.dirty().test(0x3000));
+    CHECK(!mem.dirty().test(0x4000));
+    CHECK((dirty_ranges(mem.dirty(), 0, mem.size()) == range_list{{0x1000, 0x3000}}));
+    CHECK((dirty_ranges(mem.dirty(), 0x1800, 0x2800) == range_list{{0x1800, 0x1000}}));
+
+    //pages partially in the range stay marked
+    mem.clear_dirty(0x1800, 0x4000);
+    CHECK(mem.dirty().count() == 1);
+    CHECK(mem.dirty().test(0x1000));
+
+    //the cached write page is marked again after clearing
+    mem.write(0x3004, data, 4);
+    CHECK(mem.dirty().test(0x3000));
+    mem.clear_dirty();
+    CHECK(mem.dirty().count() == 0);
+    mem.write(0x3008, data, 4);
+    CHECK(mem.dirty().count() == 1);
+
+    //a fork starts clean and tracks its own writes
+    mem.clear_dirty();
+    paged_mem *child = mem.fork();
+    CHECK(child->dirty().count() == 0);
+    child->write(0x1000, data, 4);
+    CHECK(child->dirty().test(0x1000));
+    CHECK(mem.dirty().count() == 0);
+    delete child;
+
+    //released pages read as zero, so they changed
+    mem.clear();
+    CHECK(mem.dirty().test(0x1000) && mem.dirty().test(0x3000));
+
+    //ranges are clipped to the bounds given, not to whole pages
+    dirty_pages flat(10000);
+    flat.mark(9000, 1000);
+    CHECK((dirty_ranges(flat, 0, 10000) == range_list{{0x2000, 10000 - 0x2000}}));
+    flat.clear(0, 10000);
+    CHECK(flat.count() == 1);
+    flat.clear(0, 0x3000);
+    CHECK(flat.count() == 0);
+}
+
+static bool write_file(const char *path, const std::vector<unsigned char> &data){
+    FILE *out = fopen(path, "wb");
+    if (out == NULL) {
+        return false;
+    }
+    bool ok = fwrite(data.data(), 1, data.size(), out) == data.size();
+    return fclose(out) == 0 && ok;
+}
+
+template <typename T> static void put(std::vector<unsigned char> *v, size_t off, T x){
+    memcpy(v->data() + off, &x, sizeof(x));
+}
+
+static void check_image_base(){
+    //raw binary images are placed at base
+    std::vector<unsigned char> bin = {0x44, 0x33, 0x22, 0x11, 0x88, 0x77, 0x66, 0x55};
+    CHECK(write_file("paged_mem_test.bin", bin));
+    mem_image img;
+    CHECK(load_mem_image(&img, "paged_mem_test.bin", 0x2000));
+    CHECK(img.ranges.size() == 1 && img.ranges[0].lo == 0x2000 && img.ranges[0].hi == 0x2008);
+    CHECK(img.mem.read32(0x2000) == 0x11223344 && img.mem.read32(0x2004) == 0x55667788);
+
+    //ELF segments keep their address: ELF32 header, one PT_LOAD program header at 52, 8 bytes of data at 84 loaded to 0x3000
+    std::vector<unsigned char> elf(92, 0);
+    memcpy(elf.data(), "\x7f" "ELF\x01\x01\x01", 7);
+    put<uint16_t>(&elf, 16, 2);             //e_type
+    put<uint16_t>(&elf, 18, 243);           //e_machine
+    put<uint32_t>(&elf, 20, 1);             //e_version
+    put<uint32_t>(&elf, 24, 0x3000);        //e_entry
+    put<uint32_t>(&elf, 28, 52);            //e_phoff
+    put<uint16_t>(&elf, 40, 52);            //e_ehsize
+    put<uint16_t>(&elf, 42, 32);            //e_phentsize
+    put<uint16_t>(&elf, 44, 1);             //e_phnum
+    put<uint32_t>(&elf, 52, 1);             //p_type
+    put<uint32_t>(&elf, 56, 84);            //p_offset
+    put<uint32_t>(&elf, 60, 0x3000);        //p_vaddr
+    put<uint32_t>(&elf, 64, 0x3000);        //p_paddr
+    put<uint32_t>(&elf, 68, 8);             //p_filesz
+    put<uint32_t>(&elf, 72, 8);             //p_memsz
+    memcpy(elf.data() + 84, bin.data(), 8);
+    CHECK(write_file("paged_mem_test.elf", elf));
+    CHECK(load_mem_image(&img, "paged_mem_test.elf", 0x2000));
+    CHECK(img.ranges.size() == 1 && img.ranges[0].lo == 0x3000 && img.ranges[0].hi == 0x3008);
+    CHECK(img.mem.read32(0x3004) == 0x55667788);
+    CHECK(img.mem.read32(0x5000) == 0);
+}
+
+int main(){
+    check_zero_pages();
+    check_page_crossing();
+    check_masked_write();
+    check_fork();
+    check_dirty();
+    check_image_base();
+    return test_result("paged_mem");
+}
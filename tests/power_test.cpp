@@ -0,0 +1,143 @@
+// Self-check of the switching-activity counters (verilator_power.h): every toggle counting kernel supported by the host against a
+// bit-by-bit reference for all lengths up to 1100 bytes and unaligned buffers, the attribution of cycles to the regions built from
+// nested and overlapping symbols, and the energy of the events.
+//
+// The energy table and CSV are written to the working directory.
+
+#include "verilator_power.h"
+#include "test_util.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+static uint64_t toggle_count_bits(const unsigned char *prev, const unsigned char *cur, uint32_t len){
+    uint64_t n = 0;
+    for (uint32_t i = 0; i < len; i++) {
+        for (int b = 0; b < 8; b++) {
+            n += ((prev[i] ^ cur[i]) >> b) & 1;
+        }
+    }
+    return n;
+}
+
+static void check_kernels(){
+    std::mt19937 rng(11);
+    int kernels = 0;
+    for (int isa = 0; isa < TOGGLE_COUNT_ISA_CNT; isa++) {
+        toggle_count_fn fn = toggle_count_kernel((toggle_count_isa)isa);
+        if (fn == NULL) {
+            continue;
+        }
+        kernels++;
+        int mismatches = 0;
+        for (uint32_t len = 0; len <= 1100; len++) {
+            //odd offsets make the buffers unaligned
+            uint32_t off = len % 7;
+            std::vector<unsigned char> prev(len + off), cur(len + off);
+            for (size_t i = 0; i < prev.size(); i++) {
+                prev[i] = (unsigned char)rng();
+                cur[i]  = (len % 3 == 0) ? prev[i] : (unsigned char)rng();
+            }
+            uint64_t expected = toggle_count_bits(prev.data() + off, cur.data() + off, len);
+            if (fn(prev.data() + off, cur.data() + off, len) != expected || memcmp(prev.data() + off, cur.data() + off, len) != 0) {
+                mismatches++;
+            }
+        }
+        if (mismatches != 0) {
+            fprintf(stderr, "FAIL: toggle counting kernel %s differs from the reference for %d lengths\n",
+                    toggle_count_name((toggle_count_isa)isa), mismatches);
+            test_failures++;
+        }
+    }
+    CHECK(kernels >= 1);
+    CHECK(toggle_count_kernel(TOGGLE_COUNT_SCALAR) != NULL);
+    CHECK(toggle_count_kernel(toggle_count_selected()) != NULL);
+
+    unsigned char prev[5] = {0x00, 0xff, 0x0f, 0x01, 0x80}, cur[5] = {0xff, 0xff, 0xf0, 0x00, 0x80};
+    CHECK(toggle_count(prev, cur, 5) == 17);
+    CHECK(toggle_count(prev, cur, 5) == 0);
+}
+
+static std::map<std::string, uint64_t> region_cycles(const power_counters &pwr){
+    std::map<std::string, uint64_t> cycles;
+    if (!pwr.write_csv("power_test.csv")) {
+        return cycles;
+    }
+    FILE *in = fopen("power_test.csv", "r");
+    char line[256];
+    while (in != NULL && fgets(line, sizeof(line), in) != NULL) {
+        char *event = strchr(line, ',');
+        if (event == NULL) {
+            continue;
+        }
+        *event++ = '\0';
+        if (strncmp(event, "cycle,", 6) == 0) {
+            cycles[line] = strtoull(event + 6, NULL, 10);
+        }
+    }
+    if (in != NULL) {
+        fclose(in);
+    }
+    return cycles;
+}
+
+static void check_regions(){
+    static const char *const units[] = {"VALU", "VMUL"};
+    program_info info;
+    info.load_hi = 0x3000;
+    info.symbols = {{0x1000, 0x100, "outer"},       // holds inner, overlaps the start of overlap
+                    {0x1010, 0x010, "inner"},
+                    {0x10f0, 0x040, "overlap"},
+                    {0x1200, 0x000, "nosize"},      // extends to the next symbol
+                    {0x1300, 0x020, "last"}};
+    power_counters pwr(2, units, &info);
+
+    //the PCs outside all regions make every following PC go through the region lookup
+    std::map<std::string, uint64_t> expected = {{"outer", 3}, {"overlap", 1}, {"nosize", 2}, {"last", 1}, {"[other]", 4}};
+    for (uint32_t pc : {0x1000u, 0x0ffcu, 0x1014u, 0x0ffcu, 0x10f8u, 0x0ffcu, 0x1100u, 0x1210u, 0x12fcu, 0x1310u, 0x1320u}) {
+        pwr.cycle(pc);
+    }
+    CHECK(region_cycles(pwr) == expected);
+    CHECK(pwr.count(PWR_CYCLE) == 11);
+}
+
+static void check_energy(){
+    static const char *const units[] = {"VALU", "VMUL"};
+    FILE *out = fopen("power_test_energy.txt", "w");
+    CHECK(out != NULL);
+    if (out == NULL) {
+        return;
+    }
+    fprintf(out, "# energy per event\ncycle 2\nvalu_busy 0.5\nvmul_stall 0.25\n");
+    fclose(out);
+
+    power_counters pwr(2, units);
+    CHECK(pwr.load_energy("power_test_energy.txt"));
+    for (int c = 0; c < 10; c++) {
+        pwr.cycle(0x1000 + 4 * c);
+        pwr.unit_activity(64, 1, 2);
+    }
+    CHECK(pwr.count(PWR_CYCLE) == 10);
+    CHECK(pwr.count(PWR_UNIT_EVENTS) == 640);
+    CHECK(pwr.count(PWR_UNIT_EVENTS + 2 + 1) == 640);
+    CHECK(pwr.energy() == 10 * 2.0 + 640 * 0.5 + 640 * 0.25);
+
+    out = fopen("power_test_energy.txt", "w");
+    fprintf(out, "vdiv_busy 1\n");
+    fclose(out);
+    CHECK(!pwr.load_energy("power_test_energy.txt"));
+}
+
+int main(){
+    check_kernels();
+    check_regions();
+    check_energy();
+    printf("toggle counting: %s\n", toggle_count_name(toggle_count_selected()));
+    return test_result("power counters");
+}
@@ -0,0 +1,28 @@
+// Helpers shared by the self-checks in tests/: a failed CHECK() reports its condition and location and the test carries on, so one
+// run lists every failure; test_result() turns the count into the exit status ctest expects.
+
+#ifndef TEST_UTIL_H
+#define TEST_UTIL_H
+
+#include <stdio.h>
+
+inline int test_failures = 0;
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            fprintf(stderr, "FAIL: %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+            test_failures++; \
+        } \
+    } while (0)
+
+//print the outcome of the checks of what, returns the exit status of the test
+inline int test_result(const char *what){
+    if (test_failures != 0) {
+        fprintf(stderr, "%s: %d checks failed\n", what, test_failures);
+        return 1;
+    }
+    printf("%s: all checks passed\n", what);
+    return 0;
+}
+
+#endif
@@ -0,0 +1,29 @@
+// Converts a binary commit log written through commit_log (verilator_commitlog.h) into the spike-compatible text format
+// written by update_xreg_commit(), update_freg_commit() and update_vreg_commit().
+//
+// Usage: commitlog_convert <binary log> [text output, default stdout]
+
+#include "verilator_commitlog.h"
+
+#include <errno.h>
+#include <string.h>
+
+int main(int argc, char **argv){
+    if (argc < 2 || argc > 3) {
+        fprintf(stderr, "Usage: %s <binary log> [text output]\n", argv[0]);
+        return 1;
+    }
+    FILE *out = stdout;
+    if (argc == 3) {
+        out = fopen(argv[2], "w");
+        if (out == NULL) {
+            fprintf(stderr, "ERROR: opening `%s': %s\n", argv[2], strerror(errno));
+            return 1;
+        }
+    }
+    bool ok = commit_log_to_text(argv[1], out);
+    if (out != stdout) {
+        fclose(out);
+    }
+    return ok ? 0 : 1;
+}
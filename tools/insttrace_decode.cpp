@@ -0,0 +1,133 @@
+// Decodes a binary instruction trace written through inst_trace_log (verilator_insttrace.h).  By default it prints the text format
+// written by the FILE overloads of update_inst_trace(); the index is used to start at a cycle or PC without decoding the chunks before it.
+//
+// Usage: insttrace_decode <binary trace> [options]
+//   -o <file>          text output (default stdout)
+//   -b <cycle>         first cycle to print
+//   -e <cycle>         cycle to stop at
+//   -p <pc>            start at the first retirement of the instruction at pc (hex with 0x), combined with -b starts at the
+//                      first retirement at or after that cycle
+//   -r                 print the records (cycle, cycles, PC, instruction, vl, vtype) instead of the text trace
+//   -i                 print the chunk index
+
+#include "verilator_insttrace.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+
+static bool print_records(inst_trace_reader &in, FILE *out, uint64_t begin, uint64_t end){
+    std::vector<inst_trace_record> recs;
+    bool vcsr = (in.flags() & INST_TRACE_VCSR) != 0;
+    fprintf(out, "cycle,cycles,new_pc,pc,instr%s\n", vcsr ? ",vl,vtype" : "");
+    for (size_t i = in.find_cycle(begin); i < in.chunks().size(); i++) {
+        if (end != 0 && in.chunks()[i].first_cycle >= end) {
+            break;
+        }
+        if (!in.read_chunk(i, &recs)) {
+            return false;
+        }
+        for (const inst_trace_record &rec : recs) {
+            if (rec.cycle + rec.run <= begin || (end != 0 && rec.cycle >= end)) {
+                continue;
+            }
+            fprintf(out, "%llu,%u,%d,0x%08x,0x%08x", (unsigned long long)rec.cycle, rec.run, rec.new_pc ? 1 : 0, rec.pc, rec.instr);
+            if (vcsr) {
+                fprintf(out, ",%u,0x%08x", rec.vl, rec.vtype);
+            }
+            fprintf(out, "\n");
+        }
+    }
+    return true;
+}
+
+int main(int argc, char **argv){
+    std::string in_path, out_path;
+    uint64_t begin = 0, end = 0;
+    uint32_t pc = 0;
+    bool     have_pc = false, records = false, show_index = false;
+
+    for (int i = 1; i < argc; i++) {
+        std::string opt = argv[i];
+        if (opt == "-r") {
+            records = true;
+        } else if (opt == "-i") {
+            show_index = true;
+        } else if (opt.size() == 2 && opt[0] == '-' && i + 1 < argc) {
+            const char *arg = argv[++i];
+            switch (opt[1]) {
+                case 'o': out_path = arg; break;
+                case 'b': begin = strtoull(arg, NULL, 0); break;
+                case 'e': end   = strtoull(arg, NULL, 0); break;
+                case 'p': pc    = strtoul(arg, NULL, 0); have_pc = true; break;
+                default:
+                    fprintf(stderr, "ERROR: unknown option `%s'\n", opt.c_str());
+                    return 1;
+            }
+        } else if (in_path.empty() && opt[0] != '-') {
+            in_path = opt;
+        } else {
+            fprintf(stderr, "ERROR: unexpected argument `%s'\n", opt.c_str());
+            return 1;
+        }
+    }
+    if (in_path.empty()) {
+        fprintf(stderr, "Usage: %s <binary trace> [-o <text output>] [-b <cycle>] [-e <cycle>] [-p <pc>] [-r] [-i]\n", argv[0]);
+        return 1;
+    }
+
+    inst_trace_reader in;
+    if (!in.open(in_path.c_str())) {
+        return 1;
+    }
+    FILE *out = stdout;
+    if (!out_path.empty()) {
+        out = fopen(out_path.c_str(), "w");
+        if (out == NULL) {
+            fprintf(stderr, "ERROR: opening `%s': %s\n", out_path.c_str(), strerror(errno));
+            return 1;
+        }
+    }
+
+    bool ok = true;
+    if (show_index) {
+        fprintf(out, "chunk,offset,first_cycle,last_cycle,pc_lo,pc_hi,records\n");
+        for (size_t i = 0; i < in.chunks().size(); i++) {
+            const inst_trace_index_entry &e = in.chunks()[i];
+            fprintf(out, "%zu,%llu,%llu,%llu,0x%08x,0x%08x,%u\n", i, (unsigned long long)e.offset, (unsigned long long)e.first_cycle,
+                    (unsigned long long)e.last_cycle, e.pc_lo, e.pc_hi, e.records);
+        }
+    } else {
+        if (have_pc) {
+            //first retirement of pc, only chunks whose PC range holds it are decoded
+            std::vector<inst_trace_record> recs;
+            bool found = false;
+            for (size_t i = in.find_pc(pc, in.find_cycle(begin)); i < in.chunks().size() && !found; i = in.find_pc(pc, i + 1)) {
+                if (!in.read_chunk(i, &recs)) {
+                    ok = false;
+                    break;
+                }
+                for (const inst_trace_record &rec : recs) {
+                    if (rec.new_pc && rec.pc == pc && rec.cycle >= begin) {
+                        begin = rec.cycle;
+                        found = true;
+                        break;
+                    }
+                }
+            }
+            if (ok && !found) {
+                fprintf(stderr, "ERROR: PC 0x%08x does not retire in the trace\n", pc);
+                ok = false;
+            }
+        }
+        if (ok) {
+            ok = records ? print_records(in, out, begin, end) : inst_trace_to_text(in, out, begin, end);
+        }
+    }
+    if (out != stdout) {
+        fclose(out);
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,147 @@
+// Microbenchmark of the byte-enable merge kernels behind update_mem_write() and paged_mem::write_masked() (masked_copy() in
+// verilator_memory.h).  Every kernel supported by the host is first checked against a byte-by-byte reference for all interface widths
+// from 32 to 1024 bits, then timed per memory beat against that reference for the power-of-two widths, together with masked_copy(),
+// which picks a kernel by beat width.
+//
+// Usage: mem_kernel_bench [-n <beats per measurement>]
+// Exits with 1 if a kernel produces a different result than the reference.
+
+#include "verilator_memory.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <random>
+#include <vector>
+
+//the per-byte loop update_mem_write() used before the kernels
+static void masked_copy_bytes(unsigned char *dst, const unsigned char *src, const unsigned char *be, uint32_t len){
+    for (uint32_t i = 0; i < len; i++) {
+        if ((be[i/8] & (1<<(i%8)))) {
+            dst[i] = src[i];
+        }
+    }
+}
+
+enum mask_pattern {
+    MASK_FULL,          // unit-stride beat
+    MASK_WORDS,         // every other 32-bit element, e.g. a strided store
+    MASK_RANDOM,
+    MASK_PATTERN_CNT
+};
+static const char *const pattern_names[MASK_PATTERN_CNT] = {"full", "words", "random"};
+
+static void make_mask(mask_pattern p, std::mt19937 &rng, unsigned char *be, uint32_t len){
+    memset(be, 0, (len + 7) / 8);
+    for (uint32_t i = 0; i < len; i++) {
+        bool on = (p == MASK_FULL) || (p == MASK_WORDS && (i / 4) % 2 == 0) || (p == MASK_RANDOM && (rng() & 1));
+        if (on) {
+            be[i / 8] |= 1 << (i % 8);
+        }
+    }
+}
+
+//ns per beat of fn over a ring of beats, so the destination does not stay in registers
+static double time_kernel(masked_copy_fn fn, const std::vector<unsigned char> &src, const std::vector<unsigned char> &be,
+                          std::vector<unsigned char> &dst, uint32_t len, uint32_t ring, uint64_t beats){
+    uint32_t be_bytes = (len + 7) / 8;
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t n = 0; n < beats; n++) {
+        uint32_t slot = n % ring;
+        fn(&dst[(size_t)slot * len], &src[(size_t)slot * len], &be[(size_t)slot * be_bytes], len);
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    return ns / beats;
+}
+
+int main(int argc, char **argv){
+    uint64_t beats = 2000000;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            beats = strtoull(argv[++i], NULL, 0);
+        } else {
+            fprintf(stderr, "Usage: %s [-n <beats per measurement>]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    std::vector<masked_copy_isa> isas;
+    for (int i = 0; i < MASKED_COPY_ISA_CNT; i++) {
+        if (masked_copy_kernel((masked_copy_isa)i) != NULL) {
+            isas.push_back((masked_copy_isa)i);
+        }
+    }
+    printf("Kernels:");
+    for (masked_copy_isa isa : isas) {
+        printf(" %s", masked_copy_name(isa));
+    }
+    printf(", masked_copy() uses %s\n", masked_copy_name(masked_copy_selected()));
+
+    //correctness, every width and offset of the tail, all mask patterns
+    std::mt19937 rng(1);
+    int errors = 0;
+    for (uint32_t w = 32; w <= 1024; w += 8) {
+        uint32_t len = w / 8;
+        std::vector<unsigned char> src(len), be((len + 7) / 8), ref(len), out(len);
+        for (int trial = 0; trial < 64; trial++) {
+            for (unsigned char &b : src) {
+                b = rng();
+            }
+            make_mask((mask_pattern)(trial % MASK_PATTERN_CNT), rng, be.data(), len);
+            for (uint32_t i = 0; i < len; i++) {
+                ref[i] = rng();
+            }
+            std::vector<unsigned char> init = ref;
+            masked_copy_bytes(ref.data(), src.data(), be.data(), len);
+            for (masked_copy_isa isa : isas) {
+                out = init;
+                masked_copy_kernel(isa)(out.data(), src.data(), be.data(), len);
+                if (out != ref && errors++ < 8) {
+                    fprintf(stderr, "MISMATCH: %s kernel, %u bit interface, trial %d\n", masked_copy_name(isa), w, trial);
+                }
+            }
+            out = init;
+            masked_copy(out.data(), src.data(), be.data(), len);
+            if (out != ref && errors++ < 8) {
+                fprintf(stderr, "MISMATCH: masked_copy(), %u bit interface, trial %d\n", w, trial);
+            }
+        }
+    }
+    if (errors != 0) {
+        fprintf(stderr, "FAIL: %d mismatching results\n", errors);
+        return 1;
+    }
+    printf("All kernels match the reference for 32 to 1024 bit interfaces\n\n");
+
+    //performance
+    const uint32_t ring = 256;
+    printf("ns per beat (speedup over the byte loop)\n");
+    printf("WIDTH  MASK      bytes");
+    for (masked_copy_isa isa : isas) {
+        printf("  %16s", masked_copy_name(isa));
+    }
+    printf("       masked_copy\n");
+    for (uint32_t w = 32; w <= 1024; w *= 2) {
+        uint32_t len = w / 8;
+        std::vector<unsigned char> src((size_t)ring * len), dst((size_t)ring * len), be((size_t)ring * ((len + 7) / 8));
+        for (unsigned char &b : src) {
+            b = rng();
+        }
+        for (int p = 0; p < MASK_PATTERN_CNT; p++) {
+            for (uint32_t r = 0; r < ring; r++) {
+                make_mask((mask_pattern)p, rng, &be[(size_t)r * ((len + 7) / 8)], len);
+            }
+            double base = time_kernel(masked_copy_bytes, src, be, dst, len, ring, beats);
+            printf("%5u  %-6s  %7.2f", w, pattern_names[p], base);
+            for (masked_copy_isa isa : isas) {
+                double t = time_kernel(masked_copy_kernel(isa), src, be, dst, len, ring, beats);
+                printf("  %7.2f (%5.1fx)", t, base / t);
+            }
+            double t = time_kernel(masked_copy, src, be, dst, len, ring, beats);
+            printf("  %7.2f (%5.1fx)\n", t, base / t);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,80 @@
+// Helpers shared by the host tools: shell command construction and execution and reading the statistics written by write_stats()
+// (verilator_support.h).
+
+#ifndef TOOL_UTIL_H
+#define TOOL_UTIL_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+inline std::vector<std::string> split(const std::string &str, char sep){
+    std::vector<std::string> out;
+    size_t pos = 0;
+    for (size_t next = str.find(sep); next != std::string::npos; next = str.find(sep, pos)) {
+        out.push_back(str.substr(pos, next - pos));
+        pos = next + 1;
+    }
+    out.push_back(str.substr(pos));
+    return out;
+}
+
+//quote an argument for /bin/sh
+inline std::string quote(const std::string &arg){
+    std::string out = "'";
+    for (char c : arg) {
+        if (c == '\'') {
+            out += "'\\''";
+        } else {
+            out += c;
+        }
+    }
+    return out + "'";
+}
+
+inline std::string replace_all(std::string str, const std::string &from, const std::string &to){
+    for (size_t pos = str.find(from); pos != std::string::npos; pos = str.find(from, pos + to.size())) {
+        str.replace(pos, from.size(), to);
+    }
+    return str;
+}
+
+//run a shell command with its output redirected to log, returns the exit status
+inline int run(const std::string &cmd, const std::string &log){
+    int status = system((cmd + " >" + quote(log) + " 2>&1").c_str());
+    if (status == -1 || !WIFEXITED(status)) {
+        return -1;
+    }
+    return WEXITSTATUS(status);
+}
+
+//read the last line of key=value pairs written by write_stats()
+inline bool read_stats(const std::string &path, std::map<std::string, std::string> *stats){
+    FILE *in = fopen(path.c_str(), "r");
+    if (in == NULL) {
+        return false;
+    }
+    char line[4096];
+    std::string last;
+    while (fgets(line, sizeof(line), in) != NULL) {
+        if (line[0] != '\n') {
+            last = line;
+        }
+    }
+    fclose(in);
+    for (const std::string &item : split(last, ' ')) {
+        size_t eq = item.find('=');
+        if (eq != std::string::npos) {
+            std::string val = item.substr(eq + 1);
+            val.erase(val.find_last_not_of("\r\n") + 1);
+            (*stats)[item.substr(0, eq)] = val;
+        }
+    }
+    return !stats->empty();
+}
+
+#endif
@@ -0,0 +1,235 @@
+// Runs one benchmark kernel (benchmarks/) on a simulator and checks it, used by the CTest benchmark targets.
+// The simulator dumps the result region of the kernel with dump_mem_region() and appends its statistics to the file in VICUNA_STATS
+// through report_stats().  The dump is compared with the expected result and the cycle count with the stored baseline.
+//
+// Usage: vicuna_bench -n <name> -p <image> -e <expected> -s <simulator> [options]
+//   -r <command>       command running the simulator, {sim}, {prog}, {dump}, {start}, {end} and {name} are replaced by the simulator,
+//                      the image, the dump file, the start and end address of the result region (hex) and the benchmark name
+//                      (default: "{sim} {prog} {dump} {start} {end}")
+//   -a <address>       start of the result region (default 0x10000, see benchmarks/link.ld)
+//   -c <config>        configuration the baseline is stored for, e.g. rv32im_zve32x-128-32-32
+//   -B <file>          baseline file, lines of "<config> <name> <cycles> <instr> <vector instr>"
+//   -t <percent>       tolerated cycle increase over the baseline (default 2)
+//   -u                 store the measured counts as the new baseline instead of checking them
+//   -m                 pass without a baseline for the configuration (by default a missing baseline fails the test)
+
+#include "tool_util.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+struct bench_baseline {
+    std::string config;
+    std::string name;
+    long long   cycles;
+    long long   instr;
+    long long   vector_instr;
+};
+
+static bool read_words(const std::string &path, std::vector<uint32_t> *words){
+    FILE *in = fopen(path.c_str(), "r");
+    if (in == NULL) {
+        fprintf(stderr, "ERROR: opening `%s': %s\n", path.c_str(), strerror(errno));
+        return false;
+    }
+    unsigned int w;
+    while (fscanf(in, "%x", &w) == 1) {
+        words->push_back(w);
+    }
+    fclose(in);
+    return true;
+}
+
+static std::vector<bench_baseline> read_baselines(const std::string &path){
+    std::vector<bench_baseline> out;
+    FILE *in = fopen(path.c_str(), "r");
+    if (in == NULL) {
+        return out;
+    }
+    char line[1024], config[256], name[256];
+    long long cycles, instr, vector_instr;
+    while (fgets(line, sizeof(line), in) != NULL) {
+        if (line[0] != '#' && sscanf(line, "%255s %255s %lld %lld %lld", config, name, &cycles, &instr, &vector_instr) == 5) {
+            out.push_back({config, name, cycles, instr, vector_instr});
+        }
+    }
+    fclose(in);
+    return out;
+}
+
+int main(int argc, char **argv){
+    std::string name, prog, expected_path, sim, config, baseline_path;
+    std::string run_cmd  = "{sim} {prog} {dump} {start} {end}";
+    uint32_t    start    = 0x10000;
+    double      tolerance = 2.0;
+    bool        update   = false;
+    bool        allow_missing = false;
+
+    for (int i = 1; i < argc; i++) {
+        std::string opt = argv[i];
+        if (opt == "-u") {
+            update = true;
+            continue;
+        }
+        if (opt == "-m") {
+            allow_missing = true;
+            continue;
+        }
+        if (opt.size() != 2 || opt[0] != '-' || i + 1 >= argc) {
+            fprintf(stderr, "ERROR: unexpected argument `%s'\n", argv[i]);
+            return 1;
+        }
+        std::string arg = argv[++i];
+        switch (opt[1]) {
+            case 'n': name          = arg; break;
+            case 'p': prog          = arg; break;
+            case 'e': expected_path = arg; break;
+            case 's': sim           = arg; break;
+            case 'r': run_cmd       = arg; break;
+            case 'c': config        = arg; break;
+            case 'B': baseline_path = arg; break;
+            case 'a': start     = strtoul(arg.c_str(), NULL, 0); break;
+            case 't': tolerance = atof(arg.c_str()); break;
+            default:
+                fprintf(stderr, "ERROR: unknown option `%s'\n", opt.c_str());
+                return 1;
+        }
+    }
+    if (name.empty() || prog.empty() || expected_path.empty() || sim.empty()) {
+        fprintf(stderr, "Usage: %s -n <name> -p <image> -e <expected> -s <simulator> [-r <command>] [-a <address>] [-c <config>] "
+                        "[-B <baselines>] [-t <percent>] [-u] [-m]\n", argv[0]);
+        return 1;
+    }
+
+    std::vector<uint32_t> expected;
+    if (!read_words(expected_path, &expected)) {
+        return 1;
+    }
+    uint32_t end = start + expected.size() * 4;
+
+    //run the simulator
+    std::string dump_path  = name + ".dump";
+    std::string stats_path = name + ".stats";
+    remove(dump_path.c_str());
+    remove(stats_path.c_str());
+    char addr[16];
+    std::string cmd = run_cmd;
+    cmd = replace_all(cmd, "{sim}",  quote(sim));
+    cmd = replace_all(cmd, "{prog}", quote(prog));
+    cmd = replace_all(cmd, "{dump}", quote(dump_path));
+    cmd = replace_all(cmd, "{name}", quote(name));
+    snprintf(addr, sizeof(addr), "0x%08x", start);
+    cmd = replace_all(cmd, "{start}", addr);
+    snprintf(addr, sizeof(addr), "0x%08x", end);
+    cmd = replace_all(cmd, "{end}", addr);
+    printf("%s\n", cmd.c_str());
+    fflush(stdout);
+    int status = run("VICUNA_STATS=" + quote(stats_path) + " " + cmd, name + ".log");
+    if (status != 0) {
+        fprintf(stderr, "ERROR: simulator exited with status %d, see %s.log\n", status, name.c_str());
+        return 1;
+    }
+
+    //functional check
+    std::vector<uint32_t> dump;
+    if (!read_words(dump_path, &dump)) {
+        return 1;
+    }
+    int mismatches = 0;
+    for (size_t i = 0; i < expected.size(); i++) {
+        bool have = i < dump.size();
+        if (have && dump[i] == expected[i]) {
+            continue;
+        }
+        if (mismatches++ < 8) {
+            fprintf(stderr, "MISMATCH at 0x%08zx: expected %08x, got %s", start + i * 4, expected[i], have ? "" : "nothing\n");
+            if (have) {
+                fprintf(stderr, "%08x\n", dump[i]);
+            }
+        }
+    }
+    if (mismatches != 0) {
+        fprintf(stderr, "FAIL: %d of %zu result words differ\n", mismatches, expected.size());
+        return 1;
+    }
+
+    //performance check
+    std::map<std::string, std::string> stats;
+    if (!read_stats(stats_path, &stats)) {
+        fprintf(stderr, "ERROR: no statistics in `%s', report_stats() was not called\n", stats_path.c_str());
+        return 1;
+    }
+    long long cycles       = atoll(stats["cycles"].c_str());
+    long long instr        = atoll(stats["instr"].c_str());
+    long long vector_instr = atoll(stats["vector_instr"].c_str());
+    printf("%s: result ok, cycles %lld instr %lld CPI %s vector instr %lld\n", name.c_str(), cycles, instr, stats["cpi"].c_str(),
+           vector_instr);
+    if (baseline_path.empty()) {
+        return 0;
+    }
+
+    //concurrent tests share the baseline file, which is rewritten in place and thus keeps its lock
+    int lock = open(baseline_path.c_str(), O_CREAT | O_RDONLY, 0666);
+    if (lock >= 0) {
+        flock(lock, LOCK_EX);
+    }
+    std::vector<bench_baseline> baselines = read_baselines(baseline_path);
+    bench_baseline *base = NULL;
+    for (bench_baseline &b : baselines) {
+        if (b.config == config && b.name == name) {
+            base = &b;
+        }
+    }
+    int ret = 0;
+    if (update) {
+        if (base == NULL) {
+            baselines.push_back({config, name, 0, 0, 0});
+            base = &baselines.back();
+        }
+        base->cycles       = cycles;
+        base->instr        = instr;
+        base->vector_instr = vector_instr;
+        FILE *out = fopen(baseline_path.c_str(), "w");
+        if (out == NULL) {
+            fprintf(stderr, "ERROR: opening `%s': %s\n", baseline_path.c_str(), strerror(errno));
+            ret = 1;
+        } else {
+            fprintf(out, "# <config> <benchmark> <cycles> <instr> <vector instr>, written by vicuna_bench -u\n");
+            for (const bench_baseline &b : baselines) {
+                fprintf(out, "%s %s %lld %lld %lld\n", b.config.c_str(), b.name.c_str(), b.cycles, b.instr, b.vector_instr);
+            }
+            fclose(out);
+            printf("%s: baseline of %s updated\n", name.c_str(), config.c_str());
+        }
+    } else if (base == NULL) {
+        if (allow_missing) {
+            printf("%s: no baseline for %s, run with -u to store one\n", name.c_str(), config.c_str());
+        } else {
+            fprintf(stderr, "FAIL: no baseline of %s for %s in `%s', run with -u to store one or -m to allow a missing baseline\n",
+                    name.c_str(), config.c_str(), baseline_path.c_str());
+            ret = 1;
+        }
+    } else {
+        double change = base->cycles ? 100.0 * (cycles - base->cycles) / base->cycles : 0.0;
+        printf("%s: baseline %lld cycles, %+.2f%%\n", name.c_str(), base->cycles, change);
+        if (change > tolerance) {
+            fprintf(stderr, "FAIL: %s is %.2f%% slower than the baseline of %s (tolerance %.2f%%)\n", name.c_str(), change,
+                    config.c_str(), tolerance);
+            ret = 1;
+        }
+    }
+    if (lock >= 0) {
+        flock(lock, LOCK_UN);
+        close(lock);
+    }
+    return ret;
+}
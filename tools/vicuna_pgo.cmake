@@ -0,0 +1,111 @@
+# Profile-guided optimization of a Vicuna simulator, run as a CMake script:
+#
+#   cmake -DBUILD_DIR=<build dir> -DTARGET=<simulator target> [options] -P tools/vicuna_pgo.cmake
+#
+# BUILD_DIR is the configured build tree of a project that verilates the model with vicuna_verilate() (or applies VICUNA_VERILATOR_ARGS
+# and VICUNA_MODEL_COMPILE_OPTIONS/VICUNA_MODEL_LINK_OPTIONS itself).  The script
+#   1. reconfigures it with VICUNA_PGO=GENERATE and builds the instrumented simulator,
+#   2. runs the training workloads on it, which write the compiler profiles and, for models with VICUNA_VERILATOR_THREADS > 1, the
+#      Verilator thread schedule profile (profile.vlt) into VICUNA_PGO_DIR,
+#   3. reconfigures it with VICUNA_PGO=USE and rebuilds the simulator with the profiles.
+# The same tree is used for both builds because gcc finds the profile of each object by its path.
+#
+# Options:
+#   SIM      - simulator executable (default <BUILD_DIR>/<TARGET>)
+#   RUN_CMD  - command running one workload, {sim}, {prog}, {dump}, {start} and {end} are replaced as by tools/vicuna_bench.cpp
+#              (default "{sim} {prog} {dump} {start} {end}")
+#   TRAIN    - list of program images (default: the benchmark images that run on every configuration).  profile.vlt is taken from
+#              the last one, so put the most representative workload last
+#   END_PC   - IF_PC at which a training run has reached the end of its program (default with the benchmark images: 0x1c, the final
+#              loop of benchmarks/crt0.S).  The simulator must call report_stats() at the end of the run, the if_pc it writes to
+#              VICUNA_STATS is checked against END_PC if set
+#   JOBS     - parallel build jobs
+
+if(NOT BUILD_DIR OR NOT TARGET)
+    message(FATAL_ERROR "usage: cmake -DBUILD_DIR=<build dir> -DTARGET=<simulator target> [-DSIM=...] [-DRUN_CMD=...] [-DTRAIN=...] "
+                        "-P vicuna_pgo.cmake")
+endif()
+get_filename_component(BUILD_DIR ${BUILD_DIR} ABSOLUTE)
+if(NOT SIM)
+    set(SIM ${BUILD_DIR}/${TARGET})
+endif()
+if(NOT RUN_CMD)
+    set(RUN_CMD "{sim} {prog} {dump} {start} {end}")
+endif()
+if(NOT TRAIN)
+    if(NOT DEFINED END_PC)
+        set(END_PC 0x1c)
+    endif()
+    set(IMAGES ${CMAKE_CURRENT_LIST_DIR}/../benchmarks/images)
+    set(TRAIN ${IMAGES}/memcpy.hex ${IMAGES}/gather_strided.hex ${IMAGES}/gather_indexed.hex ${IMAGES}/reduce.hex ${IMAGES}/slide.hex
+              ${IMAGES}/conv2d.hex ${IMAGES}/gemm_i8.hex)
+endif()
+set(BUILD_ARGS "")
+if(JOBS)
+    set(BUILD_ARGS -j ${JOBS})
+endif()
+
+file(STRINGS ${BUILD_DIR}/CMakeCache.txt PGO_DIR REGEX "^VICUNA_PGO_DIR:")
+if(NOT PGO_DIR)
+    message(FATAL_ERROR "${BUILD_DIR} is not a configured build tree including Vicuna")
+endif()
+string(REGEX REPLACE "^[^=]*=" "" PGO_DIR "${PGO_DIR}")
+
+function(pgo_step what)
+    message(STATUS "PGO: ${what}")
+    execute_process(COMMAND ${ARGN} RESULT_VARIABLE result)
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "PGO: ${what} failed (${result})")
+    endif()
+endfunction()
+
+#1. instrumented build, stale profiles would be merged into the new ones
+file(REMOVE_RECURSE ${PGO_DIR})
+file(MAKE_DIRECTORY ${PGO_DIR}/train)
+pgo_step("configuring the instrumented build" ${CMAKE_COMMAND} -DVICUNA_PGO=GENERATE ${BUILD_DIR})
+pgo_step("building the instrumented simulator" ${CMAKE_COMMAND} --build ${BUILD_DIR} --target ${TARGET} ${BUILD_ARGS})
+
+#2. training
+foreach(prog ${TRAIN})
+    get_filename_component(name ${prog} NAME_WE)
+    set(cmd "${RUN_CMD}")
+    string(REPLACE "{sim}" "${SIM}" cmd "${cmd}")
+    string(REPLACE "{prog}" "${prog}" cmd "${cmd}")
+    string(REPLACE "{dump}" "${PGO_DIR}/train/${name}.dump" cmd "${cmd}")
+    string(REPLACE "{start}" "0x00010000" cmd "${cmd}")
+    string(REPLACE "{end}" "0x00010004" cmd "${cmd}")
+    string(REPLACE "{name}" "${name}" cmd "${cmd}")
+    set(stats ${PGO_DIR}/train/${name}.stats)
+    message(STATUS "PGO: training on ${name}")
+    execute_process(COMMAND ${CMAKE_COMMAND} -E env VICUNA_STATS=${stats} sh -c "${cmd}" WORKING_DIRECTORY ${PGO_DIR}/train
+                    OUTPUT_FILE ${PGO_DIR}/train/${name}.log ERROR_FILE ${PGO_DIR}/train/${name}.log RESULT_VARIABLE result)
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "PGO: training on ${name} failed (${result}), see ${PGO_DIR}/train/${name}.log")
+    endif()
+    #a run cut short (timeout, stall, crash) would train the profiles on the wrong code
+    set(stats_line "")
+    if(EXISTS ${stats})
+        file(STRINGS ${stats} stats_line REGEX "if_pc=")
+    endif()
+    if(NOT stats_line)
+        message(FATAL_ERROR "PGO: training on ${name} wrote no statistics, report_stats() was not called, see ${PGO_DIR}/train/${name}.log")
+    endif()
+    if(NOT "${END_PC}" STREQUAL "")
+        list(GET stats_line -1 stats_line)
+        string(REGEX MATCH "if_pc=(0x[0-9a-fA-F]+)" if_pc "${stats_line}")
+        math(EXPR if_pc "${CMAKE_MATCH_1}")
+        math(EXPR end_pc "${END_PC}")
+        if(NOT if_pc EQUAL end_pc)
+            message(FATAL_ERROR "PGO: training on ${name} stopped at IF_PC ${CMAKE_MATCH_1}, not at the end of the program (${END_PC}), "
+                                "see ${PGO_DIR}/train/${name}.log")
+        endif()
+    endif()
+    if(EXISTS ${PGO_DIR}/train/profile.vlt)
+        file(RENAME ${PGO_DIR}/train/profile.vlt ${PGO_DIR}/profile.vlt)
+    endif()
+endforeach()
+
+#3. optimized build
+pgo_step("configuring the optimized build" ${CMAKE_COMMAND} -DVICUNA_PGO=USE ${BUILD_DIR})
+pgo_step("building the optimized simulator" ${CMAKE_COMMAND} --build ${BUILD_DIR} --target ${TARGET} ${BUILD_ARGS})
+message(STATUS "PGO: done, ${SIM} is built with the profiles in ${PGO_DIR}")
@@ -0,0 +1,349 @@
+// Design-space sweep driver.  Configures and builds one Verilated simulator per point of a matrix of Vicuna configuration values,
+// runs a list of benchmarks on every variant and prints one consolidated table of cycles, CPI and vector pipeline utilization.
+//
+// The simulator project (-S) is the CMake project that includes Vicuna and verilates it, each variant gets its own build tree under
+// the work directory (-B).  Vicuna generates its configuration package into the build tree, so the variants are built side by side.
+// The benchmarks are run with the VICUNA_STATS environment variable set, report_stats() of the simulator then appends its summary
+// statistics to a file per benchmark (see write_stats() in verilator_support.h) from which the table is built.
+//
+// Usage: vicuna_sweep -S <simulator project> -B <work dir> -b <benchmark list> [options]
+//   -D NAME=V1;V2;...  values of a cache variable of the sweep, e.g. -D "VREG_W=128;256" -D "VPROC_PIPELINES=32:VLSU 32:VALU;64:VLSU 64:VALU".
+//                      Repeat for every swept variable, all combinations are built.  Repeating a variable adds further values
+//   -C <arg>           additional argument for every configure step, e.g. -C -DCMAKE_BUILD_TYPE=Release
+//   -G <generator>     CMake generator of the variant build trees
+//   -t <target>        simulator target to build (default: all targets)
+//   -x <executable>    simulator executable relative to the variant build tree (default: the target name)
+//   -r <command>       command running one benchmark, {sim}, {prog}, {name} and {dir} are replaced by the simulator executable, the
+//                      benchmark program, the benchmark name and the variant build tree (default: "{sim} {prog}")
+//   -j <n>             number of variants built and run concurrently (default: number of hardware threads)
+//   -k <n>             parallel build jobs per variant (default: hardware threads / -j)
+//   -o <file>          also write the table as CSV with all statistics
+//
+// The benchmark list holds one benchmark per line, "<name> <program>", lines starting with # are ignored.
+
+#include "tool_util.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct sweep_axis {
+    std::string              name;
+    std::vector<std::string> values;
+};
+
+struct sweep_variant {
+    std::vector<std::string> values;    // one value per axis
+    std::string              dir;
+};
+
+struct sweep_bench {
+    std::string name;
+    std::string prog;
+};
+
+struct sweep_result {
+    std::string                        status = "NOT RUN";
+    std::map<std::string, std::string> stats;
+};
+
+static std::mutex log_mutex;
+
+static void progress(const char *fmt, const std::string &dir, const std::string &what){
+    std::lock_guard<std::mutex> lock(log_mutex);
+    fprintf(stderr, fmt, dir.c_str(), what.c_str());
+    fflush(stderr);
+}
+
+int main(int argc, char **argv){
+    std::string src_dir, work_dir, bench_path, generator, target, exe, csv_path;
+    std::string run_cmd = "{sim} {prog}";
+    std::vector<std::string> configure_args;
+    std::vector<sweep_axis> axes;
+    int jobs = 0, build_jobs = 0;
+
+    for (int i = 1; i < argc; i++) {
+        //options take their argument as the next argument or attached, e.g. -DVREG_W=128
+        std::string opt = argv[i];
+        if (opt.size() < 2 || opt[0] != '-' || (opt.size() == 2 && i + 1 >= argc)) {
+            fprintf(stderr, "ERROR: unexpected argument `%s'\n", argv[i]);
+            return 1;
+        }
+        std::string arg = (opt.size() > 2) ? opt.substr(2) : std::string(argv[++i]);
+        switch (opt[1]) {
+            case 'S': src_dir    = arg; break;
+            case 'B': work_dir   = arg; break;
+            case 'b': bench_path = arg; break;
+            case 'G': generator  = arg; break;
+            case 't': target     = arg; break;
+            case 'x': exe        = arg; break;
+            case 'r': run_cmd    = arg; break;
+            case 'o': csv_path   = arg; break;
+            case 'j': jobs       = atoi(arg.c_str()); break;
+            case 'k': build_jobs = atoi(arg.c_str()); break;
+            case 'C': configure_args.push_back(arg); break;
+            case 'D': {
+                size_t eq = arg.find('=');
+                if (eq == std::string::npos || eq == 0) {
+                    fprintf(stderr, "ERROR: expected NAME=V1;V2;... after -D, got `%s'\n", arg.c_str());
+                    return 1;
+                }
+                std::string name = arg.substr(0, eq);
+                std::vector<std::string> values = split(arg.substr(eq + 1), ';');
+                auto it = std::find_if(axes.begin(), axes.end(), [&](const sweep_axis &axis) { return axis.name == name; });
+                if (it == axes.end()) {
+                    axes.push_back({name, values});
+                } else {
+                    it->values.insert(it->values.end(), values.begin(), values.end());
+                }
+                break;
+            }
+            default:
+                fprintf(stderr, "ERROR: unknown option `%s'\n", opt.c_str());
+                return 1;
+        }
+    }
+    if (src_dir.empty() || work_dir.empty() || bench_path.empty()) {
+        fprintf(stderr, "Usage: %s -S <simulator project> -B <work dir> -b <benchmark list> [-D NAME=V1;V2;...]... [-C <configure arg>]... "
+                        "[-G <generator>] [-t <target>] [-x <executable>] [-r <command>] [-j <n>] [-k <n>] [-o <csv>]\n", argv[0]);
+        return 1;
+    }
+    if (exe.empty()) {
+        exe = target;
+    }
+    if (exe.empty() && run_cmd.find("{sim}") != std::string::npos) {
+        fprintf(stderr, "ERROR: the simulator executable is unknown, specify -t or -x\n");
+        return 1;
+    }
+
+    //benchmark list
+    std::vector<sweep_bench> benches;
+    FILE *in = fopen(bench_path.c_str(), "r");
+    if (in == NULL) {
+        fprintf(stderr, "ERROR: opening `%s': %s\n", bench_path.c_str(), strerror(errno));
+        return 1;
+    }
+    char line[4096];
+    while (fgets(line, sizeof(line), in) != NULL) {
+        char name[1024], prog[3072];
+        if (line[0] == '#' || sscanf(line, "%1023s %3071[^\r\n]", name, prog) != 2) {
+            continue;
+        }
+        benches.push_back({name, prog});
+    }
+    fclose(in);
+    if (benches.empty()) {
+        fprintf(stderr, "ERROR: no benchmarks in `%s'\n", bench_path.c_str());
+        return 1;
+    }
+
+    //all combinations of the axis values, the last axis varies fastest
+    std::vector<sweep_variant> variants(1);
+    for (const sweep_axis &axis : axes) {
+        std::vector<sweep_variant> next;
+        for (const sweep_variant &var : variants) {
+            for (const std::string &val : axis.values) {
+                next.push_back(var);
+                next.back().values.push_back(val);
+            }
+        }
+        variants.swap(next);
+    }
+    mkdir(work_dir.c_str(), 0777);
+    for (size_t i = 0; i < variants.size(); i++) {
+        char name[32];
+        snprintf(name, sizeof(name), "/variant%03zu", i);
+        variants[i].dir = work_dir + name;
+    }
+
+    int hw_threads = std::max(1, (int)std::thread::hardware_concurrency());
+    if (jobs <= 0) {
+        jobs = hw_threads;
+    }
+    jobs = std::min(jobs, (int)variants.size());
+    if (build_jobs <= 0) {
+        build_jobs = std::max(1, hw_threads / jobs);
+    }
+    fprintf(stderr, "Sweeping %zu variants x %zu benchmarks, %d variants at a time with %d build jobs each\n",
+            variants.size(), benches.size(), jobs, build_jobs);
+
+    //each worker configures, builds and runs one variant at a time
+    std::vector<sweep_result> results(variants.size() * benches.size());
+    std::atomic<size_t> next_variant(0);
+    auto worker = [&]() {
+        for (size_t v = next_variant.fetch_add(1); v < variants.size(); v = next_variant.fetch_add(1)) {
+            sweep_variant &var = variants[v];
+            std::string label;
+            std::string configure = "cmake -S " + quote(src_dir) + " -B " + quote(var.dir);
+            if (!generator.empty()) {
+                configure += " -G " + quote(generator);
+            }
+            for (const std::string &arg : configure_args) {
+                configure += " " + quote(arg);
+            }
+            for (size_t a = 0; a < axes.size(); a++) {
+                configure += " " + quote("-D" + axes[a].name + "=" + var.values[a]);
+                label     += (a ? " " : "") + axes[a].name + "=" + var.values[a];
+            }
+            mkdir(var.dir.c_str(), 0777);
+            FILE *desc = fopen((var.dir + "/variant.txt").c_str(), "w");
+            if (desc != NULL) {
+                fprintf(desc, "%s\n", label.c_str());
+                fclose(desc);
+            }
+
+            progress("%s: building %s\n", var.dir, label);
+            std::string build = "cmake --build " + quote(var.dir) + " -j " + std::to_string(build_jobs);
+            if (!target.empty()) {
+                build += " --target " + quote(target);
+            }
+            if (run(configure, var.dir + "/configure.log") != 0) {
+                progress("%s: configure FAILED, see %s\n", var.dir, var.dir + "/configure.log");
+                for (size_t b = 0; b < benches.size(); b++) {
+                    results[v * benches.size() + b].status = "CONFIGURE FAILED";
+                }
+                continue;
+            }
+            if (run(build, var.dir + "/build.log") != 0) {
+                progress("%s: build FAILED, see %s\n", var.dir, var.dir + "/build.log");
+                for (size_t b = 0; b < benches.size(); b++) {
+                    results[v * benches.size() + b].status = "BUILD FAILED";
+                }
+                continue;
+            }
+
+            for (size_t b = 0; b < benches.size(); b++) {
+                sweep_result &res = results[v * benches.size() + b];
+                std::string stats_path = var.dir + "/" + benches[b].name + ".stats";
+                remove(stats_path.c_str());
+                std::string cmd = run_cmd;
+                cmd = replace_all(cmd, "{sim}",  quote(var.dir + "/" + exe));
+                cmd = replace_all(cmd, "{prog}", quote(benches[b].prog));
+                cmd = replace_all(cmd, "{name}", quote(benches[b].name));
+                cmd = replace_all(cmd, "{dir}",  quote(var.dir));
+                cmd = "cd " + quote(var.dir) + " && VICUNA_STATS=" + quote(stats_path) + " " + cmd;
+                int status = run(cmd, var.dir + "/" + benches[b].name + ".log");
+                if (!read_stats(stats_path, &res.stats)) {
+                    res.status = "NO STATS";
+                } else {
+                    res.status = (status == 0) ? "PASS" : "FAIL";
+                }
+                progress("%s: %s\n", var.dir, benches[b].name + " " + res.status);
+            }
+        }
+    };
+    std::vector<std::thread> threads;
+    for (int i = 0; i < jobs; i++) {
+        threads.emplace_back(worker);
+    }
+    for (std::thread &t : threads) {
+        t.join();
+    }
+
+    //consolidated table: cycles, CPI and busy share of every vector pipeline per variant and benchmark
+    size_t max_pipes = 0;
+    for (const sweep_result &res : results) {
+        size_t n = 0;
+        while (res.stats.count("pipe" + std::to_string(n) + "_busy")) {
+            n++;
+        }
+        max_pipes = std::max(max_pipes, n);
+    }
+    std::vector<std::string> header;
+    for (const sweep_axis &axis : axes) {
+        header.push_back(axis.name);
+    }
+    header.insert(header.end(), {"BENCHMARK", "STATUS", "CYCLES", "CPI", "VECTOR INSTR"});
+    for (size_t p = 0; p < max_pipes; p++) {
+        header.push_back("PIPE" + std::to_string(p) + " BUSY%");
+    }
+    std::vector<std::vector<std::string>> rows;
+    for (size_t v = 0; v < variants.size(); v++) {
+        for (size_t b = 0; b < benches.size(); b++) {
+            const sweep_result &res = results[v * benches.size() + b];
+            auto stat = [&](const std::string &key) {
+                auto it = res.stats.find(key);
+                return it == res.stats.end() ? std::string("-") : it->second;
+            };
+            std::vector<std::string> row = variants[v].values;
+            row.insert(row.end(), {benches[b].name, res.status, stat("cycles"), stat("cpi"), stat("vector_instr")});
+            for (size_t p = 0; p < max_pipes; p++) {
+                row.push_back(stat("pipe" + std::to_string(p) + "_busy"));
+            }
+            rows.push_back(row);
+        }
+    }
+    std::vector<size_t> width(header.size());
+    for (size_t c = 0; c < header.size(); c++) {
+        width[c] = header[c].size();
+        for (const std::vector<std::string> &row : rows) {
+            width[c] = std::max(width[c], row[c].size());
+        }
+    }
+    auto print_row = [&](const std::vector<std::string> &row) {
+        for (size_t c = 0; c < row.size(); c++) {
+            printf("%-*s%s", (int)width[c], row[c].c_str(), c + 1 < row.size() ? "  " : "\n");
+        }
+    };
+    print_row(header);
+    for (const std::vector<std::string> &row : rows) {
+        print_row(row);
+    }
+
+    //CSV with all statistics keys
+    if (!csv_path.empty()) {
+        FILE *csv = fopen(csv_path.c_str(), "w");
+        if (csv == NULL) {
+            fprintf(stderr, "ERROR: opening `%s': %s\n", csv_path.c_str(), strerror(errno));
+            return 1;
+        }
+        std::vector<std::string> keys;
+        for (const sweep_result &res : results) {
+            for (const auto &kv : res.stats) {
+                if (std::find(keys.begin(), keys.end(), kv.first) == keys.end()) {
+                    keys.push_back(kv.first);
+                }
+            }
+        }
+        for (const sweep_axis &axis : axes) {
+            fprintf(csv, "%s,", axis.name.c_str());
+        }
+        fprintf(csv, "benchmark,status");
+        for (const std::string &key : keys) {
+            fprintf(csv, ",%s", key.c_str());
+        }
+        fprintf(csv, "\n");
+        for (size_t v = 0; v < variants.size(); v++) {
+            for (size_t b = 0; b < benches.size(); b++) {
+                const sweep_result &res = results[v * benches.size() + b];
+                for (const std::string &val : variants[v].values) {
+                    fprintf(csv, "\"%s\",", replace_all(val, "\"", "\"\"").c_str());
+                }
+                fprintf(csv, "%s,%s", benches[b].name.c_str(), res.status.c_str());
+                for (const std::string &key : keys) {
+                    auto it = res.stats.find(key);
+                    fprintf(csv, ",%s", it == res.stats.end() ? "" : it->second.c_str());
+                }
+                fprintf(csv, "\n");
+            }
+        }
+        fclose(csv);
+    }
+
+    int failed = 0;
+    for (const sweep_result &res : results) {
+        failed += (res.status != "PASS");
+    }
+    fprintf(stderr, "%zu runs, %d failed\n", results.size(), failed);
+    return failed ? 1 : 0;
+}
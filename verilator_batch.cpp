@@ -0,0 +1,121 @@
+// Multi-threaded batch runner for use with simulation with Verilator.
+// Runs a list of tests on a pool of Vvproc_top instances, one instance per worker thread.
+#include "verilator_batch.h"
+
+#include <chrono>
+#include <thread>
+
+/*
+*   n_workers      - number of worker threads and model instances.  0 selects the number of hardware threads
+*   run_test       - test function
+*   rst_cycles     - number of cycles the model is held in reset before each test
+*/
+batch_runner::batch_runner(int n_workers, batch_test_fn_t run_test, int rst_cycles){
+    if (n_workers <= 0) {
+        n_workers = std::thread::hardware_concurrency();
+        if (n_workers <= 0) {
+            n_workers = 1;
+        }
+    }
+    this->n_workers  = n_workers;
+    this->rst_cycles = rst_cycles;
+    this->run_test   = run_test;
+    pool.assign(n_workers, NULL);
+    n_run = 0;
+}
+
+batch_runner::~batch_runner(){
+    for (sim_context *ctx : pool) {
+        if (ctx == NULL) {
+            continue;
+        }
+        ctx->top->final();
+        delete ctx->top;
+        delete ctx->vctx;
+        delete ctx;
+    }
+}
+
+/*
+* Add a test to the queue.
+*/
+void batch_runner::add(const batch_test &test){
+    queue.push_back(test);
+}
+
+/*
+* Worker loop.  Takes the next test through the shared index next until it reaches last.
+*/
+void batch_runner::worker(int id, size_t last, std::atomic<size_t> *next){
+    //the model is constructed by the thread simulating it, so its memory is local to that thread
+    sim_context *ctx = pool[id];
+    if (ctx == NULL) {
+        ctx = new sim_context;
+        ctx->vctx = new VerilatedContext;
+        ctx->top  = new Vvproc_top(ctx->vctx);
+        pool[id]  = ctx;
+    }
+
+    for (size_t i = next->fetch_add(1); i < last; i = next->fetch_add(1)) {
+        batch_result &res = done[i];
+        reset_model(ctx, rst_cycles);
+
+        auto t0 = std::chrono::steady_clock::now();
+        res.status = run_test(ctx, queue[i]);
+        auto t1 = std::chrono::steady_clock::now();
+
+        res.worker       = id;
+        res.cycles       = ctx->cycles;
+        res.instr        = ctx->instr;
+        res.vector_instr = ctx->vector_instr;
+        res.wall_s       = std::chrono::duration<double>(t1 - t0).count();
+    }
+}
+
+/*
+* Run all queued tests and wait for them to finish.  Returns the number of failed tests.
+*/
+int batch_runner::run(){
+    size_t first = n_run;
+    size_t last  = queue.size();
+    done.resize(last);
+
+    std::atomic<size_t> next(first);
+    std::vector<std::thread> threads;
+    int n_threads = (last - first < (size_t)n_workers) ? (int)(last - first) : n_workers;
+    for (int i = 0; i < n_threads; i++) {
+        threads.emplace_back(&batch_runner::worker, this, i, last, &next);
+    }
+    for (std::thread &t : threads) {
+        t.join();
+    }
+    n_run = last;
+
+    int failed = 0;
+    for (size_t i = first; i < last; i++) {
+        if (done[i].status != 0) {
+            failed++;
+        }
+    }
+    return failed;
+}
+
+/*
+* Print one line per test and a summary.
+*/
+void batch_runner::report(FILE *out) const {
+    int    failed = 0;
+    double wall   = 0.0;
+    long long cycles = 0;
+    for (size_t i = 0; i < done.size(); i++) {
+        const batch_result &res = done[i];
+        fprintf(out, "%-32s %-4s cycles: %10d instr: %10d CPI: %6.3f vector instr: %8d wall: %8.3fs (worker %d)\n",
+                queue[i].name.c_str(), res.status == 0 ? "PASS" : "FAIL", res.cycles, res.instr,
+                res.instr ? (double)res.cycles / res.instr : 0.0, res.vector_instr, res.wall_s, res.worker);
+        failed += (res.status != 0);
+        wall   += res.wall_s;
+        cycles += res.cycles;
+    }
+    fprintf(out, "%zu tests, %d failed, %lld cycles simulated, %.3fs summed test time on %d workers\n",
+            done.size(), failed, cycles, wall, n_workers);
+}
@@ -0,0 +1,103 @@
+// Multi-threaded batch runner for use with simulation with Verilator.
+// Runs a list of tests on a pool of Vvproc_top instances, one instance per worker thread.
+//
+// Each worker owns a sim_context (see verilator_support.h) whose model is constructed once and reset between tests with reset_model().
+// Workers take the next test from a shared queue as soon as they are done with the previous one, so long and short tests balance out.
+// The test function gets the context of its worker and must only use the sim_context overloads of the harness functions and its own
+// memory objects (e.g. a paged_mem forked from a preloaded image).  The legacy update_mem_load() queue wrapper is not thread safe.
+//
+// Example:
+//     batch_runner runner(64, [](sim_context *ctx, const batch_test &test) {
+//         paged_mem mem;
+//         load_program(&mem, (char *)test.prog_path.c_str(), NULL);
+//         mem_port port(VMEM_W, MEM_LAT, mem.size());
+//         while (!check_stall(ctx, 1000)) { ...drive ctx->top and port...; advance_cycle(ctx); update_stats(ctx); }
+//         return 0;
+//     });
+//     runner.add({"test0", "test0.elf"});
+//     runner.run();
+//     runner.report(stdout);
+
+#ifndef VERILATOR_BATCH_H
+#define VERILATOR_BATCH_H
+
+#include "verilator_support.h"
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <vector>
+
+/*
+*   One entry of the batch.  user is passed through to the test function unchanged.
+*/
+struct batch_test {
+    std::string name;
+    std::string prog_path;
+    void       *user = NULL;
+};
+
+/*
+*   Outcome of one test: the return value of the test function and the harness counters of the context after the test.
+*/
+struct batch_result {
+    int    status       = -1;
+    int    worker       = -1;
+    int    cycles       = 0;
+    int    instr        = 0;
+    int    vector_instr = 0;
+    double wall_s       = 0.0;
+};
+
+/*
+*   Test function.  Runs test on the (already reset) model of ctx and returns 0 on success.
+*/
+typedef std::function<int(sim_context *ctx, const batch_test &test)> batch_test_fn_t;
+
+class batch_runner {
+public:
+    /*
+    * ARGS:
+    *   n_workers      - number of worker threads and model instances.  0 selects the number of hardware threads
+    *   run_test       - test function
+    *   rst_cycles     - number of cycles the model is held in reset before each test
+    */
+    batch_runner(int n_workers, batch_test_fn_t run_test, int rst_cycles = 10);
+    ~batch_runner();
+    batch_runner(const batch_runner &) = delete;
+    batch_runner &operator=(const batch_runner &) = delete;
+
+    /*
+    * Add a test to the queue.  Tests added after run() are run by the next call to run().
+    */
+    void add(const batch_test &test);
+
+    /*
+    * Run all queued tests and wait for them to finish.  The model instances are kept for later calls.  Returns the number of failed tests.
+    */
+    int run();
+
+    /*
+    * Tests and results of all runs so far, results[i] belongs to tests[i].
+    */
+    const std::vector<batch_test>   &tests() const { return queue; }
+    const std::vector<batch_result> &results() const { return done; }
+
+    /*
+    * Print one line per test and a summary.
+    */
+    void report(FILE *out) const;
+
+private:
+    int                        n_workers;
+    int                        rst_cycles;
+    batch_test_fn_t            run_test;
+    std::vector<sim_context *> pool;        // one context per worker, models constructed by the worker on first use
+    std::vector<batch_test>    queue;
+    std::vector<batch_result>  done;
+    size_t                     n_run;       // tests of the queue already run
+
+    void worker(int id, size_t last, std::atomic<size_t> *next);
+};
+
+#endif
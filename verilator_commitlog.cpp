@@ -0,0 +1,417 @@
+// Binary commit log for use with simulation with Verilator.
+// Provides an asynchronous writer for xreg/freg/vreg commits and the conversion of binary logs to the spike-compatible text format
+// written by update_xreg_commit(), update_freg_commit() and update_vreg_commit(), as well as a checker comparing commits against a
+// reference log in that text format while the simulation runs.
+#include "verilator_commitlog.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+
+commit_log::commit_log() : file(NULL), vreg_bytes(0), ring_mask(0), head(0), tail(0), stop(false), write_error(false) {
+}
+
+commit_log::~commit_log(){
+    close();
+}
+
+/*
+* Open the log file and start the writer thread.  Returns false if error
+*
+*   *path          - binary log file to write
+*   vreg_w         - width of the vector registers in bits
+*   ring_bytes     - size of the ring buffer, rounded up to a power of two
+*/
+bool commit_log::open(const char *path, uint32_t vreg_w, size_t ring_bytes){
+    close();
+    file = fopen(path, "wb");
+    if (file == NULL) {
+        fprintf(stderr, "ERROR: opening `%s': %s\n", path, strerror(errno));
+        return false;
+    }
+    this->path  = path;
+    write_error = false;
+    commit_log_header hdr = {COMMIT_LOG_MAGIC, COMMIT_LOG_VERSION, vreg_w, 0};
+    if (fwrite(&hdr, sizeof(hdr), 1, file) != 1) {
+        fprintf(stderr, "ERROR: writing `%s': %s\n", path, strerror(errno));
+        fclose(file);
+        file = NULL;
+        return false;
+    }
+
+    vreg_bytes = vreg_w / 8;
+    //the ring must hold at least one record of the largest kind
+    size_t size = 4096;
+    while (size < ring_bytes || size < 2 * (sizeof(commit_record_header) + vreg_bytes + (vreg_bytes + 7) / 8)) {
+        size <<= 1;
+    }
+    ring.assign(size, 0);
+    ring_mask = size - 1;
+    head.store(0);
+    tail.store(0);
+    stop.store(false);
+    writer = std::thread(&commit_log::drain, this);
+    return true;
+}
+
+/*
+* Flush all pending records, stop the writer thread and close the file.  Returns false if writing the log failed
+*/
+bool commit_log::close(){
+    if (file == NULL) {
+        return true;
+    }
+    stop.store(true, std::memory_order_release);
+    writer.join();
+    //the writer thread has ended, write_error is no longer written
+    bool ok = fclose(file) == 0 && !write_error;
+    file = NULL;
+    if (!ok) {
+        fprintf(stderr, "ERROR: writing `%s' failed, the commit log is truncated\n", path.c_str());
+    }
+    return ok;
+}
+
+/*
+* Wait until len bytes are free in the ring.  Returns the current tail.
+*/
+size_t commit_log::reserve(size_t len){
+    size_t t = tail.load(std::memory_order_relaxed);
+    while (t + len - head.load(std::memory_order_acquire) > ring.size()) {
+        std::this_thread::yield();
+    }
+    return t;
+}
+
+/*
+* Copy len bytes into the ring at position pos, without publishing them to the writer thread.  Returns the position after the copied bytes.
+*/
+size_t commit_log::push(size_t pos, const void *src, size_t len){
+    size_t idx   = pos & ring_mask;
+    size_t first = ring.size() - idx;
+    if (len <= first) {
+        memcpy(&ring[idx], src, len);
+    } else {
+        memcpy(&ring[idx], src, first);
+        memcpy(&ring[0], (const unsigned char *)src + first, len - first);
+    }
+    return pos + len;
+}
+
+void commit_log::scalar(uint8_t kind, uint32_t addr, uint32_t data){
+    if (file == NULL) {
+        return;
+    }
+    struct {
+        commit_record_header h;
+        uint32_t             data;
+    } rec = {{kind, (uint8_t)addr, 4}, data};
+    size_t t = reserve(sizeof(rec));
+    t = push(t, &rec, sizeof(rec));
+    tail.store(t, std::memory_order_release);
+}
+
+/*
+* Append a vreg commit.  data holds vreg_w/8 bytes, mask one bit per byte of data.
+*/
+void commit_log::vreg(uint32_t addr, const unsigned char *data, const unsigned char *mask){
+    if (file == NULL) {
+        return;
+    }
+    uint32_t mask_bytes = (vreg_bytes + 7) / 8;
+    commit_record_header h = {COMMIT_VREG, (uint8_t)addr, (uint16_t)(vreg_bytes + mask_bytes)};
+    size_t t = reserve(sizeof(h) + h.len);
+    t = push(t, &h, sizeof(h));
+    t = push(t, data, vreg_bytes);
+    t = push(t, mask, mask_bytes);
+    //publish the whole record at once
+    tail.store(t, std::memory_order_release);
+}
+
+/*
+* Writer thread.  Writes everything published by the simulation thread until stopped, then flushes the rest.
+*/
+void commit_log::drain(){
+    while (true) {
+        size_t h = head.load(std::memory_order_relaxed);
+        size_t t = tail.load(std::memory_order_acquire);
+        if (h == t) {
+            if (stop.load(std::memory_order_acquire)) {
+                //tail may have moved between the two loads, only stop once it is known to be drained
+                if (tail.load(std::memory_order_acquire) == h) {
+                    break;
+                }
+                continue;
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+            continue;
+        }
+        size_t idx = h & ring_mask;
+        size_t n   = t - h;
+        if (n > ring.size() - idx) {
+            n = ring.size() - idx;
+        }
+        //after a failed write the records are still consumed, so the simulation does not block on a full ring
+        if (!write_error && fwrite(&ring[idx], 1, n, file) != n) {
+            write_error = true;
+        }
+        head.store(h + n, std::memory_order_release);
+    }
+    if (!write_error && fflush(file) != 0) {
+        write_error = true;
+    }
+}
+
+/*
+* Write one commit in the text format of update_*_commit() to buf, without newline.  Scalar commits hold a 4 byte value, vreg commits
+* len bytes of data and a write mask.  buf must hold 16 + 2*len characters.  Returns the length of the text.
+*/
+static size_t format_commit(char *buf, uint8_t kind, uint32_t reg, const unsigned char *data, const unsigned char *mask, uint32_t len){
+    static const char hex[] = "0123456789abcdef";
+    if (kind != COMMIT_VREG) {
+        uint32_t v;
+        memcpy(&v, data, 4);
+        return snprintf(buf, 16, "%c%d 0x%08x", kind == COMMIT_XREG ? 'x' : 'f', reg, v);
+    }
+    char *p = buf + snprintf(buf, 16, "v%d 0x", reg);
+    //bytes written most significant first to match the outputs from spike
+    for (int i = len - 1; i >= 0; i--) {
+        if (mask[i/8] & (1 << (i%8))) {
+            *p++ = hex[data[i] >> 4];
+            *p++ = hex[data[i] & 0xf];
+        } else {
+            *p++ = 'X';
+            *p++ = 'X';
+        }
+    }
+    *p = '\0';
+    return p - buf;
+}
+
+/*
+*   Function to convert a binary commit log into the text format of update_*_commit().  Returns false if error
+*
+*   *bin_path      - binary commit log to read
+*   *out           - text output
+*/
+bool commit_log_to_text(const char *bin_path, FILE *out){
+    FILE *in = fopen(bin_path, "rb");
+    if (in == NULL) {
+        fprintf(stderr, "ERROR: opening `%s': %s\n", bin_path, strerror(errno));
+        return false;
+    }
+    commit_log_header hdr;
+    if (fread(&hdr, sizeof(hdr), 1, in) != 1 || hdr.magic != COMMIT_LOG_MAGIC || hdr.version != COMMIT_LOG_VERSION) {
+        fprintf(stderr, "ERROR: `%s' is not a binary commit log\n", bin_path);
+        fclose(in);
+        return false;
+    }
+
+    uint32_t vreg_bytes = hdr.vreg_w / 8;
+    std::vector<unsigned char> payload(65536);
+    std::vector<char> line(16 + 2 * vreg_bytes);
+    commit_record_header h;
+    bool ok = true;
+    while (fread(&h, sizeof(h), 1, in) == 1) {
+        if (fread(payload.data(), 1, h.len, in) != h.len) {
+            fprintf(stderr, "ERROR: truncated record in `%s'\n", bin_path);
+            ok = false;
+            break;
+        }
+        if ((h.kind == COMMIT_XREG || h.kind == COMMIT_FREG) && h.len == 4) {
+            size_t n = format_commit(line.data(), h.kind, h.reg, payload.data(), NULL, 4);
+            line[n++] = '\n';
+            fwrite(line.data(), 1, n, out);
+        } else if (h.kind == COMMIT_VREG && h.len == vreg_bytes + (vreg_bytes + 7) / 8) {
+            size_t n = format_commit(line.data(), h.kind, h.reg, payload.data(), payload.data() + vreg_bytes, vreg_bytes);
+            line[n++] = '\n';
+            fwrite(line.data(), 1, n, out);
+        } else {
+            fprintf(stderr, "ERROR: invalid record in `%s'\n", bin_path);
+            ok = false;
+            break;
+        }
+    }
+    fclose(in);
+    if (ok && ferror(out)) {
+        fprintf(stderr, "ERROR: writing the text commit log failed\n");
+        ok = false;
+    }
+    return ok;
+}
+
+commit_check::commit_check() : ref(NULL), vreg_bytes(0), line_buf(NULL), line_cap(0), line_no(0), n_commits(0), cycle(0), pc(0),
+                               failed(false), fail_cycle(0), fail_pc(0), fail_commit(0), fail_line(0) {
+}
+
+commit_check::~commit_check(){
+    close();
+    free(line_buf);
+}
+
+/*
+* Open the reference log.  Returns false if error
+*
+*   *ref_path      - reference text commit log
+*   vreg_w         - width of the vector registers in bits
+*/
+bool commit_check::open(const char *ref_path, uint32_t vreg_w){
+    close();
+    ref = fopen(ref_path, "r");
+    if (ref == NULL) {
+        fprintf(stderr, "ERROR: opening `%s': %s\n", ref_path, strerror(errno));
+        return false;
+    }
+    this->ref_path = ref_path;
+    vreg_bytes = vreg_w / 8;
+    act_buf.assign(16 + 2 * vreg_bytes, 0);
+    line_no    = 0;
+    n_commits  = 0;
+    failed     = false;
+    for (std::deque<ref_line> &q : pending) {
+        q.clear();
+    }
+    return true;
+}
+
+void commit_check::close(){
+    if (ref != NULL) {
+        fclose(ref);
+        ref = NULL;
+    }
+}
+
+/*
+* Get the next reference commit of the given kind.  Lines of the other kinds read on the way are queued.  Lines which are not commits
+* (anything not starting with x, f or v followed by a register number) are skipped.  Returns false if the reference has no further
+* commits of this kind.
+*/
+bool commit_check::next(int kind, ref_line *out){
+    while (pending[kind].empty()) {
+        ssize_t n = getline(&line_buf, &line_cap, ref);
+        if (n < 0) {
+            return false;
+        }
+        line_no++;
+        while (n > 0 && (line_buf[n-1] == '\n' || line_buf[n-1] == '\r')) {
+            line_buf[--n] = '\0';
+        }
+        int k;
+        switch (line_buf[0]) {
+            case 'x': k = COMMIT_XREG; break;
+            case 'f': k = COMMIT_FREG; break;
+            case 'v': k = COMMIT_VREG; break;
+            default:  continue;
+        }
+        if (line_buf[1] < '0' || line_buf[1] > '9') {
+            continue;
+        }
+        pending[k].push_back({line_no, std::string(line_buf, n)});
+    }
+    *out = std::move(pending[kind].front());
+    pending[kind].pop_front();
+    return true;
+}
+
+/*
+* Record the first divergence.  exp is NULL if the reference has no further commits.  Returns false.
+*/
+bool commit_check::diverge(const ref_line *exp, const char *act){
+    failed      = true;
+    fail_cycle  = cycle;
+    fail_pc     = pc;
+    fail_commit = n_commits;
+    fail_line   = exp ? exp->line_no : line_no;
+    expected    = exp ? exp->text : std::string("<end of reference>");
+    actual      = act;
+    return false;
+}
+
+bool commit_check::scalar(uint8_t kind, uint32_t addr, uint32_t data){
+    if (failed || ref == NULL) {
+        return !failed;
+    }
+    char act[16];
+    format_commit(act, kind, addr, (const unsigned char *)&data, NULL, 4);
+    ref_line exp;
+    if (!next(kind, &exp)) {
+        return diverge(NULL, act);
+    }
+    //compare register number and value rather than text, so the reference may use any zero padding or case
+    char *end;
+    unsigned long reg = strtoul(exp.text.c_str() + 1, &end, 10);
+    unsigned long val = strtoul(end, &end, 16);
+    if (reg != addr || val != data) {
+        return diverge(&exp, act);
+    }
+    n_commits++;
+    return true;
+}
+
+/*
+* Compare a vreg commit.  Bytes which are XX in the reference or masked out in the commit are not compared.
+*/
+bool commit_check::vreg(uint32_t addr, const unsigned char *data, const unsigned char *mask){
+    if (failed || ref == NULL) {
+        return !failed;
+    }
+    char *act = act_buf.data();
+    format_commit(act, COMMIT_VREG, addr, data, mask, vreg_bytes);
+    ref_line exp;
+    if (!next(COMMIT_VREG, &exp)) {
+        return diverge(NULL, act);
+    }
+    const char *p = exp.text.c_str() + 1;
+    char *end;
+    unsigned long reg = strtoul(p, &end, 10);
+    if (reg != addr || strncmp(end, " 0x", 3) != 0 || strlen(end + 3) != 2 * vreg_bytes) {
+        return diverge(&exp, act);
+    }
+    const char *hex = end + 3;
+    //both texts list the bytes most significant first, byte i is at character 2*(vreg_bytes-1-i)
+    for (uint32_t i = 0; i < vreg_bytes; i++) {
+        const char *r = hex + 2 * (vreg_bytes - 1 - i);
+        if (!(mask[i/8] & (1 << (i%8))) || (r[0] == 'X' && r[1] == 'X')) {
+            continue;
+        }
+        char byte[3] = {r[0], r[1], '\0'};
+        unsigned long val = strtoul(byte, &end, 16);
+        if (end != byte + 2 || val != data[i]) {
+            return diverge(&exp, act);
+        }
+    }
+    n_commits++;
+    return true;
+}
+
+/*
+* Check that no reference commits are left.  Returns false if the reference holds further commits or the run diverged before.
+*/
+bool commit_check::finish(){
+    if (failed || ref == NULL) {
+        return !failed;
+    }
+    for (int k = COMMIT_XREG; k <= COMMIT_VREG; k++) {
+        ref_line exp;
+        if (next(k, &exp)) {
+            return diverge(&exp, "<end of simulation>");
+        }
+    }
+    return true;
+}
+
+/*
+* Print the divergence or the number of matched commits.
+*/
+void commit_check::report(FILE *out) const {
+    if (!failed) {
+        fprintf(out, "commit log matches `%s': %llu commits\n", ref_path.c_str(), (unsigned long long)n_commits);
+        return;
+    }
+    fprintf(out, "ERROR: COMMIT LOG DIVERGED FROM `%s' AT CYCLE %u (WB_PC = 0x%08x) AFTER %llu MATCHING COMMITS\n",
+            ref_path.c_str(), fail_cycle, fail_pc, (unsigned long long)fail_commit);
+    fprintf(out, "  expected (line %llu): %s\n", (unsigned long long)fail_line, expected.c_str());
+    fprintf(out, "  actual:              %s\n", actual.c_str());
+}
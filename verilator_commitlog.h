@@ -0,0 +1,195 @@
+// Binary commit log for use with simulation with Verilator.
+// Provides an asynchronous writer for xreg/freg/vreg commits and the conversion of binary logs to the spike-compatible text format
+// written by update_xreg_commit(), update_freg_commit() and update_vreg_commit(), as well as a checker comparing commits against a
+// reference log in that text format while the simulation runs.
+//
+// Does not access the verilator model, the update_*_commit() overloads in verilator_support.h feed the log from the model.
+
+#ifndef VERILATOR_COMMITLOG_H
+#define VERILATOR_COMMITLOG_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <deque>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+*   Binary commit log file format.  All values little-endian.
+*
+*   File header:    commit_log_header
+*   Records:        commit_record_header followed by len payload bytes
+*       COMMIT_XREG / COMMIT_FREG: 4 bytes register value
+*       COMMIT_VREG:               vreg_w/8 bytes register value (byte 0 first) followed by (vreg_w/8+7)/8 bytes write mask (bit i enables byte i)
+*/
+static const uint32_t COMMIT_LOG_MAGIC   = 0x544d4356; // "VCMT"
+static const uint32_t COMMIT_LOG_VERSION = 1;
+
+enum commit_kind : uint8_t {
+    COMMIT_XREG = 0,
+    COMMIT_FREG = 1,
+    COMMIT_VREG = 2
+};
+
+struct commit_log_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vreg_w;
+    uint32_t reserved;
+};
+
+struct commit_record_header {
+    uint8_t  kind;
+    uint8_t  reg;
+    uint16_t len;
+};
+
+/*
+*   Asynchronous commit log writer.  Records are copied into a lock-free single-producer single-consumer ring buffer by the simulation
+*   thread and written to the file by a background thread, so logging a commit costs one memcpy on the simulation thread.  If the
+*   writer falls behind the simulation waits for free space, no records are dropped.
+*/
+class commit_log {
+public:
+    commit_log();
+    ~commit_log();
+    commit_log(const commit_log &) = delete;
+    commit_log &operator=(const commit_log &) = delete;
+
+    /*
+    * Open the log file and start the writer thread.  Returns false if error
+    * ARGS:
+    *   *path          - binary log file to write
+    *   vreg_w         - width of the vector registers in bits
+    *   ring_bytes     - size of the ring buffer, rounded up to a power of two
+    */
+    bool open(const char *path, uint32_t vreg_w, size_t ring_bytes = 1 << 22);
+
+    /*
+    * Flush all pending records, stop the writer thread and close the file.  Returns false if writing the log failed (e.g. disk full),
+    * the log is then truncated
+    */
+    bool close();
+
+    bool is_open() const { return file != NULL; }
+
+    /*
+    * Append a commit.  mask holds one bit per byte of data.
+    */
+    void xreg(uint32_t addr, uint32_t data)                                          { scalar(COMMIT_XREG, addr, data); }
+    void freg(uint32_t addr, uint32_t data)                                          { scalar(COMMIT_FREG, addr, data); }
+    void vreg(uint32_t addr, const unsigned char *data, const unsigned char *mask);
+
+private:
+    FILE                       *file;
+    std::string                 path;
+    uint32_t                    vreg_bytes;
+    std::vector<unsigned char>  ring;
+    size_t                      ring_mask;
+    std::atomic<size_t>         head;        // next byte to be written to the file, owned by the writer thread
+    std::atomic<size_t>         tail;        // next free byte, owned by the simulation thread
+    std::atomic<bool>           stop;
+    bool                        write_error; // a write failed, latched by the writer thread until close()
+    std::thread                 writer;
+
+    void scalar(uint8_t kind, uint32_t addr, uint32_t data);
+    size_t push(size_t pos, const void *src, size_t len);
+    size_t reserve(size_t len);
+    void drain();
+};
+
+/*
+*   Function to convert a binary commit log into the text format of update_*_commit() (e.g. "x5 0x0000002a", "v3 0x...XX..").
+*   Returns false if error
+* ARGS:
+*   *bin_path      - binary commit log to read
+*   *out           - text output
+*/
+bool commit_log_to_text(const char *bin_path, FILE *out);
+
+/*
+*   Streaming comparison of commits against a reference commit log in the text format of update_*_commit() (e.g. spike output).
+*   The reference is read as commits arrive, so a divergent run can be stopped at the first mismatching commit instead of being
+*   diffed after it finished.  xreg, freg and vreg commits are matched in order per register file, the order between the register
+*   files is not checked as the scalar core and the vector unit retire independently.  A vreg byte written as XX on either side
+*   (masked out) matches any value.
+*/
+class commit_check {
+public:
+    commit_check();
+    ~commit_check();
+    commit_check(const commit_check &) = delete;
+    commit_check &operator=(const commit_check &) = delete;
+
+    /*
+    * Open the reference log.  Returns false if error
+    * ARGS:
+    *   *ref_path      - reference text commit log
+    *   vreg_w         - width of the vector registers in bits
+    */
+    bool open(const char *ref_path, uint32_t vreg_w);
+    void close();
+    bool is_open() const { return ref != NULL; }
+
+    /*
+    * Set the simulation position reported for the following commits.
+    */
+    void at(uint32_t cycle, uint32_t pc) { this->cycle = cycle; this->pc = pc; }
+
+    /*
+    * Compare a commit with the next reference commit of the same register file.  mask holds one bit per byte of data.
+    * Returns false if the commit diverges.  Once diverged, all further commits are ignored and return false.
+    */
+    bool xreg(uint32_t addr, uint32_t data)                                          { return scalar(COMMIT_XREG, addr, data); }
+    bool freg(uint32_t addr, uint32_t data)                                          { return scalar(COMMIT_FREG, addr, data); }
+    bool vreg(uint32_t addr, const unsigned char *data, const unsigned char *mask);
+
+    /*
+    * Check that no reference commits are left after the end of the simulation.  Returns false if the reference holds further
+    * commits (or the run diverged before).
+    */
+    bool finish();
+
+    bool     diverged() const { return failed; }
+    uint64_t commits() const  { return n_commits; }
+
+    /*
+    * Print the divergence (expected and actual commit with cycle, PC and reference line) or the number of matched commits.
+    */
+    void report(FILE *out) const;
+
+private:
+    struct ref_line {
+        uint64_t    line_no;
+        std::string text;
+    };
+
+    FILE                 *ref;
+    std::string           ref_path;
+    uint32_t              vreg_bytes;
+    char                 *line_buf;
+    size_t                line_cap;
+    uint64_t              line_no;
+    std::deque<ref_line>  pending[3];   // reference commits read ahead, one queue per commit_kind
+    std::vector<char>     act_buf;      // text of the vreg commit being compared
+    uint64_t              n_commits;
+    uint32_t              cycle;
+    uint32_t              pc;
+
+    bool                  failed;
+    uint32_t              fail_cycle;
+    uint32_t              fail_pc;
+    uint64_t              fail_commit;
+    uint64_t              fail_line;
+    std::string           expected;
+    std::string           actual;
+
+    bool next(int kind, ref_line *out);
+    bool scalar(uint8_t kind, uint32_t addr, uint32_t data);
+    bool diverge(const ref_line *exp, const char *act);
+};
+
+#endif
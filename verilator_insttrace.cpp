@@ -0,0 +1,441 @@
+// Binary instruction trace for use with simulation with Verilator.
+// Provides the writer used by the inst_trace_log overloads of update_inst_trace() in verilator_support.h and the reader used by the
+// insttrace_decode tool, which converts a binary trace back into the text format of the FILE overloads.
+#include "verilator_insttrace.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/types.h>
+
+#ifdef TRACE_ZLIB
+#include <zlib.h>
+#endif
+
+static void put_varint(std::vector<unsigned char> &buf, uint64_t v){
+    while (v >= 0x80) {
+        buf.push_back((unsigned char)(v | 0x80));
+        v >>= 7;
+    }
+    buf.push_back((unsigned char)v);
+}
+
+static bool get_varint(const unsigned char *&p, const unsigned char *end, uint64_t *v){
+    uint64_t r = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (p == end) {
+            return false;
+        }
+        unsigned char b = *p++;
+        r |= (uint64_t)(b & 0x7f) << shift;
+        if (!(b & 0x80)) {
+            *v = r;
+            return true;
+        }
+    }
+    return false;
+}
+
+static uint32_t zigzag(uint32_t delta){
+    return (delta << 1) ^ (uint32_t)((int32_t)delta >> 31);
+}
+
+static uint32_t unzigzag(uint32_t v){
+    return (v >> 1) ^ (0u - (v & 1));
+}
+
+inst_trace_log::inst_trace_log() : file(NULL), vcsr(false), write_error(false), chunk_bytes(0), offset(0), n_records(0), pending_valid(false) {
+}
+
+inst_trace_log::~inst_trace_log(){
+    close();
+}
+
+/*
+* Open the trace file.  Returns false if error
+*
+*   *path          - binary trace file to write
+*   vcsr           - record vl and vtype
+*   chunk_bytes    - size of the encoded records of one chunk
+*/
+bool inst_trace_log::open(const char *path, bool vcsr, uint32_t chunk_bytes){
+    close();
+    file = fopen(path, "wb");
+    if (file == NULL) {
+        fprintf(stderr, "ERROR: opening `%s': %s\n", path, strerror(errno));
+        return false;
+    }
+    this->path  = path;
+    write_error = false;
+    inst_trace_header hdr = {INST_TRACE_MAGIC, INST_TRACE_VERSION, vcsr ? (uint32_t)INST_TRACE_VCSR : 0u, 0};
+    if (fwrite(&hdr, sizeof(hdr), 1, file) != 1) {
+        fprintf(stderr, "ERROR: writing `%s': %s\n", path, strerror(errno));
+        fclose(file);
+        file = NULL;
+        return false;
+    }
+    this->vcsr        = vcsr;
+    this->chunk_bytes = chunk_bytes ? chunk_bytes : 1;
+    offset        = sizeof(hdr);
+    n_records     = 0;
+    pending_valid = false;
+    buf.clear();
+    buf.reserve(this->chunk_bytes + 32);
+    index.clear();
+    return true;
+}
+
+/*
+* Write the pending records and the index and close the file.  Returns false if writing the trace failed
+*/
+bool inst_trace_log::close(){
+    if (file == NULL) {
+        return true;
+    }
+    if (pending_valid) {
+        encode(pending);
+        pending_valid = false;
+    }
+    flush();
+    inst_trace_footer footer = {offset, (uint32_t)index.size(), INST_TRACE_INDEX_MAGIC};
+    if (!index.empty() && fwrite(index.data(), sizeof(inst_trace_index_entry), index.size(), file) != index.size()) {
+        write_error = true;
+    }
+    if (fwrite(&footer, sizeof(footer), 1, file) != 1) {
+        write_error = true;
+    }
+    bool ok = fclose(file) == 0 && !write_error;
+    file = NULL;
+    if (!ok) {
+        fprintf(stderr, "ERROR: writing `%s' failed, the instruction trace is truncated\n", path.c_str());
+    }
+    return ok;
+}
+
+/*
+* Trace the write-back state of one cycle.  Extends the pending record while nothing changes.
+*/
+void inst_trace_log::cycle(uint64_t cycle, bool new_pc, uint32_t pc, uint32_t instr, uint32_t vl, uint32_t vtype){
+    if (file == NULL) {
+        return;
+    }
+    if (!vcsr) {
+        vl    = 0;
+        vtype = 0;
+    }
+    if (pending_valid && !new_pc && pc == pending.pc && instr == pending.instr && vl == pending.vl && vtype == pending.vtype &&
+        cycle == pending.cycle + pending.run) {
+        pending.run++;
+        return;
+    }
+    if (pending_valid) {
+        encode(pending);
+    }
+    pending       = inst_trace_record{cycle, 1, new_pc, pc, instr, vl, vtype};
+    pending_valid = true;
+}
+
+/*
+* Append a record to the current chunk, the chunk is written once it is full.
+*/
+void inst_trace_log::encode(const inst_trace_record &rec){
+    if (buf.empty()) {
+        chunk = inst_trace_chunk_header{INST_TRACE_CHUNK_MAGIC, INST_TRACE_RAW, 0, 0, rec.cycle, 0, rec.pc, rec.pc, 0, 0};
+        prev  = inst_trace_record{rec.cycle, 0, false, 0, 0, 0, 0};
+    }
+    uint8_t flags = rec.new_pc ? INST_REC_NEW_PC : 0;
+    if (rec.pc == prev.pc) {
+        flags |= INST_REC_PC_SAME;
+    } else if (rec.pc == prev.pc + 4) {
+        flags |= INST_REC_PC_SEQ;
+    }
+    if (rec.instr == prev.instr) {
+        flags |= INST_REC_INSTR_SAME;
+    } else if (rec.instr < 0x10000) {
+        flags |= INST_REC_INSTR16;
+    }
+    if (rec.vl != prev.vl || rec.vtype != prev.vtype) {
+        flags |= INST_REC_VCSR;
+    }
+
+    buf.push_back(flags);
+    put_varint(buf, rec.cycle - prev.cycle);
+    put_varint(buf, rec.run - 1);
+    if (!(flags & (INST_REC_PC_SAME | INST_REC_PC_SEQ))) {
+        put_varint(buf, zigzag(rec.pc - prev.pc));
+    }
+    if (!(flags & INST_REC_INSTR_SAME)) {
+        int n = (flags & INST_REC_INSTR16) ? 2 : 4;
+        for (int i = 0; i < n; i++) {
+            buf.push_back((unsigned char)(rec.instr >> (8 * i)));
+        }
+    }
+    if (flags & INST_REC_VCSR) {
+        put_varint(buf, rec.vl);
+        put_varint(buf, rec.vtype);
+    }
+
+    chunk.last_cycle = rec.cycle + rec.run - 1;
+    chunk.pc_lo      = (rec.pc < chunk.pc_lo) ? rec.pc : chunk.pc_lo;
+    chunk.pc_hi      = (rec.pc > chunk.pc_hi) ? rec.pc : chunk.pc_hi;
+    chunk.records++;
+    n_records++;
+    prev = rec;
+    if (buf.size() >= chunk_bytes) {
+        flush();
+    }
+}
+
+/*
+* Write the current chunk and add it to the index.
+*/
+void inst_trace_log::flush(){
+    if (buf.empty()) {
+        return;
+    }
+    const unsigned char *data = buf.data();
+    chunk.raw_len    = buf.size();
+    chunk.stored_len = buf.size();
+#ifdef TRACE_ZLIB
+    uLongf len = compressBound(buf.size());
+    packed.resize(len);
+    if (compress2(packed.data(), &len, buf.data(), buf.size(), Z_BEST_SPEED) == Z_OK && len < buf.size()) {
+        chunk.compression = INST_TRACE_ZLIB;
+        chunk.stored_len  = len;
+        data = packed.data();
+    }
+#endif
+    //after a failed write the records are still encoded, so the simulation carries on and close() reports the error
+    if (fwrite(&chunk, sizeof(chunk), 1, file) != 1 || fwrite(data, 1, chunk.stored_len, file) != chunk.stored_len) {
+        write_error = true;
+    }
+    index.push_back(inst_trace_index_entry{offset, chunk.first_cycle, chunk.last_cycle, chunk.pc_lo, chunk.pc_hi, chunk.records, 0});
+    offset += sizeof(chunk) + chunk.stored_len;
+    buf.clear();
+}
+
+inst_trace_reader::inst_trace_reader() : file(NULL), hdr_flags(0) {
+}
+
+inst_trace_reader::~inst_trace_reader(){
+    close();
+}
+
+void inst_trace_reader::close(){
+    if (file != NULL) {
+        fclose(file);
+        file = NULL;
+    }
+    index.clear();
+}
+
+/*
+* Open a trace and read its index, or rebuild the index from the chunk headers if the trace was not closed.  Returns false if error
+*/
+bool inst_trace_reader::open(const char *path){
+    close();
+    file = fopen(path, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "ERROR: opening `%s': %s\n", path, strerror(errno));
+        return false;
+    }
+    inst_trace_header hdr;
+    if (fread(&hdr, sizeof(hdr), 1, file) != 1 || hdr.magic != INST_TRACE_MAGIC) {
+        fprintf(stderr, "ERROR: `%s' is not a binary instruction trace\n", path);
+        close();
+        return false;
+    }
+    if (hdr.version != INST_TRACE_VERSION) {
+        fprintf(stderr, "ERROR: `%s' has unsupported version %u\n", path, hdr.version);
+        close();
+        return false;
+    }
+    hdr_flags = hdr.flags;
+
+    inst_trace_footer footer;
+    if (fseeko(file, -(off_t)sizeof(footer), SEEK_END) == 0 && fread(&footer, sizeof(footer), 1, file) == 1 &&
+        footer.magic == INST_TRACE_INDEX_MAGIC && fseeko(file, (off_t)footer.index_offset, SEEK_SET) == 0) {
+        index.resize(footer.n_chunks);
+        if (footer.n_chunks == 0 || fread(index.data(), sizeof(inst_trace_index_entry), footer.n_chunks, file) == footer.n_chunks) {
+            return true;
+        }
+    }
+    fprintf(stderr, "WARNING: `%s' has no index (trace not closed), scanning chunks\n", path);
+    return scan();
+}
+
+/*
+* Rebuild the index from the chunk headers.  A truncated last chunk is dropped.
+*/
+bool inst_trace_reader::scan(){
+    index.clear();
+    uint64_t pos = sizeof(inst_trace_header);
+    inst_trace_chunk_header ch;
+    while (fseeko(file, (off_t)pos, SEEK_SET) == 0 && fread(&ch, sizeof(ch), 1, file) == 1 && ch.magic == INST_TRACE_CHUNK_MAGIC) {
+        if (fseeko(file, (off_t)(pos + sizeof(ch) + ch.stored_len - 1), SEEK_SET) != 0 || fgetc(file) == EOF) {
+            break;
+        }
+        index.push_back(inst_trace_index_entry{pos, ch.first_cycle, ch.last_cycle, ch.pc_lo, ch.pc_hi, ch.records, 0});
+        pos += sizeof(ch) + ch.stored_len;
+    }
+    return true;
+}
+
+/*
+* Returns the index of the first chunk at or after from that may contain the given cycle, or chunks().size() if none.
+*/
+size_t inst_trace_reader::find_cycle(uint64_t cycle, size_t from) const {
+    size_t lo = from, hi = index.size();
+    //chunks are in cycle order
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (index[mid].last_cycle < cycle) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/*
+* Returns the index of the first chunk at or after from whose PC range contains pc, or chunks().size() if none.
+*/
+size_t inst_trace_reader::find_pc(uint32_t pc, size_t from) const {
+    for (size_t i = from; i < index.size(); i++) {
+        if (pc >= index[i].pc_lo && pc <= index[i].pc_hi) {
+            return i;
+        }
+    }
+    return index.size();
+}
+
+/*
+* Decode all records of chunk i.  Returns false if error
+*/
+bool inst_trace_reader::read_chunk(size_t i, std::vector<inst_trace_record> *out){
+    out->clear();
+    inst_trace_chunk_header ch;
+    if (i >= index.size() || fseeko(file, (off_t)index[i].offset, SEEK_SET) != 0 || fread(&ch, sizeof(ch), 1, file) != 1 ||
+        ch.magic != INST_TRACE_CHUNK_MAGIC) {
+        fprintf(stderr, "ERROR: instruction trace chunk %zu not found\n", i);
+        return false;
+    }
+    stored.resize(ch.stored_len);
+    if (fread(stored.data(), 1, ch.stored_len, file) != ch.stored_len) {
+        fprintf(stderr, "ERROR: instruction trace chunk %zu truncated\n", i);
+        return false;
+    }
+    const unsigned char *p = stored.data();
+    if (ch.compression == INST_TRACE_ZLIB) {
+#ifdef TRACE_ZLIB
+        raw.resize(ch.raw_len);
+        uLongf len = ch.raw_len;
+        if (uncompress(raw.data(), &len, stored.data(), stored.size()) != Z_OK || len != ch.raw_len) {
+            fprintf(stderr, "ERROR: instruction trace chunk %zu corrupt\n", i);
+            return false;
+        }
+        p = raw.data();
+#else
+        fprintf(stderr, "ERROR: instruction trace chunk %zu is compressed, compile with TRACE_ZLIB to read it\n", i);
+        return false;
+#endif
+    } else if (ch.compression != INST_TRACE_RAW || ch.raw_len != ch.stored_len) {
+        fprintf(stderr, "ERROR: instruction trace chunk %zu has unknown compression %u\n", i, ch.compression);
+        return false;
+    }
+
+    const unsigned char *end = p + ch.raw_len;
+    inst_trace_record prev = {ch.first_cycle, 0, false, 0, 0, 0, 0};
+    out->reserve(ch.records);
+    while (p < end) {
+        inst_trace_record rec = prev;
+        uint8_t  flags = *p++;
+        uint64_t delta, run, v;
+        if (!get_varint(p, end, &delta) || !get_varint(p, end, &run)) {
+            break;
+        }
+        rec.cycle  = prev.cycle + delta;
+        rec.run    = (uint32_t)run + 1;
+        rec.new_pc = (flags & INST_REC_NEW_PC) != 0;
+        if (flags & INST_REC_PC_SEQ) {
+            rec.pc = prev.pc + 4;
+        } else if (!(flags & INST_REC_PC_SAME)) {
+            if (!get_varint(p, end, &v)) {
+                break;
+            }
+            rec.pc = prev.pc + unzigzag((uint32_t)v);
+        }
+        if (!(flags & INST_REC_INSTR_SAME)) {
+            int n = (flags & INST_REC_INSTR16) ? 2 : 4;
+            if (end - p < n) {
+                break;
+            }
+            rec.instr = 0;
+            for (int b = 0; b < n; b++) {
+                rec.instr |= (uint32_t)*p++ << (8 * b);
+            }
+        }
+        if (flags & INST_REC_VCSR) {
+            uint64_t vl, vtype;
+            if (!get_varint(p, end, &vl) || !get_varint(p, end, &vtype)) {
+                break;
+            }
+            rec.vl    = (uint32_t)vl;
+            rec.vtype = (uint32_t)vtype;
+        }
+        out->push_back(rec);
+        prev = rec;
+    }
+    if (p != end || out->size() != ch.records) {
+        fprintf(stderr, "ERROR: instruction trace chunk %zu corrupt\n", i);
+        return false;
+    }
+    return true;
+}
+
+/*
+* Function to convert a binary instruction trace into the text format of update_inst_trace().  Returns false if error
+*
+*   *bin_path      - binary instruction trace to read
+*   *out           - text output
+*   begin          - first cycle to convert
+*   end            - cycle to stop at, 0 converts up to the end of the trace
+*/
+bool inst_trace_to_text(const char *bin_path, FILE *out, uint64_t begin, uint64_t end){
+    inst_trace_reader in;
+    if (!in.open(bin_path)) {
+        return false;
+    }
+    return inst_trace_to_text(in, out, begin, end);
+}
+
+bool inst_trace_to_text(inst_trace_reader &in, FILE *out, uint64_t begin, uint64_t end){
+    std::vector<inst_trace_record> recs;
+    for (size_t i = in.find_cycle(begin); i < in.chunks().size(); i++) {
+        if (end != 0 && in.chunks()[i].first_cycle >= end) {
+            break;
+        }
+        if (!in.read_chunk(i, &recs)) {
+            return false;
+        }
+        for (const inst_trace_record &rec : recs) {
+            uint64_t c0 = (rec.cycle > begin) ? rec.cycle : begin;
+            uint64_t c1 = rec.cycle + rec.run;
+            if (end != 0 && c1 > end) {
+                c1 = end;
+            }
+            if (c0 >= c1) {
+                continue;
+            }
+            if (rec.new_pc && c0 == rec.cycle) {
+                fputs("NEW PC\n", out);
+            }
+            char line[16];
+            snprintf(line, sizeof(line), "%08x\n", rec.instr);
+            for (uint64_t c = c0; c < c1; c++) {
+                fwrite(line, 1, 9, out);
+            }
+        }
+    }
+    return true;
+}
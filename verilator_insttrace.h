@@ -0,0 +1,219 @@
+// Binary instruction trace for use with simulation with Verilator.
+// Provides the writer used by the inst_trace_log overloads of update_inst_trace() in verilator_support.h and the reader used by the
+// insttrace_decode tool, which converts a binary trace back into the text format of the FILE overloads.
+//
+// Does not access the verilator model.  With TRACE_ZLIB defined (link zlib) the chunks are compressed, the reader needs TRACE_ZLIB to
+// decode compressed chunks.
+
+#ifndef VERILATOR_INSTTRACE_H
+#define VERILATOR_INSTTRACE_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+/*
+*   Binary instruction trace file format.  All values little-endian.
+*
+*   File header:    inst_trace_header
+*   Chunks:         inst_trace_chunk_header followed by stored_len bytes, the records of the chunk (zlib compressed if compression
+*                   is INST_TRACE_ZLIB).  Every chunk is decoded on its own, the delta state starts from zero in every chunk
+*   Index:          n_chunks inst_trace_index_entry, one per chunk in file order
+*   Footer:         inst_trace_footer.  A trace without footer (simulation aborted) is read by scanning the chunk headers
+*
+*   A record holds the write-back state of the scalar core (PC, instruction_wb, vector CSRs) from one cycle for as many consecutive
+*   traced cycles as it stays unchanged.  A new record starts when an instruction retires (new PC), instruction_wb or the vector CSRs
+*   change, or tracing resumes after a gap.  Record encoding:
+*       flags                    1 byte, INST_REC_* bits
+*       cycle delta              varint, cycles since the previous record of the chunk (since first_cycle for the first record)
+*       run - 1                  varint, number of further traced cycles with the same state
+*       PC delta                 zigzag varint of pc - previous pc, unless INST_REC_PC_SEQ or INST_REC_PC_SAME
+*       instruction              2 bytes with INST_REC_INSTR16, 4 bytes otherwise, not present with INST_REC_INSTR_SAME
+*       vl, vtype                varints, only with INST_REC_VCSR
+*/
+static const uint32_t INST_TRACE_MAGIC       = 0x52544956; // "VITR"
+static const uint32_t INST_TRACE_CHUNK_MAGIC = 0x48435456; // "VTCH"
+static const uint32_t INST_TRACE_INDEX_MAGIC = 0x58495456; // "VTIX"
+static const uint32_t INST_TRACE_VERSION     = 1;
+
+enum inst_trace_flags : uint32_t {
+    INST_TRACE_VCSR = 1u << 0           // records carry vl and vtype
+};
+
+enum inst_trace_compression : uint32_t {
+    INST_TRACE_RAW  = 0,
+    INST_TRACE_ZLIB = 1
+};
+
+enum inst_record_flags : uint8_t {
+    INST_REC_NEW_PC     = 1u << 0,      // an instruction retired in the first cycle of the record ("NEW PC" in the text trace)
+    INST_REC_PC_SEQ     = 1u << 1,      // pc == previous pc + 4
+    INST_REC_PC_SAME    = 1u << 2,      // pc == previous pc
+    INST_REC_INSTR_SAME = 1u << 3,      // instruction == previous instruction
+    INST_REC_INSTR16    = 1u << 4,      // instruction fits in 16 bits
+    INST_REC_VCSR       = 1u << 5       // vl and vtype differ from the previous record
+};
+
+struct inst_trace_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t flags;
+    uint32_t reserved;
+};
+
+struct inst_trace_chunk_header {
+    uint32_t magic;
+    uint32_t compression;
+    uint32_t raw_len;                   // bytes of records
+    uint32_t stored_len;                // bytes following the header
+    uint64_t first_cycle;               // first cycle of the first record
+    uint64_t last_cycle;                // last traced cycle of the last record
+    uint32_t pc_lo;                     // range of the PCs of the records
+    uint32_t pc_hi;
+    uint32_t records;
+    uint32_t reserved;
+};
+
+struct inst_trace_index_entry {
+    uint64_t offset;                    // file offset of the chunk header
+    uint64_t first_cycle;
+    uint64_t last_cycle;
+    uint32_t pc_lo;
+    uint32_t pc_hi;
+    uint32_t records;
+    uint32_t reserved;
+};
+
+struct inst_trace_footer {
+    uint64_t index_offset;
+    uint32_t n_chunks;
+    uint32_t magic;
+};
+
+/*
+*   Decoded trace record.
+*/
+struct inst_trace_record {
+    uint64_t cycle;                     // first cycle of the record
+    uint32_t run;                       // consecutive traced cycles, at least 1
+    bool     new_pc;
+    uint32_t pc;
+    uint32_t instr;
+    uint32_t vl;                        // 0 without INST_TRACE_VCSR
+    uint32_t vtype;
+};
+
+/*
+*   Binary instruction trace writer.  Records are encoded into a chunk buffer and written once the chunk is full, the index is
+*   written by close().
+*/
+class inst_trace_log {
+public:
+    inst_trace_log();
+    ~inst_trace_log();
+    inst_trace_log(const inst_trace_log &) = delete;
+    inst_trace_log &operator=(const inst_trace_log &) = delete;
+
+    /*
+    * Open the trace file.  Returns false if error
+    * ARGS:
+    *   *path          - binary trace file to write
+    *   vcsr           - record vl and vtype
+    *   chunk_bytes    - size of the encoded records of one chunk
+    */
+    bool open(const char *path, bool vcsr = true, uint32_t chunk_bytes = 1 << 16);
+
+    /*
+    * Write the pending records and the index and close the file.  Returns false if writing the trace failed (e.g. disk full), the
+    * trace then lacks its index and cannot be read
+    */
+    bool close();
+
+    bool is_open() const { return file != NULL; }
+
+    /*
+    * Trace the write-back state of one cycle.  Cycles must be passed in increasing order, cycles that are not passed are not traced.
+    */
+    void cycle(uint64_t cycle, bool new_pc, uint32_t pc, uint32_t instr, uint32_t vl, uint32_t vtype);
+
+    uint64_t records() const { return n_records; }
+
+private:
+    FILE                               *file;
+    std::string                         path;
+    bool                                vcsr;
+    bool                                write_error;    // a write failed, latched until close()
+    uint32_t                            chunk_bytes;
+    uint64_t                            offset;         // file offset of the next chunk
+    uint64_t                            n_records;
+
+    bool                                pending_valid;  // record still extended by following cycles
+    inst_trace_record                   pending;
+
+    std::vector<unsigned char>          buf;            // records of the current chunk
+    inst_trace_record                   prev;           // delta state of the current chunk
+    inst_trace_chunk_header             chunk;
+    std::vector<unsigned char>          packed;         // compression buffer
+    std::vector<inst_trace_index_entry> index;
+
+    void encode(const inst_trace_record &rec);
+    void flush();
+};
+
+/*
+*   Binary instruction trace reader.  Chunks are located through the index, so decoding can start at any cycle or PC without reading
+*   the chunks before it.
+*/
+class inst_trace_reader {
+public:
+    inst_trace_reader();
+    ~inst_trace_reader();
+    inst_trace_reader(const inst_trace_reader &) = delete;
+    inst_trace_reader &operator=(const inst_trace_reader &) = delete;
+
+    /*
+    * Open a trace and read its index.  Returns false if error
+    */
+    bool open(const char *path);
+    void close();
+
+    const std::vector<inst_trace_index_entry> &chunks() const { return index; }
+    uint32_t flags() const { return hdr_flags; }
+
+    /*
+    * Returns the index of the first chunk that may contain the given cycle / a record of the given PC, or chunks().size() if none.
+    */
+    size_t find_cycle(uint64_t cycle, size_t from = 0) const;
+    size_t find_pc(uint32_t pc, size_t from = 0) const;
+
+    /*
+    * Decode all records of chunk i.  Returns false if error
+    */
+    bool read_chunk(size_t i, std::vector<inst_trace_record> *out);
+
+private:
+    FILE                               *file;
+    uint32_t                            hdr_flags;
+    std::vector<inst_trace_index_entry> index;
+    std::vector<unsigned char>          stored;
+    std::vector<unsigned char>          raw;
+
+    bool scan();
+};
+
+/*
+*   Function to convert a binary instruction trace into the text format of the FILE overloads of update_inst_trace(): per traced
+*   cycle the instruction in write-back as 8 hex digits, preceded by a "NEW PC" line in cycles where an instruction retired.
+*   Returns false if error
+* ARGS:
+*   *bin_path      - binary instruction trace to read (or &in - opened trace)
+*   *out           - text output
+*   begin          - first cycle to convert
+*   end            - cycle to stop at, 0 converts up to the end of the trace
+*/
+bool inst_trace_to_text(const char *bin_path, FILE *out, uint64_t begin = 0, uint64_t end = 0);
+bool inst_trace_to_text(inst_trace_reader &in, FILE *out, uint64_t begin = 0, uint64_t end = 0);
+
+#endif
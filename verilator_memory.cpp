@@ -0,0 +1,1662 @@
+// Memory models for use with simulation with Verilator.
+// Provides the memory port and backing store objects used by the memory helpers in verilator_support.h
+//
+// None of the objects in this file access the verilator model directly.  Interface signals are passed in by the user as byte pointers so that any memory width can be supported.
+#include "verilator_memory.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define MASKED_COPY_X86
+#include <immintrin.h>
+#endif
+
+/*
+*   Memory port with a fixed maximum latency, responses held in a ring buffer indexed by the current cycle.
+*
+*   mem_w          - width of the interface in bits
+*   mem_lat        - default latency of the interface in cycles (must be at least 1)
+*   mem_size       - total size of the memory address space
+*   max_lat        - largest latency that will be requested through request().  Defaults to mem_lat
+*/
+mem_port::mem_port(uint32_t mem_w, uint32_t mem_lat, uint32_t mem_size, uint32_t max_lat){
+    if (mem_lat == 0) {
+        fprintf(stderr, "WARNING: memory latency of 0 is not supported, using 1\n");
+        mem_lat = 1;
+    }
+    if (max_lat < mem_lat) {
+        max_lat = mem_lat;
+    }
+    timing      = NULL;
+    requester   = 0;
+    bytes       = mem_w / 8;
+    lat_default = mem_lat;
+    this->mem_size = mem_size;
+    resize(max_lat);
+}
+
+/*
+* Allocate the response ring for latencies up to max_lat and drop all in-flight requests.
+*/
+void mem_port::resize(uint32_t max_lat){
+    lat_max = max_lat;
+
+    //ring needs one more slot than the largest latency so a new request never lands on the slot currently responding
+    uint32_t slots = 1;
+    while (slots <= max_lat) {
+        slots <<= 1;
+    }
+    slot_mask = slots - 1;
+
+    data.assign((size_t)slots * bytes, 0);
+    valid.assign(slots, 0);
+    err.assign(slots, 0);
+    reset();
+}
+
+/*
+* Take the latency of the requests issued through update() from a timing model shared with other ports.
+*
+*   *timing        - timing model, NULL for the fixed latency
+*   requester      - requester ID of this port, returned by timing->add_requester()
+*/
+void mem_port::set_timing(mem_timing *timing, int requester){
+    this->timing    = timing;
+    this->requester = requester;
+    if (timing != NULL && timing->max_latency() > lat_max) {
+        resize(timing->max_latency());
+    }
+}
+
+/*
+* Latency of a load issued through update().
+*/
+uint32_t mem_port::load_latency(uint32_t address, bool req_valid){
+    if (timing == NULL || !req_valid) {
+        return lat_default;
+    }
+    return timing->access(requester, address, false, bytes);
+}
+
+/*
+* Charge a store on the write interface belonging to this port to the timing model.
+*/
+void mem_port::store(uint32_t address, bool req_valid){
+    if (timing != NULL && req_valid) {
+        timing->access(requester, address, true, bytes);
+    }
+}
+
+/*
+* Put the response due in the current cycle on the processor read port.  Valid is deasserted if no response is due.
+*/
+void mem_port::respond(unsigned char *model_data_i, bool *model_valid_i, bool *model_err_i){
+    uint32_t idx = now & slot_mask;
+    memcpy(model_data_i, slot(now), bytes);
+    *model_valid_i = valid[idx];
+    *model_err_i   = err[idx];
+
+    //slot is free again once it has been put on the port
+    if (valid[idx]) {
+        n_outstanding--;
+    }
+    valid[idx] = 0;
+    err[idx]   = 0;
+}
+
+/*
+* Reserve the response slot for a request with the given latency.  Returns the slot data or NULL if the request can not be scheduled.
+*/
+unsigned char *mem_port::schedule(uint32_t lat, bool in_range){
+    if (lat == 0 || lat > lat_max) {
+        fprintf(stderr, "ERROR: memory request latency %u outside supported range 1 to %u\n", lat, lat_max);
+        return NULL;
+    }
+
+    //keep responses in request order
+    uint64_t due = now + lat;
+    if (due <= last_due) {
+        due = last_due + 1;
+    }
+    if (due - now > slot_mask) {
+        fprintf(stderr, "ERROR: too many outstanding memory requests (%u)\n", n_outstanding);
+        return NULL;
+    }
+
+    uint32_t idx = due & slot_mask;
+    valid[idx] = 1;
+    err[idx]   = !in_range;
+
+    last_due = due;
+    n_outstanding++;
+    return slot(due);
+}
+
+/*
+* Evaluate a load request and schedule its response.  Returns false if the request could not be scheduled.
+*/
+bool mem_port::request(uint32_t address, bool req_valid, uint32_t lat, const unsigned char *mem){
+    if (!req_valid) {
+        return true;
+    }
+    bool in_range = address < mem_size;
+    unsigned char *dst = schedule(lat, in_range);
+    if (dst == NULL) {
+        return false;
+    }
+    if (in_range) {
+        //clip accesses running past the end of memory, the remaining bytes read as zero
+        uint32_t n = (mem_size - address < bytes) ? (mem_size - address) : bytes;
+        memcpy(dst, &mem[address], n);
+        memset(dst + n, 0, bytes - n);
+    } else {
+        memset(dst, 0, bytes);
+    }
+    return true;
+}
+
+bool mem_port::request(uint32_t address, bool req_valid, uint32_t lat, const paged_mem *mem){
+    if (!req_valid) {
+        return true;
+    }
+    bool in_range = address < mem_size && address < mem->size();
+    unsigned char *dst = schedule(lat, in_range);
+    if (dst == NULL) {
+        return false;
+    }
+    if (in_range) {
+        uint64_t limit = (mem->size() < mem_size) ? mem->size() : mem_size;
+        uint32_t n = (limit - address < bytes) ? (uint32_t)(limit - address) : bytes;
+        mem->read(address, dst, n);
+        memset(dst + n, 0, bytes - n);
+    } else {
+        memset(dst, 0, bytes);
+    }
+    return true;
+}
+
+/*
+* Advance the port by one cycle.
+*/
+void mem_port::advance(){
+    now++;
+}
+
+/*
+* Respond, issue a request with the default latency and advance by one cycle.
+*/
+void mem_port::update(uint32_t address, bool req_valid, unsigned char *model_data_i, bool *model_valid_i, bool *model_err_i, const unsigned char *mem){
+    respond(model_data_i, model_valid_i, model_err_i);
+    request(address, req_valid, load_latency(address, req_valid), mem);
+    advance();
+}
+
+void mem_port::update(uint32_t address, bool req_valid, unsigned char *model_data_i, bool *model_valid_i, bool *model_err_i, const paged_mem *mem){
+    respond(model_data_i, model_valid_i, model_err_i);
+    request(address, req_valid, load_latency(address, req_valid), mem);
+    advance();
+}
+
+/*
+* Drop all in-flight requests.
+*/
+void mem_port::reset(){
+    now           = 0;
+    last_due      = 0;
+    n_outstanding = 0;
+    memset(data.data(), 0, data.size());
+    memset(valid.data(), 0, valid.size());
+    memset(err.data(), 0, err.size());
+}
+
+/*
+* Serialize / restore the in-flight requests, used for checkpoints.
+*/
+void mem_port::save_state(std::vector<unsigned char> &buf) const {
+    uint64_t hdr[5] = {bytes, slot_mask, now, last_due, n_outstanding};
+    buf.insert(buf.end(), (const unsigned char *)hdr, (const unsigned char *)(hdr + 5));
+    buf.insert(buf.end(), data.begin(), data.end());
+    buf.insert(buf.end(), valid.begin(), valid.end());
+    buf.insert(buf.end(), err.begin(), err.end());
+}
+
+bool mem_port::restore_state(const std::vector<unsigned char> &buf){
+    uint64_t hdr[5];
+    if (buf.size() != sizeof(hdr) + data.size() + valid.size() + err.size()) {
+        return false;
+    }
+    memcpy(hdr, buf.data(), sizeof(hdr));
+    if (hdr[0] != bytes || hdr[1] != slot_mask) {
+        return false;
+    }
+    now           = hdr[2];
+    last_due      = hdr[3];
+    n_outstanding = hdr[4];
+    const unsigned char *p = buf.data() + sizeof(hdr);
+    memcpy(data.data(), p, data.size());
+    p += data.size();
+    memcpy(valid.data(), p, valid.size());
+    p += valid.size();
+    memcpy(err.data(), p, err.size());
+    return true;
+}
+
+/*
+*   Memory hierarchy timing model: port arbitration, optional set-associative L1 data cache and banked SRAM with a bandwidth limit.
+*
+*   &cfg           - configuration
+*/
+mem_timing::mem_timing(const mem_timing_config &cfg){
+    this->cfg = cfg;
+    if (this->cfg.ports == 0) {
+        this->cfg.ports = 1;
+    }
+    if (this->cfg.max_lat == 0) {
+        this->cfg.max_lat = 1;
+    }
+    n_sets    = 0;
+    line_bits = 0;
+    if (cfg.cache_size != 0) {
+        uint32_t way_bytes = (cfg.cache_ways != 0) ? cfg.cache_size / cfg.cache_ways : 0;
+        uint32_t sets      = (cfg.cache_line != 0) ? way_bytes / cfg.cache_line : 0;
+        if (cfg.cache_line < 4 || (cfg.cache_line & (cfg.cache_line - 1)) != 0 || sets == 0 || (sets & (sets - 1)) != 0 ||
+            (uint64_t)sets * cfg.cache_line * cfg.cache_ways != cfg.cache_size) {
+            fprintf(stderr, "WARNING: unsupported cache geometry (%u bytes, %u ways, %u byte lines), cache disabled\n", cfg.cache_size,
+                    cfg.cache_ways, cfg.cache_line);
+            this->cfg.cache_size = 0;
+        } else {
+            n_sets = sets;
+            while ((1u << line_bits) < cfg.cache_line) {
+                line_bits++;
+            }
+        }
+    }
+    if (cfg.sram_banks != 0 && cfg.sram_bank_w == 0) {
+        fprintf(stderr, "WARNING: SRAM bank width of 0 bytes, bank conflicts not modeled\n");
+        this->cfg.sram_banks = 0;
+    }
+    bank_free.assign(this->cfg.sram_banks, 0);
+    tags.assign((size_t)n_sets * cfg.cache_ways, 0);
+    lru.assign(tags.size(), 0);
+    dirty.assign(tags.size(), 0);
+    reset();
+    clear_stats();
+}
+
+/*
+* Register a requester and return its ID.
+*/
+int mem_timing::add_requester(const char *name){
+    requester_stats r = {};
+    r.name = name;
+    req.push_back(r);
+    return (int)req.size() - 1;
+}
+
+void mem_timing::reset(){
+    now        = 0;
+    stamp      = 0;
+    port_cycle = 0;
+    port_used  = 0;
+    bw_free    = 0;
+    std::fill(bank_free.begin(), bank_free.end(), 0);
+    std::fill(lru.begin(), lru.end(), 0);
+    std::fill(dirty.begin(), dirty.end(), 0);
+}
+
+void mem_timing::clear_stats(){
+    for (requester_stats &r : req) {
+        std::string name = r.name;
+        r = requester_stats{};
+        r.name = name;
+    }
+    evictions     = 0;
+    writebacks    = 0;
+    sram_rd_bytes = 0;
+    sram_wr_bytes = 0;
+    n_cycles      = 0;
+}
+
+/*
+* Reserve the banks and bandwidth of an SRAM access starting no earlier than cycle t.  Returns the cycle the access completes.
+*/
+uint64_t mem_timing::sram_access(requester_stats &r, uint64_t t, uint32_t address, uint32_t len){
+    uint64_t start = t;
+    if (!bank_free.empty()) {
+        uint64_t first = address / cfg.sram_bank_w;
+        uint64_t last  = ((uint64_t)address + len - 1) / cfg.sram_bank_w;
+        for (uint64_t w = first; w <= last; w++) {
+            uint64_t &free = bank_free[w % cfg.sram_banks];
+            uint64_t  s    = std::max(t, free);
+            free  = s + 1;
+            start = std::max(start, s);
+        }
+        r.bank_wait += start - t;
+    }
+    uint64_t xfer = 1;
+    if (cfg.sram_bw != 0) {
+        xfer = (len + cfg.sram_bw - 1) / cfg.sram_bw;
+        uint64_t s = std::max(start, bw_free);
+        r.bw_wait += s - start;
+        bw_free = s + xfer;
+        start   = s;
+    }
+    return start + cfg.sram_lat + xfer - 1;
+}
+
+/*
+* Look up one cache line at cycle t, filling it on a miss.  Updates *done with the cycle the line is available.  Returns true on a hit.
+*/
+bool mem_timing::cache_access(requester_stats &r, uint64_t t, uint32_t line, bool write, uint64_t *done){
+    size_t    base   = (size_t)(line & (n_sets - 1)) * cfg.cache_ways;
+    size_t    victim = base;
+    for (size_t i = base; i < base + cfg.cache_ways; i++) {
+        if (lru[i] != 0 && tags[i] == line) {
+            lru[i] = ++stamp;
+            if (write && cfg.write_back) {
+                dirty[i] = 1;
+            }
+            return true;
+        }
+        if (lru[i] < lru[victim]) {
+            victim = i;
+        }
+    }
+    if (write && !cfg.write_back) {
+        //no write-allocate, the caller writes through to the SRAM
+        return false;
+    }
+
+    uint64_t fill = sram_access(r, t, line << line_bits, cfg.cache_line);
+    sram_rd_bytes += cfg.cache_line;
+    *done = std::max(*done, fill);
+    if (lru[victim] != 0) {
+        evictions++;
+        if (dirty[victim]) {
+            //write buffer, occupies the SRAM after the fill but is not waited for
+            requester_stats wb = {};
+            sram_access(wb, t, tags[victim] << line_bits, cfg.cache_line);
+            sram_wr_bytes += cfg.cache_line;
+            writebacks++;
+        }
+    }
+    tags[victim]  = line;
+    lru[victim]   = ++stamp;
+    dirty[victim] = write;
+    return false;
+}
+
+/*
+* Account an access issued in the current cycle and return its latency in cycles.
+*/
+uint32_t mem_timing::access(int requester, uint32_t address, bool write, uint32_t len){
+    requester_stats &r = req[requester];
+    (write ? r.stores : r.loads)++;
+    if (len == 0) {
+        len = 1;
+    }
+
+    //port arbitration, first come first served within a cycle
+    if (port_cycle < now) {
+        port_cycle = now;
+        port_used  = 0;
+    }
+    if (port_used == cfg.ports) {
+        port_cycle++;
+        port_used = 0;
+    }
+    port_used++;
+    uint64_t t = port_cycle;
+    r.port_wait += t - now;
+
+    uint64_t done;
+    bool     hit = false;
+    if (n_sets == 0) {
+        done = sram_access(r, t, address, len);
+        (write ? sram_wr_bytes : sram_rd_bytes) += len;
+    } else {
+        uint64_t lookup = t + cfg.hit_lat;
+        uint32_t first  = address >> line_bits;
+        uint32_t last   = (uint32_t)(((uint64_t)address + len - 1) >> line_bits);
+        done = lookup;
+        hit  = true;
+        for (uint64_t l = first; l <= last; l++) {
+            hit &= cache_access(r, lookup, (uint32_t)l, write, &done);
+        }
+        if (write && !cfg.write_back) {
+            sram_access(r, lookup, address, len);
+            sram_wr_bytes += len;
+        }
+    }
+    if (hit) {
+        (write ? r.store_hits : r.load_hits)++;
+    }
+
+    uint64_t lat = (done > now) ? done - now : 1;
+    if (lat > cfg.max_lat) {
+        r.clamped++;
+        lat = cfg.max_lat;
+    }
+    if (!write) {
+        r.load_lat += lat;
+    }
+    return (uint32_t)lat;
+}
+
+/*
+* Advance the model by one cycle.
+*/
+void mem_timing::cycle(){
+    now++;
+    n_cycles++;
+}
+
+/*
+* Print the hit/miss, latency and contention statistics.
+*/
+void mem_timing::report(FILE *out) const {
+    fprintf(out, "Memory Timing (");
+    if (n_sets != 0) {
+        fprintf(out, "L1 %u B %u-way %u B lines %s, hit %u cycles, ", cfg.cache_size, cfg.cache_ways, cfg.cache_line,
+                cfg.write_back ? "write-back" : "write-through", cfg.hit_lat);
+    } else {
+        fprintf(out, "no cache, ");
+    }
+    fprintf(out, "SRAM %u cycles", cfg.sram_lat);
+    if (cfg.sram_banks != 0) {
+        fprintf(out, " %u x %u B banks", cfg.sram_banks, cfg.sram_bank_w);
+    }
+    if (cfg.sram_bw != 0) {
+        fprintf(out, " %u B/cycle", cfg.sram_bw);
+    }
+    fprintf(out, ", %u port%s, %llu cycles):\n", cfg.ports, cfg.ports == 1 ? "" : "s", (unsigned long long)n_cycles);
+    fprintf(out, "REQUESTER         LOADS  LOAD HIT %%      STORES  STORE HIT %%  AVG LOAD LAT   PORT WAIT   BANK WAIT     BW WAIT  CLAMPED\n");
+    for (const requester_stats &r : req) {
+        fprintf(out, "%-12s  %9llu     %6.2f  %10llu       %6.2f  %12.2f  %10llu  %10llu  %10llu  %7llu\n", r.name.c_str(),
+                (unsigned long long)r.loads, (n_sets && r.loads) ? 100.0 * r.load_hits / r.loads : 0.0, (unsigned long long)r.stores,
+                (n_sets && r.stores) ? 100.0 * r.store_hits / r.stores : 0.0, r.loads ? (double)r.load_lat / r.loads : 0.0,
+                (unsigned long long)r.port_wait, (unsigned long long)r.bank_wait, (unsigned long long)r.bw_wait,
+                (unsigned long long)r.clamped);
+    }
+    double cyc = n_cycles ? (double)n_cycles : 1.0;
+    fprintf(out, "SRAM traffic: read %llu B, write %llu B (%.3f B/cycle)", (unsigned long long)sram_rd_bytes,
+            (unsigned long long)sram_wr_bytes, (sram_rd_bytes + sram_wr_bytes) / cyc);
+    if (n_sets != 0) {
+        fprintf(out, ", evictions %llu, dirty write-backs %llu", (unsigned long long)evictions, (unsigned long long)writebacks);
+    }
+    fprintf(out, "\n\n");
+}
+
+/*
+* Parse a timing configuration of comma-separated key=value pairs.  Returns false if error
+*/
+bool parse_mem_timing(const char *spec, mem_timing_config *cfg){
+    std::string s = spec;
+    size_t pos = 0;
+    while (pos <= s.size()) {
+        size_t end = s.find(',', pos);
+        if (end == std::string::npos) {
+            end = s.size();
+        }
+        std::string item = s.substr(pos, end - pos);
+        pos = end + 1;
+        if (item.empty()) {
+            continue;
+        }
+        if (item == "wb" || item == "wt") {
+            cfg->write_back = (item == "wb");
+            continue;
+        }
+        size_t eq = item.find('=');
+        std::string key = item.substr(0, eq);
+        char *vend = NULL;
+        unsigned long val = (eq == std::string::npos) ? 0 : strtoul(item.c_str() + eq + 1, &vend, 0);
+        if (eq == std::string::npos || vend == item.c_str() + eq + 1) {
+            fprintf(stderr, "ERROR: memory timing: expected <key>=<value>, got `%s'\n", item.c_str());
+            return false;
+        }
+        if (*vend == 'k' || *vend == 'K') {
+            val *= 1024;
+            vend++;
+        }
+        if (*vend != '\0') {
+            fprintf(stderr, "ERROR: memory timing: invalid value in `%s'\n", item.c_str());
+            return false;
+        }
+        uint32_t v = (uint32_t)val;
+        if      (key == "ports")    cfg->ports       = v;
+        else if (key == "size")     cfg->cache_size  = v;
+        else if (key == "ways")     cfg->cache_ways  = v;
+        else if (key == "line")     cfg->cache_line  = v;
+        else if (key == "hit_lat")  cfg->hit_lat     = v;
+        else if (key == "sram_lat") cfg->sram_lat    = v;
+        else if (key == "banks")    cfg->sram_banks  = v;
+        else if (key == "bank_w")   cfg->sram_bank_w = v;
+        else if (key == "bw")       cfg->sram_bw     = v;
+        else if (key == "max_lat")  cfg->max_lat     = v;
+        else {
+            fprintf(stderr, "ERROR: memory timing: unknown key `%s'\n", key.c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+*   Byte-enable merge kernels.  All kernels handle any len; the vector kernels leave the tail shorter than their width to the scalar one.
+*/
+
+//64-bit byte mask for every value of a byte enable byte
+struct be_expand_table {
+    uint64_t mask[256];
+    be_expand_table(){
+        for (int m = 0; m < 256; m++) {
+            uint64_t v = 0;
+            for (int b = 0; b < 8; b++) {
+                if (m & (1 << b)) {
+                    v |= 0xffull << (8 * b);
+                }
+            }
+            mask[m] = v;
+        }
+    }
+};
+static const be_expand_table be_expand;
+
+static void masked_copy_scalar(unsigned char *dst, const unsigned char *src, const unsigned char *be, uint32_t len){
+    uint32_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        unsigned char m = be[i / 8];
+        if (m == 0) {
+            continue;
+        }
+        if (m == 0xff) {
+            memcpy(dst + i, src + i, 8);
+            continue;
+        }
+        uint64_t d, s, mask = be_expand.mask[m];
+        memcpy(&d, dst + i, 8);
+        memcpy(&s, src + i, 8);
+        d = (d & ~mask) | (s & mask);
+        memcpy(dst + i, &d, 8);
+    }
+    if (i + 4 <= len && (be[i / 8] & 0xf) != 0) {
+        uint32_t d, s, mask = (uint32_t)be_expand.mask[be[i / 8] & 0xf];
+        memcpy(&d, dst + i, 4);
+        memcpy(&s, src + i, 4);
+        d = (d & ~mask) | (s & mask);
+        memcpy(dst + i, &d, 4);
+        i += 4;
+    }
+    for (; i < len; i++) {
+        if (be[i / 8] & (1 << (i % 8))) {
+            dst[i] = src[i];
+        }
+    }
+}
+
+#ifdef MASKED_COPY_X86
+__attribute__((target("sse2")))
+static void masked_copy_sse2(unsigned char *dst, const unsigned char *src, const unsigned char *be, uint32_t len){
+    uint32_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        uint32_t m = be[i / 8] | (be[i / 8 + 1] << 8);
+        if (m == 0) {
+            continue;
+        }
+        __m128i s = _mm_loadu_si128((const __m128i *)(src + i));
+        if (m != 0xffff) {
+            __m128i mask = _mm_set_epi64x((long long)be_expand.mask[m >> 8], (long long)be_expand.mask[m & 0xff]);
+            __m128i d    = _mm_loadu_si128((const __m128i *)(dst + i));
+            s = _mm_or_si128(_mm_and_si128(mask, s), _mm_andnot_si128(mask, d));
+        }
+        _mm_storeu_si128((__m128i *)(dst + i), s);
+    }
+    if (i < len) {
+        masked_copy_scalar(dst + i, src + i, be + i / 8, len - i);
+    }
+}
+
+__attribute__((target("avx2")))
+static void masked_copy_avx2(unsigned char *dst, const unsigned char *src, const unsigned char *be, uint32_t len){
+    //byte j of the expanded mask tests bit j % 8 of byte enable byte j / 8
+    const __m256i spread = _mm256_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1,
+                                            2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3);
+    const __m256i bits   = _mm256_set1_epi64x(0x8040201008040201ll);
+    uint32_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        uint32_t m;
+        memcpy(&m, be + i / 8, 4);
+        if (m == 0) {
+            continue;
+        }
+        __m256i s = _mm256_loadu_si256((const __m256i *)(src + i));
+        if (m != 0xffffffffu) {
+            __m256i mask = _mm256_shuffle_epi8(_mm256_set1_epi32((int)m), spread);
+            mask = _mm256_cmpeq_epi8(_mm256_and_si256(mask, bits), bits);
+            s = _mm256_blendv_epi8(_mm256_loadu_si256((const __m256i *)(dst + i)), s, mask);
+        }
+        _mm256_storeu_si256((__m256i *)(dst + i), s);
+    }
+    if (len - i >= 16) {
+        masked_copy_sse2(dst + i, src + i, be + i / 8, len - i);
+    } else if (i < len) {
+        masked_copy_scalar(dst + i, src + i, be + i / 8, len - i);
+    }
+}
+
+//the tail is left to the AVX2 kernel, masked accesses reaching past the beat are much slower than blends on some hosts
+__attribute__((target("avx512f,avx512bw,avx2")))
+static void masked_copy_avx512(unsigned char *dst, const unsigned char *src, const unsigned char *be, uint32_t len){
+    uint32_t i = 0;
+    for (; i + 64 <= len; i += 64) {
+        __mmask64 k;
+        memcpy(&k, be + i / 8, 8);
+        if (k != 0) {
+            _mm512_mask_storeu_epi8(dst + i, k, _mm512_loadu_si512(src + i));
+        }
+    }
+    if (i < len) {
+        masked_copy_avx2(dst + i, src + i, be + i / 8, len - i);
+    }
+}
+#endif
+
+masked_copy_fn masked_copy_kernel(masked_copy_isa isa){
+    switch (isa) {
+        case MASKED_COPY_SCALAR:
+            return masked_copy_scalar;
+#ifdef MASKED_COPY_X86
+        case MASKED_COPY_SSE2:
+            return __builtin_cpu_supports("sse2") ? masked_copy_sse2 : NULL;
+        case MASKED_COPY_AVX2:
+            return __builtin_cpu_supports("avx2") ? masked_copy_avx2 : NULL;
+        case MASKED_COPY_AVX512:
+            return (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx2")) ?
+                   masked_copy_avx512 : NULL;
+#endif
+        default:
+            return NULL;
+    }
+}
+
+masked_copy_isa masked_copy_selected(){
+    static const masked_copy_isa isa = [](){
+        int best = MASKED_COPY_SCALAR;
+        for (int i = MASKED_COPY_SCALAR; i < MASKED_COPY_ISA_CNT; i++) {
+            if (masked_copy_kernel((masked_copy_isa)i) != NULL) {
+                best = i;
+            }
+        }
+        return (masked_copy_isa)best;
+    }();
+    return isa;
+}
+
+const char *masked_copy_name(masked_copy_isa isa){
+    static const char *const names[MASKED_COPY_ISA_CNT] = {"scalar", "sse2", "avx2", "avx512"};
+    return (isa < MASKED_COPY_ISA_CNT) ? names[isa] : "unknown";
+}
+
+//widest kernel of the selected instruction set that fits beats of at least 1 << (i + 3) bytes, short beats skip the wide kernels
+struct masked_copy_dispatch {
+    masked_copy_fn fn[4];
+    masked_copy_dispatch(){
+        for (int i = 0; i < 4; i++) {
+            int isa = std::min(i, (int)masked_copy_selected());
+            while (masked_copy_kernel((masked_copy_isa)isa) == NULL) {
+                isa--;
+            }
+            fn[i] = masked_copy_kernel((masked_copy_isa)isa);
+        }
+    }
+};
+
+/*
+* Copy the bytes of src selected by the byte enable bit mask be to dst with the kernel selected for the host.
+*/
+void masked_copy(unsigned char *dst, const unsigned char *src, const unsigned char *be, uint32_t len){
+    static const masked_copy_dispatch dispatch;
+    int cls = (len >= 64) ? 3 : (len >= 32) ? 2 : (len >= 16) ? 1 : 0;
+    dispatch.fn[cls](dst, src, be, len);
+}
+
+/*
+*   Bitmap of written pages.
+*
+*   mem_size       - total size of the memory address space
+*/
+dirty_pages::dirty_pages(uint64_t mem_size){
+    pages = (mem_size + PAGE_SIZE - 1) >> PAGE_BITS;
+    bits.assign((pages + 63) / 64, 0);
+}
+
+void dirty_pages::clear(){
+    std::fill(bits.begin(), bits.end(), 0);
+}
+
+/*
+* Clear the pages lying entirely within [lo, hi).
+*/
+void dirty_pages::clear(uint32_t lo, uint64_t hi){
+    uint64_t pn  = ((uint64_t)lo + PAGE_SIZE - 1) >> PAGE_BITS;
+    uint64_t end = std::min(hi >> PAGE_BITS, pages);
+    for (; pn < end && (pn & 63) != 0; pn++) {
+        bits[pn >> 6] &= ~(1ull << (pn & 63));
+    }
+    for (; pn + 64 <= end; pn += 64) {
+        bits[pn >> 6] = 0;
+    }
+    for (; pn < end; pn++) {
+        bits[pn >> 6] &= ~(1ull << (pn & 63));
+    }
+}
+
+//first page at or after pn and before end that is marked (set) or not marked, end if none
+uint64_t dirty_pages::find(uint64_t pn, uint64_t end, bool set) const {
+    while (pn < end) {
+        uint64_t w = set ? bits[pn >> 6] : ~bits[pn >> 6];
+        w &= ~0ull << (pn & 63);
+        if (w != 0) {
+            return std::min<uint64_t>(end, (pn & ~63ull) + __builtin_ctzll(w));
+        }
+        pn = (pn | 63) + 1;
+    }
+    return end;
+}
+
+/*
+* Call fn for every run of consecutive marked pages, clipped to [lo, hi).  Unmarked pages are skipped 64 at a time.
+*/
+void dirty_pages::for_each_range(uint32_t lo, uint64_t hi, const std::function<void(uint32_t address, uint32_t len)> &fn) const {
+    uint64_t end = std::min((hi + PAGE_SIZE - 1) >> PAGE_BITS, pages);
+    for (uint64_t pn = find(lo >> PAGE_BITS, end, true); pn < end; pn = find(pn, end, true)) {
+        uint64_t run_end = find(pn, end, false);
+        uint64_t a = std::max<uint64_t>(pn << PAGE_BITS, lo);
+        uint64_t b = std::min<uint64_t>(run_end << PAGE_BITS, hi);
+        if (a < b) {
+            fn((uint32_t)a, (uint32_t)(b - a));
+        }
+        pn = run_end;
+    }
+}
+
+size_t dirty_pages::count() const {
+    size_t n = 0;
+    for (uint64_t w : bits) {
+        n += __builtin_popcountll(w);
+    }
+    return n;
+}
+
+//page returned for reads of pages that were never written
+alignas(64) static const unsigned char zero_page[paged_mem::PAGE_SIZE] = {0};
+
+/*
+*   Sparse memory backing store with 4 KiB pages allocated on first write and copy-on-write forking.
+*
+*   mem_size       - total size of the memory address space
+*/
+paged_mem::paged_mem(uint64_t mem_size) : dirty_map(mem_size) {
+    this->mem_size = mem_size;
+    n_pages = 0;
+    memset(table, 0, sizeof(table));
+    invalidate();
+}
+
+paged_mem::~paged_mem(){
+    clear();
+}
+
+void paged_mem::invalidate() const {
+    rd_tag  = ~0u;
+    rd_page = NULL;
+    wr_tag  = ~0u;
+    wr_page = NULL;
+}
+
+paged_mem::page **paged_mem::entry(uint32_t pn) const {
+    page **l2 = table[pn >> L2_BITS];
+    return (l2 == NULL) ? NULL : &l2[pn & (L2_SIZE - 1)];
+}
+
+/*
+* Returns a copy-on-write copy of this memory.  Cost is proportional to the number of allocated pages, no page data is copied.
+*/
+paged_mem *paged_mem::fork() const {
+    paged_mem *copy = new paged_mem(mem_size);
+    for (uint32_t i = 0; i < (1u << L1_BITS); i++) {
+        if (table[i] == NULL) {
+            continue;
+        }
+        copy->table[i] = new page*[L2_SIZE];
+        for (uint32_t j = 0; j < L2_SIZE; j++) {
+            page *pg = table[i][j];
+            if (pg != NULL) {
+                pg->refs.fetch_add(1, std::memory_order_relaxed);
+            }
+            copy->table[i][j] = pg;
+        }
+    }
+    copy->n_pages = n_pages;
+    //pages are shared now, the cached write page of this memory must not be written in place anymore
+    invalidate();
+    return copy;
+}
+
+/*
+* Call fn for every allocated page, in address order.
+*/
+void paged_mem::for_each_page(const std::function<void(uint32_t address, const unsigned char *data)> &fn) const {
+    for (uint32_t i = 0; i < (1u << L1_BITS); i++) {
+        if (table[i] == NULL) {
+            continue;
+        }
+        for (uint32_t j = 0; j < L2_SIZE; j++) {
+            if (table[i][j] != NULL) {
+                fn(((i << L2_BITS) | j) << PAGE_BITS, table[i][j]->data);
+            }
+        }
+    }
+}
+
+/*
+* Release all pages, the whole memory reads as zero afterwards.
+*/
+void paged_mem::clear(){
+    for (uint32_t i = 0; i < (1u << L1_BITS); i++) {
+        if (table[i] == NULL) {
+            continue;
+        }
+        for (uint32_t j = 0; j < L2_SIZE; j++) {
+            page *pg = table[i][j];
+            if (pg == NULL) {
+                continue;
+            }
+            //the page reads as zero from now on
+            dirty_map.mark(((i << L2_BITS) | j) << PAGE_BITS, 1);
+            if (pg->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                delete pg;
+            }
+        }
+        delete[] table[i];
+        table[i] = NULL;
+    }
+    n_pages = 0;
+    invalidate();
+}
+
+/*
+* Clear the dirty pages, or those lying entirely within [lo, hi).
+*/
+void paged_mem::clear_dirty(){
+    dirty_map.clear();
+    //the next write to the cached page has to mark it again
+    wr_tag  = ~0u;
+    wr_page = NULL;
+}
+
+void paged_mem::clear_dirty(uint32_t lo, uint64_t hi){
+    dirty_map.clear(lo, hi);
+    wr_tag  = ~0u;
+    wr_page = NULL;
+}
+
+/*
+* Page lookup for reads.  Returns a shared zero page for pages that were never written.
+*/
+const unsigned char *paged_mem::page_rd(uint32_t address) const {
+    uint32_t pn = address >> PAGE_BITS;
+    if (pn == rd_tag) {
+        return rd_page;
+    }
+    page **e = entry(pn);
+    const unsigned char *p = (e != NULL && *e != NULL) ? (*e)->data : zero_page;
+    //zero pages are not cached, a later write would allocate the page behind the cache's back
+    if (p != zero_page) {
+        rd_tag  = pn;
+        rd_page = p;
+    }
+    return p;
+}
+
+/*
+* Page lookup for writes.  Allocates the page or breaks sharing with a fork.
+*/
+unsigned char *paged_mem::page_wr(uint32_t address){
+    uint32_t pn = address >> PAGE_BITS;
+    if (pn == wr_tag) {
+        return wr_page;
+    }
+    page **l2 = table[pn >> L2_BITS];
+    if (l2 == NULL) {
+        l2 = table[pn >> L2_BITS] = new page*[L2_SIZE]();
+    }
+    page *&pg = l2[pn & (L2_SIZE - 1)];
+    if (pg == NULL) {
+        pg = new page;
+        pg->refs.store(1, std::memory_order_relaxed);
+        memset(pg->data, 0, PAGE_SIZE);
+        n_pages++;
+    } else if (pg->refs.load(std::memory_order_acquire) > 1) {
+        //shared with a fork, take a private copy
+        page *priv = new page;
+        priv->refs.store(1, std::memory_order_relaxed);
+        memcpy(priv->data, pg->data, PAGE_SIZE);
+        if (pg->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            delete pg;
+        }
+        pg = priv;
+    }
+    //the read cache may point at the page that was just replaced
+    if (rd_tag == pn) {
+        rd_page = pg->data;
+    }
+    dirty_map.mark(address, 1);
+    wr_tag  = pn;
+    wr_page = pg->data;
+    return wr_page;
+}
+
+/*
+* Copy len bytes starting at address out of memory.
+*/
+void paged_mem::read(uint32_t address, unsigned char *dst, uint32_t len) const {
+    uint32_t off = address & (PAGE_SIZE - 1);
+    //fast path, access within one page
+    if (off + len <= PAGE_SIZE) {
+        memcpy(dst, page_rd(address) + off, len);
+        return;
+    }
+    while (len > 0) {
+        uint32_t n = PAGE_SIZE - off;
+        if (n > len) {
+            n = len;
+        }
+        memcpy(dst, page_rd(address) + off, n);
+        address += n;
+        dst     += n;
+        len     -= n;
+        off      = 0;
+    }
+}
+
+/*
+* Copy len bytes starting at address into memory.
+*/
+void paged_mem::write(uint32_t address, const unsigned char *src, uint32_t len){
+    uint32_t off = address & (PAGE_SIZE - 1);
+    if (off + len <= PAGE_SIZE) {
+        memcpy(page_wr(address) + off, src, len);
+        return;
+    }
+    while (len > 0) {
+        uint32_t n = PAGE_SIZE - off;
+        if (n > len) {
+            n = len;
+        }
+        memcpy(page_wr(address) + off, src, n);
+        address += n;
+        src     += n;
+        len     -= n;
+        off      = 0;
+    }
+}
+
+/*
+* Write the bytes of src selected by the byte enable bit mask be (bit i enables byte i).
+*/
+void paged_mem::write_masked(uint32_t address, const unsigned char *src, const unsigned char *be, uint32_t len){
+    uint32_t off = address & (PAGE_SIZE - 1);
+    //fast path, access within one page
+    if (off + len <= PAGE_SIZE) {
+        //fully disabled writes must not allocate the page
+        for (uint32_t i = 0; i < (len + 7) / 8; i++) {
+            if (be[i] != 0) {
+                masked_copy(page_wr(address) + off, src, be, len);
+                return;
+            }
+        }
+        return;
+    }
+    unsigned char *pg  = NULL;
+    uint32_t       cur = ~0u;
+    for (uint32_t i = 0; i < len; i++) {
+        if (!(be[i/8] & (1 << (i%8)))) {
+            continue;
+        }
+        uint32_t a = address + i;
+        if ((a >> PAGE_BITS) != cur) {
+            cur = a >> PAGE_BITS;
+            pg  = page_wr(a);
+        }
+        pg[a & (PAGE_SIZE - 1)] = src[i];
+    }
+}
+
+/*
+*   Returns the symbol containing address, or NULL.  Symbols without a size extend up to the next symbol.
+*/
+const elf_symbol *program_info::lookup(uint32_t address) const {
+    auto it = std::upper_bound(symbols.begin(), symbols.end(), address,
+                               [](uint32_t a, const elf_symbol &sym) { return a < sym.addr; });
+    if (it == symbols.begin()) {
+        return NULL;
+    }
+    --it;
+    if (it->size != 0 && address - it->addr >= it->size) {
+        return NULL;
+    }
+    return &*it;
+}
+
+/*
+*   Returns the symbol with the given name, or NULL.
+*/
+const elf_symbol *program_info::find(const char *name) const {
+    for (const elf_symbol &sym : symbols) {
+        if (sym.name == name) {
+            return &sym;
+        }
+    }
+    return NULL;
+}
+
+//ELF32 structures and constants, only the fields needed by the loader (see the System V ABI)
+namespace {
+
+struct elf32_ehdr {
+    unsigned char e_ident[16];
+    uint16_t e_type, e_machine;
+    uint32_t e_version, e_entry, e_phoff, e_shoff, e_flags;
+    uint16_t e_ehsize, e_phentsize, e_phnum, e_shentsize, e_shnum, e_shstrndx;
+};
+struct elf32_phdr {
+    uint32_t p_type, p_offset, p_vaddr, p_paddr, p_filesz, p_memsz, p_flags, p_align;
+};
+struct elf32_shdr {
+    uint32_t sh_name, sh_type, sh_flags, sh_addr, sh_offset, sh_size, sh_link, sh_info, sh_addralign, sh_entsize;
+};
+struct elf32_sym {
+    uint32_t st_name, st_value, st_size;
+    unsigned char st_info, st_other;
+    uint16_t st_shndx;
+};
+
+const uint32_t PT_LOAD     = 1;
+const uint32_t SHT_SYMTAB  = 2;
+const uint32_t STT_NOTYPE  = 0;
+const uint32_t STT_OBJECT  = 1;
+const uint32_t STT_FUNC    = 2;
+const uint16_t SHN_UNDEF   = 0;
+const uint16_t SHN_ABS     = 0xfff1;
+const uint16_t EM_RISCV    = 243;
+
+/*
+*   Read-only view of a whole file.  Mapped if possible, otherwise read with a single bulk read.
+*/
+struct file_view {
+    const unsigned char *data = NULL;
+    size_t               size = 0;
+    bool                 mapped = false;
+    std::vector<unsigned char> buf;
+
+    bool open(const char *path){
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+            void *p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED) {
+                data   = (const unsigned char *)p;
+                size   = st.st_size;
+                mapped = true;
+                ::close(fd);
+                return true;
+            }
+        }
+        //not mappable (e.g. a pipe), fall back to reading everything at once
+        unsigned char chunk[65536];
+        ssize_t n;
+        while ((n = ::read(fd, chunk, sizeof(chunk))) > 0) {
+            buf.insert(buf.end(), chunk, chunk + n);
+        }
+        ::close(fd);
+        if (n < 0) {
+            return false;
+        }
+        data = buf.data();
+        size = buf.size();
+        return true;
+    }
+
+    ~file_view(){
+        if (mapped) {
+            munmap((void *)data, size);
+        }
+    }
+};
+
+void note_range(program_info *info, uint32_t lo, uint32_t hi){
+    if (info == NULL || hi <= lo) {
+        return;
+    }
+    if (info->load_lo == info->load_hi) {
+        info->load_lo = lo;
+        info->load_hi = hi;
+    } else {
+        info->load_lo = std::min(info->load_lo, lo);
+        info->load_hi = std::max(info->load_hi, hi);
+    }
+}
+
+bool load_elf(const char *prog_path, const file_view &f, const image_writer_t &write, program_info *info){
+    elf32_ehdr eh;
+    if (f.size < sizeof(eh)) {
+        fprintf(stderr, "ERROR: truncated ELF header in `%s'\n", prog_path);
+        return false;
+    }
+    memcpy(&eh, f.data, sizeof(eh));
+    if (eh.e_ident[4] != 1 || eh.e_ident[5] != 1) {
+        fprintf(stderr, "ERROR: `%s' is not a little-endian ELF32 image\n", prog_path);
+        return false;
+    }
+    if (eh.e_machine != EM_RISCV) {
+        fprintf(stderr, "WARNING: `%s' is not a RISC-V ELF image (e_machine = %d)\n", prog_path, eh.e_machine);
+    }
+
+    //loadable segments.  Only the file contents are copied, the BSS part (p_memsz > p_filesz) is left to read as zero
+    for (uint32_t i = 0; i < eh.e_phnum; i++) {
+        size_t off = (size_t)eh.e_phoff + (size_t)i * eh.e_phentsize;
+        elf32_phdr ph;
+        if (off + sizeof(ph) > f.size) {
+            fprintf(stderr, "ERROR: truncated program header in `%s'\n", prog_path);
+            return false;
+        }
+        memcpy(&ph, f.data + off, sizeof(ph));
+        if (ph.p_type != PT_LOAD || ph.p_memsz == 0) {
+            continue;
+        }
+        if ((size_t)ph.p_offset + ph.p_filesz > f.size) {
+            fprintf(stderr, "ERROR: segment %d exceeds file size in `%s'\n", i, prog_path);
+            return false;
+        }
+        if (ph.p_filesz != 0 && !write(ph.p_paddr, f.data + ph.p_offset, ph.p_filesz)) {
+            return false;
+        }
+        note_range(info, ph.p_paddr, ph.p_paddr + ph.p_memsz);
+    }
+
+    if (info == NULL) {
+        return true;
+    }
+    info->entry = eh.e_entry;
+
+    //symbol table, if the image has not been stripped
+    for (uint32_t i = 0; i < eh.e_shnum; i++) {
+        size_t off = (size_t)eh.e_shoff + (size_t)i * eh.e_shentsize;
+        elf32_shdr sh, strsh;
+        if (off + sizeof(sh) > f.size) {
+            break;
+        }
+        memcpy(&sh, f.data + off, sizeof(sh));
+        if (sh.sh_type != SHT_SYMTAB || sh.sh_link >= eh.e_shnum) {
+            continue;
+        }
+        size_t stroff = (size_t)eh.e_shoff + (size_t)sh.sh_link * eh.e_shentsize;
+        if (stroff + sizeof(strsh) > f.size) {
+            break;
+        }
+        memcpy(&strsh, f.data + stroff, sizeof(strsh));
+        if ((size_t)sh.sh_offset + sh.sh_size > f.size || (size_t)strsh.sh_offset + strsh.sh_size > f.size) {
+            break;
+        }
+        const char *strtab = (const char *)f.data + strsh.sh_offset;
+        for (size_t s = 0; s + sizeof(elf32_sym) <= sh.sh_size; s += sizeof(elf32_sym)) {
+            elf32_sym sym;
+            memcpy(&sym, f.data + sh.sh_offset + s, sizeof(sym));
+            uint32_t type = sym.st_info & 0xf;
+            if ((type != STT_FUNC && type != STT_OBJECT && type != STT_NOTYPE) ||
+                sym.st_shndx == SHN_UNDEF || sym.st_shndx == SHN_ABS || sym.st_name >= strsh.sh_size) {
+                continue;
+            }
+            const char *name = strtab + sym.st_name;
+            //skip unnamed symbols, local assembler labels and RISC-V mapping symbols
+            if (name[0] == 0 || name[0] == '.' || name[0] == '$') {
+                continue;
+            }
+            info->symbols.push_back({sym.st_value, sym.st_size, std::string(name, strnlen(name, strsh.sh_size - sym.st_name))});
+        }
+    }
+    std::stable_sort(info->symbols.begin(), info->symbols.end(),
+                     [](const elf_symbol &a, const elf_symbol &b) { return a.addr < b.addr; });
+    return true;
+}
+
+bool load_bin(const file_view &f, const image_writer_t &write, program_info *info){
+    if (f.size > UINT32_MAX || !write(0, f.data, f.size)) {
+        return false;
+    }
+    note_range(info, 0, f.size);
+    return true;
+}
+
+/*
+*   Memory dump: frames of an address index and the data of the indexed ranges, applied in file order.
+*/
+bool load_mem_dump(const char *path, const file_view &f, const image_writer_t &write, program_info *info){
+    size_t pos = 0;
+    while (pos < f.size) {
+        mem_dump_header hdr;
+        if (f.size - pos < sizeof(hdr)) {
+            fprintf(stderr, "ERROR: truncated memory dump `%s'\n", path);
+            return false;
+        }
+        memcpy(&hdr, f.data + pos, sizeof(hdr));
+        size_t index_bytes = (size_t)hdr.n_ranges * sizeof(mem_dump_range);
+        if (hdr.magic != MEM_DUMP_MAGIC || hdr.version != MEM_DUMP_VERSION) {
+            fprintf(stderr, "ERROR: `%s' has no memory dump frame at offset %zu\n", path, pos);
+            return false;
+        }
+        if (f.size - pos - sizeof(hdr) < index_bytes || f.size - pos - sizeof(hdr) - index_bytes < hdr.data_bytes) {
+            fprintf(stderr, "ERROR: truncated memory dump `%s'\n", path);
+            return false;
+        }
+        size_t frame_bytes = sizeof(hdr) + index_bytes + hdr.data_bytes;
+        for (uint32_t i = 0; i < hdr.n_ranges; i++) {
+            mem_dump_range r;
+            memcpy(&r, f.data + pos + sizeof(hdr) + i * sizeof(r), sizeof(r));
+            if (r.offset > frame_bytes || r.len > frame_bytes - r.offset) {
+                fprintf(stderr, "ERROR: corrupt range index in memory dump `%s'\n", path);
+                return false;
+            }
+            if (r.len == 0) {
+                continue;
+            }
+            if (!write(r.address, f.data + pos + r.offset, r.len)) {
+                return false;
+            }
+            note_range(info, r.address, r.address + r.len);
+        }
+        pos += frame_bytes;
+    }
+    return true;
+}
+
+//value of every character as a hex digit, -1 if it is none
+struct hex_table {
+    signed char val[256];
+    hex_table(){
+        for (int c = 0; c < 256; c++) {
+            val[c] = (c >= '0' && c <= '9') ? c - '0' : (c >= 'a' && c <= 'f') ? c - 'a' + 10 : (c >= 'A' && c <= 'F') ? c - 'A' + 10 : -1;
+        }
+    }
+};
+const hex_table hex_values;
+
+inline int hex_digit(unsigned char c){
+    return hex_values.val[c];
+}
+
+/*
+*   Hex format: lines of whitespace separated 32-bit little-endian words.  A line starting with @ sets the word address, lines starting with
+*   # or / are comments.  Consecutive words are collected and stored in one call to write.
+*/
+bool load_hex(const file_view &f, const image_writer_t &write, program_info *info){
+    const unsigned char *p   = f.data;
+    const unsigned char *end = f.data + f.size;
+    std::vector<unsigned char> run;
+    uint32_t run_addr = 0;
+    uint32_t addr     = 0;
+    bool     line_start = true;
+
+    auto flush = [&]() {
+        if (run.empty()) {
+            return true;
+        }
+        if (!write(run_addr, run.data(), run.size())) {
+            return false;
+        }
+        note_range(info, run_addr, run_addr + run.size());
+        run.clear();
+        return true;
+    };
+
+    while (p < end) {
+        unsigned char c = *p;
+        if (c == '\n') {
+            line_start = true;
+            p++;
+            continue;
+        }
+        if (line_start && (c == '#' || c == '/')) {
+            while (p < end && *p != '\n') {
+                p++;
+            }
+            continue;
+        }
+        line_start = false;
+        if (c == '@') {
+            uint32_t v = 0;
+            int d;
+            for (p++; p < end && (d = hex_digit(*p)) >= 0; p++) {
+                v = (v << 4) | d;
+            }
+            if (!flush()) {
+                return false;
+            }
+            addr = v * 4;
+            continue;
+        }
+        int d = hex_digit(c);
+        if (d < 0) {
+            p++; //whitespace or stray characters
+            continue;
+        }
+        uint32_t v = 0;
+        for (; p < end && (d = hex_digit(*p)) >= 0; p++) {
+            v = (v << 4) | d;
+        }
+        if (run.empty()) {
+            run_addr = addr;
+        }
+        size_t n = run.size();
+        run.resize(n + 4);
+        run[n]     = v;
+        run[n + 1] = v >> 8;
+        run[n + 2] = v >> 16;
+        run[n + 3] = v >> 24;
+        addr += 4;
+    }
+    return flush();
+}
+
+} // namespace
+
+/*
+*   Function to load a program image.  The format is chosen by content: ELF or memory dump (by magic number), raw binary (.bin extension)
+*   or @addr hex.
+*
+*   *prog_path     - program to load
+*   write          - callback storing the image into memory
+*   *info          - entry point, loaded range and symbol table of the program.  May be NULL
+*/
+bool load_image(const char *prog_path, const image_writer_t &write, program_info *info){
+    file_view f;
+    if (!f.open(prog_path)) {
+        fprintf(stderr, "ERROR: invalid program path `%s': %s\n", prog_path, strerror(errno));
+        return false;
+    }
+    if (info != NULL) {
+        *info = program_info();
+    }
+
+    bool ok;
+    size_t len = strlen(prog_path);
+    uint32_t magic = 0;
+    if (f.size >= 4) {
+        memcpy(&magic, f.data, 4);
+    }
+    if (f.size >= 4 && memcmp(f.data, "\x7f" "ELF", 4) == 0) {
+        ok = load_elf(prog_path, f, write, info);
+    } else if (magic == MEM_DUMP_MAGIC) {
+        ok = load_mem_dump(prog_path, f, write, info);
+    } else if (len >= 4 && strcmp(prog_path + len - 4, ".bin") == 0) {
+        ok = load_bin(f, write, info);
+    } else {
+        ok = load_hex(f, write, info);
+    }
+
+    if (ok && info != NULL && info->entry == 0) {
+        info->entry = info->load_lo;
+    }
+    return ok;
+}
+
+/*
+*   Function to load a program image into a paged memory.  Returns false if error
+*
+*   *mem           - memory to load the program into
+*   *prog_path     - program to load
+*   *info          - entry point, loaded range and symbol table of the program.  May be NULL
+*/
+bool load_image(paged_mem *mem, const char *prog_path, program_info *info){
+    auto write = [mem](uint32_t address, const unsigned char *data, uint32_t len) {
+        if (!mem->in_range(address, len)) {
+            fprintf(stderr, "ERROR: program data at 0x%08x-0x%08x outside of memory (%llu bytes)\n", address, address + len,
+                    (unsigned long long)mem->size());
+            return false;
+        }
+        mem->write(address, data, len);
+        return true;
+    };
+    return load_image(prog_path, write, info);
+}
+
+/*
+*   Function to load an expected memory image.  Returns false if error
+*
+*   *img           - image to load, cleared first
+*   *path          - image file
+*   base           - address of the first word of hex and raw binary images
+*/
+bool load_mem_image(mem_image *img, const char *path, uint32_t base){
+    img->mem.clear();
+    img->ranges.clear();
+    //memory dumps and ELF files carry their own addresses
+    FILE *in = fopen(path, "rb");
+    unsigned char magic[4] = {0};
+    if (in != NULL) {
+        if (fread(magic, 4, 1, in) != 1) {
+            memset(magic, 0, sizeof(magic));
+        }
+        fclose(in);
+    }
+    uint32_t dump_magic = MEM_DUMP_MAGIC;
+    if (memcmp(magic, &dump_magic, 4) == 0 || memcmp(magic, "\x7f" "ELF", 4) == 0) {
+        base = 0;
+    }
+
+    auto write = [img, base](uint32_t address, const unsigned char *data, uint32_t len) {
+        uint64_t lo = (uint64_t)address + base;
+        if (lo > UINT32_MAX || !img->mem.in_range((uint32_t)lo, len)) {
+            fprintf(stderr, "ERROR: image data at 0x%08llx-0x%08llx outside of memory\n", (unsigned long long)lo,
+                    (unsigned long long)lo + len);
+            return false;
+        }
+        img->mem.write((uint32_t)lo, data, len);
+        img->ranges.push_back({(uint32_t)lo, lo + len});
+        return true;
+    };
+    if (!load_image(path, write, NULL)) {
+        return false;
+    }
+
+    //frames of a dump may overlap, merge into disjoint ranges
+    std::sort(img->ranges.begin(), img->ranges.end(), [](const mem_range &a, const mem_range &b) { return a.lo < b.lo; });
+    size_t n = 0;
+    for (const mem_range &r : img->ranges) {
+        if (n > 0 && r.lo <= img->ranges[n - 1].hi) {
+            img->ranges[n - 1].hi = std::max(img->ranges[n - 1].hi, r.hi);
+        } else {
+            img->ranges[n++] = r;
+        }
+    }
+    img->ranges.resize(n);
+    return true;
+}
+
+/*
+*   mem_w          - width of the memory interface in bits
+*   window         - number of cycles per bandwidth sample
+*/
+mem_traffic::mem_traffic(uint32_t mem_w, uint32_t window){
+    this->bytes_per_beat = mem_w / 8;
+    this->window         = window ? window : 1;
+    clear();
+}
+
+void mem_traffic::clear(){
+    n_cycles        = 0;
+    busy_cycles     = 0;
+    beat_this_cycle = false;
+    open.clear();
+    memset(stats, 0, sizeof(stats));
+    be_hist.assign(bytes_per_beat + 1, 0);
+    windows.assign(1, window_stats{0, 0, 0, 0});
+}
+
+/*
+* A vector load or store was accepted.  A previous instruction with the same ID is complete.
+*/
+void mem_traffic::issue(uint32_t id, bool store, int stride, bool misaligned){
+    if (id >= open.size()) {
+        open.resize(id + 1, open_instr{false, false, false, MEM_STRIDE_UNKNOWN, 0, 0});
+    }
+    complete(open[id]);
+    open[id] = open_instr{true, store, misaligned, stride & 3, 0, 0};
+}
+
+/*
+* A request on the memory interface.  be holds one bit per byte of the interface.
+*/
+void mem_traffic::beat(uint32_t id, bool we, const unsigned char *be){
+    uint32_t bytes = 0;
+    for (uint32_t i = 0; i < (bytes_per_beat + 7) / 8; i++) {
+        bytes += __builtin_popcount(be[i]);
+    }
+    if (bytes > bytes_per_beat) {
+        bytes = bytes_per_beat;
+    }
+    if (id >= open.size()) {
+        open.resize(id + 1, open_instr{false, false, false, MEM_STRIDE_UNKNOWN, 0, 0});
+    }
+    open_instr &in = open[id];
+    if (!in.active || in.store != we) {
+        //not seen at issue, account it on its own
+        complete(in);
+        in = open_instr{true, we, false, MEM_STRIDE_UNKNOWN, 0, 0};
+    }
+    in.beats++;
+    in.bytes += bytes;
+    be_hist[bytes]++;
+    if (bytes == bytes_per_beat) {
+        stats[in.store][in.stride].full_beats++;
+    }
+
+    window_stats &w = windows.back();
+    (we ? w.wr_bytes : w.rd_bytes) += bytes;
+    w.beats++;
+    beat_this_cycle = true;
+}
+
+/*
+* Advance one cycle.
+*/
+void mem_traffic::cycle(){
+    busy_cycles += beat_this_cycle;
+    beat_this_cycle = false;
+    n_cycles++;
+    if (n_cycles % window == 0) {
+        windows.push_back(window_stats{n_cycles, 0, 0, 0});
+    }
+}
+
+void mem_traffic::complete(open_instr &in){
+    if (!in.active) {
+        return;
+    }
+    class_stats &c = stats[in.store][in.stride];
+    uint64_t ideal = (in.bytes + bytes_per_beat - 1) / bytes_per_beat;
+    uint64_t excess = in.beats - ideal;
+    c.instr++;
+    c.beats        += in.beats;
+    c.bytes        += in.bytes;
+    c.excess_beats += excess;
+    if (in.misaligned) {
+        c.misaligned++;
+        c.misaligned_excess_beats += excess;
+    }
+    in.active = false;
+}
+
+/*
+* Print the traffic statistics.
+*/
+void mem_traffic::report(FILE *out){
+    for (open_instr &in : open) {
+        complete(in);
+    }
+    static const char *const stride_names[4] = {"unit", "strided", "indexed", "unknown"};
+    class_stats total = {};
+    fprintf(out, "Vector Memory Traffic (%u bit interface, %llu cycles, interface busy %.2f%%):\n", bytes_per_beat * 8,
+            (unsigned long long)n_cycles, n_cycles ? 100.0 * busy_cycles / n_cycles : 0.0);
+    fprintf(out, "TYPE   STRIDE      INSTR  MISALIGNED       BEATS  FULL BEATS         BYTES  BE UTIL %%  EXCESS BEATS\n");
+    for (int st = 0; st < 2; st++) {
+        for (int sd = 0; sd < 4; sd++) {
+            const class_stats &c = stats[st][sd];
+            if (c.instr == 0 && c.beats == 0) {
+                continue;
+            }
+            fprintf(out, "%-5s  %-8s  %7llu  %10llu  %10llu  %10llu  %12llu     %6.2f  %12llu\n", st ? "store" : "load", stride_names[sd],
+                    (unsigned long long)c.instr, (unsigned long long)c.misaligned, (unsigned long long)c.beats,
+                    (unsigned long long)c.full_beats, (unsigned long long)c.bytes,
+                    c.beats ? 100.0 * c.bytes / (c.beats * bytes_per_beat) : 0.0, (unsigned long long)c.excess_beats);
+            total.beats                   += c.beats;
+            total.bytes                   += c.bytes;
+            total.excess_beats            += c.excess_beats;
+            total.misaligned_excess_beats += c.misaligned_excess_beats;
+        }
+    }
+    uint64_t rd = 0, wr = 0;
+    for (const window_stats &w : windows) {
+        rd += w.rd_bytes;
+        wr += w.wr_bytes;
+    }
+    double cyc = n_cycles ? (double)n_cycles : 1.0;
+    fprintf(out, "Bandwidth: read %.3f B/cycle, write %.3f B/cycle, peak %u B/cycle\n", rd / cyc, wr / cyc, bytes_per_beat);
+    fprintf(out, "Bytes lost to partial beats: %llu of %llu interface bytes (%.2f%%)\n",
+            (unsigned long long)(total.beats * bytes_per_beat - total.bytes), (unsigned long long)(total.beats * bytes_per_beat),
+            total.beats ? 100.0 * (total.beats * bytes_per_beat - total.bytes) / (total.beats * bytes_per_beat) : 0.0);
+    fprintf(out, "Excess beats: %llu (%.2f%% of all beats), of which %llu from misaligned unit-stride accesses\n",
+            (unsigned long long)total.excess_beats, total.beats ? 100.0 * total.excess_beats / total.beats : 0.0,
+            (unsigned long long)total.misaligned_excess_beats);
+    fprintf(out, "Enabled bytes per beat:");
+    for (size_t i = 0; i < be_hist.size(); i++) {
+        if (be_hist[i] != 0) {
+            fprintf(out, " %zu:%llu", i, (unsigned long long)be_hist[i]);
+        }
+    }
+    fprintf(out, "\n\n");
+}
+
+/*
+* Write the bandwidth samples as CSV.  Returns false if error
+*/
+bool mem_traffic::write_bandwidth(const char *path) const {
+    FILE *out = fopen(path, "w");
+    if (out == NULL) {
+        fprintf(stderr, "ERROR: opening `%s': %s\n", path, strerror(errno));
+        return false;
+    }
+    fprintf(out, "cycle,rd_bytes,wr_bytes,beats\n");
+    for (const window_stats &w : windows) {
+        if (w.start >= n_cycles) {
+            break;
+        }
+        fprintf(out, "%llu,%llu,%llu,%llu\n", (unsigned long long)w.start, (unsigned long long)w.rd_bytes,
+                (unsigned long long)w.wr_bytes, (unsigned long long)w.beats);
+    }
+    fclose(out);
+    return true;
+}
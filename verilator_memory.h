@@ -0,0 +1,623 @@
+// Memory models for use with simulation with Verilator.
+// Provides the memory port and backing store objects used by the memory helpers in verilator_support.h
+//
+// None of the objects in this file access the verilator model directly.  Interface signals are passed in by the user as byte pointers so that any memory width can be supported.
+
+#ifndef VERILATOR_MEMORY_H
+#define VERILATOR_MEMORY_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <vector>
+
+/*
+*   Memory port with a fixed maximum latency.  Responses are held in a ring buffer indexed by the current cycle, so advancing one cycle
+*   does not move any queued data.  Several requests may be in flight at once, each with its own latency.  Responses are always returned
+*   in request order: a request that would overtake an earlier one is delayed until the cycle after it.
+*
+*   Typical use, once per simulated cycle:
+*       port.update(address, req_valid, model_data_i, model_valid_i, model_err_i, mem);
+*   or, for per-request latencies:
+*       port.respond(model_data_i, model_valid_i, model_err_i);
+*       port.request(address, req_valid, lat, mem);
+*       port.advance();
+*
+*   With a mem_timing attached (set_timing()), update() takes the latency of every load from the timing model instead of mem_lat.
+*/
+class paged_mem;
+class mem_timing;
+
+class mem_port {
+public:
+    /*
+    * ARGS:
+    *   mem_w          - width of the interface in bits
+    *   mem_lat        - default latency of the interface in cycles (must be at least 1)
+    *   mem_size       - total size of the memory address space
+    *   max_lat        - largest latency that will be requested through request().  Defaults to mem_lat
+    */
+    mem_port(uint32_t mem_w, uint32_t mem_lat, uint32_t mem_size, uint32_t max_lat = 0);
+
+    /*
+    * Put the response due in the current cycle on the processor read port.  Valid is deasserted if no response is due.
+    * ARGS:
+    *   *model_data_i  - pointer to memory data read interface on verilator model
+    *   *model_valid_i - pointer to memory valid read interface on verilator model
+    *   *model_err_i   - pointer to memory error read interface on verilator model
+    */
+    void respond(unsigned char *model_data_i, bool *model_valid_i, bool *model_err_i);
+
+    /*
+    * Evaluate a load request and schedule its response.  Returns false if the request could not be scheduled (latency out of range).
+    * ARGS:
+    *   address        - address of the load request being issued
+    *   req_valid      - validity of the load request being issued
+    *   lat            - latency of this request in cycles (1 to max_lat)
+    *   *mem           - pointer to memory space
+    */
+    bool request(uint32_t address, bool req_valid, uint32_t lat, const unsigned char *mem);
+    bool request(uint32_t address, bool req_valid, uint32_t lat, const paged_mem *mem);
+
+    /*
+    * Advance the port by one cycle.
+    */
+    void advance();
+
+    /*
+    * Respond, issue a request with the default latency and advance by one cycle.  Equivalent to the original update_mem_load().
+    */
+    void update(uint32_t address, bool req_valid, unsigned char *model_data_i, bool *model_valid_i, bool *model_err_i, const unsigned char *mem);
+    void update(uint32_t address, bool req_valid, unsigned char *model_data_i, bool *model_valid_i, bool *model_err_i, const paged_mem *mem);
+
+    /*
+    * Take the latency of the requests issued through update() from a timing model shared with other ports.  Grows the response ring to
+    * the largest latency of the model, which drops all in-flight requests, so call it before the first request.  NULL detaches the model.
+    * ARGS:
+    *   *timing        - timing model
+    *   requester      - requester ID of this port, returned by timing->add_requester()
+    */
+    void set_timing(mem_timing *timing, int requester);
+
+    /*
+    * Charge a store issued on the write interface belonging to this port to the timing model.  Stores complete immediately in the
+    * backing store, but occupy the cache, SRAM banks and bandwidth seen by later loads.  Does nothing without a timing model.
+    */
+    void store(uint32_t address, bool req_valid);
+
+    /*
+    * Drop all in-flight requests.
+    */
+    void reset();
+
+    /*
+    * Serialize / restore the in-flight requests, used for checkpoints.  restore_state() returns false if the saved port has a different geometry.
+    */
+    void save_state(std::vector<unsigned char> &buf) const;
+    bool restore_state(const std::vector<unsigned char> &buf);
+
+    uint32_t outstanding() const { return n_outstanding; }
+    uint32_t width_bytes() const { return bytes; }
+    uint32_t latency() const { return lat_default; }
+    uint32_t size() const { return mem_size; }
+
+private:
+    mem_timing *timing;                 // timing model used by update(), NULL for the fixed latency
+    int         requester;              // requester ID of this port in the timing model
+
+    uint32_t bytes;                     // interface width in bytes
+    uint32_t lat_default;               // latency used by update()
+    uint32_t lat_max;                   // largest latency accepted by request()
+    uint32_t mem_size;                  // size of the memory address space
+    uint32_t slot_mask;                 // ring size - 1, ring size is a power of two larger than lat_max
+
+    uint64_t now;                       // current cycle, selects the slot that responds this cycle
+    uint64_t last_due;                  // cycle of the most recently scheduled response
+    uint32_t n_outstanding;             // requests scheduled but not yet responded
+
+    std::vector<unsigned char> data;    // ring of response data, bytes per slot
+    std::vector<unsigned char> valid;   // ring of response valid flags
+    std::vector<unsigned char> err;     // ring of response error flags
+
+    unsigned char *slot(uint64_t cycle) { return &data[(cycle & slot_mask) * bytes]; }
+    unsigned char *schedule(uint32_t lat, bool in_range);
+    void           resize(uint32_t max_lat);
+    uint32_t       load_latency(uint32_t address, bool req_valid);
+};
+
+/*
+*   Byte-enable merge kernels used by the memory write helpers.  masked_copy() copies the bytes of src selected by the byte enable bit
+*   mask be (bit i enables byte i) to dst, for any len.  The kernel is selected once at runtime from the instruction sets of the host:
+*   AVX-512BW masked stores, AVX2 or SSE2 blends with the mask expanded from be, or 64-bit scalar merges with a table lookup per mask
+*   byte.  Beats shorter than a vector register use the narrower kernels.  Fully enabled chunks are copied and disabled chunks are
+*   skipped without merging.
+*/
+enum masked_copy_isa {
+    MASKED_COPY_SCALAR,
+    MASKED_COPY_SSE2,
+    MASKED_COPY_AVX2,
+    MASKED_COPY_AVX512,
+    MASKED_COPY_ISA_CNT
+};
+
+typedef void (*masked_copy_fn)(unsigned char *dst, const unsigned char *src, const unsigned char *be, uint32_t len);
+
+void masked_copy(unsigned char *dst, const unsigned char *src, const unsigned char *be, uint32_t len);
+
+/*
+* Returns the kernel for the given instruction set, or NULL if the host or the compiler does not support it.  masked_copy_selected()
+* returns the instruction set masked_copy() uses.
+*/
+masked_copy_fn  masked_copy_kernel(masked_copy_isa isa);
+masked_copy_isa masked_copy_selected();
+const char     *masked_copy_name(masked_copy_isa isa);
+
+/*
+*   Bitmap of the 4 KiB pages written since it was last cleared.  Kept by paged_mem for its own writes and by update_mem_write() for flat
+*   memories, it lets dump_mem_dirty() (verilator_support.h) write only the modified regions of memory.
+*/
+class dirty_pages {
+public:
+    static const uint32_t PAGE_BITS = 12;
+    static const uint32_t PAGE_SIZE = 1u << PAGE_BITS;
+
+    /*
+    * ARGS:
+    *   mem_size       - total size of the memory address space
+    */
+    explicit dirty_pages(uint64_t mem_size = 1ull << 32);
+
+    /*
+    * Mark the pages of len bytes starting at address as written.  The caller is responsible for range checks, len must not be 0.
+    */
+    void mark(uint32_t address, uint32_t len){
+        uint32_t last = (uint32_t)(((uint64_t)address + len - 1) >> PAGE_BITS);
+        for (uint32_t pn = address >> PAGE_BITS; pn <= last; pn++) {
+            bits[pn >> 6] |= 1ull << (pn & 63);
+        }
+    }
+
+    bool test(uint32_t address) const { return (bits[address >> (PAGE_BITS + 6)] >> ((address >> PAGE_BITS) & 63)) & 1; }
+
+    /*
+    * Clear all pages, or the pages lying entirely within [lo, hi).  Pages only partially within the range stay marked.
+    */
+    void clear();
+    void clear(uint32_t lo, uint64_t hi);
+
+    /*
+    * Call fn for every run of consecutive marked pages, clipped to [lo, hi), in address order.
+    */
+    void for_each_range(uint32_t lo, uint64_t hi, const std::function<void(uint32_t address, uint32_t len)> &fn) const;
+
+    /*
+    * Number of marked pages.
+    */
+    size_t count() const;
+
+private:
+    uint64_t              pages;
+    std::vector<uint64_t> bits;
+
+    uint64_t find(uint64_t pn, uint64_t end, bool set) const;
+};
+
+/*
+*   Sparse memory backing store.  The address space is split into 4 KiB pages that are allocated on first write; pages that were never
+*   written read as zero without being allocated.  The most recently used page is cached for reads and for writes, so consecutive
+*   accesses to the same page skip the page table walk.
+*
+*   fork() returns a copy-on-write copy of the whole memory: both copies share all pages until one of them writes to a page.  A program
+*   can therefore be loaded once and forked for every run.  Page reference counts are atomic, so forks may be used from different threads
+*   (a single paged_mem object itself is not thread safe).
+*/
+class paged_mem {
+public:
+    static const uint32_t PAGE_BITS = 12;
+    static const uint32_t PAGE_SIZE = 1u << PAGE_BITS;
+
+    /*
+    * ARGS:
+    *   mem_size       - total size of the memory address space.  Accesses at or beyond mem_size are out of range
+    */
+    explicit paged_mem(uint64_t mem_size = 1ull << 32);
+    ~paged_mem();
+    paged_mem(const paged_mem &) = delete;
+    paged_mem &operator=(const paged_mem &) = delete;
+
+    /*
+    * Returns a copy-on-write copy of this memory.  Cost is proportional to the number of allocated pages, no page data is copied.
+    */
+    paged_mem *fork() const;
+
+    /*
+    * Copy len bytes starting at address out of / into memory.  Accesses may cross page boundaries.  The caller is responsible for range checks.
+    */
+    void read(uint32_t address, unsigned char *dst, uint32_t len) const;
+    void write(uint32_t address, const unsigned char *src, uint32_t len);
+
+    /*
+    * Write the bytes of src selected by the byte enable bit mask be (bit i enables byte i).
+    */
+    void write_masked(uint32_t address, const unsigned char *src, const unsigned char *be, uint32_t len);
+
+    /*
+    * Call fn for every allocated page, in address order.  Used to serialize the memory without visiting unallocated pages.
+    */
+    void for_each_page(const std::function<void(uint32_t address, const unsigned char *data)> &fn) const;
+
+    /*
+    * Release all pages, the whole memory reads as zero afterwards.
+    */
+    void clear();
+
+    /*
+    * Pages written since the memory was created or the pages were last cleared with clear_dirty().  Writes of the program loader count
+    * as well, call clear_dirty() after loading to track only the writes of the simulation.  A fork starts with no dirty pages.
+    */
+    const dirty_pages &dirty() const { return dirty_map; }
+    void clear_dirty();
+    void clear_dirty(uint32_t lo, uint64_t hi);
+
+    uint32_t read32(uint32_t address) const { unsigned char b[4]; read(address, b, 4); return b[0] | (b[1] << 8) | (b[2] << 16) | ((uint32_t)b[3] << 24); }
+
+    bool     in_range(uint32_t address, uint32_t len) const { return address < mem_size && len <= mem_size - address; }
+    uint64_t size() const { return mem_size; }
+
+    /*
+    * Number of pages allocated by this memory, including pages shared with forks.
+    */
+    size_t pages() const { return n_pages; }
+    size_t resident_bytes() const { return n_pages * (size_t)PAGE_SIZE; }
+
+    /*
+    * Page lookup used by the accessors above.  page_rd returns a shared zero page for pages that were never written, page_wr
+    * allocates the page or breaks sharing with a fork.
+    */
+    const unsigned char *page_rd(uint32_t address) const;
+    unsigned char *page_wr(uint32_t address);
+
+private:
+    struct page {
+        std::atomic<uint32_t> refs;
+        unsigned char data[PAGE_SIZE];
+    };
+    static const uint32_t L1_BITS = 10;                         // first level indexes address bits [31:22]
+    static const uint32_t L2_BITS = 32 - PAGE_BITS - L1_BITS;   // second level indexes address bits [21:12]
+    static const uint32_t L2_SIZE = 1u << L2_BITS;
+
+    uint64_t    mem_size;
+    size_t      n_pages;
+    page      **table[1u << L1_BITS];                           // second level tables, allocated on demand
+    dirty_pages dirty_map;                                      // marked by page_wr() when the write cache misses
+
+    mutable uint32_t             rd_tag;                        // page number of the cached read page, ~0 if none
+    mutable const unsigned char *rd_page;
+    mutable uint32_t             wr_tag;                        // page number of the cached write page, ~0 if none
+    mutable unsigned char       *wr_page;
+
+    page **entry(uint32_t pn) const;
+    void   invalidate() const;
+};
+
+static_assert(paged_mem::PAGE_BITS == dirty_pages::PAGE_BITS, "dirty_pages tracks the pages of paged_mem");
+
+/*
+*   Memory hierarchy timing model shared by several memory ports, e.g. the scalar data port and the vector port.  Accesses pass through
+*   an optional set-associative L1 data cache and then a banked SRAM:
+*     - at most `ports` accesses per cycle are accepted, further accesses issued in the same cycle wait for the next one (contention)
+*     - the cache is looked up in hit_lat cycles.  Misses fill the whole line from the SRAM, dirty victims are written back after the fill
+*     - write_back selects write-back with write-allocate, otherwise the cache is write-through without write-allocate
+*     - the SRAM answers sram_lat cycles after an access starts.  Words of sram_bank_w bytes are interleaved over sram_banks banks, each
+*       bank starts one word per cycle.  sram_bw limits the bytes per cycle transferred by the SRAM
+*   Only latencies are modeled: data always comes from the backing store, which the timing model never reads or writes.  The memory
+*   interfaces have no grant signal, so accesses are never refused; a backlog shows up as longer load latency instead.  Latencies above
+*   max_lat are clamped and counted.
+*
+*   Usage:
+*       mem_timing timing(cfg);
+*       data_port.set_timing(&timing, timing.add_requester("scalar"));
+*       vec_port.set_timing(&timing, timing.add_requester("vector"));
+*   then once per cycle, after all ports were updated:
+*       timing.cycle();
+*/
+struct mem_timing_config {
+    uint32_t ports       = 1;       // accesses accepted per cycle, shared by all requesters
+    uint32_t cache_size  = 0;       // L1 data cache size in bytes, 0 disables the cache
+    uint32_t cache_ways  = 4;
+    uint32_t cache_line  = 32;      // line size in bytes, power of two
+    bool     write_back  = true;    // write-back with write-allocate, otherwise write-through without write-allocate
+    uint32_t hit_lat     = 1;       // cache lookup latency in cycles
+    uint32_t sram_lat    = 1;       // SRAM access latency in cycles
+    uint32_t sram_banks  = 0;       // number of SRAM banks, 0 disables the bank conflict model
+    uint32_t sram_bank_w = 4;       // bytes per bank word
+    uint32_t sram_bw     = 0;       // SRAM bytes per cycle, 0 for unlimited
+    uint32_t max_lat     = 256;     // largest latency returned, the size of the response ring of the ports
+};
+
+/*
+* Parse a timing configuration of comma-separated key=value pairs into *cfg, keys not given keep their value.  Keys are the field
+* names of mem_timing_config without the cache_ and sram_ prefixes for size, ways, line, banks, bank_w and bw (e.g.
+* "size=16384,ways=4,line=32,wt,hit_lat=1,sram_lat=4,banks=8,bw=16"); "wb" and "wt" select the write policy.  Sizes accept a k suffix.
+* Returns false if error
+* ARGS:
+*   *spec          - configuration string
+*   *cfg           - configuration to update
+*/
+bool parse_mem_timing(const char *spec, mem_timing_config *cfg);
+
+class mem_timing {
+public:
+    /*
+    * ARGS:
+    *   &cfg           - configuration.  Invalid cache or bank geometries are reported and disable the cache or bank model
+    */
+    explicit mem_timing(const mem_timing_config &cfg);
+
+    /*
+    * Register a requester, e.g. one memory port, and return its ID.  Statistics are kept per requester.
+    */
+    int add_requester(const char *name);
+
+    /*
+    * Account an access issued in the current cycle and return its latency in cycles (1 to max_lat).
+    * ARGS:
+    *   requester      - ID returned by add_requester().  Accesses issued in the same cycle are accepted in call order
+    *   address        - address of the access
+    *   write          - store instead of load
+    *   len            - access width in bytes
+    */
+    uint32_t access(int requester, uint32_t address, bool write, uint32_t len);
+
+    /*
+    * Advance the model by one cycle.
+    */
+    void cycle();
+
+    /*
+    * Invalidate the cache and drop all pending SRAM and port occupancy.  clear_stats() clears the statistics only.
+    */
+    void reset();
+    void clear_stats();
+
+    /*
+    * Print the hit/miss, latency and contention statistics of every requester and the SRAM traffic.
+    */
+    void report(FILE *out) const;
+
+    uint32_t max_latency() const { return cfg.max_lat; }
+    const mem_timing_config &config() const { return cfg; }
+
+private:
+    struct requester_stats {
+        std::string name;
+        uint64_t    loads;
+        uint64_t    stores;
+        uint64_t    load_hits;
+        uint64_t    store_hits;
+        uint64_t    load_lat;                   // total latency of all loads
+        uint64_t    port_wait;                  // cycles waited for a port of the cache / SRAM
+        uint64_t    bank_wait;                  // cycles waited for busy SRAM banks
+        uint64_t    bw_wait;                    // cycles waited for SRAM bandwidth
+        uint64_t    clamped;                    // latencies clamped to max_lat
+    };
+
+    mem_timing_config cfg;
+    uint32_t          n_sets;                   // 0 without cache
+    uint32_t          line_bits;
+
+    uint64_t now;
+    uint64_t stamp;                             // LRU use counter
+    uint64_t port_cycle;                        // cycle the next access is accepted in
+    uint32_t port_used;                         // accesses already accepted in port_cycle
+    uint64_t bw_free;                           // first cycle the SRAM bandwidth is available
+    std::vector<uint64_t> bank_free;            // first cycle each bank can start a word
+
+    std::vector<uint32_t> tags;                 // [set * ways + way], line address
+    std::vector<uint64_t> lru;                  // last use of each way, 0 if invalid
+    std::vector<uint8_t>  dirty;
+
+    std::vector<requester_stats> req;
+    uint64_t evictions;
+    uint64_t writebacks;
+    uint64_t sram_rd_bytes;
+    uint64_t sram_wr_bytes;
+    uint64_t n_cycles;
+
+    uint64_t sram_access(requester_stats &r, uint64_t t, uint32_t address, uint32_t len);
+    bool     cache_access(requester_stats &r, uint64_t t, uint32_t line, bool write, uint64_t *done);
+};
+
+/*
+*   Vector memory traffic statistics.  Records each vector load and store with the number of memory interface beats, the byte enable
+*   utilization of the beats, the stride class and whether the unit-stride access was misaligned (and therefore split into strided
+*   accesses by the LSU), as well as read and write bandwidth per window of cycles.
+*
+*   Beats are matched to instructions through the XIF instruction ID.  An instruction is complete once its ID is issued again or at
+*   the report.  Excess beats are the beats above ceil(enabled bytes / interface width) per instruction, i.e. the interface bandwidth
+*   lost to partial beats.
+*
+*   Usage, once per cycle (update_mem_traffic() in verilator_support.h does this from the vproc_core signals):
+*       traffic.issue(id, store, stride, misaligned);              // vector load/store accepted
+*       traffic.beat(id, we, be);                                  // request on the vector memory interface
+*       traffic.cycle();
+*/
+enum mem_stride {
+    MEM_STRIDE_UNIT    = 0,         // same encoding as lsu_stride in vproc_pkg.sv
+    MEM_STRIDE_STRIDED = 1,
+    MEM_STRIDE_INDEXED = 2,
+    MEM_STRIDE_UNKNOWN = 3          // beats of instructions issued before the statistics were started
+};
+
+class mem_traffic {
+public:
+    /*
+    * ARGS:
+    *   mem_w          - width of the memory interface in bits
+    *   window         - number of cycles per bandwidth sample
+    */
+    mem_traffic(uint32_t mem_w, uint32_t window = 1000);
+
+    void issue(uint32_t id, bool store, int stride, bool misaligned);
+    void beat(uint32_t id, bool we, const unsigned char *be);
+    void cycle();
+    void clear();
+
+    /*
+    * Print the traffic per access type and stride class, the bandwidth lost to partial beats and misaligned accesses and the histogram
+    * of enabled bytes per beat.  Completes all open instructions.
+    */
+    void report(FILE *out);
+
+    /*
+    * Write the bandwidth samples as CSV (window start cycle, bytes read, bytes written, beats).  Returns false if error
+    */
+    bool write_bandwidth(const char *path) const;
+
+private:
+    struct open_instr {
+        bool     active;
+        bool     store;
+        bool     misaligned;
+        int      stride;
+        uint64_t beats;
+        uint64_t bytes;
+    };
+    struct class_stats {
+        uint64_t instr;
+        uint64_t misaligned;
+        uint64_t beats;
+        uint64_t full_beats;
+        uint64_t bytes;
+        uint64_t excess_beats;
+        uint64_t misaligned_excess_beats;
+    };
+    struct window_stats {
+        uint64_t start;
+        uint64_t rd_bytes;
+        uint64_t wr_bytes;
+        uint64_t beats;
+    };
+
+    uint32_t                    bytes_per_beat;
+    uint32_t                    window;
+    uint64_t                    n_cycles;
+    uint64_t                    busy_cycles;
+    bool                        beat_this_cycle;
+    std::vector<open_instr>     open;           // indexed by XIF instruction ID
+    class_stats                 stats[2][4];    // [store][stride]
+    std::vector<uint64_t>       be_hist;        // beats by number of enabled bytes
+    std::vector<window_stats>   windows;
+
+    void complete(open_instr &in);
+};
+
+
+/*
+*   Symbol read from the symbol table of an ELF program image.
+*/
+struct elf_symbol {
+    uint32_t    addr;
+    uint32_t    size;
+    std::string name;
+};
+
+/*
+*   Information about a loaded program image.  Only ELF images carry an entry point and symbols, for hex and raw binary images
+*   the entry point is the lowest loaded address and the symbol table is empty.
+*/
+struct program_info {
+    uint32_t entry   = 0;
+    uint32_t load_lo = 0;                   // lowest loaded address
+    uint32_t load_hi = 0;                   // one past the highest loaded address (including zero-filled BSS)
+    std::vector<elf_symbol> symbols;        // function and object symbols, sorted by address
+
+    /*
+    * Returns the symbol containing address, or NULL.  Symbols without a size extend up to the next symbol.
+    */
+    const elf_symbol *lookup(uint32_t address) const;
+
+    /*
+    * Returns the symbol with the given name, or NULL.
+    */
+    const elf_symbol *find(const char *name) const;
+};
+
+/*
+*   Callback used by load_image() to store a chunk of the program image.  Returns false if the chunk does not fit.
+*   Memory that is not written by the loader (i.e. BSS) is expected to read as zero.
+*/
+typedef std::function<bool(uint32_t address, const unsigned char *data, uint32_t len)> image_writer_t;
+
+/*
+*   Binary memory dump written by dump_mem_dirty() (verilator_support.h).  All values little-endian.  A dump is a sequence of frames, one
+*   per call; incremental dumps append a frame holding the pages written since the previous one.  Applying the frames in order (as
+*   load_image() does) rebuilds the memory at the cycle of the last frame.
+*
+*   Frame:          mem_dump_header, n_ranges mem_dump_range (the address index), then the data of the ranges in index order
+*/
+static const uint32_t MEM_DUMP_MAGIC   = 0x50444d56; // "VMDP"
+static const uint32_t MEM_DUMP_VERSION = 1;
+
+struct mem_dump_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t n_ranges;
+    uint32_t reserved;
+    uint64_t cycle;                     // cycle the frame was written in
+    uint64_t data_bytes;                // bytes of range data following the index
+};
+
+struct mem_dump_range {
+    uint32_t address;
+    uint32_t len;
+    uint64_t offset;                    // offset of the data from the start of the frame
+};
+
+/*
+*   Function to load a program image.  The format is chosen by content: ELF (by magic number), memory dump (by magic number), raw binary
+*   (.bin extension, loaded at address 0) or the @addr hex format, parsed in a single pass over the file without line buffering.  The file is mapped rather than
+*   read line by line, so load time depends only on the image size.  Returns false if error.
+* ARGS:
+*   *prog_path     - program to load
+*   write          - callback storing the image into memory
+*   *info          - entry point, loaded range and symbol table of the program.  May be NULL
+*/
+bool load_image(const char *prog_path, const image_writer_t &write, program_info *info);
+
+/*
+*   Function to load a program image into a paged memory.  Returns false if error
+* ARGS:
+*   *mem           - memory to load the program into
+*   *prog_path     - program to load
+*   *info          - entry point, loaded range and symbol table of the program.  May be NULL
+*/
+bool load_image(paged_mem *mem, const char *prog_path, program_info *info);
+
+/*
+*   Expected memory contents for compare_mem_region() (verilator_support.h): the image data and the address ranges it covers.
+*/
+struct mem_range {
+    uint32_t lo;
+    uint64_t hi;                        // one past the last byte
+};
+
+struct mem_image {
+    paged_mem              mem;
+    std::vector<mem_range> ranges;      // sorted, not overlapping
+};
+
+/*
+*   Function to load an expected memory image.  Accepts the formats of load_image(): a memory dump or ELF file keeps the addresses of its
+*   ranges, hex and raw binary images are placed at base, e.g. the start of the region written by dump_mem_region().  Returns false if error
+* ARGS:
+*   *img           - image to load, cleared first
+*   *path          - image file
+*   base           - address of the first word of hex and raw binary images
+*/
+bool load_mem_image(mem_image *img, const char *path, uint32_t base);
+
+#endif
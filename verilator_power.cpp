@@ -0,0 +1,429 @@
+// Switching-activity counters and energy estimation for use with simulation with Verilator.
+// Counts power-proxy events of the vector unit per cycle and combines them with an energy table per run and per PC region.
+#include "verilator_power.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <string.h>
+
+#include <algorithm>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define TOGGLE_COUNT_X86
+#include <immintrin.h>
+#endif
+
+/*
+*   Toggle counting kernels.  All kernels handle any len; the vector kernels leave the tail shorter than their width to a narrower one.
+*/
+
+static uint64_t toggle_count_scalar(unsigned char *prev, const unsigned char *cur, uint32_t len){
+    uint64_t n = 0;
+    uint32_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t a, b;
+        memcpy(&a, prev + i, 8);
+        memcpy(&b, cur + i, 8);
+        n += __builtin_popcountll(a ^ b);
+    }
+    for (; i < len; i++) {
+        n += __builtin_popcount(prev[i] ^ cur[i]);
+    }
+    memcpy(prev, cur, len);
+    return n;
+}
+
+#ifdef TOGGLE_COUNT_X86
+__attribute__((target("popcnt")))
+static uint64_t toggle_count_popcnt(unsigned char *prev, const unsigned char *cur, uint32_t len){
+    uint64_t n = 0;
+    uint32_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t a, b;
+        memcpy(&a, prev + i, 8);
+        memcpy(&b, cur + i, 8);
+        memcpy(prev + i, &b, 8);
+        n += __builtin_popcountll(a ^ b);
+    }
+    for (; i < len; i++) {
+        n += __builtin_popcount(prev[i] ^ cur[i]);
+        prev[i] = cur[i];
+    }
+    return n;
+}
+
+//popcount of every byte from two 4-bit table lookups, summed per 64-bit lane with psadbw
+__attribute__((target("avx2,popcnt")))
+static uint64_t toggle_count_avx2(unsigned char *prev, const unsigned char *cur, uint32_t len){
+    const __m256i lut  = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                          0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low  = _mm256_set1_epi8(0x0f);
+    __m256i       acc  = _mm256_setzero_si256();
+    uint32_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(prev + i));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(cur + i));
+        _mm256_storeu_si256((__m256i *)(prev + i), b);
+        __m256i x   = _mm256_xor_si256(a, b);
+        __m256i cnt = _mm256_add_epi8(_mm256_shuffle_epi8(lut, _mm256_and_si256(x, low)),
+                                      _mm256_shuffle_epi8(lut, _mm256_and_si256(_mm256_srli_epi16(x, 4), low)));
+        acc = _mm256_add_epi64(acc, _mm256_sad_epu8(cnt, _mm256_setzero_si256()));
+    }
+    uint64_t lanes[4];
+    _mm256_storeu_si256((__m256i *)lanes, acc);
+    uint64_t n = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    if (i < len) {
+        n += toggle_count_popcnt(prev + i, cur + i, len - i);
+    }
+    return n;
+}
+
+__attribute__((target("avx512f,avx512vpopcntdq,avx2,popcnt")))
+static uint64_t toggle_count_avx512(unsigned char *prev, const unsigned char *cur, uint32_t len){
+    __m512i  acc = _mm512_setzero_si512();
+    uint32_t i   = 0;
+    for (; i + 64 <= len; i += 64) {
+        __m512i a = _mm512_loadu_si512(prev + i);
+        __m512i b = _mm512_loadu_si512(cur + i);
+        _mm512_storeu_si512(prev + i, b);
+        acc = _mm512_add_epi64(acc, _mm512_popcnt_epi64(_mm512_xor_si512(a, b)));
+    }
+    //the 512-bit reduce and extract intrinsics trip -Wuninitialized in GCC 12, sum the lanes in memory
+    uint64_t lanes[8];
+    _mm512_storeu_si512(lanes, acc);
+    uint64_t n = 0;
+    for (uint64_t l : lanes) {
+        n += l;
+    }
+    if (i < len) {
+        n += toggle_count_avx2(prev + i, cur + i, len - i);
+    }
+    return n;
+}
+#endif
+
+toggle_count_fn toggle_count_kernel(toggle_count_isa isa){
+    switch (isa) {
+        case TOGGLE_COUNT_SCALAR:
+            return toggle_count_scalar;
+#ifdef TOGGLE_COUNT_X86
+        case TOGGLE_COUNT_POPCNT:
+            return __builtin_cpu_supports("popcnt") ? toggle_count_popcnt : NULL;
+        case TOGGLE_COUNT_AVX2:
+            return (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt")) ? toggle_count_avx2 : NULL;
+        case TOGGLE_COUNT_AVX512:
+            return (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vpopcntdq") && __builtin_cpu_supports("avx2") &&
+                    __builtin_cpu_supports("popcnt")) ? toggle_count_avx512 : NULL;
+#endif
+        default:
+            return NULL;
+    }
+}
+
+toggle_count_isa toggle_count_selected(){
+    static const toggle_count_isa isa = [](){
+        int best = TOGGLE_COUNT_SCALAR;
+        for (int i = TOGGLE_COUNT_SCALAR; i < TOGGLE_COUNT_ISA_CNT; i++) {
+            if (toggle_count_kernel((toggle_count_isa)i) != NULL) {
+                best = i;
+            }
+        }
+        return (toggle_count_isa)best;
+    }();
+    return isa;
+}
+
+const char *toggle_count_name(toggle_count_isa isa){
+    static const char *const names[TOGGLE_COUNT_ISA_CNT] = {"scalar", "popcnt", "avx2", "avx512"};
+    return (isa < TOGGLE_COUNT_ISA_CNT) ? names[isa] : "unknown";
+}
+
+/*
+* Count the bits that differ between prev and cur and copy cur to prev, with the kernel selected for the host.
+*/
+uint64_t toggle_count(unsigned char *prev, const unsigned char *cur, uint32_t len){
+    static const toggle_count_fn fn = toggle_count_kernel(toggle_count_selected());
+    return fn(prev, cur, len);
+}
+
+/*
+*   Switching-activity counters.
+*
+*   n_units        - number of functional unit types
+*   **unit_names   - names of the unit types
+*   *info          - symbol table of the program, one region per function symbol.  May be NULL
+*/
+power_counters::power_counters(int n_units, const char *const *unit_names, const program_info *info) : n_units(n_units) {
+    event_names = {"cycle", "vrf_wr_toggle", "vrf_mask_toggle", "vrf_wr_byte", "vrf_rd_toggle"};
+    for (const char *suffix : {"_busy", "_stall"}) {
+        for (int u = 0; u < n_units; u++) {
+            std::string name = unit_names[u];
+            std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return tolower(c); });
+            event_names.push_back(name + suffix);
+        }
+    }
+    energy_per_event.assign(event_names.size(), 0.0);
+    regions.push_back(region{"[other]", 0, 0, 0, std::vector<uint64_t>(event_names.size(), 0)});
+    sorted  = true;
+    cur     = NULL;
+    last_pc = 1;                    //RISC-V PCs are even, never matches
+    if (info != NULL) {
+        //symbols are sorted by address; nested symbols are dropped and overlapping ones clipped, regions must not overlap
+        const std::vector<elf_symbol> &syms = info->symbols;
+        uint64_t covered = 0;
+        for (size_t i = 0; i < syms.size(); i++) {
+            uint64_t hi = (uint64_t)syms[i].addr + syms[i].size;
+            if (syms[i].size == 0) {
+                //symbols without a size extend up to the next symbol
+                hi = info->load_hi;
+                for (size_t j = i + 1; j < syms.size(); j++) {
+                    if (syms[j].addr > syms[i].addr) {
+                        hi = syms[j].addr;
+                        break;
+                    }
+                }
+            }
+            uint64_t lo = std::max<uint64_t>(syms[i].addr, covered);
+            if (lo >= hi) {
+                continue;
+            }
+            add_region(syms[i].name.c_str(), (uint32_t)lo, (uint32_t)hi);
+            covered = hi;
+        }
+    }
+}
+
+/*
+* Add a region [lo, hi).
+*/
+void power_counters::add_region(const char *name, uint32_t lo, uint32_t hi){
+    regions.insert(regions.end() - 1, region{name, lo, hi, 0, std::vector<uint64_t>(event_names.size(), 0)});
+    sorted  = false;
+    cur     = NULL;
+    last_pc = 1;
+}
+
+void power_counters::clear(){
+    for (region &r : regions) {
+        r.retired = 0;
+        std::fill(r.counts.begin(), r.counts.end(), 0);
+    }
+    prev_wr_data.clear();
+    prev_wr_mask.clear();
+    prev_rd_data.clear();
+    last_pc = 1;
+}
+
+/*
+* Load the energy per event.  Returns false if error
+*/
+bool power_counters::load_energy(const char *path){
+    FILE *in = fopen(path, "r");
+    if (in == NULL) {
+        fprintf(stderr, "ERROR: opening `%s': %s\n", path, strerror(errno));
+        return false;
+    }
+    char line[256];
+    int  n  = 0;
+    bool ok = true;
+    while (ok && fgets(line, sizeof(line), in) != NULL) {
+        n++;
+        char *hash = strchr(line, '#');
+        if (hash != NULL) {
+            *hash = '\0';
+        }
+        char   name[128];
+        double e;
+        int    fields = sscanf(line, "%127s %lf", name, &e);
+        if (fields <= 0) {
+            continue;
+        }
+        auto it = std::find(event_names.begin(), event_names.end(), std::string(name));
+        if (fields != 2 || it == event_names.end()) {
+            fprintf(stderr, "ERROR: %s:%d: expected <event> <energy> with a known event, got `%s'\n", path, n, name);
+            ok = false;
+            break;
+        }
+        energy_per_event[it - event_names.begin()] = e;
+    }
+    fclose(in);
+    return ok;
+}
+
+power_counters::region *power_counters::lookup(uint32_t pc){
+    if (!sorted) {
+        std::sort(regions.begin(), regions.end() - 1, [](const region &a, const region &b) { return a.lo < b.lo; });
+        sorted = true;
+    }
+    auto end = regions.end() - 1;
+    auto it  = std::upper_bound(regions.begin(), end, pc, [](uint32_t a, const region &r) { return a < r.lo; });
+    if (it != regions.begin() && pc < (it - 1)->hi) {
+        return &*(it - 1);
+    }
+    return &regions.back();
+}
+
+/*
+* Start a cycle.
+*/
+void power_counters::cycle(uint32_t wb_pc){
+    if (wb_pc != last_pc) {
+        //"[other]" is empty, so a PC outside the current region is always looked up
+        if (cur == NULL || wb_pc - cur->lo >= cur->hi - cur->lo) {
+            cur = lookup(wb_pc);
+        }
+        cur->retired++;
+        last_pc = wb_pc;
+    }
+    cur->counts[PWR_CYCLE]++;
+}
+
+/*
+* Register file write ports of the cycle.  The data and mask registers toggle whether or not the port writes, bytes are counted for
+* the enabled ports only.
+*/
+void power_counters::vreg_write(const unsigned char *data, const unsigned char *mask, uint32_t en, uint32_t vreg_w, uint32_t data_bytes, uint32_t mask_bytes){
+    if (prev_wr_data.size() != data_bytes || prev_wr_mask.size() != mask_bytes) {
+        prev_wr_data.assign(data, data + data_bytes);
+        prev_wr_mask.assign(mask, mask + mask_bytes);
+    }
+    cur->counts[PWR_VRF_WR_TOGGLE]   += toggle_count(prev_wr_data.data(), data, data_bytes);
+    cur->counts[PWR_VRF_MASK_TOGGLE] += toggle_count(prev_wr_mask.data(), mask, mask_bytes);
+    //one mask bit per byte, vreg_w / 8 bits per port (a power of two, less than a byte only for 32-bit vector registers)
+    uint32_t port_bits = vreg_w / 8;
+    for (; en != 0; en &= en - 1) {
+        uint32_t p = __builtin_ctz(en);
+        if (port_bits < 8) {
+            uint32_t bit = p * port_bits;
+            cur->counts[PWR_VRF_WR_BYTE] += __builtin_popcount((mask[bit / 8] >> (bit % 8)) & ((1u << port_bits) - 1));
+        } else {
+            for (uint32_t i = p * port_bits / 8; i < (p + 1) * port_bits / 8; i++) {
+                cur->counts[PWR_VRF_WR_BYTE] += __builtin_popcount(mask[i]);
+            }
+        }
+    }
+}
+
+/*
+* Register file read ports of the cycle.
+*/
+void power_counters::vreg_read(const unsigned char *data, uint32_t bytes){
+    if (prev_rd_data.size() != bytes) {
+        prev_rd_data.assign(data, data + bytes);
+    }
+    cur->counts[PWR_VRF_RD_TOGGLE] += toggle_count(prev_rd_data.data(), data, bytes);
+}
+
+/*
+* Functional unit activity of one pipeline in the cycle.
+*/
+void power_counters::unit_activity(uint32_t width, uint32_t busy, uint32_t stall){
+    for (; busy != 0; busy &= busy - 1) {
+        cur->counts[PWR_UNIT_EVENTS + __builtin_ctz(busy)] += width;
+    }
+    for (; stall != 0; stall &= stall - 1) {
+        cur->counts[PWR_UNIT_EVENTS + n_units + __builtin_ctz(stall)] += width;
+    }
+}
+
+uint64_t power_counters::count(int event) const {
+    uint64_t n = 0;
+    for (const region &r : regions) {
+        n += r.counts[event];
+    }
+    return n;
+}
+
+double power_counters::region_energy(const region &r) const {
+    double e = 0;
+    for (size_t i = 0; i < r.counts.size(); i++) {
+        e += r.counts[i] * energy_per_event[i];
+    }
+    return e;
+}
+
+double power_counters::energy() const {
+    double e = 0;
+    for (const region &r : regions) {
+        e += region_energy(r);
+    }
+    return e;
+}
+
+/*
+* Print the events and energy of the run and the energy per region, sorted by energy.
+*
+*   *out           - text output
+*   max_lines      - number of regions to print, 0 for all
+*/
+void power_counters::report(FILE *out, int max_lines) const {
+    uint64_t cycles  = count(PWR_CYCLE);
+    uint64_t retired = 0;
+    for (const region &r : regions) {
+        retired += r.retired;
+    }
+    double total = energy();
+    fprintf(out, "Switching Activity: %llu cycles, %llu instructions retired (toggle counting: %s)\n", (unsigned long long)cycles,
+            (unsigned long long)retired, toggle_count_name(toggle_count_selected()));
+    fprintf(out, "  EVENT                        COUNT   PER CYCLE        ENERGY       %%\n");
+    for (size_t i = 0; i < event_names.size(); i++) {
+        uint64_t n = count(i);
+        if (n == 0) {
+            continue;
+        }
+        double e = n * energy_per_event[i];
+        fprintf(out, "  %-18s  %14llu  %10.2f  %12.1f  %6.2f\n", event_names[i].c_str(), (unsigned long long)n,
+                cycles ? (double)n / cycles : 0.0, e, total > 0 ? 100.0 * e / total : 0.0);
+    }
+    fprintf(out, "  Energy %.1f, %.3f per cycle, %.3f per instruction\n", total, cycles ? total / cycles : 0.0, retired ? total / retired : 0.0);
+
+    std::vector<const region *> order;
+    for (const region &r : regions) {
+        if (r.counts[PWR_CYCLE] != 0) {
+            order.push_back(&r);
+        }
+    }
+    std::sort(order.begin(), order.end(), [this](const region *a, const region *b) {
+        double ea = region_energy(*a), eb = region_energy(*b);
+        return ea != eb ? ea > eb : a->counts[PWR_CYCLE] > b->counts[PWR_CYCLE];
+    });
+    fprintf(out, "        ENERGY       %%      CYCLES     RETIRED   PER INSTR  REGION\n");
+    int n = 0;
+    for (const region *r : order) {
+        if (max_lines > 0 && n == max_lines) {
+            break;
+        }
+        double e = region_energy(*r);
+        fprintf(out, "  %12.1f  %6.2f  %10llu  %10llu  %10.3f  %s\n", e, total > 0 ? 100.0 * e / total : 0.0,
+                (unsigned long long)r->counts[PWR_CYCLE], (unsigned long long)r->retired, r->retired ? e / r->retired : 0.0,
+                r->name.c_str());
+        n++;
+    }
+    fprintf(out, "\n");
+}
+
+/*
+* Write the events per region as CSV.  Returns false if error
+*/
+bool power_counters::write_csv(const char *path) const {
+    FILE *out = fopen(path, "w");
+    if (out == NULL) {
+        fprintf(stderr, "ERROR: opening `%s': %s\n", path, strerror(errno));
+        return false;
+    }
+    fprintf(out, "region,event,count,energy\n");
+    for (const region &r : regions) {
+        if (r.counts[PWR_CYCLE] == 0) {
+            continue;
+        }
+        fprintf(out, "%s,retired,%llu,0\n", r.name.c_str(), (unsigned long long)r.retired);
+        for (size_t i = 0; i < event_names.size(); i++) {
+            if (r.counts[i] != 0) {
+                fprintf(out, "%s,%s,%llu,%.3f\n", r.name.c_str(), event_names[i].c_str(), (unsigned long long)r.counts[i],
+                        r.counts[i] * energy_per_event[i]);
+            }
+        }
+    }
+    fclose(out);
+    return true;
+}
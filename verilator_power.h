@@ -0,0 +1,166 @@
+// Switching-activity counters and energy estimation for use with simulation with Verilator.
+// Counts power-proxy events of the vector unit per cycle: bit toggles on the vector register file write and read ports, bytes written
+// into the register file and the active cycles of every functional unit weighted by the width of its pipeline.  The events are
+// attributed to PC regions (functions of the program or user-defined ranges) and combined with a user-supplied energy per event into
+// an energy estimate per run and per region.
+//
+// Does not access the verilator model, update_power() in verilator_support.h feeds the counters from the signals of vproc_core.
+
+#ifndef VERILATOR_POWER_H
+#define VERILATOR_POWER_H
+
+#include "verilator_memory.h"
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+/*
+*   Toggle counting kernels.  toggle_count() returns the number of bits that differ between prev and cur (the popcount of their XOR)
+*   and copies cur to prev, for any len.  The kernel is selected once at runtime from the instruction sets of the host: AVX-512
+*   VPOPCNTDQ, AVX2 with a nibble lookup table, the POPCNT instruction or a portable 64-bit popcount.
+*/
+enum toggle_count_isa {
+    TOGGLE_COUNT_SCALAR,
+    TOGGLE_COUNT_POPCNT,
+    TOGGLE_COUNT_AVX2,
+    TOGGLE_COUNT_AVX512,
+    TOGGLE_COUNT_ISA_CNT
+};
+
+typedef uint64_t (*toggle_count_fn)(unsigned char *prev, const unsigned char *cur, uint32_t len);
+
+uint64_t toggle_count(unsigned char *prev, const unsigned char *cur, uint32_t len);
+
+/*
+* Returns the kernel for the given instruction set, or NULL if the host or the compiler does not support it.  toggle_count_selected()
+* returns the instruction set toggle_count() uses.
+*/
+toggle_count_fn  toggle_count_kernel(toggle_count_isa isa);
+toggle_count_isa toggle_count_selected();
+const char      *toggle_count_name(toggle_count_isa isa);
+
+/*
+*   Power-proxy events.  Unit events follow PWR_UNIT_EVENTS, two per functional unit (busy, stalled), counted in lane-bit cycles: the
+*   width of the pipeline in bits for every cycle the unit is busy or stalled.
+*/
+enum power_event {
+    PWR_CYCLE,                  // clock cycles, for clock tree and leakage energy
+    PWR_VRF_WR_TOGGLE,          // bits toggled on the register file write data ports
+    PWR_VRF_MASK_TOGGLE,        // bits toggled on the write byte masks
+    PWR_VRF_WR_BYTE,            // bytes written into the register file (enabled write ports, enabled bytes)
+    PWR_VRF_RD_TOGGLE,          // bits toggled on the register file read data ports
+    PWR_UNIT_EVENTS
+};
+
+/*
+*   Switching-activity counters with per-region attribution.  Every cycle is charged to the region containing the PC in the write-back
+*   stage of the scalar core, as pc_profile does, so the vector activity of a kernel is charged to the code waiting on it.
+*
+*   Usage, once per cycle (update_power() in verilator_support.h does this from the vproc_core signals):
+*       pwr.cycle(wb_pc);
+*       pwr.vreg_write(data, mask, en, vreg_w, data_bytes, mask_bytes);
+*       pwr.vreg_read(data, bytes);
+*       pwr.unit_activity(width, busy, stall);     // per pipeline
+*
+*   Energy table (load_energy()): one "<event> <energy>" pair per line, # starts a comment.  Events are cycle, vrf_wr_toggle,
+*   vrf_mask_toggle, vrf_wr_byte, vrf_rd_toggle and <unit>_busy / <unit>_stall with the lower case unit names, e.g. valu_busy.  The
+*   energies are per event in any unit (e.g. pJ) and default to 0.
+*/
+class power_counters {
+public:
+    /*
+    * ARGS:
+    *   n_units        - number of functional unit types (VPROC_UNIT_CNT)
+    *   **unit_names   - names of the unit types (vproc_unit_names)
+    *   *info          - symbol table of the program, one region per function symbol (nested symbols are dropped and overlapping ones
+    *                    clipped).  May be NULL
+    */
+    power_counters(int n_units, const char *const *unit_names, const program_info *info = NULL);
+
+    /*
+    * Add a region [lo, hi).  Regions must not overlap, PCs outside all regions are charged to "[other]".
+    */
+    void add_region(const char *name, uint32_t lo, uint32_t hi);
+
+    /*
+    * Load the energy per event.  Returns false if error
+    */
+    bool load_energy(const char *path);
+
+    /*
+    * Start a cycle, selects the region of wb_pc.  A change of wb_pc is counted as the retirement of the instruction at wb_pc.
+    */
+    void cycle(uint32_t wb_pc);
+
+    /*
+    * Register file write ports of the cycle.
+    * ARGS:
+    *   *data          - write data of all ports, port 0 first (vregfile_wr_data_q)
+    *   *mask          - byte masks of all ports (vregfile_wr_mask_q)
+    *   en             - write enable bit per port (vregfile_wr_en_q)
+    *   vreg_w         - width of the vector registers, the width of one port
+    *   data_bytes     - bytes of *data
+    *   mask_bytes     - bytes of *mask
+    */
+    void vreg_write(const unsigned char *data, const unsigned char *mask, uint32_t en, uint32_t vreg_w, uint32_t data_bytes, uint32_t mask_bytes);
+
+    /*
+    * Register file read ports of the cycle, the read data of all ports (vregfile_rd_data).
+    */
+    void vreg_read(const unsigned char *data, uint32_t bytes);
+
+    /*
+    * Functional unit activity of one pipeline in the cycle.
+    * ARGS:
+    *   width          - width of the pipeline in bits
+    *   busy           - busy bit per unit type
+    *   stall          - stalled bit per unit type
+    */
+    void unit_activity(uint32_t width, uint32_t busy, uint32_t stall);
+
+    void clear();
+
+    uint64_t count(int event) const;
+    double   energy() const;
+
+    /*
+    * Print the events and energy of the run and the energy per region, sorted by energy.
+    * ARGS:
+    *   *out           - text output
+    *   max_lines      - number of regions to print, 0 for all
+    */
+    void report(FILE *out, int max_lines = 0) const;
+
+    /*
+    * Write the events per region as CSV (region, event, count, energy).  Returns false if error
+    */
+    bool write_csv(const char *path) const;
+
+private:
+    struct region {
+        std::string           name;
+        uint32_t              lo, hi;
+        uint64_t              retired;
+        std::vector<uint64_t> counts;                   // per event
+    };
+
+    int                         n_units;
+    std::vector<std::string>    event_names;
+    std::vector<double>         energy_per_event;
+    std::vector<region>         regions;                // sorted by lo, regions.back() is "[other]"
+    bool                        sorted;
+    region                     *cur;
+    uint32_t                    last_pc;
+
+    std::vector<unsigned char>  prev_wr_data;
+    std::vector<unsigned char>  prev_wr_mask;
+    std::vector<unsigned char>  prev_rd_data;
+
+    region *lookup(uint32_t pc);
+    double  region_energy(const region &r) const;
+};
+
+#endif
@@ -0,0 +1,527 @@
+// PC-level cycle profiler for use with simulation with Verilator.
+// Keeps a cycle and retire histogram per PC and a shadow call stack, symbolized against the ELF symbols of the program.
+#include "verilator_profile.h"
+
+#include <errno.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+
+/*
+*   *info          - symbol table of the profiled program.  May be NULL
+*/
+pc_profile::pc_profile(const program_info *info) : info(info) {
+    clear();
+}
+
+/*
+* Clear all counters.
+*/
+void pc_profile::clear(){
+    table.assign(1024, pc_entry{FREE, 0, 0});
+    used         = 0;
+    last         = 0;
+    last_pc      = FREE;
+    n_cycles     = 0;
+    n_retired    = 0;
+    frames.assign(1, frame{0, -1, 0, 0, 0});
+    children.clear();
+    cur          = 0;
+    call_pending = false;
+    ret_pending  = false;
+}
+
+/*
+* Returns the slot of pc, inserting it if needed.
+*/
+pc_profile::pc_entry *pc_profile::slot(uint32_t pc){
+    size_t mask = table.size() - 1;
+    //PCs are at least 2 byte aligned, drop the low bit before hashing
+    size_t i = ((pc >> 1) * 0x9e3779b1u) & mask;
+    while (table[i].pc != pc) {
+        if (table[i].pc == FREE) {
+            if (2 * (used + 1) > table.size()) {
+                grow();
+                return slot(pc);
+            }
+            table[i].pc = pc;
+            used++;
+            break;
+        }
+        i = (i + 1) & mask;
+    }
+    last = i;
+    return &table[i];
+}
+
+void pc_profile::grow(){
+    std::vector<pc_entry> old(2 * table.size(), pc_entry{FREE, 0, 0});
+    old.swap(table);
+    size_t mask = table.size() - 1;
+    for (const pc_entry &e : old) {
+        if (e.pc == FREE) {
+            continue;
+        }
+        size_t i = ((e.pc >> 1) * 0x9e3779b1u) & mask;
+        while (table[i].pc != FREE) {
+            i = (i + 1) & mask;
+        }
+        table[i] = e;
+    }
+}
+
+/*
+* Returns the frame of the function containing pc called from parent, creating it if needed.
+*/
+uint32_t pc_profile::child(uint32_t parent, uint32_t pc){
+    const elf_symbol *s = info ? info->lookup(pc) : NULL;
+    int32_t sym = s ? (int32_t)(s - info->symbols.data()) : -1;
+    uint64_t key = ((uint64_t)parent << 32) | (uint32_t)sym;
+    auto it = children.find(key);
+    if (it != children.end()) {
+        return it->second;
+    }
+    frame f = {parent, sym, 0, 0, 0};
+    if (s != NULL) {
+        f.lo = s->addr;
+        f.hi = s->addr + s->size;
+        if (s->size == 0) {
+            //symbols without a size extend up to the next symbol
+            f.hi = info->load_hi;
+            for (size_t i = sym + 1; i < info->symbols.size(); i++) {
+                if (info->symbols[i].addr > s->addr) {
+                    f.hi = info->symbols[i].addr;
+                    break;
+                }
+            }
+        }
+    }
+    frames.push_back(f);
+    children.emplace(key, (uint32_t)(frames.size() - 1));
+    return frames.size() - 1;
+}
+
+/*
+* Retirement of the instruction at pc.  Updates the shadow call stack.
+*/
+void pc_profile::retire(uint32_t pc, uint32_t instr){
+    n_retired++;
+    //calls and returns take effect with the next retired instruction, so the cycles of the jump stay with the function executing it
+    if (call_pending) {
+        cur = child(cur, pc);
+    } else {
+        if (ret_pending && cur != 0) {
+            cur = frames[cur].parent;
+        }
+        if (cur == 0) {
+            cur = child(0, pc);
+        } else if (pc - frames[cur].lo >= frames[cur].hi - frames[cur].lo) {
+            //left the function without a call: tail call, or the stack was not known when profiling started
+            cur = child(frames[cur].parent, pc);
+        }
+    }
+
+    //ra (x1) and t0 (x5) are the link registers of the calling convention
+    auto link = [](uint32_t r) { return r == 1 || r == 5; };
+    bool call = false, ret = false;
+    if ((instr & 3) == 3) {
+        uint32_t opcode = instr & 0x7f;
+        uint32_t rd     = (instr >> 7)  & 0x1f;
+        uint32_t rs1    = (instr >> 15) & 0x1f;
+        if (opcode == 0x6f) {                   //jal
+            call = link(rd);
+        } else if (opcode == 0x67) {            //jalr
+            call = link(rd);
+            ret  = rd == 0 && link(rs1);
+        }
+    } else {
+        uint32_t funct3 = (instr >> 13) & 7;
+        uint32_t rs1    = (instr >> 7)  & 0x1f;
+        uint32_t rs2    = (instr >> 2)  & 0x1f;
+        if ((instr & 3) == 1 && funct3 == 1) {  //c.jal
+            call = true;
+        } else if ((instr & 3) == 2 && funct3 == 4 && rs2 == 0 && rs1 != 0) {
+            if ((instr >> 12) & 1) {            //c.jalr
+                call = true;
+            } else {                            //c.jr
+                ret = link(rs1);
+            }
+        }
+    }
+    call_pending = call;
+    ret_pending  = ret && !call;
+}
+
+/*
+* Account one cycle to the instruction in the write-back stage.
+*/
+void pc_profile::sample(uint32_t wb_pc, uint32_t wb_instr){
+    n_cycles++;
+    pc_entry *e;
+    if (wb_pc != last_pc) {
+        e = slot(wb_pc);
+        e->retired++;
+        retire(wb_pc, wb_instr);
+        last_pc = wb_pc;
+    } else {
+        e = &table[last];
+    }
+    e->cycles++;
+    frames[cur].cycles++;
+}
+
+const char *pc_profile::sym_name(int32_t sym) const {
+    return sym < 0 ? "[unknown]" : info->symbols[sym].name.c_str();
+}
+
+/*
+* Print the flat function profile, sorted by cycles.
+*
+*   *out           - text output
+*   max_lines      - number of functions to print, 0 for all
+*/
+void pc_profile::report(FILE *out, int max_lines) const {
+    struct line {
+        uint32_t key;       // symbol index + 1 (0 for unknown), or PC without symbols
+        uint64_t cycles;
+        uint64_t retired;
+    };
+    std::vector<line> lines;
+    if (info != NULL) {
+        lines.resize(info->symbols.size() + 1);
+        for (size_t i = 0; i < lines.size(); i++) {
+            lines[i] = line{(uint32_t)i, 0, 0};
+        }
+        for (const pc_entry &e : table) {
+            if (e.pc == FREE) {
+                continue;
+            }
+            const elf_symbol *s = info->lookup(e.pc);
+            line &l = lines[s ? s - info->symbols.data() + 1 : 0];
+            l.cycles  += e.cycles;
+            l.retired += e.retired;
+        }
+    } else {
+        for (const pc_entry &e : table) {
+            if (e.pc != FREE) {
+                lines.push_back(line{e.pc, e.cycles, e.retired});
+            }
+        }
+    }
+    std::sort(lines.begin(), lines.end(), [](const line &a, const line &b) { return a.cycles > b.cycles; });
+
+    fprintf(out, "Cycle Profile: %llu cycles, %llu instructions retired\n", (unsigned long long)n_cycles, (unsigned long long)n_retired);
+    fprintf(out, "    CYCLES       %%     RETIRED      CPI  %s\n", info ? "FUNCTION" : "PC");
+    int n = 0;
+    for (const line &l : lines) {
+        if (l.cycles == 0 || (max_lines > 0 && n == max_lines)) {
+            break;
+        }
+        char pc_name[16];
+        const char *name = pc_name;
+        if (info != NULL) {
+            name = sym_name((int32_t)l.key - 1);
+        } else {
+            snprintf(pc_name, sizeof(pc_name), "0x%08x", l.key);
+        }
+        fprintf(out, "%10llu  %6.2f  %10llu  %7.3f  %s\n", (unsigned long long)l.cycles, 100.0 * l.cycles / n_cycles,
+                (unsigned long long)l.retired, l.retired ? (double)l.cycles / l.retired : 0.0, name);
+        n++;
+    }
+    fprintf(out, "\n");
+}
+
+/*
+* Write the cycles per call stack in folded format.  Returns false if error
+*
+*   *path          - output file
+*/
+bool pc_profile::write_folded(const char *path) const {
+    FILE *out = fopen(path, "w");
+    if (out == NULL) {
+        fprintf(stderr, "ERROR: opening `%s': %s\n", path, strerror(errno));
+        return false;
+    }
+    std::vector<const char *> stack;
+    std::string text;
+    for (size_t i = 0; i < frames.size(); i++) {
+        if (frames[i].cycles == 0) {
+            continue;
+        }
+        stack.clear();
+        if (i == 0) {
+            stack.push_back(sym_name(-1));     //cycles before the first retirement
+        }
+        for (uint32_t f = i; f != 0; f = frames[f].parent) {
+            stack.push_back(sym_name(frames[f].sym));
+        }
+        text.clear();
+        for (size_t j = stack.size(); j-- > 0; ) {
+            text += stack[j];
+            if (j != 0) {
+                text += ';';
+            }
+        }
+        fprintf(out, "%s %llu\n", text.c_str(), (unsigned long long)frames[i].cycles);
+    }
+    fclose(out);
+    return true;
+}
+
+/*
+*   interval       - retired instructions per interval
+*/
+bbv_profile::bbv_profile(uint64_t interval) : interval_len(interval ? interval : 1), last_chosen(0) {
+    clear();
+}
+
+/*
+* Clear all intervals and blocks, chosen intervals are kept.
+*/
+void bbv_profile::clear(){
+    n_cycles  = 0;
+    n_retired = 0;
+    last_pc   = 1;          //RISC-V PCs are even, never matches
+    blk_start = 0;
+    blk_len   = 0;
+    next_pc   = 0;
+    blk_end   = false;
+    iv_first  = 0;
+    iv_instr  = 0;
+    block_ids.clear();
+    block_pc.clear();
+    counts.clear();
+    touched.clear();
+    intervals.clear();
+}
+
+//branches, jumps and system instructions (ecall, ebreak, xRET, wfi) end a basic block
+static bool ends_block(uint32_t instr){
+    if ((instr & 3) == 3) {
+        uint32_t opcode = instr & 0x7f;
+        return opcode == 0x63 || opcode == 0x6f || opcode == 0x67 || opcode == 0x73;
+    }
+    uint32_t quadrant = instr & 3;
+    uint32_t funct3   = (instr >> 13) & 7;
+    if (quadrant == 1) {
+        return funct3 == 1 || funct3 == 5 || funct3 == 6 || funct3 == 7;   //c.jal, c.j, c.beqz, c.bnez
+    }
+    //c.jr, c.jalr, c.ebreak
+    return quadrant == 2 && funct3 == 4 && ((instr >> 2) & 0x1f) == 0 && (((instr >> 7) & 0x1f) != 0 || ((instr >> 12) & 1));
+}
+
+/*
+* Add the instructions of the current block to the vector of the current interval.
+*/
+void bbv_profile::end_block(){
+    if (blk_len == 0) {
+        return;
+    }
+    auto it = block_ids.find(blk_start);
+    uint32_t id;
+    if (it == block_ids.end()) {
+        id = block_pc.size();
+        block_ids.emplace(blk_start, id);
+        block_pc.push_back(blk_start);
+        counts.push_back(0);
+    } else {
+        id = it->second;
+    }
+    if (counts[id] == 0) {
+        touched.push_back(id);
+    }
+    counts[id] += blk_len;
+    blk_len = 0;
+}
+
+/*
+* Store the vector of the current interval, which ends before end_cycle.
+*/
+void bbv_profile::end_interval(uint64_t end_cycle){
+    if (iv_instr == 0) {
+        return;
+    }
+    interval_stats iv;
+    iv.first_cycle = iv_first;
+    iv.cycles      = end_cycle - iv_first;
+    iv.instr       = iv_instr;
+    std::sort(touched.begin(), touched.end());
+    iv.bbv.reserve(touched.size());
+    for (uint32_t id : touched) {
+        iv.bbv.emplace_back(id + 1, counts[id]);
+        counts[id] = 0;
+    }
+    touched.clear();
+    intervals.push_back(std::move(iv));
+    iv_first = end_cycle;
+    iv_instr = 0;
+}
+
+/*
+* Retirement of the instruction at pc.  The block in progress ends if the previous instruction ended it or pc does not follow it,
+* a new interval starts with the first block after interval_len instructions.
+*/
+void bbv_profile::retire(uint32_t pc, uint32_t instr){
+    n_retired++;
+    if (blk_len != 0 && (blk_end || pc != next_pc)) {
+        end_block();
+    }
+    if (blk_len == 0) {
+        if (iv_instr >= interval_len) {
+            //the cycles before this retirement belong to the closed interval
+            end_interval(n_cycles - 1);
+        }
+        blk_start = pc;
+    }
+    blk_len++;
+    iv_instr++;
+    next_pc = pc + ((instr & 3) == 3 ? 4 : 2);
+    blk_end = ends_block(instr);
+}
+
+/*
+* Account one cycle.
+*/
+void bbv_profile::sample(uint32_t wb_pc, uint32_t wb_instr){
+    n_cycles++;
+    if (wb_pc != last_pc) {
+        retire(wb_pc, wb_instr);
+        last_pc = wb_pc;
+    }
+}
+
+/*
+* Close the current block and interval.
+*/
+void bbv_profile::finish(){
+    end_block();
+    end_interval(n_cycles);
+}
+
+/*
+* Write the basic-block vectors in the SimPoint frequency vector format.  Returns false if error
+*/
+bool bbv_profile::write_bb(const char *path){
+    finish();
+    FILE *out = fopen(path, "w");
+    if (out == NULL) {
+        fprintf(stderr, "ERROR: opening `%s': %s\n", path, strerror(errno));
+        return false;
+    }
+    for (const interval_stats &iv : intervals) {
+        fputc('T', out);
+        for (const auto &e : iv.bbv) {
+            fprintf(out, ":%u:%u ", e.first, e.second);
+        }
+        fputc('\n', out);
+    }
+    fclose(out);
+    return true;
+}
+
+/*
+* Write the intervals as CSV.  Returns false if error
+*/
+bool bbv_profile::write_intervals(const char *path){
+    finish();
+    FILE *out = fopen(path, "w");
+    if (out == NULL) {
+        fprintf(stderr, "ERROR: opening `%s': %s\n", path, strerror(errno));
+        return false;
+    }
+    fprintf(out, "interval,first_cycle,cycles,instructions,cpi\n");
+    for (size_t i = 0; i < intervals.size(); i++) {
+        const interval_stats &iv = intervals[i];
+        fprintf(out, "%zu,%llu,%llu,%llu,%.4f\n", i, (unsigned long long)iv.first_cycle, (unsigned long long)iv.cycles,
+                (unsigned long long)iv.instr, (double)iv.cycles / iv.instr);
+    }
+    fclose(out);
+    return true;
+}
+
+/*
+* Load the intervals chosen by SimPoint and the cluster weights.  Returns false if error
+*/
+bool bbv_profile::load_simpoints(const char *simpoints_path, const char *weights_path){
+    //both files hold "<value> <cluster>" per line
+    auto read_pairs = [](const char *path, std::vector<std::pair<double, uint32_t>> *pairs) {
+        FILE *in = fopen(path, "r");
+        if (in == NULL) {
+            fprintf(stderr, "ERROR: opening `%s': %s\n", path, strerror(errno));
+            return false;
+        }
+        double   v;
+        uint32_t cluster;
+        while (fscanf(in, "%lf %u", &v, &cluster) == 2) {
+            pairs->emplace_back(v, cluster);
+        }
+        bool ok = feof(in);
+        fclose(in);
+        if (!ok || pairs->empty()) {
+            fprintf(stderr, "ERROR: `%s' is not a list of \"<value> <cluster>\" lines\n", path);
+        }
+        return ok && !pairs->empty();
+    };
+    std::vector<std::pair<double, uint32_t>> points, weights;
+    if (!read_pairs(simpoints_path, &points) || !read_pairs(weights_path, &weights)) {
+        return false;
+    }
+    chosen.clear();
+    last_chosen = 0;
+    for (const auto &p : points) {
+        auto w = std::find_if(weights.begin(), weights.end(), [&p](const std::pair<double, uint32_t> &w) { return w.second == p.second; });
+        if (w == weights.end()) {
+            fprintf(stderr, "ERROR: no weight for cluster %u in `%s'\n", p.second, weights_path);
+            chosen.clear();
+            return false;
+        }
+        chosen.push_back(simpoint{(uint64_t)p.first, w->first});
+        last_chosen = std::max(last_chosen, (uint64_t)p.first);
+    }
+    return true;
+}
+
+/*
+* Print the intervals, blocks and CPI of the run and, with chosen intervals, the weighted CPI estimate.
+*
+*   *out           - text output
+*   complete       - the run was simulated to the end
+*/
+void bbv_profile::report(FILE *out, bool complete){
+    finish();
+    fprintf(out, "Basic-Block Vectors: %zu intervals of %llu instructions, %zu blocks, %llu cycles, %llu instructions retired, CPI %.4f\n",
+            intervals.size(), (unsigned long long)interval_len, block_pc.size(), (unsigned long long)n_cycles,
+            (unsigned long long)n_retired, n_retired ? (double)n_cycles / n_retired : 0.0);
+    if (chosen.empty()) {
+        fprintf(out, "\n");
+        return;
+    }
+    fprintf(out, "  INTERVAL    WEIGHT      CYCLES    INSTRUCTIONS      CPI\n");
+    double   cpi = 0, weight = 0;
+    uint64_t sampled = 0;
+    for (const simpoint &p : chosen) {
+        if (p.interval >= intervals.size()) {
+            fprintf(out, "%10llu  %8.5f  not reached\n", (unsigned long long)p.interval, p.weight);
+            continue;
+        }
+        const interval_stats &iv = intervals[p.interval];
+        fprintf(out, "%10llu  %8.5f  %10llu  %14llu  %7.4f\n", (unsigned long long)p.interval, p.weight, (unsigned long long)iv.cycles,
+                (unsigned long long)iv.instr, (double)iv.cycles / iv.instr);
+        cpi     += p.weight * iv.cycles / iv.instr;
+        weight  += p.weight;
+        sampled += iv.cycles;
+    }
+    if (weight == 0) {
+        fprintf(out, "No chosen interval was reached\n\n");
+        return;
+    }
+    //weights of intervals not reached are left out, renormalize
+    cpi /= weight;
+    fprintf(out, "Weighted CPI estimate %.4f, the chosen intervals are %.2f%% of the cycles simulated", cpi, 100.0 * sampled / n_cycles);
+    if (complete && n_retired != 0) {
+        double full = (double)n_cycles / n_retired;
+        fprintf(out, ", whole run CPI %.4f (error %+.2f%%)", full, 100.0 * (cpi - full) / full);
+    }
+    fprintf(out, "\n\n");
+}
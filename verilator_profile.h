@@ -0,0 +1,222 @@
+// PC-level cycle profiler for use with simulation with Verilator.
+// Keeps a cycle and retire histogram per PC and a shadow call stack, symbolized against the ELF symbols of the program.
+// Also provides the basic-block vector collector for SimPoint-style sampled simulation (bbv_profile).
+//
+// Does not access the verilator model, update_profile() and update_bbv() in verilator_support.h sample the write-back stage of the
+// scalar core.
+//
+// Every cycle is charged to the PC in the write-back stage, i.e. the oldest instruction in flight, which is the one all younger
+// instructions wait on.  Cycles in which the scalar core waits on a vector instruction or a load are therefore attributed to that
+// instruction.  Calls and returns are recognized from the retired instructions (jal/jalr/c.jal/c.jalr linking to ra or t0, jalr/c.jr
+// through ra or t0 without link) and a jump out of the current function without a call replaces the innermost frame, which covers
+// tail calls and code reached before the profiler was started.
+
+#ifndef VERILATOR_PROFILE_H
+#define VERILATOR_PROFILE_H
+
+#include "verilator_memory.h"
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include <unordered_map>
+#include <vector>
+
+class pc_profile {
+public:
+    /*
+    * ARGS:
+    *   *info          - symbol table of the profiled program, must stay valid while profiling.  May be NULL, the profile is then
+    *                    reported by PC only
+    */
+    pc_profile(const program_info *info = NULL);
+
+    /*
+    * Account one cycle.  A change of wb_pc is counted as the retirement of the instruction at wb_pc.
+    * ARGS:
+    *   wb_pc          - PC of the instruction in the write-back stage
+    *   wb_instr       - instruction word in the write-back stage
+    */
+    void sample(uint32_t wb_pc, uint32_t wb_instr);
+
+    /*
+    * Clear all counters, e.g. at the start of the region of interest.
+    */
+    void clear();
+
+    uint64_t cycles() const  { return n_cycles; }
+    uint64_t retired() const { return n_retired; }
+
+    /*
+    * Print the flat function profile (cycles, share of cycles, retired instructions and CPI per function), sorted by cycles.
+    * ARGS:
+    *   *out           - text output
+    *   max_lines      - number of functions to print, 0 for all
+    */
+    void report(FILE *out, int max_lines = 0) const;
+
+    /*
+    * Write the cycles per call stack in the folded format of flamegraph.pl and compatible tools ("main;foo;bar 1234" per line).
+    * Returns false if error
+    * ARGS:
+    *   *path          - output file
+    */
+    bool write_folded(const char *path) const;
+
+private:
+    //per-PC counters, open addressing hash table with linear probing keyed by PC.  RISC-V PCs are even, so 1 marks a free slot
+    struct pc_entry {
+        uint32_t pc;
+        uint64_t cycles;
+        uint64_t retired;
+    };
+    static const uint32_t FREE = 1;
+
+    //shadow call stack frames, one node per distinct stack
+    struct frame {
+        uint32_t parent;
+        int32_t  sym;       // index into info->symbols, -1 if unknown
+        uint32_t lo, hi;    // address range of the function, lo == hi if unknown
+        uint64_t cycles;
+    };
+
+    const program_info                     *info;
+    std::vector<pc_entry>                   table;
+    size_t                                  used;
+    size_t                                  last;       // slot of the PC sampled last
+    uint32_t                                last_pc;
+    uint64_t                                n_cycles;
+    uint64_t                                n_retired;
+
+    std::vector<frame>                      frames;     // frames[0] is the root
+    std::unordered_map<uint64_t, uint32_t>  children;   // (parent << 32 | sym) -> frame
+    uint32_t                                cur;
+    bool                                    call_pending;
+    bool                                    ret_pending;
+
+    pc_entry *slot(uint32_t pc);
+    void grow();
+    uint32_t child(uint32_t parent, uint32_t pc);
+    void retire(uint32_t pc, uint32_t instr);
+    const char *sym_name(int32_t sym) const;
+};
+
+/*
+*   Basic-block vector collector for SimPoint-style sampled simulation.  The retired PC stream is split into basic blocks: a block ends
+*   after a branch, jump or system instruction, or when the next retired PC is not the sequential successor (trap, interrupt).  Blocks
+*   are identified by their first PC and numbered from 1 in order of first execution.  Every interval instructions (rounded up to the
+*   end of a block) the instructions executed per block form one basic-block vector, written in the frequency vector format of SimPoint
+*   (.bb, "T:id:count :id:count ..." per interval), together with the cycles and CPI of every interval.
+*
+*   The intervals are defined by instruction counts, so intervals chosen by SimPoint on one run apply to runs of the same program with
+*   any VREG_W/VLANE_W configuration.  With load_simpoints() the collector reports the CPI estimated from the chosen intervals, weighted
+*   by their cluster weights.  The RTL model cannot fast-forward, so a run still simulates every interval up to the last chosen one;
+*   done() tells the testbench when it can stop.
+*
+*   Usage:
+*       bbv_profile bbv(100000000);
+*       every cycle:    update_bbv(ctx, &bbv);
+*       at the end:     bbv.write_bb("app.bb"); bbv.write_intervals("app.csv");
+*       simpoint -loadFVFile app.bb -maxK 30 -saveSimpoints app.simpoints -saveSimpointWeights app.weights
+*       later runs:     bbv.load_simpoints("app.simpoints", "app.weights"); ... stop when bbv.done(); bbv.report(stdout);
+*/
+class bbv_profile {
+public:
+    /*
+    * ARGS:
+    *   interval       - retired instructions per interval
+    */
+    explicit bbv_profile(uint64_t interval = 100000000);
+
+    /*
+    * Account one cycle.  A change of wb_pc is counted as the retirement of the instruction at wb_pc.
+    * ARGS:
+    *   wb_pc          - PC of the instruction in the write-back stage
+    *   wb_instr       - instruction word in the write-back stage
+    */
+    void sample(uint32_t wb_pc, uint32_t wb_instr);
+
+    /*
+    * Close the current block and interval, e.g. at the end of the run.  The writers and report() call it.
+    */
+    void finish();
+
+    /*
+    * Clear all intervals and blocks.  Chosen intervals loaded with load_simpoints() are kept.
+    */
+    void clear();
+
+    /*
+    * Write the basic-block vectors in the SimPoint frequency vector format.  Returns false if error
+    */
+    bool write_bb(const char *path);
+
+    /*
+    * Write the intervals as CSV (interval, first cycle, cycles, instructions, CPI).  Returns false if error
+    */
+    bool write_intervals(const char *path);
+
+    /*
+    * Load the intervals chosen by SimPoint (-saveSimpoints, "<interval> <cluster>" per line) and the cluster weights
+    * (-saveSimpointWeights, "<weight> <cluster>" per line).  Returns false if error
+    */
+    bool load_simpoints(const char *simpoints_path, const char *weights_path);
+
+    /*
+    * Returns true once all chosen intervals were measured.
+    */
+    bool done() const { return !chosen.empty() && n_intervals() > last_chosen; }
+
+    /*
+    * Print the number of intervals and blocks and the CPI of the run.  With chosen intervals, print their CPI and weights and the
+    * weighted CPI estimate, compared with the CPI of the whole run if the run was simulated to the end.
+    * ARGS:
+    *   *out           - text output
+    *   complete       - the run was simulated to the end
+    */
+    void report(FILE *out, bool complete = true);
+
+    size_t   n_intervals() const { return intervals.size(); }
+    size_t   n_blocks() const    { return block_pc.size(); }
+    uint64_t cycles() const      { return n_cycles; }
+    uint64_t retired() const     { return n_retired; }
+
+private:
+    struct interval_stats {
+        uint64_t first_cycle;
+        uint64_t cycles;
+        uint64_t instr;
+        std::vector<std::pair<uint32_t, uint32_t>> bbv;   // (block id, instructions), sorted by id
+    };
+    struct simpoint {
+        uint64_t interval;
+        double   weight;
+    };
+
+    uint64_t                                interval_len;
+    uint64_t                                n_cycles;
+    uint64_t                                n_retired;
+    uint32_t                                last_pc;
+
+    uint32_t                                blk_start;      // first PC of the current block
+    uint32_t                                blk_len;        // instructions of the current block so far, 0 if none
+    uint32_t                                next_pc;        // sequential successor of the last retired instruction
+    bool                                    blk_end;        // the last retired instruction ends the block
+
+    uint64_t                                iv_first;       // first cycle of the current interval
+    uint64_t                                iv_instr;       // instructions of the current interval
+    std::unordered_map<uint32_t, uint32_t>  block_ids;      // first PC -> id - 1
+    std::vector<uint32_t>                   block_pc;       // id - 1 -> first PC
+    std::vector<uint32_t>                   counts;         // instructions per block in the current interval
+    std::vector<uint32_t>                   touched;        // blocks with non-zero counts in the current interval
+
+    std::vector<interval_stats>             intervals;
+    std::vector<simpoint>                   chosen;
+    uint64_t                                last_chosen;
+
+    void retire(uint32_t pc, uint32_t instr);
+    void end_block();
+    void end_interval(uint64_t end_cycle);
+};
+
+#endif
@@ -0,0 +1,255 @@
+// Batched cycle engine for use with simulation with Verilator.
+// run_cycles() drives the clock of a sim_context in a tight loop for a number of cycles or until a stop condition is met, instead of the
+// testbench calling advance_cycle(), update_stats(), update_vcd(), ... individually every cycle.
+//
+// The per-cycle observers are selected at compile time by a mask of run_observer bits: disabled observers compile to nothing and the stop
+// conditions are evaluated inline.  Their arguments are checked once per call rather than every cycle.  The memory ports stay with the
+// testbench: its step function is called before every rising clock edge and returns false to end the run, e.g. on the exit MMIO write.
+//
+// Example:
+//     auto step = [&](sim_context *ctx) {
+//         instr_port.update(...instruction interface of ctx->top..., mem);
+//         data_port.update(...data interface of ctx->top..., mem);
+//         update_mem_write(..., mem);
+//         return !check_memmapio(..., EXIT_ADDR, &out);
+//     };
+//     run_config cfg;
+//     cfg.stall_cycles = 1000;
+//     cfg.tfp          = tfp;
+//     cfg.trace_end    = 0;
+//     run_status st = run_cycles<RUN_STATS | RUN_VCD | RUN_STOP_STALL>(ctx, 0, cfg, step);
+
+#ifndef VERILATOR_RUN_H
+#define VERILATOR_RUN_H
+
+#include "verilator_support.h"
+
+#include <type_traits>
+
+/*
+*   Observers and stop conditions of run_cycles(), in the order they are evaluated after each cycle.
+*/
+enum run_observer : unsigned {
+    RUN_STATS          = 1u << 0,   // update_stats()
+    RUN_TRACE_TRIGGER  = 1u << 1,   // update_trace_trigger(cfg.trig), RUN_VCD, RUN_INST_TRACE and RUN_INST_LOG then follow its windows
+    RUN_VCD            = 1u << 2,   // update_vcd(cfg.tfp), in cfg.trace_begin..trace_end without RUN_TRACE_TRIGGER
+    RUN_INST_TRACE     = 1u << 3,   // update_inst_trace(cfg.inst_trace), as RUN_VCD
+    RUN_COMMIT         = 1u << 4,   // update_xreg/freg/vreg_commit() into the binary cfg.log
+    RUN_COMMIT_FILE    = 1u << 5,   // update_xreg/freg/vreg_commit() into the text cfg.commit_file, VREG_W cfg.vreg_w
+    RUN_COMMIT_CHECK   = 1u << 6,   // update_commit_check(cfg.check), stops with RUN_MISMATCH
+    RUN_PROFILE        = 1u << 7,   // update_profile(cfg.prof)
+    RUN_MEM_TRAFFIC    = 1u << 8,   // update_mem_traffic(cfg.traffic)
+    RUN_STOP_STALL     = 1u << 9,   // stop with RUN_STALL if IF_PC has not changed for cfg.stall_cycles cycles, as check_stall()
+    RUN_STOP_PC        = 1u << 10,  // stop with RUN_PC when IF_PC reaches cfg.stop_pc, as check_PC()
+    RUN_HOST_PHASES    = 1u << 11,  // time every harness phase (see host_scope) instead of the whole run as HOST_RUN
+    RUN_INST_LOG       = 1u << 12,  // update_inst_trace(cfg.inst_log), the binary instruction trace, windows as RUN_INST_TRACE
+    RUN_BBV            = 1u << 13,  // update_bbv(cfg.bbv), stops with RUN_SAMPLED once cfg.bbv->done()
+    RUN_POWER          = 1u << 14,  // update_power(cfg.pwr), VREG_W cfg.vreg_w, evaluated before RUN_BBV
+};
+
+/*
+*   Arguments of the observers and stop conditions.  Only those of the selected observers are used.
+*/
+struct run_config {
+    uint32_t          stall_cycles = 1000;  // RUN_STOP_STALL
+    uint32_t          stop_pc      = 0;     // RUN_STOP_PC
+    trace_trigger    *trig         = NULL;  // RUN_TRACE_TRIGGER
+    uint32_t          trace_begin  = 0;     // RUN_VCD and RUN_INST_TRACE without RUN_TRACE_TRIGGER, trace_end == 0 traces everything
+    uint32_t          trace_end    = 0;
+    VerilatedTrace_t *tfp          = NULL;  // RUN_VCD
+    FILE             *inst_trace   = NULL;  // RUN_INST_TRACE
+    inst_trace_log   *inst_log     = NULL;  // RUN_INST_LOG
+    commit_log       *log          = NULL;  // RUN_COMMIT
+    FILE             *commit_file  = NULL;  // RUN_COMMIT_FILE
+    int               vreg_w       = 0;     // RUN_COMMIT_FILE and RUN_POWER
+    commit_check     *check        = NULL;  // RUN_COMMIT_CHECK
+    pc_profile       *prof         = NULL;  // RUN_PROFILE
+    bbv_profile      *bbv          = NULL;  // RUN_BBV
+    mem_traffic      *traffic      = NULL;  // RUN_MEM_TRAFFIC
+    power_counters   *pwr          = NULL;  // RUN_POWER
+};
+
+/*
+*   Reason run_cycles() returned.
+*/
+enum run_status {
+    RUN_DONE,       // the requested number of cycles was simulated
+    RUN_EXIT,       // the testbench step function returned false
+    RUN_STALL,      // RUN_STOP_STALL
+    RUN_PC,         // RUN_STOP_PC
+    RUN_MISMATCH,   // RUN_COMMIT_CHECK found a divergent commit
+    RUN_SAMPLED,    // RUN_BBV measured all intervals chosen by SimPoint
+    RUN_ERROR       // an argument of a selected observer is missing, nothing was simulated
+};
+
+/*
+* Check the arguments of the selected observers.  Returns false if error
+* ARGS:
+*   -  obs          - mask of run_observer bits
+*   - &cfg          - observer arguments
+*/
+inline bool run_config_valid(unsigned obs, const run_config &cfg){
+    const char *missing = NULL;
+    if      ((obs & RUN_TRACE_TRIGGER) && cfg.trig == NULL)      missing = "trig";
+    else if ((obs & RUN_VCD) && cfg.tfp == NULL)                 missing = "tfp";
+    else if ((obs & RUN_INST_TRACE) && cfg.inst_trace == NULL)   missing = "inst_trace";
+    else if ((obs & RUN_INST_LOG) && cfg.inst_log == NULL)       missing = "inst_log";
+    else if ((obs & RUN_COMMIT) && cfg.log == NULL)              missing = "log";
+    else if ((obs & RUN_COMMIT_FILE) && cfg.commit_file == NULL) missing = "commit_file";
+    else if ((obs & RUN_COMMIT_CHECK) && cfg.check == NULL)      missing = "check";
+    else if ((obs & RUN_PROFILE) && cfg.prof == NULL)            missing = "prof";
+    else if ((obs & RUN_BBV) && cfg.bbv == NULL)                 missing = "bbv";
+    else if ((obs & RUN_MEM_TRAFFIC) && cfg.traffic == NULL)     missing = "traffic";
+    else if ((obs & RUN_POWER) && cfg.pwr == NULL)               missing = "pwr";
+    else if ((obs & RUN_POWER) && cfg.vreg_w <= 0)               missing = "vreg_w";
+    if (missing != NULL) {
+        fprintf(stderr, "ERROR: run_cycles: observer selected without run_config::%s\n", missing);
+        return false;
+    }
+    return true;
+}
+
+//host timing of a whole run, nothing with RUN_HOST_PHASES
+struct run_no_scope {
+    run_no_scope(sim_context *, host_phase) {}
+};
+
+/*
+* Simulate up to n cycles.  Every cycle calls the testbench step function, advances the clock as advance_cycle(), then evaluates the
+* selected observers and stop conditions.  Returns the reason the run ended; the cycles simulated are counted in ctx->host.sim_cycles
+* (and in ctx->cycles with RUN_STATS).  A stopped run can be continued by calling run_cycles() again.
+* ARGS:
+*   -  OBS          - mask of run_observer bits
+*   - *ctx          - simulation context
+*   -  n            - number of cycles, 0 to run until a stop condition
+*   - &cfg          - observer arguments
+*   - &step         - testbench step function, bool(sim_context *ctx).  Drives the memory ports, returns false to stop with RUN_EXIT
+*/
+template <unsigned OBS, typename STEP>
+run_status run_cycles(sim_context *ctx, uint64_t n, const run_config &cfg, STEP &&step){
+    if (!run_config_valid(OBS, cfg)) {
+        return RUN_ERROR;
+    }
+    constexpr bool phases = (OBS & RUN_HOST_PHASES) != 0;
+    Vvproc_top *top = ctx->top;
+    host_advance(ctx, 0);
+    typename std::conditional<phases, run_no_scope, host_scope>::type scope(ctx, HOST_RUN);
+
+    run_status status  = RUN_DONE;
+    uint64_t   done    = 0;
+    uint64_t   counted = 0;
+    while (n == 0 || done < n) {
+        if (!step(ctx)) {
+            status = RUN_EXIT;
+            break;
+        }
+        {
+            typename std::conditional<phases, host_scope, run_no_scope>::type eval_scope(ctx, HOST_EVAL);
+            top->clk_i = 1;
+            top->eval();
+            top->clk_i = 0;
+            top->eval();
+        }
+        done++;
+        if ((done & 1023) == 0) {
+            host_advance(ctx, done - counted);
+            counted = done;
+        }
+
+        if constexpr ((OBS & RUN_STATS) != 0) {
+            update_stats(ctx);
+        }
+        if constexpr ((OBS & RUN_TRACE_TRIGGER) != 0) {
+            update_trace_trigger(ctx, cfg.trig);
+        }
+        if constexpr ((OBS & RUN_VCD) != 0) {
+            if constexpr ((OBS & RUN_TRACE_TRIGGER) != 0) {
+                update_vcd(ctx, cfg.tfp, cfg.trig);
+            } else {
+                update_vcd(ctx, cfg.tfp, cfg.trace_begin, cfg.trace_end);
+            }
+        }
+        if constexpr ((OBS & RUN_INST_TRACE) != 0) {
+            if constexpr ((OBS & RUN_TRACE_TRIGGER) != 0) {
+                update_inst_trace(ctx, cfg.inst_trace, cfg.trig);
+            } else {
+                update_inst_trace(ctx, cfg.inst_trace, cfg.trace_begin, cfg.trace_end);
+            }
+        }
+        if constexpr ((OBS & RUN_INST_LOG) != 0) {
+            if constexpr ((OBS & RUN_TRACE_TRIGGER) != 0) {
+                update_inst_trace(ctx, cfg.inst_log, cfg.trig);
+            } else {
+                update_inst_trace(ctx, cfg.inst_log, cfg.trace_begin, cfg.trace_end);
+            }
+        }
+        if constexpr ((OBS & RUN_COMMIT) != 0) {
+            update_xreg_commit(ctx, cfg.log);
+            update_freg_commit(ctx, cfg.log);
+            update_vreg_commit(ctx, cfg.log);
+        }
+        if constexpr ((OBS & RUN_COMMIT_FILE) != 0) {
+            update_xreg_commit(ctx, cfg.commit_file);
+            update_freg_commit(ctx, cfg.commit_file);
+            update_vreg_commit(ctx, cfg.vreg_w, cfg.commit_file);
+        }
+        if constexpr ((OBS & RUN_COMMIT_CHECK) != 0) {
+            if (!update_commit_check(ctx, cfg.check)) {
+                status = RUN_MISMATCH;
+                break;
+            }
+        }
+        if constexpr ((OBS & RUN_PROFILE) != 0) {
+            update_profile(ctx, cfg.prof);
+        }
+        if constexpr ((OBS & RUN_MEM_TRAFFIC) != 0) {
+            update_mem_traffic(ctx, cfg.traffic);
+        }
+        if constexpr ((OBS & RUN_POWER) != 0) {
+            update_power(ctx, cfg.vreg_w, cfg.pwr);
+        }
+        if constexpr ((OBS & RUN_BBV) != 0) {
+            update_bbv(ctx, cfg.bbv);
+            if (cfg.bbv->done()) {
+                status = RUN_SAMPLED;
+                break;
+            }
+        }
+
+        if constexpr ((OBS & (RUN_STOP_STALL | RUN_STOP_PC)) != 0) {
+            uint32_t pc = top->vproc_top->core->pc_if;
+            if constexpr ((OBS & RUN_STOP_STALL) != 0) {
+                //same state as check_stall(), so both can be mixed
+                ctx->cycles_stalled = (pc == ctx->last_IF_PC) ? ctx->cycles_stalled + 1 : 0;
+                ctx->last_IF_PC     = pc;
+                if (ctx->cycles_stalled >= cfg.stall_cycles) {
+                    fprintf(stderr, "ERROR: SIMULATION STALLED FOR %d CYCLES AT IF_PC = 0x%x\n", cfg.stall_cycles, pc);
+                    report_stall_causes(ctx);
+                    status = RUN_STALL;
+                    break;
+                }
+            }
+            if constexpr ((OBS & RUN_STOP_PC) != 0) {
+                if (pc == cfg.stop_pc) {
+                    status = RUN_PC;
+                    break;
+                }
+            }
+        }
+    }
+    host_advance(ctx, done - counted);
+    return status;
+}
+
+/*
+* run_cycles() on default_ctx
+* ARGS:
+*   - *top          - pointer to verilator top module
+*/
+template <unsigned OBS, typename STEP>
+run_status run_cycles(Vvproc_top *top, uint64_t n, const run_config &cfg, STEP &&step){
+    default_ctx.top = top;
+    return run_cycles<OBS>(&default_ctx, n, cfg, step);
+}
+
+#endif
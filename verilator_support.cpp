@@ -3,6 +3,47 @@
 //
 // In general, accesses to internal variables (exposed with VERILATOR_PUBLIC) should be handled here by passing in a reference to TOP.  Accesses to top level interface signals (i.e. memory interfaces) should be handled by the user.
 #include "verilator_support.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+
+/*
+*   Simulation context.  Clear all harness state, the model and the verilator context are kept.
+*/
+void sim_context::reset_stats(){
+    Vvproc_top       *model    = top;
+    VerilatedContext *vc       = vctx;
+    double            progress = host.progress_interval;
+    *this = sim_context();
+    top  = model;
+    vctx = vc;
+    host.progress_interval = progress;
+}
+
+/*
+* Function to reset the model of a context.  Holds rst_ni low for the given number of cycles and clears the harness state.
+* ARGS:
+*   - *ctx          - simulation context
+*   -  rst_cycles   - number of cycles to hold reset
+*/
+void reset_model(sim_context *ctx, int rst_cycles){
+    ctx->top->clk_i  = 0;
+    ctx->top->rst_ni = 0;
+    ctx->top->eval();
+    for (int i = 0; i < rst_cycles; i++) {
+        advance_cycle(ctx);
+    }
+    ctx->top->rst_ni = 1;
+    ctx->top->eval();
+    ctx->reset_stats();
+}
+
 /*
 * Functions and Variables used to detect a stall.  Returns true if IF_PC in CV32E40X core has not changed in the provided number of cycles  
 * ARGS:
@@ -10,24 +51,68 @@
 *   -  max_cycles   - number of cycles after which a stall is declared
 */
 bool check_stall(Vvproc_top *top, uint32_t max_cycles) {
+    default_ctx.top = top;
+    return check_stall(&default_ctx, max_cycles);
+}
 
-    uint32_t current_IF_PC = top->vproc_top->core->pc_if;
-    if (current_IF_PC == last_IF_PC) {
-        cycles_stalled++;
+bool check_stall(sim_context *ctx, uint32_t max_cycles) {
+
+    uint32_t current_IF_PC = ctx->top->vproc_top->core->pc_if;
+    if (current_IF_PC == ctx->last_IF_PC) {
+        ctx->cycles_stalled++;
     } else {
-        cycles_stalled = 0;
+        ctx->cycles_stalled = 0;
     }
 
-    last_IF_PC = current_IF_PC;
+    ctx->last_IF_PC = current_IF_PC;
 
-    if ( cycles_stalled >= max_cycles) {
+    if ( ctx->cycles_stalled >= max_cycles) {
         fprintf(stderr, "ERROR: SIMULATION STALLED FOR %d CYCLES AT IF_PC = 0x%x\n", max_cycles, current_IF_PC);
+        report_stall_causes(ctx);
         return true;
     }
         
     return false;
 }
 
+/*
+* Print the dispatch stall causes of the cycles since IF_PC last changed.
+* ARGS:
+*   - *ctx          - simulation context
+*/
+void report_stall_causes(sim_context *ctx){
+    const dispatch_stats &ds = ctx->disp;
+    uint64_t window = 0;
+    for (uint64_t c : ds.window) {
+        window += c;
+    }
+    if (window == 0) {
+        return;
+    }
+    fprintf(stderr, "Dispatch in the last %llu cycles:", (unsigned long long)window);
+    for (int i = 0; i < VPROC_DISPATCH_CNT; i++) {
+        if (ds.window[i] != 0) {
+            fprintf(stderr, " %s %.1f%%", vproc_dispatch_names[i], 100.0 * ds.window[i] / window);
+        }
+    }
+    fprintf(stderr, "\n");
+    #ifdef RISCV_ZVE32X
+    auto *v_core = ctx->top->vproc_top->v_core;
+    uint32_t cause = v_core->dispatch_stall_cause;
+    if (cause >= VPROC_DISPATCH_WAIT && cause < VPROC_DISPATCH_CNT) {
+        uint32_t id = v_core->dispatch_stall_id;
+        fprintf(stderr, "Head of the instruction queue: ID %u", id);
+        if (id < ds.in_flight.size() && ds.in_flight[id].pc_valid) {
+            fprintf(stderr, " at PC 0x%08x", ds.in_flight[id].pc);
+        }
+        fprintf(stderr, ", waiting on %s\n", vproc_dispatch_names[cause]);
+    }
+    if (v_core->offload_stall_cause != 0 && v_core->offload_stall_cause < VPROC_OFFLOAD_CNT) {
+        fprintf(stderr, "Offloading refused: %s\n", vproc_offload_names[v_core->offload_stall_cause]);
+    }
+    #endif
+}
+
 /*
 * Function to check for a specific IF_PC.  Returns true if match.
 * ARGS:
@@ -38,19 +123,151 @@ bool check_PC(Vvproc_top *top, uint32_t address) {
     return (top->vproc_top->core->pc_if == address);
 }
 
+bool check_PC(sim_context *ctx, uint32_t address) {
+    return check_PC(ctx->top, address);
+}
+
+/*
+*   Host throughput: seconds of host time in TSC ticks, calibrated against steady_clock over the whole run.
+*/
+static double host_elapsed(const host_stats &h){
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - h.start_time).count();
+}
+
+static double host_tick_seconds(const host_stats &h, uint64_t ticks){
+#if defined(__x86_64__) || defined(__i386__)
+    double   elapsed = host_elapsed(h);
+    uint64_t total   = host_ticks() - h.start_ticks;
+    return total ? ticks * (elapsed / total) : 0.0;
+#else
+    return ticks * 1e-9;
+#endif
+}
+
+/*
+* Count simulated cycles, start the host timing with the first call and print the progress lines.
+* ARGS:
+*   - *ctx          - simulation context
+*   -  cycles       - number of cycles advanced since the last call
+*/
+void host_advance(sim_context *ctx, uint64_t cycles){
+    host_stats &h = ctx->host;
+    if (!h.started) {
+        h.started     = true;
+        h.start_time  = std::chrono::steady_clock::now();
+        h.start_ticks = host_ticks();
+        uint64_t t = host_ticks();
+        for (int i = 0; i < 255; i++) {
+            host_ticks();
+        }
+        h.tick_cost = (host_ticks() - t) / 256.0;
+        if (h.progress_interval < 0.0) {
+            const char *env = getenv("VICUNA_PROGRESS");
+            h.progress_interval = env != NULL ? atof(env) : 0.0;
+        }
+        h.next_progress = h.progress_interval;
+    }
+    uint64_t last = h.sim_cycles;
+    h.sim_cycles += cycles;
+    //look at the clock at most every 1024 cycles
+    if (h.progress_interval <= 0.0 || (last >> 10) == (h.sim_cycles >> 10)) {
+        return;
+    }
+    double now = host_elapsed(h);
+    if (now < h.next_progress) {
+        return;
+    }
+    double khz = (h.sim_cycles - h.last_cycles) / (now - h.last_seconds) / 1000.0;
+    fprintf(stderr, "[%8.1f s] %llu cycles, %d instructions, %.2f kHz (average %.2f kHz)\n", now,
+            (unsigned long long)h.sim_cycles, ctx->instr, khz, h.sim_cycles / now / 1000.0);
+    h.last_seconds  = now;
+    h.last_cycles   = h.sim_cycles;
+    h.next_progress = now + h.progress_interval;
+}
+
+/*
+* Set the interval of the progress lines
+* ARGS:
+*   -  seconds      - interval between progress lines, 0 to disable them
+*/
+void set_host_progress(double seconds){
+    set_host_progress(&default_ctx, seconds);
+}
+
+void set_host_progress(sim_context *ctx, double seconds){
+    ctx->host.progress_interval = seconds > 0.0 ? seconds : 0.0;
+    ctx->host.next_progress     = ctx->host.started ? host_elapsed(ctx->host) + seconds : seconds;
+}
+
+/*
+* Wall-clock seconds since the first cycle was advanced
+*/
+double host_seconds(){
+    return host_seconds(&default_ctx);
+}
+
+double host_seconds(sim_context *ctx){
+    return ctx->host.started ? host_elapsed(ctx->host) : 0.0;
+}
+
+/*
+* Print the host time breakdown
+*/
+void report_host_stats(){
+    report_host_stats(&default_ctx);
+}
+
+void report_host_stats(sim_context *ctx){
+    const host_stats &h = ctx->host;
+    if (!h.started) {
+        return;
+    }
+    double wall = host_elapsed(h);
+    fprintf(stderr, "Host Time: %.3f s for %llu cycles, %.2f kHz\n", wall, (unsigned long long)h.sim_cycles,
+            wall > 0.0 ? h.sim_cycles / wall / 1000.0 : 0.0);
+    fprintf(stderr, "PHASE          TIME (s)   SHARE      CALLS   NS/CALL\n");
+    double harness = 0.0;
+    for (int p = 0; p < HOST_PHASE_CNT; p++) {
+        if (h.calls[p] == 0) {
+            continue;
+        }
+        double t = host_tick_seconds(h, h.ticks[p]);
+        harness += t;
+        fprintf(stderr, "%-12s  %9.3f  %5.1f%%  %9llu  %8.1f\n", host_phase_names[p], t, wall > 0.0 ? t / wall * 100 : 0.0,
+                (unsigned long long)h.calls[p], t / h.calls[p] * 1e9);
+    }
+    //every timed call reads the clock twice
+    uint64_t calls = 0;
+    for (int p = 0; p < HOST_PHASE_CNT; p++) {
+        calls += h.calls[p];
+    }
+    double timing = host_tick_seconds(h, (uint64_t)(2 * calls * h.tick_cost));
+    double other  = wall > harness + timing ? wall - harness - timing : 0.0;
+    fprintf(stderr, "%-12s  %9.3f  %5.1f%%\n", "timing", timing, wall > 0.0 ? timing / wall * 100 : 0.0);
+    fprintf(stderr, "%-12s  %9.3f  %5.1f%%\n\n", "testbench", other, wall > 0.0 ? other / wall * 100 : 0.0);
+}
+
 /*
 * Function to advance signal to the next cycle (i.e pass to after next falling edge)
 * ARGS:
 *   - *top          - pointer to verilator top module
 */
 void advance_cycle(Vvproc_top *top){
+    default_ctx.top = top;
+    advance_cycle(&default_ctx);
+}
+
+void advance_cycle(sim_context *ctx){
+    host_advance(ctx, 1);
+    host_scope scope(ctx, HOST_EVAL);
+
     // rising clock edge
-    top->clk_i = 1;
-    top->eval();
+    ctx->top->clk_i = 1;
+    ctx->top->eval();
 
     // falling clock edge
-    top->clk_i = 0;
-    top->eval();
+    ctx->top->clk_i = 0;
+    ctx->top->eval();
     return;
 }
 
@@ -61,13 +278,44 @@ void advance_cycle(Vvproc_top *top){
 *   - clk_val     - value to set the clock to
 */
 void advance_half_cycle(Vvproc_top *top, int clk_val){
-    top->clk_i = clk_val;
-    top->eval();
+    default_ctx.top = top;
+    advance_half_cycle(&default_ctx, clk_val);
+}
+
+void advance_half_cycle(sim_context *ctx, int clk_val){
+    if (clk_val) {
+        host_advance(ctx, 1);
+    }
+    host_scope scope(ctx, HOST_EVAL);
+    ctx->top->clk_i = clk_val;
+    ctx->top->eval();
     return;
 }
+/*
+*   Function to read from memory through a mem_port.  Generalized to work on byte pointers for variable width interfaces.
+*
+*   *port          - memory port, constructed with the width, latency and size of the interface
+*   address        - address of the load request being issued
+*   req_valid      - validity of the load request being issued
+*
+*   *model_data_i  - pointer to memory data read interface on verilator model
+*   *model_valid_i - pointer to memory valid read interface on verilator model
+*   *model_err_i   - pointer to memory error read interface on verilator model
+*
+*   *mem           - pointer to memory space
+*/
+void update_mem_load(mem_port *port, uint32_t address, bool req_valid, unsigned char *model_data_i, bool *model_valid_i, bool *model_err_i, unsigned char *mem){
+    port->update(address, req_valid, model_data_i, model_valid_i, model_err_i, mem);
+}
+
+void update_mem_load(mem_port *port, uint32_t address, bool req_valid, unsigned char *model_data_i, bool *model_valid_i, bool *model_err_i, paged_mem *mem){
+    port->update(address, req_valid, model_data_i, model_valid_i, model_err_i, mem);
+}
+
 /*
 *   Function to read from memory and manage/update memory buffers.  Generalized to work on byte pointers for variable width interfaces.
-*   Queues of correct sizes are expected to be allocated and provided by the user.
+*   Compatibility wrapper around mem_port, one port is created per distinct queue_data pointer.  The ports are kept in default_ctx, so
+*   the wrapper is for single-context simulations only; with several contexts (e.g. batch_runner) use a mem_port per interface.
 *
 *   address        - address of the load request being issued
 *   req_valid      - validity of the load request being issued
@@ -79,54 +327,18 @@ void advance_half_cycle(Vvproc_top *top, int clk_val){
 *   *model_valid_i - pointer to memory valid read interface on verilator model
 *   *model_err_i   - pointer to memory error read interface on verilator model
 *
-*   **queue_data   - pointer to data queue
-*   *queue_valid   - pointer to valid queue
-*   *queue_err     - pointer to error queue
+*   **queue_data   - pointer to data queue (identifies the port)
+*   *queue_valid   - pointer to valid queue (unused)
+*   *queue_err     - pointer to error queue (unused)
 *
 *   *mem           - pointer to memory space
 */
 void update_mem_load(uint32_t address, bool req_valid, uint32_t mem_w, uint32_t mem_lat, uint32_t mem_size, unsigned char *model_data_i, bool *model_valid_i, bool *model_err_i, unsigned char **queue_data, bool *queue_valid, bool *queue_err, unsigned char *mem){
-
-    // Put read data on the processor read port.
-    for (int i = 0; i < mem_w/8; i++)
-    {
-        model_data_i[i]  = queue_data[mem_lat-1][i];
-    }
-    *model_valid_i = queue_valid[mem_lat-1];
-    *model_err_i   = queue_err[mem_lat-1];
-
-
-    //Next, advance fifo buffers by one cycle
-
-    for (int i = mem_lat-1; i > 0; i--) {
-        
-        for (int j = 0; j < mem_w/8; j++)
-        {
-            queue_data[i][j] = queue_data[i-1][j];
-        }
-        queue_valid[i] = queue_valid[i-1];
-        queue_err[i]   = queue_err[i-1];
-    }
-
-    //Next evaluate an outstanding request and put at the end of the buffer.
-    bool valid = (address < mem_size) & req_valid;
-
-    //set new queue entry to zero
-    for (int i = 0; i < mem_w/8; i++)
-    {
-        queue_data[0][i] = 0;
-    }
-    
-    if (valid)
-    {
-        //Copy each valid byte into buffer
-        for (int i = 0; i < mem_w/8; i++) {
-            queue_data[0][i] |= mem[address+i];
-        }
+    std::unique_ptr<mem_port> &port = default_ctx.legacy_ports[queue_data];
+    if (!port || port->width_bytes() != mem_w/8 || port->latency() != mem_lat || port->size() != mem_size) {
+        port.reset(new mem_port(mem_w, mem_lat, mem_size));
     }
-
-    queue_valid[0] = req_valid;
-    queue_err[0]   = !valid;
+    port->update(address, req_valid, model_data_i, model_valid_i, model_err_i, mem);
 }
 
 /*
@@ -142,18 +354,54 @@ void update_mem_load(uint32_t address, bool req_valid, uint32_t mem_w, uint32_t
 *   *model_be_o    - pointer to byte enable write interface on verilator model
 *
 *   *mem           - pointer to memory space
+*   *dirty         - pages written.  May be NULL
 */
-void update_mem_write(uint32_t address, bool req_valid, uint32_t mem_w, uint32_t mem_size, unsigned char *model_data_o, unsigned char *model_be_o, unsigned char *mem){
+void update_mem_write(uint32_t address, bool req_valid, uint32_t mem_w, uint32_t mem_size, unsigned char *model_data_o, unsigned char *model_be_o, unsigned char *mem, dirty_pages *dirty){
     if (req_valid) {
-        for (int i = 0; i < mem_w / 8; i++) {
-            if ((model_be_o[i/8] & (1<<(i%8)))) {
-                mem[address+i] = model_data_o[i];
-            }
-            
+        if (address >= mem_size || mem_w / 8 > mem_size - address) {
+            fprintf(stderr, "ERROR: memory write at 0x%08x outside of memory\n", address);
+            return;
+        }
+        masked_copy(&mem[address], model_data_o, model_be_o, mem_w / 8);
+        if (dirty != NULL) {
+            dirty->mark(address, mem_w / 8);
+        }
+    }
+}
+
+void update_mem_write(uint32_t address, bool req_valid, uint32_t mem_w, uint32_t mem_size, unsigned char *model_data_o, unsigned char *model_be_o, paged_mem *mem){
+    if (req_valid) {
+        if (address >= mem_size || mem_w / 8 > mem_size - address || !mem->in_range(address, mem_w / 8)) {
+            fprintf(stderr, "ERROR: memory write at 0x%08x outside of memory\n", address);
+            return;
         }
+        mem->write_masked(address, model_data_o, model_be_o, mem_w / 8);
     }
 }
 
+/*
+*   Function to write to memory through the write interface belonging to a mem_port.  The store is charged to the port's timing model.
+*
+*   *port          - memory port of the interface
+*   address        - address of the write request being issued
+*   req_valid      - validity of the write request being issued
+*
+*   *model_data_o  - pointer to memory data write interface on verilator model
+*   *model_be_o    - pointer to byte enable write interface on verilator model
+*
+*   *mem           - pointer to memory space
+*   *dirty         - pages written.  May be NULL
+*/
+void update_mem_write(mem_port *port, uint32_t address, bool req_valid, unsigned char *model_data_o, unsigned char *model_be_o, unsigned char *mem, dirty_pages *dirty){
+    port->store(address, req_valid);
+    update_mem_write(address, req_valid, port->width_bytes() * 8, port->size(), model_data_o, model_be_o, mem, dirty);
+}
+
+void update_mem_write(mem_port *port, uint32_t address, bool req_valid, unsigned char *model_data_o, unsigned char *model_be_o, paged_mem *mem){
+    port->store(address, req_valid);
+    update_mem_write(address, req_valid, port->width_bytes() * 8, port->size(), model_data_o, model_be_o, mem);
+}
+
 /*
 * Check for a write to memory mapped io.  Returns true and copies written data to *data_out if a valid write occurs to the selected address
 *   address        - address of the write request being issued
@@ -184,42 +432,50 @@ bool check_memmapio(uint32_t address, bool req_valid, uint32_t mem_w, unsigned c
 *   *prog_path    - program to load into memory
 */
 unsigned char* load_program(uint32_t mem_sz, char *prog_path){
-    unsigned char *mem = (unsigned char *)malloc(mem_sz);
+    return load_program(mem_sz, prog_path, NULL);
+}
+
+/*
+*   Function to setup memory and load a program, also returning its entry point and symbol table.  Returns NULL if error
+*
+*   mem_sz        - size of main memory to allocate
+*   *prog_path    - program to load into memory
+*   *info         - entry point and symbol table of the program (ELF only).  May be NULL
+*/
+unsigned char* load_program(uint32_t mem_sz, char *prog_path, program_info *info){
+    //calloc hands out fresh zero pages for large sizes, nothing is touched until written
+    unsigned char *mem = (unsigned char *)calloc(mem_sz, 1);
     if (mem == NULL) {
         fprintf(stderr, "ERROR: allocating %d bytes of memory: %s\n", mem_sz, strerror(errno));
         return NULL;
     }
 
-    FILE *ftmp = fopen(prog_path, "r");
-    if (ftmp == NULL) {
-        fprintf(stderr, "ERROR: invalid program path `%s': %s\n", prog_path, strerror(errno));
-        return NULL;
-    }
-    memset(mem, 0, mem_sz);
-    char buf[256];
-    int addr = 0;
-    while (fgets(buf, sizeof(buf), ftmp) != NULL) {
-        if (buf[0] == '#' || buf[0] == '/')
-            continue;
-        char *ptr = buf;
-        if (buf[0] == '@') {
-            addr = strtol(ptr + 1, &ptr, 16) * 4;
-            while (*ptr == ' ')
-                ptr++;
-        }
-        while (*ptr != '\n' && *ptr != 0) {
-            int data = strtol(ptr, &ptr, 16);
-            int i;
-            for (i = 0; i < 4; i++)
-                mem[addr+i] = data >> (8*i);
-            addr += 4;
-            while (*ptr == ' ')
-                ptr++;
+    auto write = [mem, mem_sz](uint32_t address, const unsigned char *data, uint32_t len) {
+        if (address >= mem_sz || len > mem_sz - address) {
+            fprintf(stderr, "ERROR: program data at 0x%08x-0x%08x outside of memory (%d bytes)\n", address, address + len, mem_sz);
+            return false;
         }
+        memcpy(&mem[address], data, len);
+        return true;
+    };
+    if (!load_image(prog_path, write, info)) {
+        free(mem);
+        return NULL;
     }
-    fclose(ftmp);
     return mem;
 }
+
+/*
+*   Function to load a program into a paged memory.  Returns false if error
+*
+*   *mem          - memory to load the program into
+*   *prog_path    - program to load into memory
+*   *info         - entry point and symbol table of the program (ELF only).  May be NULL
+*/
+bool load_program(paged_mem *mem, char *prog_path, program_info *info){
+    return load_image(mem, prog_path, info);
+}
+
 /*
 *   Function to dump a region of memory into a file.
 *
@@ -246,11 +502,238 @@ void dump_mem_region (uint32_t start_addr, uint32_t end_addr, unsigned char *mem
     return;
 }
 
+void dump_mem_region (uint32_t start_addr, uint32_t end_addr, paged_mem *mem, char *dump_path){
+
+    FILE *ftmp = fopen(dump_path, "w");
+    if (ftmp == NULL) {
+        fprintf(stderr, "ERROR: opening `%s': %s\n", dump_path, strerror(errno));
+        return;
+    }
+    for (uint32_t addr = start_addr; addr < end_addr; addr += 4) {
+        fprintf(ftmp, "%08x\n", mem->read32(addr));
+    }
+    fclose(ftmp);
+    return;
+}
+
+/*
+*   Write one frame of a binary memory dump holding the dirty pages of [lo, hi).  data writes the contents of one range to the file.
+*/
+static bool write_mem_dump(const char *dump_path, bool append, uint64_t cycle, const dirty_pages &dirty, uint32_t lo, uint64_t hi,
+                           const std::function<bool(uint32_t address, uint32_t len, FILE *out)> &data){
+    std::vector<mem_dump_range> index;
+    dirty.for_each_range(lo, hi, [&index](uint32_t address, uint32_t len) {
+        index.push_back({address, len, 0});
+    });
+    mem_dump_header hdr = {MEM_DUMP_MAGIC, MEM_DUMP_VERSION, (uint32_t)index.size(), 0, cycle, 0};
+    uint64_t offset = sizeof(hdr) + index.size() * sizeof(mem_dump_range);
+    for (mem_dump_range &r : index) {
+        r.offset         = offset;
+        offset          += r.len;
+        hdr.data_bytes  += r.len;
+    }
+
+    FILE *out = fopen(dump_path, append ? "ab" : "wb");
+    if (out == NULL) {
+        fprintf(stderr, "ERROR: opening `%s': %s\n", dump_path, strerror(errno));
+        return false;
+    }
+    bool ok = fwrite(&hdr, sizeof(hdr), 1, out) == 1;
+    if (ok && !index.empty()) {
+        ok = fwrite(index.data(), sizeof(mem_dump_range), index.size(), out) == index.size();
+    }
+    for (size_t i = 0; ok && i < index.size(); i++) {
+        ok = data(index[i].address, index[i].len, out);
+    }
+    if (fclose(out) != 0) {
+        ok = false;
+    }
+    if (!ok) {
+        fprintf(stderr, "ERROR: writing `%s': %s\n", dump_path, strerror(errno));
+    }
+    return ok;
+}
+
+/*
+*   Function to dump the pages of a region written since the last dump into a binary memory dump.  Returns false if error
+*
+*   start_addr        - start address of memory region
+*   end_addr          - end address of memory region, 0 for the end of memory
+*
+*   *mem              - pointer to main memory
+*   mem_sz            - size of main memory, the region is clipped to it
+*   *dirty            - pages written into the flat array
+*
+*   *dump_path        - file path to output file
+*   cycle             - cycle recorded in the frame
+*   append            - append a frame instead of replacing the file
+*/
+bool dump_mem_dirty(uint32_t start_addr, uint32_t end_addr, unsigned char *mem, uint32_t mem_sz, dirty_pages *dirty, const char *dump_path, uint64_t cycle, bool append){
+    //the last dirty page may extend past the end of the array
+    uint64_t hi = (end_addr == 0) ? mem_sz : std::min(end_addr, mem_sz);
+    auto data = [mem](uint32_t address, uint32_t len, FILE *out) {
+        return fwrite(&mem[address], 1, len, out) == len;
+    };
+    if (!write_mem_dump(dump_path, append, cycle, *dirty, start_addr, hi, data)) {
+        return false;
+    }
+    dirty->clear(start_addr, hi);
+    return true;
+}
+
+bool dump_mem_dirty(uint32_t start_addr, uint32_t end_addr, paged_mem *mem, const char *dump_path, uint64_t cycle, bool append){
+    uint64_t hi = (end_addr == 0) ? mem->size() : std::min<uint64_t>(end_addr, mem->size());
+    //written straight from the pages, nothing is copied
+    auto data = [mem](uint32_t address, uint32_t len, FILE *out) {
+        while (len > 0) {
+            uint32_t off = address & (paged_mem::PAGE_SIZE - 1);
+            uint32_t n   = std::min(len, paged_mem::PAGE_SIZE - off);
+            if (fwrite(mem->page_rd(address) + off, 1, n, out) != n) {
+                return false;
+            }
+            address += n;
+            len     -= n;
+        }
+        return true;
+    };
+    if (!write_mem_dump(dump_path, append, cycle, mem->dirty(), start_addr, hi, data)) {
+        return false;
+    }
+    mem->clear_dirty(start_addr, hi);
+    return true;
+}
+
+/*
+*   Compare [start_addr, end_addr) against the ranges of the expected image.  page(address) returns the memory contents at address,
+*   valid up to the end of its page or mem_size.  Equal chunks cost one memcmp(), only differing chunks are compared word by word.
+*/
+template <typename PAGE>
+static int compare_mem(uint32_t start_addr, uint32_t end_addr, uint64_t mem_size, const mem_image *expected, FILE *report, PAGE page){
+    const uint32_t page_mask = paged_mem::PAGE_SIZE - 1;
+    auto word = [](const unsigned char *p) { return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24); };
+    int      mismatches = 0;
+    uint64_t last_word  = ~0ull;
+    for (const mem_range &r : expected->ranges) {
+        uint64_t lo = std::max<uint64_t>(r.lo, start_addr);
+        uint64_t hi = std::min<uint64_t>(r.hi, end_addr);
+        if (hi > mem_size && lo < hi) {
+            fprintf(stderr, "ERROR: expected image at 0x%08llx-0x%08llx outside of memory (%llu bytes)\n", (unsigned long long)lo,
+                    (unsigned long long)hi, (unsigned long long)mem_size);
+            return -1;
+        }
+        for (uint64_t a = lo; a < hi; ) {
+            uint32_t off  = a & page_mask;
+            uint32_t n    = (uint32_t)std::min<uint64_t>(paged_mem::PAGE_SIZE - off, hi - a);
+            const unsigned char *got  = page((uint32_t)a);
+            const unsigned char *want = expected->mem.page_rd((uint32_t)a) + off;
+            if (memcmp(got, want, n) != 0) {
+                for (uint32_t i = 0; i < n; i++) {
+                    uint32_t w = (uint32_t)(a + i) & ~3u;
+                    if (got[i] == want[i] || w == last_word) {
+                        continue;
+                    }
+                    last_word = w;
+                    if (report != NULL && mismatches < 8) {
+                        fprintf(report, "MISMATCH at 0x%08x: expected %08x, got %08x\n", w,
+                                word(expected->mem.page_rd(w) + (w & page_mask)), word(page(w)));
+                    }
+                    mismatches++;
+                }
+            }
+            a += n;
+        }
+    }
+    return mismatches;
+}
+
+/*
+*   Function to compare a region of memory against an expected image.  Returns the number of differing 32-bit words, -1 if error
+*
+*   start_addr        - start address of memory region
+*   end_addr          - end address of memory region
+*
+*   *mem              - pointer to main memory
+*   mem_sz            - size of main memory
+*
+*   *expected_path    - expected image (or *expected - loaded image)
+*   *report           - output for the differing words, may be NULL
+*/
+int compare_mem_region(uint32_t start_addr, uint32_t end_addr, unsigned char *mem, uint32_t mem_sz, const char *expected_path, FILE *report){
+    mem_image expected;
+    if (!load_mem_image(&expected, expected_path, start_addr)) {
+        return -1;
+    }
+    return compare_mem_region(start_addr, end_addr, mem, mem_sz, &expected, report);
+}
+
+int compare_mem_region(uint32_t start_addr, uint32_t end_addr, paged_mem *mem, const char *expected_path, FILE *report){
+    mem_image expected;
+    if (!load_mem_image(&expected, expected_path, start_addr)) {
+        return -1;
+    }
+    return compare_mem_region(start_addr, end_addr, mem, &expected, report);
+}
+
+int compare_mem_region(uint32_t start_addr, uint32_t end_addr, unsigned char *mem, uint32_t mem_sz, const mem_image *expected, FILE *report){
+    return compare_mem(start_addr, end_addr, mem_sz, expected, report, [mem](uint32_t address) { return (const unsigned char *)&mem[address]; });
+}
+
+int compare_mem_region(uint32_t start_addr, uint32_t end_addr, paged_mem *mem, const mem_image *expected, FILE *report){
+    return compare_mem(start_addr, end_addr, mem->size(), expected, report, [mem](uint32_t address) {
+        return mem->page_rd(address) + (address & (paged_mem::PAGE_SIZE - 1));
+    });
+}
+
+/*
+* Append an incremental memory dump frame if the interval has elapsed.  Returns true in the cycles a frame was written.
+*   - *top          - pointer to verilator top module
+*   - *trig         - interval and region
+*   - *path         - dump file
+*   - *mem          - pointer to main memory
+*   - mem_sz        - size of main memory
+*   - *dirty        - pages written into the flat array
+*/
+bool update_mem_dump(Vvproc_top *top, mem_dump_trigger *trig, const char *path, unsigned char *mem, uint32_t mem_sz, dirty_pages *dirty){
+    default_ctx.top = top;
+    return update_mem_dump(&default_ctx, trig, path, mem, mem_sz, dirty);
+}
+
+bool update_mem_dump(sim_context *ctx, mem_dump_trigger *trig, const char *path, unsigned char *mem, uint32_t mem_sz, dirty_pages *dirty){
+    if (trig->interval <= 0 || ctx->cycles % trig->interval != 0) {
+        return false;
+    }
+    if (!dump_mem_dirty(trig->start_addr, trig->end_addr, mem, mem_sz, dirty, path, ctx->cycles, trig->frames > 0)) {
+        return false;
+    }
+    trig->frames++;
+    return true;
+}
+
+bool update_mem_dump(Vvproc_top *top, mem_dump_trigger *trig, const char *path, paged_mem *mem){
+    default_ctx.top = top;
+    return update_mem_dump(&default_ctx, trig, path, mem);
+}
+
+bool update_mem_dump(sim_context *ctx, mem_dump_trigger *trig, const char *path, paged_mem *mem){
+    if (trig->interval <= 0 || ctx->cycles % trig->interval != 0) {
+        return false;
+    }
+    if (!dump_mem_dirty(trig->start_addr, trig->end_addr, mem, path, ctx->cycles, trig->frames > 0)) {
+        return false;
+    }
+    trig->frames++;
+    return true;
+}
+
 /*
 *   Cycle count update
 */
 void update_cycles(){
-    cycles++;
+    update_cycles(&default_ctx);
+}
+
+void update_cycles(sim_context *ctx){
+    ctx->cycles++;
     return;
 }
 
@@ -260,11 +743,17 @@ void update_cycles(){
 *   - *top          - pointer to verilator top module
 */
 void update_instructions(Vvproc_top *top){
-    current_WB_PC = top->vproc_top->core->instruction_wb_pc;
-    if (current_WB_PC != last_WB_PC) {
-        instr++;
+    default_ctx.top = top;
+    update_instructions(&default_ctx);
+}
+
+void update_instructions(sim_context *ctx){
+    ctx->current_WB_PC = ctx->top->vproc_top->core->instruction_wb_pc;
+    ctx->retired       = ctx->current_WB_PC != ctx->last_WB_PC;
+    if (ctx->retired) {
+        ctx->instr++;
     }
-    last_WB_PC = current_WB_PC;
+    ctx->last_WB_PC = ctx->current_WB_PC;
     return;
 }
 
@@ -274,8 +763,13 @@ void update_instructions(Vvproc_top *top){
 *   - *top          - pointer to verilator top module
 */
 void update_vector_count(Vvproc_top *top){
-    if( top->vproc_top->vcore_result_valid && top->vproc_top->vcore_result_ready){
-        vector_instr++;
+    default_ctx.top = top;
+    update_vector_count(&default_ctx);
+}
+
+void update_vector_count(sim_context *ctx){
+    if( ctx->top->vproc_top->vcore_result_valid && ctx->top->vproc_top->vcore_result_ready){
+        ctx->vector_instr++;
     }
     return;
 }
@@ -286,96 +780,887 @@ void update_vector_count(Vvproc_top *top){
 *   - *top          - pointer to verilator top module
 */
 void update_avg_vector_len(Vvproc_top *top){
-     if( top->vproc_top->vcore_result_valid && top->vproc_top->vcore_result_ready){
-        sum_vec_lengths+= top->vproc_top->csr_vl_o; //running sum of number of elements in vectors
-        int cur_vec_len_bytes = 0;
-        switch ((top->vproc_top->csr_vtype_o >> 3) & 7) //sew stored in bits [5:3]
-        { 
-            case 0: //sew == 8
-            sum_vec_lengths_bytes+= top->vproc_top->csr_vl_o; //each element is one byte
-            cur_vec_len_bytes = top->vproc_top->csr_vl_o;
-            break;
-            case 1: //sew == 16
-            sum_vec_lengths_bytes+= top->vproc_top->csr_vl_o * 2; // each element two bytes
-            cur_vec_len_bytes = top->vproc_top->csr_vl_o * 2;
-            break;
-            case 2: //sew == 32
-            sum_vec_lengths_bytes+= top->vproc_top->csr_vl_o * 4; // each element four bytes
-            cur_vec_len_bytes = top->vproc_top->csr_vl_o * 4;
-            break;
-            default:
-            fprintf(stderr, "UNSUPPORTED SEW DETECTED\n");
-        }
-        
-        switch (top->vproc_top->csr_vtype_o & 7) //LMUL stored in bits [2:0]
-        { 
-            case 0: //LMUL = 1
-                sum_vec_lengths_bytes+= ((float)cur_vec_len_bytes)/((float)top->vproc_top->csr_vlen_b_o); //each element is one byte
-
-            case 1: //LMUL == 2
-                sum_vec_percentage += ((float)cur_vec_len_bytes)/((float)top->vproc_top->csr_vlen_b_o * 2); // 2 vector regs in group
-            break;
-            case 2: //LMUL == 4
-                sum_vec_lengths_bytes+= ((float)cur_vec_len_bytes)/((float)top->vproc_top->csr_vlen_b_o * 4); // 4 vector regs in group
-            break;
-            case 4: //LMUL == 8
-                sum_vec_lengths_bytes+= ((float)cur_vec_len_bytes)/((float)top->vproc_top->csr_vlen_b_o * 8); // 4 vector regs in group
-            break;
-            case 7: //LMUL = 1/2
-                sum_vec_lengths_bytes+= ((float)cur_vec_len_bytes)/((float)top->vproc_top->csr_vlen_b_o/2.0); //each element is one byte
-            case 6: //LMUL = 1/4
-                sum_vec_lengths_bytes+= ((float)cur_vec_len_bytes)/((float)top->vproc_top->csr_vlen_b_o/4.0); //each element is one byte
-            case 5: //LMUL = 1/8
-                sum_vec_lengths_bytes+= ((float)cur_vec_len_bytes)/((float)top->vproc_top->csr_vlen_b_o/8.0); //each element is one byte
-            default:
-                sum_vec_lengths_bytes+= ((float)cur_vec_len_bytes)/((float)top->vproc_top->csr_vlen_b_o); //each element is one byte
-            break;
+    default_ctx.top = top;
+    update_avg_vector_len(&default_ctx);
+}
+
+void update_avg_vector_len(sim_context *ctx){
+    if( ctx->top->vproc_top->vcore_result_valid && ctx->top->vproc_top->vcore_result_ready){
+        uint32_t vl    = ctx->top->vproc_top->csr_vl_o;
+        uint32_t vtype = ctx->top->vproc_top->csr_vtype_o;
+        uint32_t vlenb = ctx->top->vproc_top->csr_vlen_b_o;
+        uint32_t sew   = (vtype >> 3) & 3;  //sew stored in bits [4:3]
+        uint32_t lmul  = vtype & 7;         //LMUL stored in bits [2:0]
+        if ((vtype >> 31) || sew == 3 || lmul == 4) {
+            //invalid configuration, vl is 0 (counted as such by update_vector_hist())
+            return;
         }
+        uint64_t vec_len_bytes = (uint64_t)vl << sew;
+        ctx->sum_vec_lengths       += vl; //running sum of number of elements in vectors
+        ctx->sum_vec_lengths_bytes += vec_len_bytes;
+        //share of the register group used: LMUL = 2^lmul for lmul < 4, 1/2^(8-lmul) for the fractional encodings
+        double group_bytes = (lmul < 4) ? (double)vlenb * (1 << lmul) : (double)vlenb / (1 << (8 - lmul));
+        ctx->sum_vec_percentage += vec_len_bytes / group_bytes;
     }
     return;
 }
 
 /*
-* Top level function to update all statistics
+* Vector configuration histogram update.
 * ARGS:
 *   - *top          - pointer to verilator top module
 */
-void update_stats(Vvproc_top *top){
-    update_cycles();
-    update_instructions(top);
-    update_vector_count(top);
-    update_avg_vector_len(top);
+void update_vector_hist(Vvproc_top *top){
+    default_ctx.top = top;
+    update_vector_hist(&default_ctx);
 }
 
-/*
-* Report current state of all collected statistics
-*/
-void report_stats(){
-    fprintf(stderr, "Total Cycles: %d\n", cycles);
-    fprintf(stderr, "Instruction Count: %d CPI : %f \n\n", instr, ((float)(cycles))/((float)instr));
-    
-    fprintf(stderr, "Number of Vector Instructions Executed: %d  \n", vector_instr);
-    fprintf(stderr, "AVG VL Elements: %f  \n", ((float)(sum_vec_lengths))/((float)vector_instr));
-    fprintf(stderr, "AVG VL Bytes: %f  \n\n", ((float)(sum_vec_lengths_bytes))/((float)vector_instr));
-    fprintf(stderr, "AVG VREG Usage %: %f  \n\n", ((float)(sum_vec_percentage))/((float)vector_instr) * 100);
-    return;
-
+static void hist_add(vector_hist &h, const vector_issue &in, uint64_t count, uint64_t cycles){
+    if (h.vl.size() <= in.vl) {
+        h.vl.resize(in.vl + 1);
+    }
+    hist_bin *bins[4] = {&h.vl[in.vl], &h.sew[in.sew], &h.lmul[in.lmul], &h.occupancy[in.occupancy]};
+    for (hist_bin *b : bins) {
+        b->count  += count;
+        b->cycles += cycles;
+    }
+}
+
+void update_vector_hist(sim_context *ctx){
+    #ifdef RISCV_ZVE32X
+    auto *v_core = ctx->top->vproc_top->v_core;
+    if (v_core->dec_issue_valid && v_core->dec_issue_unit < VPROC_UNIT_CNT - 1) {
+        //the CSR outputs hold the configuration the instruction executes with, vset[i]vl[i] only changes them after it left the decoder
+        uint32_t vtype = ctx->top->vproc_top->csr_vtype_o;
+        uint32_t vlenb = ctx->top->vproc_top->csr_vlen_b_o;
+        vector_issue in;
+        in.valid = true;
+        in.unit  = v_core->dec_issue_unit;
+        in.vl    = ctx->top->vproc_top->csr_vl_o;
+        in.sew   = (vtype >> 3) & 3;
+        in.lmul  = vtype & 7;
+        in.cycle = ctx->cycles;
+        if (vtype >> 31) {
+            //vill set, count as invalid SEW and LMUL
+            in.sew  = 3;
+            in.lmul = 4;
+        }
+        in.occupancy = 0;
+        if (in.sew != 3 && in.lmul != 4) {
+            //VLMAX = VLENB * LMUL / (SEW / 8)
+            uint64_t vlmax = (in.lmul < 4) ? ((uint64_t)vlenb << in.lmul) >> in.sew : ((uint64_t)vlenb >> (8 - in.lmul)) >> in.sew;
+            uint64_t occ   = vlmax ? (uint64_t)in.vl * 10 / vlmax : 0;
+            in.occupancy   = occ > 10 ? 10 : occ;
+        }
+        hist_add(ctx->vec_hist[in.unit], in, 1, 0);
+        uint32_t id = v_core->dec_issue_id;
+        if (ctx->vec_in_flight.size() <= id) {
+            ctx->vec_in_flight.resize(id + 1);
+        }
+        ctx->vec_in_flight[id] = in;
+    }
+    size_t n_pipes = sizeof(v_core->instr_done_valid) / sizeof(v_core->instr_done_valid[0]);
+    for (size_t i = 0; i < n_pipes; i++) {
+        uint32_t id = v_core->instr_done_id[i];
+        if (!v_core->instr_done_valid[i] || id >= ctx->vec_in_flight.size() || !ctx->vec_in_flight[id].valid) {
+            continue;
+        }
+        vector_issue &in = ctx->vec_in_flight[id];
+        hist_add(ctx->vec_hist[in.unit], in, 0, ctx->cycles - in.cycle + 1);
+        in.valid = false;
+    }
+    #endif
+    return;
+}
+
+static const char *const vec_sew_names[4]  = {"8", "16", "32", "inv"};
+static const char *const vec_lmul_names[8] = {"1", "2", "4", "8", "inv", "1/8", "1/4", "1/2"};
+static const char *const vec_occ_names[11] = {"0-10%", "10-20%", "20-30%", "30-40%", "40-50%", "50-60%", "60-70%", "70-80%", "80-90%", "90-100%", "100%"};
+
+/*
+* Write the vector configuration histograms as CSV.  Returns false if error
+* ARGS:
+*   - *path         - output file
+*/
+bool write_vector_hist(const char *path){
+    return write_vector_hist(&default_ctx, path);
+}
+
+bool write_vector_hist(sim_context *ctx, const char *path){
+    FILE *out = fopen(path, "w");
+    if (out == NULL) {
+        fprintf(stderr, "ERROR: opening `%s': %s\n", path, strerror(errno));
+        return false;
+    }
+    fprintf(out, "unit,histogram,bin,instructions,cycles\n");
+    for (int u = 0; u < VPROC_UNIT_CNT - 1; u++) {
+        const vector_hist &h = ctx->vec_hist[u];
+        auto row = [&](const char *kind, const char *bin, const hist_bin &b) {
+            if (b.count != 0 || b.cycles != 0) {
+                fprintf(out, "%s,%s,%s,%llu,%llu\n", vproc_unit_names[u], kind, bin, (unsigned long long)b.count, (unsigned long long)b.cycles);
+            }
+        };
+        for (size_t i = 0; i < h.vl.size(); i++) {
+            row("vl", std::to_string(i).c_str(), h.vl[i]);
+        }
+        for (int i = 0; i < 4; i++) {
+            row("sew", vec_sew_names[i], h.sew[i]);
+        }
+        for (int i = 0; i < 8; i++) {
+            row("lmul", vec_lmul_names[i], h.lmul[i]);
+        }
+        for (int i = 0; i < 11; i++) {
+            row("occupancy", vec_occ_names[i], h.occupancy[i]);
+        }
+    }
+    fclose(out);
+    return true;
+}
+
+/*
+* Vector pipeline and unit utilization update.
+* ARGS:
+*   - *top          - pointer to verilator top module
+*/
+void update_unit_stats(Vvproc_top *top){
+    default_ctx.top = top;
+    update_unit_stats(&default_ctx);
+}
+
+void update_unit_stats(sim_context *ctx){
+    #ifdef RISCV_ZVE32X
+    auto *v_core = ctx->top->vproc_top->v_core;
+    //the number of pipelines is a parameter of the configuration, take it from the size of the per-pipeline signal arrays
+    size_t n_pipes = sizeof(v_core->pipe_units) / sizeof(v_core->pipe_units[0]);
+    if (ctx->pipes.size() != n_pipes) {
+        ctx->pipes.assign(n_pipes, pipe_stats());
+    }
+    ctx->unit_cycles++;
+    for (size_t i = 0; i < n_pipes; i++) {
+        pipe_stats &pipe  = ctx->pipes[i];
+        uint32_t    busy  = v_core->pipe_unit_busy[i];
+        uint32_t    stall = v_core->pipe_unit_stall[i];
+        pipe.units = v_core->pipe_units[i];
+        if (busy) {
+            pipe.busy++;
+        } else if (stall) {
+            pipe.stall++;
+        }
+        for (; busy; busy &= busy - 1) {
+            pipe.unit_busy[__builtin_ctz(busy)]++;
+        }
+        for (; stall; stall &= stall - 1) {
+            pipe.unit_stall[__builtin_ctz(stall)]++;
+        }
+        if ((v_core->pipe_instr_valid >> i) & 1) {
+            if ((v_core->pipe_instr_ready >> i) & 1) {
+                pipe.dispatched++;
+            } else {
+                pipe.dispatch_stall++;
+            }
+        }
+    }
+    #endif
+    return;
+}
+
+/*
+* Dispatch stall attribution update.
+* ARGS:
+*   - *top          - pointer to verilator top module
+*/
+void update_dispatch_stats(Vvproc_top *top){
+    default_ctx.top = top;
+    update_dispatch_stats(&default_ctx);
+}
+
+//vector loads/stores are LOAD-FP/STORE-FP with a vector width, all other vector instructions are OP-V
+static bool is_vector_instr(uint32_t instr){
+    uint32_t opcode = instr & 0x7f;
+    uint32_t width  = (instr >> 12) & 7;
+    return opcode == 0x57 || ((opcode == 0x07 || opcode == 0x27) && (width == 0 || width >= 5));
+}
+
+static stall_instr &stall_slot(dispatch_stats &ds, uint32_t id){
+    if (ds.in_flight.size() <= id) {
+        ds.in_flight.resize(id + 1);
+    }
+    return ds.in_flight[id];
+}
+
+static void stall_add(stall_counts &to, const stall_counts &from){
+    for (int i = 0; i < VPROC_DISPATCH_CNT; i++) {
+        to.dispatch[i] += from.dispatch[i];
+    }
+    for (int i = 0; i < VPROC_OFFLOAD_CNT; i++) {
+        to.offload[i] += from.offload[i];
+    }
+}
+
+void update_dispatch_stats(sim_context *ctx){
+    #ifdef RISCV_ZVE32X
+    auto *v_core = ctx->top->vproc_top->v_core;
+    auto *core   = ctx->top->vproc_top->core;
+    dispatch_stats &ds = ctx->disp;
+    ds.cycles++;
+
+    uint32_t if_pc = core->pc_if;
+    if (if_pc != ds.window_pc) {
+        memset(ds.window, 0, sizeof(ds.window));
+        ds.window_pc = if_pc;
+    }
+
+    //refused offloads are charged to the instruction accepted next, which is the one that was offered
+    uint32_t offload = v_core->offload_stall_cause < VPROC_OFFLOAD_CNT ? v_core->offload_stall_cause : 0;
+    ds.offload[offload]++;
+    if (offload != 0) {
+        ds.refused[offload]++;
+    }
+    if (v_core->dec_issue_valid) {
+        uint8_t id = v_core->dec_issue_id;
+        //an ID is only reused once its instruction completed, which also retired it unless the retirement was missed
+        ds.unretired.erase(std::remove(ds.unretired.begin(), ds.unretired.end(), id), ds.unretired.end());
+        ds.unretired.push_back(id);
+        stall_instr &in = stall_slot(ds, id);
+        in = stall_instr();
+        memcpy(in.stalls.offload, ds.refused, sizeof(ds.refused));
+        memset(ds.refused, 0, sizeof(ds.refused));
+    }
+
+    //the waiting causes are charged to the instruction at the head of the queue
+    uint32_t cause = v_core->dispatch_stall_cause < VPROC_DISPATCH_CNT ? v_core->dispatch_stall_cause : VPROC_DISPATCH_CNT - 1;
+    ds.dispatch[cause]++;
+    ds.window[cause]++;
+    if (cause >= VPROC_DISPATCH_WAIT) {
+        stall_instr &in = stall_slot(ds, v_core->dispatch_stall_id);
+        if (in.pc_valid) {
+            ds.by_pc[in.pc].dispatch[cause]++;
+        } else {
+            in.stalls.dispatch[cause]++;
+        }
+    }
+
+    //killed instructions are not retired, their stall cycles stay unattributed
+    if (v_core->xif_commit_valid && v_core->xif_commit_kill) {
+        uint8_t id = v_core->xif_commit_id;
+        ds.unretired.erase(std::remove(ds.unretired.begin(), ds.unretired.end(), id), ds.unretired.end());
+    }
+
+    //vector instructions retire in the order they were accepted, the oldest unretired one is the one entering write-back
+    uint32_t wb_pc = core->instruction_wb_pc;
+    if (wb_pc != ds.wb_pc) {
+        ds.wb_pc = wb_pc;
+        if (is_vector_instr(core->instruction_wb) && !ds.unretired.empty()) {
+            stall_instr &in = stall_slot(ds, ds.unretired.front());
+            ds.unretired.erase(ds.unretired.begin());
+            in.pc_valid = true;
+            in.pc       = wb_pc;
+            stall_add(ds.by_pc[wb_pc], in.stalls);
+            in.stalls = stall_counts();
+        }
+    }
+    #endif
+    return;
+}
+
+//PCs with stall cycles, most stalled first
+static std::vector<std::pair<uint32_t, uint64_t>> stalled_pcs(const dispatch_stats &ds){
+    std::vector<std::pair<uint32_t, uint64_t>> pcs;
+    for (const auto &e : ds.by_pc) {
+        uint64_t total = e.second.total();
+        if (total != 0) {
+            pcs.emplace_back(e.first, total);
+        }
+    }
+    std::sort(pcs.begin(), pcs.end(), [](const std::pair<uint32_t, uint64_t> &a, const std::pair<uint32_t, uint64_t> &b) {
+        return a.second != b.second ? a.second > b.second : a.first < b.first;
+    });
+    return pcs;
+}
+
+/*
+* Write the stall cycles per PC as CSV.  Returns false if error
+* ARGS:
+*   - *path         - output file
+*/
+bool write_dispatch_stalls(const char *path){
+    return write_dispatch_stalls(&default_ctx, path);
+}
+
+bool write_dispatch_stalls(sim_context *ctx, const char *path){
+    FILE *out = fopen(path, "w");
+    if (out == NULL) {
+        fprintf(stderr, "ERROR: opening `%s': %s\n", path, strerror(errno));
+        return false;
+    }
+    fprintf(out, "pc");
+    for (int i = VPROC_DISPATCH_WAIT; i < VPROC_DISPATCH_CNT; i++) {
+        fprintf(out, ",%s", vproc_dispatch_names[i]);
+    }
+    for (int i = 1; i < VPROC_OFFLOAD_CNT; i++) {
+        fprintf(out, ",%s", vproc_offload_names[i]);
+    }
+    fprintf(out, ",total\n");
+    for (const auto &e : stalled_pcs(ctx->disp)) {
+        const stall_counts &c = ctx->disp.by_pc.at(e.first);
+        fprintf(out, "0x%08x", e.first);
+        for (int i = VPROC_DISPATCH_WAIT; i < VPROC_DISPATCH_CNT; i++) {
+            fprintf(out, ",%llu", (unsigned long long)c.dispatch[i]);
+        }
+        for (int i = 1; i < VPROC_OFFLOAD_CNT; i++) {
+            fprintf(out, ",%llu", (unsigned long long)c.offload[i]);
+        }
+        fprintf(out, ",%llu\n", (unsigned long long)e.second);
+    }
+    fclose(out);
+    return true;
+}
+
+/*
+* Offload latency update.
+* ARGS:
+*   - *top          - pointer to verilator top module
+*/
+void update_offload_latency(Vvproc_top *top){
+    default_ctx.top = top;
+    update_offload_latency(&default_ctx);
+}
+
+static size_t latency_bin(uint64_t cycles){
+    return cycles < 64 ? cycles : 64 + (63 - __builtin_clzll(cycles)) - 6;
+}
+
+static uint64_t latency_bin_lo(size_t bin){
+    return bin < 64 ? bin : 1ull << (bin - 64 + 6);
+}
+
+static void latency_add(latency_hist &h, uint64_t cycles){
+    size_t bin = latency_bin(cycles);
+    if (h.bins.size() <= bin) {
+        h.bins.resize(bin + 1);
+    }
+    h.bins[bin]++;
+    h.count++;
+    h.sum += cycles;
+    h.max  = std::max(h.max, cycles);
+}
+
+static void latency_merge(latency_hist &to, const latency_hist &from){
+    if (to.bins.size() < from.bins.size()) {
+        to.bins.resize(from.bins.size());
+    }
+    for (size_t i = 0; i < from.bins.size(); i++) {
+        to.bins[i] += from.bins[i];
+    }
+    to.count += from.count;
+    to.sum   += from.sum;
+    to.max    = std::max(to.max, from.max);
+}
+
+//lowest latency of the bin holding the given fraction of the instructions
+static uint64_t latency_percentile(const latency_hist &h, double p){
+    uint64_t need = (uint64_t)(h.count * p + 0.5), seen = 0;
+    for (size_t i = 0; i < h.bins.size(); i++) {
+        seen += h.bins[i];
+        if (seen >= need && seen != 0) {
+            return latency_bin_lo(i);
+        }
+    }
+    return h.max;
+}
+
+static offload_instr &offload_slot(offload_stats &os, uint32_t id){
+    if (os.in_flight.size() <= id) {
+        os.in_flight.resize(id + 1);
+    }
+    return os.in_flight[id];
+}
+
+//bin the latencies once the instruction has returned its result and, unless it is a configuration instruction, completed
+static void offload_finish(offload_stats &os, offload_instr &in){
+    bool cfg = in.unit == VPROC_UNIT_CNT - 1;
+    if (!in.valid || !in.resulted || !(cfg || in.done)) {
+        return;
+    }
+    int64_t lat[LAT_CNT];
+    lat[LAT_OFFLOAD] = in.refused;
+    lat[LAT_DECODE]  = in.enqueued   ? in.enqueue - in.issue      : -1;
+    lat[LAT_QUEUE]   = in.dispatched ? in.dispatch - in.enqueue   : -1;
+    lat[LAT_EXECUTE] = in.done       ? in.complete - in.dispatch  : -1;
+    lat[LAT_COMMIT]  = in.committed  ? in.commit - in.issue       : -1;
+    lat[LAT_RESULT]  = in.result - in.issue;
+    lat[LAT_TOTAL]   = std::max(in.result, in.done ? in.complete : in.result) - in.issue;
+    if (cfg) {
+        lat[LAT_DECODE] = lat[LAT_QUEUE] = lat[LAT_EXECUTE] = -1;
+    }
+    for (int c = 0; c < LAT_CNT; c++) {
+        if (lat[c] < 0) {
+            continue;
+        }
+        latency_add(os.by_unit[in.unit][c], lat[c]);
+        if (!cfg) {
+            latency_add(os.by_sew [in.sew ][c], lat[c]);
+            latency_add(os.by_lmul[in.lmul][c], lat[c]);
+        }
+    }
+    os.instructions++;
+    in.valid = false;
+}
+
+void update_offload_latency(sim_context *ctx){
+    #ifdef RISCV_ZVE32X
+    auto *v_core = ctx->top->vproc_top->v_core;
+    offload_stats &os = ctx->lat;
+    int now = ctx->cycles;
+
+    //instructions waiting in the queue during this cycle, including the one dispatched and excluding the one enqueued in it
+    if (os.queue_occupancy.size() <= os.queued) {
+        os.queue_occupancy.resize(os.queued + 1);
+    }
+    os.queue_occupancy[os.queued]++;
+
+    //refused offloads are charged to the instruction accepted next, as in update_dispatch_stats()
+    if (v_core->offload_stall_cause != 0) {
+        os.refused++;
+    }
+    if (v_core->dec_issue_valid && v_core->dec_issue_unit < VPROC_UNIT_CNT) {
+        uint32_t vtype = ctx->top->vproc_top->csr_vtype_o;
+        offload_instr &in = offload_slot(os, v_core->dec_issue_id);
+        in = offload_instr();
+        in.valid   = true;
+        in.unit    = v_core->dec_issue_unit;
+        in.sew     = (vtype >> 31) ? 3 : (vtype >> 3) & 3;
+        in.lmul    = (vtype >> 31) ? 4 : vtype & 7;
+        in.refused = os.refused;
+        in.issue   = now;
+        os.refused = 0;
+    }
+    if (v_core->queue_enq_valid) {
+        os.queued++;
+        offload_instr &in = offload_slot(os, v_core->queue_enq_id);
+        in.enqueued = true;
+        in.enqueue  = now;
+    }
+    if (v_core->dispatch_stall_cause == 0) {
+        //"issued", the instruction at the head of the queue was dispatched
+        os.queued = os.queued ? os.queued - 1 : 0;
+        offload_instr &in = offload_slot(os, v_core->dispatch_stall_id);
+        in.dispatched = true;
+        in.dispatch   = now;
+    }
+    if (v_core->xif_commit_valid) {
+        offload_instr &in = offload_slot(os, v_core->xif_commit_id);
+        if (v_core->xif_commit_kill) {
+            os.killed += in.valid ? 1 : 0;
+            in.valid = false;
+        } else {
+            in.committed = true;
+            in.commit    = now;
+        }
+    }
+    size_t n_pipes = sizeof(v_core->instr_done_valid) / sizeof(v_core->instr_done_valid[0]);
+    for (size_t i = 0; i < n_pipes; i++) {
+        if (v_core->instr_done_valid[i]) {
+            offload_instr &in = offload_slot(os, v_core->instr_done_id[i]);
+            in.done     = true;
+            in.complete = now;
+            offload_finish(os, in);
+        }
+    }
+    if (v_core->xif_result_valid) {
+        offload_instr &in = offload_slot(os, v_core->xif_result_id);
+        in.resulted = true;
+        in.result   = now;
+        offload_finish(os, in);
+    }
+    #endif
+    return;
+}
+
+/*
+* Write the offload latency histograms as CSV.  Returns false if error
+* ARGS:
+*   - *path         - output file
+*/
+bool write_offload_latency(const char *path){
+    return write_offload_latency(&default_ctx, path);
+}
+
+bool write_offload_latency(sim_context *ctx, const char *path){
+    FILE *out = fopen(path, "w");
+    if (out == NULL) {
+        fprintf(stderr, "ERROR: opening `%s': %s\n", path, strerror(errno));
+        return false;
+    }
+    const offload_stats &os = ctx->lat;
+    fprintf(out, "group,key,component,bin,count\n");
+    auto rows = [&](const char *group, const char *key, const latency_hist *h) {
+        for (int c = 0; c < LAT_CNT; c++) {
+            for (size_t i = 0; i < h[c].bins.size(); i++) {
+                if (h[c].bins[i] != 0) {
+                    fprintf(out, "%s,%s,%s,%llu,%llu\n", group, key, vproc_latency_names[c], (unsigned long long)latency_bin_lo(i),
+                            (unsigned long long)h[c].bins[i]);
+                }
+            }
+        }
+    };
+    for (int u = 0; u < VPROC_UNIT_CNT; u++) {
+        rows("unit", vproc_unit_names[u], os.by_unit[u]);
+    }
+    for (int i = 0; i < 4; i++) {
+        rows("sew", vec_sew_names[i], os.by_sew[i]);
+    }
+    for (int i = 0; i < 8; i++) {
+        rows("lmul", vec_lmul_names[i], os.by_lmul[i]);
+    }
+    for (size_t i = 0; i < os.queue_occupancy.size(); i++) {
+        if (os.queue_occupancy[i] != 0) {
+            fprintf(out, "queue,occupancy,instructions,%zu,%llu\n", i, (unsigned long long)os.queue_occupancy[i]);
+        }
+    }
+    fclose(out);
+    return true;
+}
+
+/*
+* Cycle profiler update.  Charges the current cycle to the PC in the write-back stage.
+* ARGS:
+*   - *top          - pointer to verilator top module
+*   - *prof         - profiler
+*/
+void update_profile(Vvproc_top *top, pc_profile *prof){
+    prof->sample(top->vproc_top->core->instruction_wb_pc, top->vproc_top->core->instruction_wb);
+}
+
+void update_profile(sim_context *ctx, pc_profile *prof){
+    host_scope scope(ctx, HOST_PROFILE);
+    update_profile(ctx->top, prof);
+}
+
+/*
+* Basic-block vector update.
+* ARGS:
+*   - *top          - pointer to verilator top module
+*   - *bbv          - basic-block vector collector
+*/
+void update_bbv(Vvproc_top *top, bbv_profile *bbv){
+    bbv->sample(top->vproc_top->core->instruction_wb_pc, top->vproc_top->core->instruction_wb);
+}
+
+void update_bbv(sim_context *ctx, bbv_profile *bbv){
+    host_scope scope(ctx, HOST_PROFILE);
+    update_bbv(ctx->top, bbv);
+}
+
+/*
+* Switching-activity update.
+* ARGS:
+*   - *top          - pointer to verilator top module
+*   - vreg_w        - width of the vector registers
+*   - *pwr          - switching-activity counters
+*/
+void update_power(Vvproc_top *top, int vreg_w, power_counters *pwr){
+    pwr->cycle(top->vproc_top->core->instruction_wb_pc);
+    #ifdef RISCV_ZVE32X
+    auto *v_core = top->vproc_top->v_core;
+    pwr->vreg_write((unsigned char*)&(v_core->vregfile_wr_data_q), (unsigned char*)&(v_core->vregfile_wr_mask_q), v_core->vregfile_wr_en_q,
+                    vreg_w, sizeof(v_core->vregfile_wr_data_q), sizeof(v_core->vregfile_wr_mask_q));
+    pwr->vreg_read((unsigned char*)&(v_core->vregfile_rd_data), sizeof(v_core->vregfile_rd_data));
+    size_t n_pipes = sizeof(v_core->pipe_units) / sizeof(v_core->pipe_units[0]);
+    for (size_t i = 0; i < n_pipes; i++) {
+        pwr->unit_activity(v_core->pipe_width[i], v_core->pipe_unit_busy[i], v_core->pipe_unit_stall[i]);
+    }
+    #endif
+    return;
+}
+
+void update_power(sim_context *ctx, int vreg_w, power_counters *pwr){
+    host_scope scope(ctx, HOST_PROFILE);
+    update_power(ctx->top, vreg_w, pwr);
+}
+
+/*
+* Vector memory traffic update.
+* ARGS:
+*   - *top          - pointer to verilator top module
+*   - *traffic      - traffic statistics
+*/
+void update_mem_traffic(Vvproc_top *top, mem_traffic *traffic){
+    #ifdef RISCV_ZVE32X
+    auto *v_core = top->vproc_top->v_core;
+    if (v_core->lsu_issue_valid) {
+        traffic->issue(v_core->lsu_issue_id, v_core->lsu_issue_store, v_core->lsu_issue_stride, v_core->lsu_issue_misaligned);
+    }
+    if (v_core->lsu_mem_valid) {
+        traffic->beat(v_core->lsu_mem_id, v_core->lsu_mem_we, (unsigned char*)&(v_core->lsu_mem_be));
+    }
+    traffic->cycle();
+    #endif
+    return;
+}
+
+void update_mem_traffic(sim_context *ctx, mem_traffic *traffic){
+    host_scope scope(ctx, HOST_PROFILE);
+    update_mem_traffic(ctx->top, traffic);
 }
 
 /*
-* Update .vcd trace file. If end_cycles == 0, output entire trace.
+* Top level function to update all statistics
 * ARGS:
-*   - *tfp          - pointer to verilator vcd trace object
+*   - *top          - pointer to verilator top module
+*/
+void update_stats(Vvproc_top *top){
+    default_ctx.top = top;
+    update_stats(&default_ctx);
+}
+
+void update_stats(sim_context *ctx){
+    host_scope scope(ctx, HOST_STATS);
+    update_cycles(ctx);
+    update_instructions(ctx);
+    update_vector_count(ctx);
+    update_avg_vector_len(ctx);
+    update_vector_hist(ctx);
+    update_unit_stats(ctx);
+    update_dispatch_stats(ctx);
+    update_offload_latency(ctx);
+}
+
+/*
+* Report current state of all collected statistics
+*/
+void report_stats(){
+    report_stats(&default_ctx);
+}
+
+void report_stats(sim_context *ctx){
+    fprintf(stderr, "Total Cycles: %d\n", ctx->cycles);
+    fprintf(stderr, "Instruction Count: %d CPI : %f \n\n", ctx->instr, ((float)(ctx->cycles))/((float)ctx->instr));
+    
+    fprintf(stderr, "Number of Vector Instructions Executed: %d  \n", ctx->vector_instr);
+    fprintf(stderr, "AVG VL Elements: %f  \n", ((float)(ctx->sum_vec_lengths))/((float)ctx->vector_instr));
+    fprintf(stderr, "AVG VL Bytes: %f  \n\n", ((float)(ctx->sum_vec_lengths_bytes))/((float)ctx->vector_instr));
+    fprintf(stderr, "AVG VREG Usage %%: %f  \n\n", ((float)(ctx->sum_vec_percentage))/((float)ctx->vector_instr) * 100);
+
+    //vector configuration histograms, in % of the instructions / cycles in flight of each unit type
+    bool header = false;
+    for (int u = 0; u < VPROC_UNIT_CNT - 1; u++) {
+        const vector_hist &h = ctx->vec_hist[u];
+        hist_bin total;
+        for (const hist_bin &b : h.sew) {
+            total.count  += b.count;
+            total.cycles += b.cycles;
+        }
+        if (total.count == 0) {
+            continue;
+        }
+        if (!header) {
+            fprintf(stderr, "Vector Configuration Histograms (%% of instructions / %% of cycles in flight):\n");
+            header = true;
+        }
+        double pc = 100.0 / total.count;
+        double py = total.cycles ? 100.0 / total.cycles : 0.0;
+        auto bins = [&](const char *title, const hist_bin *b, const char *const *names, int n) {
+            fprintf(stderr, "  %-10s", title);
+            for (int i = 0; i < n; i++) {
+                if (b[i].count != 0) {
+                    fprintf(stderr, " %s: %.1f/%.1f", names[i], b[i].count * pc, b[i].cycles * py);
+                }
+            }
+            fprintf(stderr, "\n");
+        };
+        fprintf(stderr, "%s: %llu instructions, %llu cycles in flight\n", vproc_unit_names[u],
+                (unsigned long long)total.count, (unsigned long long)total.cycles);
+        bins("SEW", h.sew, vec_sew_names, 4);
+        bins("LMUL", h.lmul, vec_lmul_names, 8);
+        bins("OCCUPANCY", h.occupancy, vec_occ_names, 11);
+        fprintf(stderr, "  %-10s", "VL");
+        for (size_t i = 0; i < h.vl.size(); i++) {
+            if (h.vl[i].count != 0) {
+                fprintf(stderr, " %zu: %.1f/%.1f", i, h.vl[i].count * pc, h.vl[i].cycles * py);
+            }
+        }
+        fprintf(stderr, "\n");
+    }
+    if (header) {
+        fprintf(stderr, "\n");
+    }
+
+    if (!ctx->pipes.empty()) {
+        double pct = ctx->unit_cycles ? 100.0 / ctx->unit_cycles : 0.0;
+        fprintf(stderr, "Vector Pipeline Utilization (%% of %llu cycles):\n", (unsigned long long)ctx->unit_cycles);
+        fprintf(stderr, "PIPE  UNIT      BUSY    STALL     IDLE   DISPATCH  DISPATCH STALL\n");
+        for (size_t i = 0; i < ctx->pipes.size(); i++) {
+            const pipe_stats &pipe = ctx->pipes[i];
+            fprintf(stderr, "%4zu  %-6s  %6.2f   %6.2f   %6.2f     %6.2f          %6.2f\n", i, "ALL",
+                    pipe.busy * pct, pipe.stall * pct, (ctx->unit_cycles - pipe.busy - pipe.stall) * pct,
+                    pipe.dispatched * pct, pipe.dispatch_stall * pct);
+            for (int u = 0; u < VPROC_UNIT_CNT; u++) {
+                if (!((pipe.units >> u) & 1)) {
+                    continue;
+                }
+                fprintf(stderr, "      %-6s  %6.2f   %6.2f   %6.2f\n", vproc_unit_names[u],
+                        pipe.unit_busy[u] * pct, pipe.unit_stall[u] * pct,
+                        (ctx->unit_cycles - pipe.unit_busy[u] - pipe.unit_stall[u]) * pct);
+            }
+        }
+        fprintf(stderr, "\n");
+    }
+    const dispatch_stats &ds = ctx->disp;
+    if (ds.cycles != 0) {
+        double pct = 100.0 / ds.cycles;
+        fprintf(stderr, "Dispatch Stall Attribution (%% of %llu cycles):\n ", (unsigned long long)ds.cycles);
+        for (int i = 0; i < VPROC_DISPATCH_CNT; i++) {
+            fprintf(stderr, " %s %.2f", vproc_dispatch_names[i], ds.dispatch[i] * pct);
+        }
+        fprintf(stderr, "\nOffload Stalls (%% of cycles):\n ");
+        for (int i = 1; i < VPROC_OFFLOAD_CNT; i++) {
+            fprintf(stderr, " %s %.2f", vproc_offload_names[i], ds.offload[i] * pct);
+        }
+        fprintf(stderr, "\n");
+        std::vector<std::pair<uint32_t, uint64_t>> pcs = stalled_pcs(ds);
+        if (!pcs.empty()) {
+            fprintf(stderr, "Most Stalled Vector Instructions (stall cycles by cause):\n");
+        }
+        for (size_t i = 0; i < pcs.size() && i < 10; i++) {
+            const stall_counts &c = ds.by_pc.at(pcs[i].first);
+            fprintf(stderr, "  0x%08x %10llu ", pcs[i].first, (unsigned long long)pcs[i].second);
+            for (int j = VPROC_DISPATCH_WAIT; j < VPROC_DISPATCH_CNT; j++) {
+                if (c.dispatch[j] != 0) {
+                    fprintf(stderr, " %s %llu", vproc_dispatch_names[j], (unsigned long long)c.dispatch[j]);
+                }
+            }
+            for (int j = 1; j < VPROC_OFFLOAD_CNT; j++) {
+                if (c.offload[j] != 0) {
+                    fprintf(stderr, " %s %llu", vproc_offload_names[j], (unsigned long long)c.offload[j]);
+                }
+            }
+            fprintf(stderr, "\n");
+        }
+        fprintf(stderr, "\n");
+    }
+    const offload_stats &os = ctx->lat;
+    if (os.instructions != 0) {
+        fprintf(stderr, "Vector Offload Latency (cycles, mean/p90; %llu instructions, %llu killed):\n",
+                (unsigned long long)os.instructions, (unsigned long long)os.killed);
+        fprintf(stderr, "%-12s %8s", "", "COUNT");
+        for (int c = 0; c < LAT_CNT; c++) {
+            fprintf(stderr, " %12s", vproc_latency_names[c]);
+        }
+        fprintf(stderr, "\n");
+        auto line = [](const char *group, const char *key, const latency_hist *h) {
+            if (h[LAT_TOTAL].count == 0) {
+                return;
+            }
+            fprintf(stderr, "%-5s %-6s %8llu", group, key, (unsigned long long)h[LAT_TOTAL].count);
+            for (int c = 0; c < LAT_CNT; c++) {
+                if (h[c].count == 0) {
+                    fprintf(stderr, " %12s", "-");
+                } else {
+                    fprintf(stderr, " %7.1f/%-4llu", (double)h[c].sum / h[c].count, (unsigned long long)latency_percentile(h[c], 0.9));
+                }
+            }
+            fprintf(stderr, "\n");
+        };
+        latency_hist all[LAT_CNT];
+        for (int u = 0; u < VPROC_UNIT_CNT; u++) {
+            line("unit", vproc_unit_names[u], os.by_unit[u]);
+            for (int c = 0; c < LAT_CNT; c++) {
+                latency_merge(all[c], os.by_unit[u][c]);
+            }
+        }
+        line("all", "", all);
+        for (int i = 0; i < 4; i++) {
+            line("SEW", vec_sew_names[i], os.by_sew[i]);
+        }
+        for (int i = 0; i < 8; i++) {
+            line("LMUL", vec_lmul_names[i], os.by_lmul[i]);
+        }
+        uint64_t sampled = 0, waiting = 0;
+        for (size_t i = 0; i < os.queue_occupancy.size(); i++) {
+            sampled += os.queue_occupancy[i];
+            waiting += os.queue_occupancy[i] * i;
+        }
+        fprintf(stderr, "Instruction Queue Occupancy (%% of cycles, mean %.2f):\n ", sampled ? (double)waiting / sampled : 0.0);
+        for (size_t i = 0; i < os.queue_occupancy.size(); i++) {
+            fprintf(stderr, " %zu: %.2f", i, sampled ? 100.0 * os.queue_occupancy[i] / sampled : 0.0);
+        }
+        fprintf(stderr, "\n\n");
+    }
+    report_host_stats(ctx);
+
+    const char *stats_path = getenv("VICUNA_STATS");
+    if (stats_path != NULL && stats_path[0] != '\0') {
+        write_stats(ctx, stats_path);
+    }
+}
+
+/*
+* Append the summary statistics as one line of key=value pairs.  Returns false if error
+* ARGS:
+*   - *path         - output file
+*/
+bool write_stats(const char *path){
+    return write_stats(&default_ctx, path);
+}
+
+bool write_stats(sim_context *ctx, const char *path){
+    FILE *out = fopen(path, "a");
+    if (out == NULL) {
+        fprintf(stderr, "ERROR: opening `%s': %s\n", path, strerror(errno));
+        return false;
+    }
+    double vinstr = ctx->vector_instr ? (double)ctx->vector_instr : 1.0;
+    fprintf(out, "cycles=%d instr=%d cpi=%f vector_instr=%d avg_vl=%f vreg_usage=%f", ctx->cycles, ctx->instr,
+            ctx->instr ? (double)ctx->cycles / ctx->instr : 0.0, ctx->vector_instr, ctx->sum_vec_lengths / vinstr,
+            ctx->sum_vec_percentage / vinstr * 100);
+    fprintf(out, " if_pc=0x%08x", ctx->last_IF_PC);
+    double pct = ctx->unit_cycles ? 100.0 / ctx->unit_cycles : 0.0;
+    for (size_t i = 0; i < ctx->pipes.size(); i++) {
+        fprintf(out, " pipe%zu_busy=%f pipe%zu_stall=%f", i, ctx->pipes[i].busy * pct, i, ctx->pipes[i].stall * pct);
+    }
+    double dpct = ctx->disp.cycles ? 100.0 / ctx->disp.cycles : 0.0;
+    for (int i = 0; i < VPROC_DISPATCH_CNT; i++) {
+        fprintf(out, " dispatch_%s=%f", vproc_dispatch_names[i], ctx->disp.dispatch[i] * dpct);
+    }
+    for (int i = 1; i < VPROC_OFFLOAD_CNT; i++) {
+        fprintf(out, " offload_%s=%f", vproc_offload_names[i], ctx->disp.offload[i] * dpct);
+    }
+    latency_hist all[LAT_CNT];
+    for (int u = 0; u < VPROC_UNIT_CNT; u++) {
+        for (int c = 0; c < LAT_CNT; c++) {
+            latency_merge(all[c], ctx->lat.by_unit[u][c]);
+        }
+    }
+    for (int c = 0; c < LAT_CNT; c++) {
+        fprintf(out, " latency_%s=%f", vproc_latency_names[c], all[c].count ? (double)all[c].sum / all[c].count : 0.0);
+    }
+    double wall = host_seconds(ctx);
+    fprintf(out, " host_s=%f host_khz=%f", wall, wall > 0.0 ? ctx->host.sim_cycles / wall / 1000.0 : 0.0);
+    fprintf(out, "\n");
+    fclose(out);
+    return true;
+}
+
+/*
+* Update .vcd (or .fst with TRACE_FST) trace file. If end_cycles == 0, output entire trace.
+* ARGS:
+*   - *tfp          - pointer to verilator vcd or fst trace object
 *   - begin_cycles  - cycle count to start trace
 *   - end_cycles    - cycle count to end trace
 */
 void update_vcd(VerilatedTrace_t *tfp, uint32_t begin_cycles, uint32_t end_cycles){
+    update_vcd(&default_ctx, tfp, begin_cycles, end_cycles);
+}
+
+void update_vcd(sim_context *ctx, VerilatedTrace_t *tfp, uint32_t begin_cycles, uint32_t end_cycles){
+    host_scope scope(ctx, HOST_TRACE);
     if (tfp != NULL)
     {
-        if ((cycles >= begin_cycles) && ( cycles < end_cycles) || (end_cycles == 0))
+        if ((ctx->cycles >= begin_cycles) && ( ctx->cycles < end_cycles) || (end_cycles == 0))
         {
-            #ifdef TRACE_VCD
-            tfp->dump(cycles);
+            #if defined(TRACE_VCD) || defined(TRACE_FST)
+            tfp->dump(ctx->cycles);
             #endif
         }
     }
@@ -392,21 +1677,191 @@ void update_vcd(VerilatedTrace_t *tfp, uint32_t begin_cycles, uint32_t end_cycle
 *   - end_cycles    - cycle count to end trace
 */
 void update_inst_trace(Vvproc_top *top, FILE *inst_trace, uint32_t begin_cycles, uint32_t end_cycles){
+    default_ctx.top = top;
+    update_inst_trace(&default_ctx, inst_trace, begin_cycles, end_cycles);
+}
+
+void update_inst_trace(sim_context *ctx, FILE *inst_trace, uint32_t begin_cycles, uint32_t end_cycles){
+    host_scope scope(ctx, HOST_TRACE);
     if (inst_trace != NULL)
     {
-        if ((cycles >= begin_cycles) && ( cycles < end_cycles) || (end_cycles == 0))
+        if ((ctx->cycles >= begin_cycles) && ( ctx->cycles < end_cycles) || (end_cycles == 0))
         {
-            if ((current_WB_PC != last_WB_PC)) //using values from stats, make sure update_stats() is called first
+            if (ctx->retired) //using values from stats, make sure update_stats() is called first
             {
                 //mark trace file for new instruction in wb
                 fprintf(inst_trace, "NEW PC\n");
             }
-            fprintf(inst_trace, "%08x\n", top->vproc_top->core->instruction_wb);
+            fprintf(inst_trace, "%08x\n", ctx->top->vproc_top->core->instruction_wb);
+        }
+    }
+    return;
+}
+
+
+//write-back state of the current cycle, using values from stats, make sure update_stats() is called first
+static trace_trigger::history_entry inst_trace_entry(sim_context *ctx){
+    return {(uint64_t)ctx->cycles, ctx->retired, ctx->top->vproc_top->core->instruction_wb, (uint32_t)ctx->current_WB_PC,
+            ctx->top->vproc_top->csr_vl_o, ctx->top->vproc_top->csr_vtype_o};
+}
+
+//first history entry a consumer that has read up to read has not written yet, older entries are overwritten
+static uint64_t inst_trace_history_begin(const trace_trigger *trig, uint64_t read){
+    uint64_t oldest = trig->ring_written > trig->ring.size() ? trig->ring_written - trig->ring.size() : 0;
+    return read > oldest ? read : oldest;
+}
+
+/*
+* Evaluate the windows of a trace trigger for the current cycle, and record the cycle in the instruction trace history if no window is
+* open.  Returns true if tracing is active in this cycle.
+* ARGS:
+*   - *top          - pointer to verilator top module
+*   - *trig         - trace windows
+*/
+bool update_trace_trigger(Vvproc_top *top, trace_trigger *trig){
+    default_ctx.top = top;
+    return update_trace_trigger(&default_ctx, trig);
+}
+
+bool update_trace_trigger(sim_context *ctx, trace_trigger *trig){
+    host_scope scope(ctx, HOST_TRACE);
+    uint32_t pc = ctx->top->vproc_top->core->pc_if;
+    bool active = false;
+    for (trace_window &w : trig->windows) {
+        if (w.open) {
+            bool stop = (pc >= w.stop_lo && pc <= w.stop_hi) || (w.max_cycles != 0 && (uint32_t)(ctx->cycles - w.opened_at) >= w.max_cycles);
+            w.open = !stop;
+        } else if (pc >= w.start_lo && pc <= w.start_hi && (w.max_hits == 0 || w.hits < w.max_hits)) {
+            w.open      = true;
+            w.opened_at = ctx->cycles;
+            w.hits++;
+        }
+        active |= w.open;
+    }
+    trig->active = active;
+
+    //keep the last history cycles while no window is open
+    if (!active && trig->history != 0) {
+        if (trig->ring.size() != trig->history) {
+            trig->ring.resize(trig->history);
+            trig->ring_written = trig->text_read = trig->log_read = 0;
+        }
+        trig->ring[trig->ring_written % trig->ring.size()] = inst_trace_entry(ctx);
+        trig->ring_written++;
+    }
+    return active;
+}
+
+/*
+* Update waveform trace file while a window of the trace trigger is open.
+* ARGS:
+*   - *tfp          - pointer to verilator vcd or fst trace object
+*   - *trig         - trace windows
+*/
+void update_vcd(VerilatedTrace_t *tfp, trace_trigger *trig){
+    update_vcd(&default_ctx, tfp, trig);
+}
+
+void update_vcd(sim_context *ctx, VerilatedTrace_t *tfp, trace_trigger *trig){
+    host_scope scope(ctx, HOST_TRACE);
+    if (tfp == NULL) {
+        return;
+    }
+    #if defined(TRACE_VCD) || defined(TRACE_FST)
+    if (trig->active) {
+        tfp->dump(ctx->cycles);
+    } else if (trig->dumping) {
+        //window closed, get the trace to disk rather than holding it in the writer until the next window
+        tfp->flush();
+    }
+    #endif
+    trig->dumping = trig->active;
+    return;
+}
+
+/*
+* Update instruction trace file while a window of the trace trigger is open, with the history before the window opened.
+* ARGS:
+*   - *top          - pointer to verilator top module
+*   - *inst_trace   - pointer to .txt trace file output
+*   - *trig         - trace windows
+*/
+void update_inst_trace(Vvproc_top *top, FILE *inst_trace, trace_trigger *trig){
+    default_ctx.top = top;
+    update_inst_trace(&default_ctx, inst_trace, trig);
+}
+
+void update_inst_trace(sim_context *ctx, FILE *inst_trace, trace_trigger *trig){
+    host_scope scope(ctx, HOST_TRACE);
+    if (inst_trace == NULL || !trig->active) {
+        return;
+    }
+    //window open: write the history first
+    for (uint64_t n = inst_trace_history_begin(trig, trig->text_read); n < trig->ring_written; n++) {
+        const trace_trigger::history_entry &h = trig->ring[n % trig->ring.size()];
+        if (h.new_pc) {
+            fprintf(inst_trace, "NEW PC\n");
         }
+        fprintf(inst_trace, "%08x\n", h.instr);
+    }
+    trig->text_read = trig->ring_written;
+    trace_trigger::history_entry e = inst_trace_entry(ctx);
+    if (e.new_pc) //using values from stats, make sure update_stats() is called first
+    {
+        fprintf(inst_trace, "NEW PC\n");
     }
+    fprintf(inst_trace, "%08x\n", e.instr);
     return;
 }
 
+/*
+* Update a binary instruction trace while a window of the trace trigger is open, with the history cycles before the window opened.
+* ARGS:
+*   - *top          - pointer to verilator top module
+*   - *log          - binary instruction trace
+*   - *trig         - trace windows, updated by update_trace_trigger() in this cycle
+*/
+void update_inst_trace(Vvproc_top *top, inst_trace_log *log, trace_trigger *trig){
+    default_ctx.top = top;
+    update_inst_trace(&default_ctx, log, trig);
+}
+
+void update_inst_trace(sim_context *ctx, inst_trace_log *log, trace_trigger *trig){
+    host_scope scope(ctx, HOST_TRACE);
+    if (log == NULL || !trig->active) {
+        return;
+    }
+    for (uint64_t n = inst_trace_history_begin(trig, trig->log_read); n < trig->ring_written; n++) {
+        const trace_trigger::history_entry &h = trig->ring[n % trig->ring.size()];
+        log->cycle(h.cycle, h.new_pc, h.pc, h.instr, h.vl, h.vtype);
+    }
+    trig->log_read = trig->ring_written;
+    trace_trigger::history_entry e = inst_trace_entry(ctx);
+    log->cycle(ctx->cycles, e.new_pc, e.pc, e.instr, e.vl, e.vtype);
+}
+
+/*
+* Update a binary instruction trace.  If end_cycles == 0, output entire trace.
+* ARGS:
+*   - *top          - pointer to verilator top module
+*   - *log          - binary instruction trace
+*   - begin_cycles  - cycle count to start trace
+*   - end_cycles    - cycle count to end trace
+*/
+void update_inst_trace(Vvproc_top *top, inst_trace_log *log, uint32_t begin_cycles, uint32_t end_cycles){
+    default_ctx.top = top;
+    update_inst_trace(&default_ctx, log, begin_cycles, end_cycles);
+}
+
+void update_inst_trace(sim_context *ctx, inst_trace_log *log, uint32_t begin_cycles, uint32_t end_cycles){
+    host_scope scope(ctx, HOST_TRACE);
+    if (log == NULL || !((ctx->cycles >= begin_cycles && ctx->cycles < end_cycles) || end_cycles == 0)) {
+        return;
+    }
+    trace_trigger::history_entry e = inst_trace_entry(ctx);
+    log->cycle(ctx->cycles, e.new_pc, e.pc, e.instr, e.vl, e.vtype);
+}
+
     
 /*
 * Update xreg commit log dump.  Appends any current commits to provided file.
@@ -422,6 +1877,11 @@ void update_xreg_commit(Vvproc_top *top, FILE *commit_log){
     return;
 }
 
+void update_xreg_commit(sim_context *ctx, FILE *commit_log){
+    host_scope scope(ctx, HOST_COMMIT);
+    update_xreg_commit(ctx->top, commit_log);
+}
+
 /*
 * Update freg commit log dump.  Appends any current commits to provided file.  In case RISCV_F is not enabled, remove references to fp_regfile signals as they don't exist
 * ARGS:
@@ -438,6 +1898,11 @@ void update_freg_commit(Vvproc_top *top, FILE *commit_log){
     return;
 }
 
+void update_freg_commit(sim_context *ctx, FILE *commit_log){
+    host_scope scope(ctx, HOST_COMMIT);
+    update_freg_commit(ctx->top, commit_log);
+}
+
 /*
 * Update vreg commit log dump.  Appends any current commits to provided file. In case RISCV_ZVE32X is not enabled, remove references to vregfile signals as they don't exist
 * ARGS:
@@ -470,3 +1935,464 @@ void update_vreg_commit(Vvproc_top *top, int vreg_w, FILE *commit_log){
         #endif 
     return;
 }
+
+void update_vreg_commit(sim_context *ctx, int vreg_w, FILE *commit_log){
+    host_scope scope(ctx, HOST_COMMIT);
+    update_vreg_commit(ctx->top, vreg_w, commit_log);
+}
+
+/*
+* Binary commit log variants of update_*_commit().  Commits are copied into the asynchronous writer of *log.
+* ARGS:
+*   - *top          - pointer to verilator top module
+*   - *log          - open binary commit log
+*/
+void update_xreg_commit(Vvproc_top *top, commit_log *log){
+    if(top->vproc_top->core->rf_we_wb)
+    {
+        log->xreg(top->vproc_top->core->rf_waddr_wb, top->vproc_top->core->rf_wdata_wb);
+    }
+    return;
+}
+
+void update_xreg_commit(sim_context *ctx, commit_log *log){
+    host_scope scope(ctx, HOST_COMMIT);
+    update_xreg_commit(ctx->top, log);
+}
+
+void update_freg_commit(Vvproc_top *top, commit_log *log){
+    #ifdef RISCV_F
+    if(top->vproc_top->fpu_ss_i->gen_fp_register_file__DOT__fpu_ss_regfile_i->fpr_commit_valid)
+    {
+        log->freg(top->vproc_top->fpu_ss_i->gen_fp_register_file__DOT__fpu_ss_regfile_i->fpr_commit_addr, top->vproc_top->fpu_ss_i->gen_fp_register_file__DOT__fpu_ss_regfile_i->fpr_commit_data);
+    }
+    #endif
+    return;
+}
+
+void update_freg_commit(sim_context *ctx, commit_log *log){
+    host_scope scope(ctx, HOST_COMMIT);
+    update_freg_commit(ctx->top, log);
+}
+
+void update_vreg_commit(Vvproc_top *top, commit_log *log){
+    #ifdef RISCV_ZVE32X
+    //one write port, same condition as the text log.  Data and mask are copied as they are laid out in the model
+    if(top->vproc_top->v_core->vregfile_wr_en_q)
+    {
+        log->vreg(top->vproc_top->v_core->vregfile_wr_addr_q, (unsigned char*)&(top->vproc_top->v_core->vregfile_wr_data_q), (unsigned char*)&(top->vproc_top->v_core->vregfile_wr_mask_q));
+    }
+    #endif
+    return;
+}
+
+void update_vreg_commit(sim_context *ctx, commit_log *log){
+    host_scope scope(ctx, HOST_COMMIT);
+    update_vreg_commit(ctx->top, log);
+}
+
+/*
+* Function to compare the current xreg, freg and vreg commits against a reference commit log.  Returns false once diverged
+* ARGS:
+*   - *top          - pointer to verilator top module
+*   - *check        - commit checker opened on the reference log
+*/
+bool update_commit_check(Vvproc_top *top, commit_check *check){
+    default_ctx.top = top;
+    return update_commit_check(&default_ctx, check);
+}
+
+bool update_commit_check(sim_context *ctx, commit_check *check){
+    host_scope scope(ctx, HOST_COMMIT);
+    Vvproc_top *top = ctx->top;
+    bool ok = true;
+    check->at(ctx->cycles, ctx->current_WB_PC);
+    if(top->vproc_top->core->rf_we_wb)
+    {
+        ok &= check->xreg(top->vproc_top->core->rf_waddr_wb, top->vproc_top->core->rf_wdata_wb);
+    }
+    #ifdef RISCV_F
+    if(top->vproc_top->fpu_ss_i->gen_fp_register_file__DOT__fpu_ss_regfile_i->fpr_commit_valid)
+    {
+        ok &= check->freg(top->vproc_top->fpu_ss_i->gen_fp_register_file__DOT__fpu_ss_regfile_i->fpr_commit_addr, top->vproc_top->fpu_ss_i->gen_fp_register_file__DOT__fpu_ss_regfile_i->fpr_commit_data);
+    }
+    #endif
+    #ifdef RISCV_ZVE32X
+    if(top->vproc_top->v_core->vregfile_wr_en_q)
+    {
+        ok &= check->vreg(top->vproc_top->v_core->vregfile_wr_addr_q, (unsigned char*)&(top->vproc_top->v_core->vregfile_wr_data_q), (unsigned char*)&(top->vproc_top->v_core->vregfile_wr_mask_q));
+    }
+    #endif
+    return ok && !check->diverged();
+}
+
+/*
+*   Checkpoint Functions.  File layout: header, harness counters, memory pages, memory port states, verilated model.
+*/
+#ifdef SIM_CHECKPOINT
+static const uint32_t CHECKPOINT_MAGIC   = 0x504b4356; // "VCKP"
+static const uint32_t CHECKPOINT_VERSION = 5;
+static const uint32_t CHECKPOINT_PAGE    = 4096;
+static const uint32_t CHECKPOINT_END     = 0xffffffff; // page list terminator (not a valid page address)
+
+template <typename T> static void ckpt_put(VerilatedSerialize &os, const T &v){ os.write(&v, sizeof(v)); }
+template <typename T> static void ckpt_get(VerilatedDeserialize &is, T &v){ is.read(&v, sizeof(v)); }
+
+//harness counters, in a fixed order
+template <typename S, typename F> static void ckpt_counters(S &s, sim_context *ctx, F f){
+    f(s, ctx->cycles);
+    f(s, ctx->instr);
+    f(s, ctx->vector_instr);
+    f(s, ctx->current_WB_PC);
+    f(s, ctx->last_WB_PC);
+    f(s, ctx->cycles_stalled);
+    f(s, ctx->last_IF_PC);
+    f(s, ctx->sum_vec_lengths);
+    f(s, ctx->sum_vec_lengths_bytes);
+    f(s, ctx->sum_vec_percentage);
+}
+
+//offload latency histograms, in a fixed order
+template <typename F> static void ckpt_latency(sim_context *ctx, F f){
+    for (auto &unit : ctx->lat.by_unit) {
+        for (latency_hist &h : unit) {
+            f(h);
+        }
+    }
+    for (auto &sew : ctx->lat.by_sew) {
+        for (latency_hist &h : sew) {
+            f(h);
+        }
+    }
+    for (auto &lmul : ctx->lat.by_lmul) {
+        for (latency_hist &h : lmul) {
+            f(h);
+        }
+    }
+}
+
+static bool ckpt_save(sim_context *ctx, const char *path, const std::function<void(VerilatedSerialize &)> &save_mem, mem_port **ports, int n_ports){
+    host_scope scope(ctx, HOST_CHECKPOINT);
+    VerilatedSave os;
+    os.open(path);
+    if (!os.isOpen()) {
+        fprintf(stderr, "ERROR: opening checkpoint `%s' for writing\n", path);
+        return false;
+    }
+    ckpt_put(os, CHECKPOINT_MAGIC);
+    ckpt_put(os, CHECKPOINT_VERSION);
+    ckpt_counters(os, ctx, [](VerilatedSerialize &o, auto &v) { ckpt_put(o, v); });
+    ckpt_put(os, ctx->unit_cycles);
+    ckpt_put(os, (uint32_t)ctx->pipes.size());
+    for (const pipe_stats &pipe : ctx->pipes) {
+        ckpt_put(os, pipe);
+    }
+    for (const vector_hist &h : ctx->vec_hist) {
+        ckpt_put(os, (uint32_t)h.vl.size());
+        os.write(h.vl.data(), h.vl.size() * sizeof(hist_bin));
+        ckpt_put(os, h.sew);
+        ckpt_put(os, h.lmul);
+        ckpt_put(os, h.occupancy);
+    }
+    ckpt_put(os, (uint32_t)ctx->vec_in_flight.size());
+    os.write(ctx->vec_in_flight.data(), ctx->vec_in_flight.size() * sizeof(vector_issue));
+    const dispatch_stats &ds = ctx->disp;
+    ckpt_put(os, ds.cycles);
+    ckpt_put(os, ds.dispatch);
+    ckpt_put(os, ds.offload);
+    ckpt_put(os, ds.window);
+    ckpt_put(os, ds.window_pc);
+    ckpt_put(os, ds.refused);
+    ckpt_put(os, ds.wb_pc);
+    ckpt_put(os, (uint32_t)ds.in_flight.size());
+    os.write(ds.in_flight.data(), ds.in_flight.size() * sizeof(stall_instr));
+    ckpt_put(os, (uint32_t)ds.unretired.size());
+    os.write(ds.unretired.data(), ds.unretired.size());
+    ckpt_put(os, (uint32_t)ds.by_pc.size());
+    for (const auto &e : ds.by_pc) {
+        ckpt_put(os, e.first);
+        ckpt_put(os, e.second);
+    }
+    const offload_stats &lat = ctx->lat;
+    ckpt_put(os, lat.instructions);
+    ckpt_put(os, lat.killed);
+    ckpt_put(os, lat.refused);
+    ckpt_put(os, lat.queued);
+    ckpt_latency(ctx, [&](latency_hist &h) {
+        ckpt_put(os, h.count);
+        ckpt_put(os, h.sum);
+        ckpt_put(os, h.max);
+        ckpt_put(os, (uint32_t)h.bins.size());
+        os.write(h.bins.data(), h.bins.size() * sizeof(uint64_t));
+    });
+    ckpt_put(os, (uint32_t)lat.queue_occupancy.size());
+    os.write(lat.queue_occupancy.data(), lat.queue_occupancy.size() * sizeof(uint64_t));
+    ckpt_put(os, (uint32_t)lat.in_flight.size());
+    os.write(lat.in_flight.data(), lat.in_flight.size() * sizeof(offload_instr));
+
+    save_mem(os);
+    ckpt_put(os, CHECKPOINT_END);
+
+    ckpt_put(os, (uint32_t)n_ports);
+    std::vector<unsigned char> buf;
+    for (int i = 0; i < n_ports; i++) {
+        buf.clear();
+        ports[i]->save_state(buf);
+        ckpt_put(os, (uint64_t)buf.size());
+        os.write(buf.data(), buf.size());
+    }
+
+    os << *ctx->top;
+    os.close();
+    return true;
+}
+
+static bool ckpt_restore(sim_context *ctx, const char *path, const std::function<bool(uint32_t, const unsigned char *)> &load_page, mem_port **ports, int n_ports){
+    host_scope scope(ctx, HOST_CHECKPOINT);
+    VerilatedRestore is;
+    is.open(path);
+    if (!is.isOpen()) {
+        fprintf(stderr, "ERROR: opening checkpoint `%s' for reading\n", path);
+        return false;
+    }
+    uint32_t magic, version;
+    ckpt_get(is, magic);
+    ckpt_get(is, version);
+    if (magic != CHECKPOINT_MAGIC || version != CHECKPOINT_VERSION) {
+        fprintf(stderr, "ERROR: `%s' is not a checkpoint of this harness version\n", path);
+        return false;
+    }
+    ckpt_counters(is, ctx, [](VerilatedDeserialize &i, auto &v) { ckpt_get(i, v); });
+    uint32_t n_pipes;
+    ckpt_get(is, ctx->unit_cycles);
+    ckpt_get(is, n_pipes);
+    ctx->pipes.resize(n_pipes);
+    for (pipe_stats &pipe : ctx->pipes) {
+        ckpt_get(is, pipe);
+    }
+    uint32_t n;
+    for (vector_hist &h : ctx->vec_hist) {
+        ckpt_get(is, n);
+        h.vl.resize(n);
+        is.read(h.vl.data(), n * sizeof(hist_bin));
+        ckpt_get(is, h.sew);
+        ckpt_get(is, h.lmul);
+        ckpt_get(is, h.occupancy);
+    }
+    ckpt_get(is, n);
+    ctx->vec_in_flight.resize(n);
+    is.read(ctx->vec_in_flight.data(), n * sizeof(vector_issue));
+    dispatch_stats &ds = ctx->disp;
+    ckpt_get(is, ds.cycles);
+    ckpt_get(is, ds.dispatch);
+    ckpt_get(is, ds.offload);
+    ckpt_get(is, ds.window);
+    ckpt_get(is, ds.window_pc);
+    ckpt_get(is, ds.refused);
+    ckpt_get(is, ds.wb_pc);
+    ckpt_get(is, n);
+    ds.in_flight.resize(n);
+    is.read(ds.in_flight.data(), n * sizeof(stall_instr));
+    ckpt_get(is, n);
+    ds.unretired.resize(n);
+    is.read(ds.unretired.data(), n);
+    ckpt_get(is, n);
+    ds.by_pc.clear();
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t pc;
+        ckpt_get(is, pc);
+        ckpt_get(is, ds.by_pc[pc]);
+    }
+    offload_stats &lat = ctx->lat;
+    ckpt_get(is, lat.instructions);
+    ckpt_get(is, lat.killed);
+    ckpt_get(is, lat.refused);
+    ckpt_get(is, lat.queued);
+    ckpt_latency(ctx, [&](latency_hist &h) {
+        ckpt_get(is, h.count);
+        ckpt_get(is, h.sum);
+        ckpt_get(is, h.max);
+        ckpt_get(is, n);
+        h.bins.resize(n);
+        is.read(h.bins.data(), n * sizeof(uint64_t));
+    });
+    ckpt_get(is, n);
+    lat.queue_occupancy.resize(n);
+    is.read(lat.queue_occupancy.data(), n * sizeof(uint64_t));
+    ckpt_get(is, n);
+    lat.in_flight.resize(n);
+    is.read(lat.in_flight.data(), n * sizeof(offload_instr));
+
+    std::vector<unsigned char> page(CHECKPOINT_PAGE);
+    uint32_t addr;
+    for (ckpt_get(is, addr); addr != CHECKPOINT_END; ckpt_get(is, addr)) {
+        is.read(page.data(), CHECKPOINT_PAGE);
+        if (!load_page(addr, page.data())) {
+            fprintf(stderr, "ERROR: checkpoint page 0x%08x outside of memory\n", addr);
+            return false;
+        }
+    }
+
+    uint32_t saved_ports;
+    ckpt_get(is, saved_ports);
+    if ((int)saved_ports != n_ports) {
+        fprintf(stderr, "ERROR: checkpoint contains %d memory ports, %d provided\n", saved_ports, n_ports);
+        return false;
+    }
+    std::vector<unsigned char> buf;
+    for (int i = 0; i < n_ports; i++) {
+        uint64_t len;
+        ckpt_get(is, len);
+        buf.resize(len);
+        is.read(buf.data(), len);
+        if (!ports[i]->restore_state(buf)) {
+            fprintf(stderr, "ERROR: memory port %d does not match the checkpoint\n", i);
+            return false;
+        }
+    }
+
+    is >> *ctx->top;
+    is.close();
+    return true;
+}
+#endif
+
+/*
+* Save a checkpoint.  Only non-zero pages of a flat memory and allocated pages of a paged memory are written.  Returns false if error
+*/
+bool save_checkpoint(Vvproc_top *top, const char *path, unsigned char *mem, uint32_t mem_sz, mem_port **ports, int n_ports){
+    default_ctx.top = top;
+    return save_checkpoint(&default_ctx, path, mem, mem_sz, ports, n_ports);
+}
+
+bool save_checkpoint(sim_context *ctx, const char *path, unsigned char *mem, uint32_t mem_sz, mem_port **ports, int n_ports){
+    #ifdef SIM_CHECKPOINT
+    auto save_mem = [mem, mem_sz](VerilatedSerialize &os) {
+        static const unsigned char zero[CHECKPOINT_PAGE] = {0};
+        for (uint32_t addr = 0; addr < mem_sz; addr += CHECKPOINT_PAGE) {
+            uint32_t n = (mem_sz - addr < CHECKPOINT_PAGE) ? mem_sz - addr : CHECKPOINT_PAGE;
+            if (memcmp(&mem[addr], zero, n) != 0) {
+                unsigned char page[CHECKPOINT_PAGE] = {0};
+                memcpy(page, &mem[addr], n);
+                ckpt_put(os, addr);
+                os.write(page, CHECKPOINT_PAGE);
+            }
+        }
+    };
+    return ckpt_save(ctx, path, save_mem, ports, n_ports);
+    #else
+    fprintf(stderr, "ERROR: checkpoints require a model verilated with --savable and SIM_CHECKPOINT defined\n");
+    return false;
+    #endif
+}
+
+bool save_checkpoint(Vvproc_top *top, const char *path, paged_mem *mem, mem_port **ports, int n_ports){
+    default_ctx.top = top;
+    return save_checkpoint(&default_ctx, path, mem, ports, n_ports);
+}
+
+bool save_checkpoint(sim_context *ctx, const char *path, paged_mem *mem, mem_port **ports, int n_ports){
+    #ifdef SIM_CHECKPOINT
+    auto save_mem = [mem](VerilatedSerialize &os) {
+        mem->for_each_page([&os](uint32_t addr, const unsigned char *data) {
+            ckpt_put(os, addr);
+            os.write(data, CHECKPOINT_PAGE);
+        });
+    };
+    return ckpt_save(ctx, path, save_mem, ports, n_ports);
+    #else
+    fprintf(stderr, "ERROR: checkpoints require a model verilated with --savable and SIM_CHECKPOINT defined\n");
+    return false;
+    #endif
+}
+
+/*
+* Restore a checkpoint written by save_checkpoint().  Memory not contained in the checkpoint is cleared.  Returns false if error
+*/
+bool restore_checkpoint(Vvproc_top *top, const char *path, unsigned char *mem, uint32_t mem_sz, mem_port **ports, int n_ports){
+    default_ctx.top = top;
+    return restore_checkpoint(&default_ctx, path, mem, mem_sz, ports, n_ports);
+}
+
+bool restore_checkpoint(sim_context *ctx, const char *path, unsigned char *mem, uint32_t mem_sz, mem_port **ports, int n_ports){
+    #ifdef SIM_CHECKPOINT
+    memset(mem, 0, mem_sz);
+    auto load_page = [mem, mem_sz](uint32_t addr, const unsigned char *data) {
+        if (addr >= mem_sz) {
+            return false;
+        }
+        memcpy(&mem[addr], data, (mem_sz - addr < CHECKPOINT_PAGE) ? mem_sz - addr : CHECKPOINT_PAGE);
+        return true;
+    };
+    return ckpt_restore(ctx, path, load_page, ports, n_ports);
+    #else
+    fprintf(stderr, "ERROR: checkpoints require a model verilated with --savable and SIM_CHECKPOINT defined\n");
+    return false;
+    #endif
+}
+
+bool restore_checkpoint(Vvproc_top *top, const char *path, paged_mem *mem, mem_port **ports, int n_ports){
+    default_ctx.top = top;
+    return restore_checkpoint(&default_ctx, path, mem, ports, n_ports);
+}
+
+bool restore_checkpoint(sim_context *ctx, const char *path, paged_mem *mem, mem_port **ports, int n_ports){
+    #ifdef SIM_CHECKPOINT
+    mem->clear();
+    auto load_page = [mem](uint32_t addr, const unsigned char *data) {
+        if (!mem->in_range(addr, 1)) {
+            return false;
+        }
+        mem->write(addr, data, CHECKPOINT_PAGE);
+        return true;
+    };
+    return ckpt_restore(ctx, path, load_page, ports, n_ports);
+    #else
+    fprintf(stderr, "ERROR: checkpoints require a model verilated with --savable and SIM_CHECKPOINT defined\n");
+    return false;
+    #endif
+}
+
+/*
+* Take a checkpoint if the trigger condition is met.  Returns true in the cycle the checkpoint was written.
+*/
+static bool checkpoint_due(sim_context *ctx, checkpoint_trigger *trig){
+    if (trig->taken) {
+        return false;
+    }
+    return (trig->at_pc && check_PC(ctx, trig->pc)) || (trig->at_cycle && ctx->cycles >= trig->cycle);
+}
+
+bool update_checkpoint(Vvproc_top *top, checkpoint_trigger *trig, const char *path, unsigned char *mem, uint32_t mem_sz, mem_port **ports, int n_ports){
+    default_ctx.top = top;
+    return update_checkpoint(&default_ctx, trig, path, mem, mem_sz, ports, n_ports);
+}
+
+bool update_checkpoint(sim_context *ctx, checkpoint_trigger *trig, const char *path, unsigned char *mem, uint32_t mem_sz, mem_port **ports, int n_ports){
+    if (!checkpoint_due(ctx, trig)) {
+        return false;
+    }
+    trig->taken = true;
+    if (save_checkpoint(ctx, path, mem, mem_sz, ports, n_ports)) {
+        fprintf(stderr, "Checkpoint written to `%s' at cycle %d, IF_PC = 0x%x\n", path, ctx->cycles, ctx->top->vproc_top->core->pc_if);
+        return true;
+    }
+    return false;
+}
+
+bool update_checkpoint(Vvproc_top *top, checkpoint_trigger *trig, const char *path, paged_mem *mem, mem_port **ports, int n_ports){
+    default_ctx.top = top;
+    return update_checkpoint(&default_ctx, trig, path, mem, ports, n_ports);
+}
+
+bool update_checkpoint(sim_context *ctx, checkpoint_trigger *trig, const char *path, paged_mem *mem, mem_port **ports, int n_ports){
+    if (!checkpoint_due(ctx, trig)) {
+        return false;
+    }
+    trig->taken = true;
+    if (save_checkpoint(ctx, path, mem, ports, n_ports)) {
+        fprintf(stderr, "Checkpoint written to `%s' at cycle %d, IF_PC = 0x%x\n", path, ctx->cycles, ctx->top->vproc_top->core->pc_if);
+        return true;
+    }
+    return false;
+}
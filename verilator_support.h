@@ -41,59 +41,449 @@
 
 #include "verilated.h"
 
+#include "verilator_memory.h"
+#include "verilator_commitlog.h"
+#include "verilator_insttrace.h"
+#include "verilator_profile.h"
+#include "verilator_power.h"
+
 #include <stdio.h>
 #include <stdint.h>
 
-#ifdef TRACE_VCD
+#include <chrono>
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#if defined(TRACE_FST)
+#include "verilated_fst_c.h"
+typedef VerilatedFstC VerilatedTrace_t; //compressed FST traces, the model must be verilated with --trace-fst
+#elif defined(TRACE_VCD)
 #include "verilated_vcd_c.h"
 typedef VerilatedVcdC VerilatedTrace_t; //This file only exists if traces are enabled 
 #else
 typedef void VerilatedTrace_t;  
 #endif
-#ifdef TRACE_VCD
-#include "verilated_vcd_c.h"
-typedef VerilatedVcdC VerilatedTrace_t; //This file only exists if traces are enabled 
+
+/*
+*   Unit types of the vector core, in the order of op_unit in vproc_pkg.sv
+*/
+static const int VPROC_UNIT_CNT = 10;
+inline const char *const vproc_unit_names[VPROC_UNIT_CNT] = {"VLSU", "VALU", "VMUL", "VDIV", "VFPU", "VSLD", "VELEM", "VZVBB", "VZVBC", "VCFG"};
+
+/*
+*   Utilization of one vector pipeline, see update_unit_stats().  Idle cycles are the sampled cycles neither busy nor stalled.
+*/
+struct pipe_stats {
+    uint16_t units          = 0;    // units placed in the pipeline, bit i is op_unit i
+    uint64_t busy           = 0;    // cycles in which at least one unit of the pipeline was busy
+    uint64_t stall          = 0;    // cycles in which no unit was busy and at least one was stalled
+    uint64_t dispatched     = 0;    // cycles in which the dispatcher issued an instruction to the pipeline
+    uint64_t dispatch_stall = 0;    // cycles in which an instruction for the pipeline waited in the dispatcher
+    uint64_t unit_busy [VPROC_UNIT_CNT] = {};
+    uint64_t unit_stall[VPROC_UNIT_CNT] = {};
+};
+
+/*
+*   Histogram bin weighted by instruction count and by the cycles the instructions were in flight (accepted by the decoder until
+*   completed by their pipeline).
+*/
+struct hist_bin {
+    uint64_t count  = 0;
+    uint64_t cycles = 0;
+};
+
+/*
+*   Vector configuration histograms of one unit type, see update_vector_hist().
+*/
+struct vector_hist {
+    std::vector<hist_bin> vl;               // by VL, grown as needed
+    hist_bin              sew[4];           // by vtype.vsew: 8, 16, 32, invalid
+    hist_bin              lmul[8];          // by vtype.vlmul encoding: 1, 2, 4, 8, reserved, 1/8, 1/4, 1/2
+    hist_bin              occupancy[11];    // by VL / VLMAX in steps of 10%, occupancy[10] is a full register group
+};
+
+/*
+*   Vector instruction in flight, bins it is counted in.
+*/
+struct vector_issue {
+    bool     valid     = false;
+    uint8_t  unit      = 0;
+    uint8_t  sew       = 0;
+    uint8_t  lmul      = 0;
+    uint8_t  occupancy = 0;
+    uint32_t vl        = 0;
+    int      cycle     = 0;                 // cycle accepted by the decoder
+};
+
+/*
+*   Dispatch stall causes, in the order of dispatch_stall in vproc_pkg.sv.  Every cycle has exactly one: "issued" if the instruction at
+*   the head of the instruction queue was dispatched, "empty" and "decode" if there was none to dispatch, otherwise the reason the head
+*   instruction waited.  The waiting causes (from VPROC_DISPATCH_WAIT on) are charged to the PC of the head instruction.
+*/
+static const int VPROC_DISPATCH_CNT  = 11;
+static const int VPROC_DISPATCH_WAIT = 3;
+inline const char *const vproc_dispatch_names[VPROC_DISPATCH_CNT] = {"issued", "empty", "decode", "waw", "raw", "war", "port", "commit", "vlsu_queue", "mem", "busy"};
+
+/*
+*   Offload stall causes, in the order of offload_stall in vproc_pkg.sv: why an instruction offered on the XIF issue interface was not
+*   accepted ("none" if nothing was refused).
+*/
+static const int VPROC_OFFLOAD_CNT = 5;
+inline const char *const vproc_offload_names[VPROC_OFFLOAD_CNT] = {"none", "queue_full", "vset", "id_used", "xreg"};
+
+/*
+*   Stall cycles of one instruction or PC by cause.  offload[0] and dispatch[0 .. VPROC_DISPATCH_WAIT-1] stay 0.
+*/
+struct stall_counts {
+    uint64_t dispatch[VPROC_DISPATCH_CNT] = {};
+    uint64_t offload [VPROC_OFFLOAD_CNT]  = {};
+
+    uint64_t total() const {
+        uint64_t sum = 0;
+        for (uint64_t c : dispatch) sum += c;
+        for (uint64_t c : offload)  sum += c;
+        return sum;
+    }
+};
+
+/*
+*   Vector instruction in flight for stall attribution.  Its PC is known once the scalar core retired it, until then its stall cycles
+*   are kept here.
+*/
+struct stall_instr {
+    bool         pc_valid = false;
+    uint32_t     pc       = 0;
+    stall_counts stalls;
+};
+
+/*
+*   Dispatch and offload stall attribution, see update_dispatch_stats().
+*/
+struct dispatch_stats {
+    uint64_t                 cycles = 0;
+    uint64_t                 dispatch[VPROC_DISPATCH_CNT] = {};        // per cause, sums up to cycles
+    uint64_t                 offload [VPROC_OFFLOAD_CNT]  = {};        // per cause, sums up to cycles
+    uint64_t                 window  [VPROC_DISPATCH_CNT] = {};        // dispatch causes since IF_PC last changed, see check_stall()
+    uint32_t                 window_pc  = 0;
+    uint64_t                 refused [VPROC_OFFLOAD_CNT]  = {};        // offload stalls of the instruction offered next
+    uint32_t                 wb_pc      = 0;                           // PC last seen in the write-back stage
+    std::vector<stall_instr> in_flight;                                // indexed by XIF instruction ID
+    std::vector<uint8_t>     unretired;                                // IDs accepted and not yet retired, oldest first
+    std::unordered_map<uint32_t, stall_counts> by_pc;
+};
+
+/*
+*   Offload latency components of a vector instruction, see update_offload_latency().  The stages follow the instruction through the
+*   vector core: cycles it was offered on the XIF issue interface and refused before it was accepted ("offload"), accepted until
+*   enqueued in the instruction queue ("decode"), enqueued until dispatched to a pipeline ("queue", the residency in the INSTR_QUEUE_SZ
+*   queue and its output stage) and dispatched until completed by its pipeline ("execute").  "commit" and "result" are the cycles from
+*   acceptance to the XIF commit and result transactions, "total" the cycles from acceptance to the later of result and completion.
+*   Configuration instructions are not enqueued and have no decode, queue and execute latency.
+*/
+enum latency_component {
+    LAT_OFFLOAD,
+    LAT_DECODE,
+    LAT_QUEUE,
+    LAT_EXECUTE,
+    LAT_COMMIT,
+    LAT_RESULT,
+    LAT_TOTAL,
+    LAT_CNT
+};
+inline const char *const vproc_latency_names[LAT_CNT] = {"offload", "decode", "queue", "execute", "commit", "result", "total"};
+
+/*
+*   Latency histogram.  Latencies below 64 cycles have one bin each, longer latencies one bin per power of two.
+*/
+struct latency_hist {
+    uint64_t              count = 0;
+    uint64_t              sum   = 0;
+    uint64_t              max   = 0;
+    std::vector<uint64_t> bins;             // grown as needed
+};
+
+/*
+*   Vector instruction in flight for offload latency tracking, cycles of the handshakes seen so far.
+*/
+struct offload_instr {
+    bool     valid      = false;
+    bool     enqueued   = false;
+    bool     dispatched = false;
+    bool     committed  = false;
+    bool     done       = false;
+    bool     resulted   = false;
+    uint8_t  unit       = 0;
+    uint8_t  sew        = 0;                // as vector_issue
+    uint8_t  lmul       = 0;
+    uint64_t refused    = 0;                // cycles refused before it was accepted
+    int      issue      = 0;
+    int      enqueue    = 0;
+    int      dispatch   = 0;
+    int      commit     = 0;
+    int      complete   = 0;
+    int      result     = 0;
+};
+
+/*
+*   Offload latency histograms by unit type (opcode class), SEW and LMUL, and occupancy of the instruction queue, see
+*   update_offload_latency().  Configuration instructions are only binned by unit type.
+*/
+struct offload_stats {
+    uint64_t                   instructions = 0;                        // instructions whose latencies were recorded
+    uint64_t                   killed       = 0;                        // instructions killed by the XIF commit interface
+    latency_hist               by_unit[VPROC_UNIT_CNT][LAT_CNT];
+    latency_hist               by_sew [4][LAT_CNT];                     // bins of vector_hist::sew
+    latency_hist               by_lmul[8][LAT_CNT];                     // bins of vector_hist::lmul
+    uint64_t                   refused = 0;                             // refused cycles of the instruction offered next
+    uint32_t                   queued  = 0;                             // instructions enqueued and not yet dispatched
+    std::vector<uint64_t>      queue_occupancy;                         // cycles by number of queued instructions
+    std::vector<offload_instr> in_flight;                               // indexed by XIF instruction ID
+};
+
+/*
+*   Host time phases of the harness, see host_scope.  Time outside of all phases is the testbench itself.
+*/
+enum host_phase {
+    HOST_EVAL,          // model evaluation, advance_cycle() and advance_half_cycle()
+    HOST_STATS,         // update_stats()
+    HOST_MEM,           // memory model, timed by the testbench with host_scope
+    HOST_TRACE,         // VCD/FST and instruction traces
+    HOST_COMMIT,        // commit logs and commit checking
+    HOST_PROFILE,       // update_profile(), update_bbv(), update_power() and update_mem_traffic()
+    HOST_CHECKPOINT,    // checkpoint save and restore
+    HOST_RUN,           // run_cycles() batches without RUN_HOST_PHASES (verilator_run.h), all harness phases inclusive
+    HOST_PHASE_CNT
+};
+inline const char *const host_phase_names[HOST_PHASE_CNT] = {"eval", "stats", "memory", "trace", "commit", "profile", "checkpoint", "run"};
+
+/*
+*   Timestamp for host timing.  The TSC on x86 (assumed invariant, converted to seconds against steady_clock), nanoseconds of
+*   steady_clock elsewhere.
+*/
+inline uint64_t host_ticks(){
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
 #else
-typedef void VerilatedTrace_t;  
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
 #endif
+}
+
+/*
+*   Host-side throughput of the simulation.  Started by the first advance_cycle() after the context was reset.
+*/
+struct host_stats {
+    bool     started     = false;
+    uint64_t start_ticks = 0;
+    std::chrono::steady_clock::time_point start_time;
+    uint64_t sim_cycles  = 0;                   // clock cycles advanced
+    uint64_t ticks[HOST_PHASE_CNT] = {};
+    uint64_t calls[HOST_PHASE_CNT] = {};
+    int      depth       = 0;                   // nested host_scopes, only the outermost one is timed
+    double   tick_cost   = 0.0;                 // ticks per host_ticks() call, to estimate the overhead of the timing itself
+
+    //progress lines, see set_host_progress()
+    double   progress_interval = -1.0;          // seconds between progress lines, 0 disables them, < 0 until read from VICUNA_PROGRESS
+    double   next_progress     = 0.0;
+    double   last_seconds      = 0.0;
+    uint64_t last_cycles       = 0;
+};
+
+/*
+*   Simulation context.  Holds the verilated model and all harness state belonging to it, so that several models can be simulated in one
+*   process, e.g. one per thread (see verilator_batch.h).  Each function below exists in two forms: taking a sim_context, operating on
+*   that context and its model, or taking a Vvproc_top, operating on default_ctx.  The harness state of default_ctx is also available
+*   under the original global names (cycles, instr, ...).
+*/
+struct sim_context {
+    Vvproc_top       *top  = NULL;          // verilated model simulated in this context
+    VerilatedContext *vctx = NULL;          // verilator context owning the model.  May be NULL for default_ctx
+
+    //stall detection
+    uint32_t cycles_stalled = 0;
+    uint32_t last_IF_PC     = 0;
+
+    //statistics
+    int   cycles                = 0;
+    int   current_WB_PC         = 0;
+    int   last_WB_PC            = 0;
+    bool  retired               = false;    // an instruction entered write-back in this cycle, set by update_instructions()
+    int   instr                 = 0;
+    int   vector_instr          = 0;
+    uint64_t sum_vec_lengths       = 0;
+    uint64_t sum_vec_lengths_bytes = 0;
+    double   sum_vec_percentage    = 0.0;
+
+    //vector pipeline and unit utilization
+    uint64_t                unit_cycles = 0;    // cycles sampled by update_unit_stats()
+    std::vector<pipe_stats> pipes;              // one entry per vector pipeline
+
+    //VL/SEW/LMUL/occupancy histograms per unit type, see update_vector_hist()
+    vector_hist                 vec_hist[VPROC_UNIT_CNT];
+    std::vector<vector_issue>   vec_in_flight;  // indexed by XIF instruction ID
+
+    //dispatch and offload stall attribution, see update_dispatch_stats()
+    dispatch_stats disp;
+
+    //offload latency per instruction and instruction queue occupancy, see update_offload_latency()
+    offload_stats lat;
+
+    //host time per harness phase and simulated cycles per second
+    host_stats host;
+
+    //memory ports of the update_mem_load() compatibility wrapper, one per queue_data pointer
+    std::map<unsigned char **, std::unique_ptr<mem_port>> legacy_ports;
+
+    /*
+    * Clear all harness state.  The model and the verilator context are kept.
+    */
+    void reset_stats();
+};
+
+inline sim_context default_ctx;
+
+/*
+*   Scoped timer charging the host time of its lifetime to a phase of a context, e.g.
+*       { host_scope t(ctx, HOST_MEM); update_mem_load(...); }
+*   The harness functions time themselves, the testbench times its memory model.
+*/
+class host_scope {
+public:
+    host_scope(sim_context *ctx, host_phase phase) : host(&ctx->host), phase(phase), t0(0) {
+        if (host->depth++ == 0) {
+            t0 = host_ticks();
+        }
+    }
+    ~host_scope() {
+        if (--host->depth == 0) {
+            host->ticks[phase] += host_ticks() - t0;
+            host->calls[phase]++;
+        }
+    }
+private:
+    host_stats *host;
+    host_phase  phase;
+    uint64_t    t0;
+};
+
+/*
+* Count simulated cycles towards the host throughput, starting the host timing with the first call.  Called by advance_cycle() and by
+* run_cycles() (verilator_run.h) for every batch of cycles.
+* ARGS:
+*   - *ctx          - simulation context
+*   -  cycles       - number of cycles advanced since the last call
+*/
+void host_advance(sim_context *ctx, uint64_t cycles);
+
+/*
+* Print a progress line (simulated cycles, current and average simulated kHz, retired instructions) to stderr every given number of
+* wall-clock seconds.  Without a call the interval is read from the VICUNA_PROGRESS environment variable, unset disables the lines.
+* ARGS:
+*   - *ctx          - simulation context (default_ctx if omitted)
+*   -  seconds      - interval between progress lines, 0 to disable them
+*/
+void set_host_progress(double seconds);
+void set_host_progress(sim_context *ctx, double seconds);
+
+/*
+* Wall-clock seconds since the first cycle of the context was advanced.  Usable for timeouts of long simulations.
+* ARGS:
+*   - *ctx          - simulation context (default_ctx if omitted)
+*/
+double host_seconds();
+double host_seconds(sim_context *ctx);
+
+/*
+* Print the host time breakdown: wall-clock time, simulated kHz and the time, share and cost per call of every phase.  Also
+* printed by report_stats().
+* ARGS:
+*   - *ctx          - simulation context (default_ctx if omitted)
+*/
+void report_host_stats();
+void report_host_stats(sim_context *ctx);
+
+/*
+* Function to reset the model of a context.  Holds rst_ni low for the given number of cycles and clears the harness state, so that a
+* model can be reused for the next program instead of being reconstructed.
+* ARGS:
+*   - *ctx          - simulation context
+*   -  rst_cycles   - number of cycles to hold reset
+*/
+void reset_model(sim_context *ctx, int rst_cycles);
 
 /*
 * Functions and Variables used to detect a stall.  Returns true if IF_PC in CV32E40X core has not changed in the provided number of cycles  
+* When it fires, the dispatch stall causes of the stalled cycles are printed as well (see report_stall_causes()).
 * ARGS:
-*   - *top          - pointer to verilator top module
+*   - *top          - pointer to verilator top module (or *ctx - simulation context)
 *   -  max_cycles   - number of cycles after which a stall is declared
 */
-inline uint32_t cycles_stalled = 0;
-inline uint32_t last_IF_PC = 0;
+inline uint32_t &cycles_stalled = default_ctx.cycles_stalled;
+inline uint32_t &last_IF_PC = default_ctx.last_IF_PC;
 bool check_stall(Vvproc_top *top, uint32_t max_cycles);
+bool check_stall(sim_context *ctx, uint32_t max_cycles);
+
+/*
+* Print the dispatch stall causes of the cycles since IF_PC last changed and the instruction at the head of the instruction queue.
+* Requires update_stats() (or update_dispatch_stats()) every cycle.  Called when check_stall() or run_cycles() detect a stall.
+* ARGS:
+*   - *ctx          - simulation context
+*/
+void report_stall_causes(sim_context *ctx);
 
 /*
 * Function to check for a specific IF_PC.  Returns true if match.
 * ARGS:
-*   - *top          - pointer to verilator top module
+*   - *top          - pointer to verilator top module (or *ctx - simulation context)
 *   -  address      - address to check for
 */
 bool check_PC(Vvproc_top *top, uint32_t address);
+bool check_PC(sim_context *ctx, uint32_t address);
 
 /*
 * Function to advance signal to the next cycle (i.e pass to after next falling edge)
 * ARGS:
-*   - *top          - pointer to verilator top module
+*   - *top          - pointer to verilator top module (or *ctx - simulation context)
 */
 void advance_cycle(Vvproc_top *top);
+void advance_cycle(sim_context *ctx);
 
 
 /*
 * Function to advance clock to next value specified
 * ARGS:
-*   - *top          - pointer to verilator top module
+*   - *top          - pointer to verilator top module (or *ctx - simulation context)
 *   - clk_val     - value to set the clock to
 */
 void advance_half_cycle(Vvproc_top *top, int clk_val);
+void advance_half_cycle(sim_context *ctx, int clk_val);
+
+/*
+*   Function to read from memory through a mem_port (see verilator_memory.h).  Generalized to work on byte pointers for variable width interfaces.
+*   The port owns its latency queue, advancing one cycle does not copy any queued data.
+* ARGS:
+*   *port          - memory port, constructed with the width, latency and size of the interface
+*   address        - address of the load request being issued
+*   req_valid      - validity of the load request being issued
+*
+*   *model_data_i  - pointer to memory data read interface on verilator model
+*   *model_valid_i - pointer to memory valid read interface on verilator model
+*   *model_err_i   - pointer to memory error read interface on verilator model
+*
+*   *mem           - pointer to memory space (flat array or paged_mem)
+*/
+void update_mem_load(mem_port *port, uint32_t address, bool req_valid, unsigned char *model_data_i, bool *model_valid_i, bool *model_err_i, unsigned char *mem);
+void update_mem_load(mem_port *port, uint32_t address, bool req_valid, unsigned char *model_data_i, bool *model_valid_i, bool *model_err_i, paged_mem *mem);
 
 /*
 *   Function to read from memory and manage/update memory buffers.  Generalized to work on byte pointers for variable width interfaces.
-*   Queues of correct sizes are expected to be allocated and provided by the user.
+*   Compatibility wrapper around mem_port.  The queue arrays are only used to identify the port and are no longer read or written,
+*   new code should construct a mem_port and use the overload above instead.  Not thread safe.
 * ARGS:
 *   address        - address of the load request being issued
 *   req_valid      - validity of the load request being issued
@@ -125,9 +515,28 @@ void update_mem_load(uint32_t address, bool req_valid, uint32_t mem_w, uint32_t
 *   *model_data_o  - pointer to memory data write interface on verilator model
 *   *model_be_o    - pointer to byte enable write interface on verilator model
 *
-*   *mem           - pointer to memory space
+*   *mem           - pointer to memory space (flat array or paged_mem)
+*   *dirty         - pages written, see dump_mem_dirty().  May be NULL.  A paged_mem keeps its own (paged_mem::dirty())
 */
-void update_mem_write(uint32_t address, bool req_valid, uint32_t mem_w, uint32_t mem_size, unsigned char *model_data_o, unsigned char *model_be_o, unsigned char *mem);
+void update_mem_write(uint32_t address, bool req_valid, uint32_t mem_w, uint32_t mem_size, unsigned char *model_data_o, unsigned char *model_be_o, unsigned char *mem, dirty_pages *dirty = NULL);
+void update_mem_write(uint32_t address, bool req_valid, uint32_t mem_w, uint32_t mem_size, unsigned char *model_data_o, unsigned char *model_be_o, paged_mem *mem);
+
+/*
+*   Function to write to memory through the write interface belonging to a mem_port.  Values immediately written to memory; with a
+*   mem_timing attached to the port, the store is charged to the timing model (see mem_port::store()).
+* ARGS:
+*   *port          - memory port of the interface, provides its width and memory size
+*   address        - address of the write request being issued
+*   req_valid      - validity of the write request being issued
+*
+*   *model_data_o  - pointer to memory data write interface on verilator model
+*   *model_be_o    - pointer to byte enable write interface on verilator model
+*
+*   *mem           - pointer to memory space (flat array or paged_mem)
+*   *dirty         - pages written, as above.  May be NULL
+*/
+void update_mem_write(mem_port *port, uint32_t address, bool req_valid, unsigned char *model_data_o, unsigned char *model_be_o, unsigned char *mem, dirty_pages *dirty = NULL);
+void update_mem_write(mem_port *port, uint32_t address, bool req_valid, unsigned char *model_data_o, unsigned char *model_be_o, paged_mem *mem);
 
 /*
 * Check for a write to memory mapped io.  Returns true and copies written data to *data_out if a valid write occurs to the selected address
@@ -145,22 +554,105 @@ bool check_memmapio(uint32_t address, bool req_valid, uint32_t mem_w, unsigned c
 
 /*
 *   Function to setup memory.  Handles checking memory parameters, allocates main memory, and loads program.  Returns unsigned char* to main memory.  Returns NULL if error
+*   Memory is allocated zeroed on demand (calloc), so only pages touched by the program image or the simulation are backed.  The returned pointer is released with free().
+*   The program may be an ELF image, a raw binary (.bin, loaded at address 0) or a hex file in the @addr format, see load_image() in verilator_memory.h.
 * ARGS:
 *   mem_sz        - size of main memory to allocate
 *   *prog_path    - program to load into memory
+*   *info         - entry point and symbol table of the program (ELF only), second overload only.  May be NULL
 */
 unsigned char* load_program(uint32_t mem_sz, char *prog_path);
+unsigned char* load_program(uint32_t mem_sz, char *prog_path, program_info *info);
+
+/*
+*   Function to load a program into a paged memory (see verilator_memory.h).  Pages are only allocated for the program image, a loaded
+*   memory can be forked for each run with paged_mem::fork().  Returns false if error
+* ARGS:
+*   *mem          - memory to load the program into
+*   *prog_path    - program to load into memory
+*   *info         - entry point and symbol table of the program (ELF only).  May be NULL
+*/
+bool load_program(paged_mem *mem, char *prog_path, program_info *info);
 /*
 *   Function to dump a region of memory into a file.
 * ARGS:
 *   start_addr        - start address of memory region
 *   end_addr          - end address of memory region
 *
-*   *mem              - pointer to main memory
+*   *mem              - pointer to main memory (flat array or paged_mem)
 *
 *   *dump_path        - file path to output file
 */
 void dump_mem_region (uint32_t start_addr, uint32_t end_addr, unsigned char *mem, char *dump_path);
+void dump_mem_region (uint32_t start_addr, uint32_t end_addr, paged_mem *mem, char *dump_path);
+
+/*
+*   Function to dump the pages of a region written since the last dump (or since the dirty pages were cleared) into a binary memory dump
+*   (see mem_dump_header in verilator_memory.h).  The file holds an index of the dumped address ranges followed by their raw contents,
+*   unmodified memory is not written.  The dirty bits of the pages lying entirely within the region are cleared, so repeated calls with
+*   append write incremental dumps.  load_image() / load_program() apply all frames of a dump.  Returns false if error
+* ARGS:
+*   start_addr        - start address of memory region
+*   end_addr          - end address of memory region, 0 for the end of memory
+*
+*   *mem              - pointer to main memory (flat array with its dirty pages, or paged_mem)
+*   mem_sz            - size of the flat array, the region is clipped to it
+*   *dirty            - pages written by update_mem_write() into the flat array
+*
+*   *dump_path        - file path to output file
+*   cycle             - cycle recorded in the frame
+*   append            - append a frame instead of replacing the file
+*/
+bool dump_mem_dirty(uint32_t start_addr, uint32_t end_addr, unsigned char *mem, uint32_t mem_sz, dirty_pages *dirty, const char *dump_path, uint64_t cycle = 0, bool append = false);
+bool dump_mem_dirty(uint32_t start_addr, uint32_t end_addr, paged_mem *mem, const char *dump_path, uint64_t cycle = 0, bool append = false);
+
+/*
+*   Function to compare a region of memory against an expected image (see load_mem_image() in verilator_memory.h).  Only the parts of
+*   the region covered by the image are compared, a page at a time with memcmp(); differing words are reported to *report (the first
+*   8) and counted.  Returns the number of differing 32-bit words, -1 if the image cannot be loaded or the compared part of it
+*   lies outside of memory
+* ARGS:
+*   start_addr        - start address of memory region
+*   end_addr          - end address of memory region
+*
+*   *mem              - pointer to main memory (flat array or paged_mem)
+*   mem_sz            - size of the flat array
+*
+*   *expected_path    - expected image: a text file in the format of dump_mem_region() starting at start_addr, a raw binary or a
+*                       memory dump (or *expected - image loaded once with load_mem_image())
+*   *report           - output for the differing words, may be NULL
+*/
+int compare_mem_region(uint32_t start_addr, uint32_t end_addr, unsigned char *mem, uint32_t mem_sz, const char *expected_path, FILE *report = stderr);
+int compare_mem_region(uint32_t start_addr, uint32_t end_addr, paged_mem *mem, const char *expected_path, FILE *report = stderr);
+int compare_mem_region(uint32_t start_addr, uint32_t end_addr, unsigned char *mem, uint32_t mem_sz, const mem_image *expected, FILE *report = stderr);
+int compare_mem_region(uint32_t start_addr, uint32_t end_addr, paged_mem *mem, const mem_image *expected, FILE *report = stderr);
+
+/*
+*   Periodic incremental memory dumps, see update_mem_dump().  Every interval cycles a frame with the pages of the region written since
+*   the previous frame is appended to the dump file; the first frame of a run replaces the file.
+*/
+struct mem_dump_trigger {
+    int      interval   = 0;            // cycles between frames, 0 disables the dumps
+    uint32_t start_addr = 0;            // region, end_addr 0 for the end of memory
+    uint32_t end_addr   = 0;
+    int      frames     = 0;            // frames written so far
+};
+
+/*
+* Append an incremental memory dump frame if the interval has elapsed.  Should be called once per simulated cycle after update_stats().
+* Returns true in the cycles a frame was written.
+* ARGS:
+*   - *top          - pointer to verilator top module (or *ctx - simulation context)
+*   - *trig         - interval and region
+*   - *path         - dump file
+*   - *mem          - pointer to main memory (flat array with its dirty pages, or paged_mem)
+*   - mem_sz        - size of the flat array
+*   - *dirty        - pages written by update_mem_write() into the flat array
+*/
+bool update_mem_dump(Vvproc_top *top, mem_dump_trigger *trig, const char *path, unsigned char *mem, uint32_t mem_sz, dirty_pages *dirty);
+bool update_mem_dump(sim_context *ctx, mem_dump_trigger *trig, const char *path, unsigned char *mem, uint32_t mem_sz, dirty_pages *dirty);
+bool update_mem_dump(Vvproc_top *top, mem_dump_trigger *trig, const char *path, paged_mem *mem);
+bool update_mem_dump(sim_context *ctx, mem_dump_trigger *trig, const char *path, paged_mem *mem);
 
 
 
@@ -173,93 +665,417 @@ void dump_mem_region (uint32_t start_addr, uint32_t end_addr, unsigned char *mem
 
 /*
 *   Cycle count update
+* ARGS:
+*   - *ctx          - simulation context (default_ctx if omitted)
 */
-inline int cycles = 0;
+inline int &cycles = default_ctx.cycles;
 void update_cycles();
+void update_cycles(sim_context *ctx);
 
 /*
 *   Retired instruction count update
 * ARGS:
-*   - *top          - pointer to verilator top module
+*   - *top          - pointer to verilator top module (or *ctx - simulation context)
 */
-inline int current_WB_PC = 0;
-inline int last_WB_PC = 0;
-inline int instr = 0;
+inline int &current_WB_PC = default_ctx.current_WB_PC;
+inline int &last_WB_PC = default_ctx.last_WB_PC;
+inline int &instr = default_ctx.instr;
 void update_instructions(Vvproc_top *top);
+void update_instructions(sim_context *ctx);
 /*
 *   Total Vector Instructions executed update
 * ARGS:
-*   - *top          - pointer to verilator top module
+*   - *top          - pointer to verilator top module (or *ctx - simulation context)
 */
-inline int vector_instr = 0;
+inline int &vector_instr = default_ctx.vector_instr;
 void update_vector_count(Vvproc_top *top);
+void update_vector_count(sim_context *ctx);
 
 /*
 * Average vector length calculation update.  
 * ARGS:
-*   - *top          - pointer to verilator top module
+*   - *top          - pointer to verilator top module (or *ctx - simulation context)
 */
-inline int sum_vec_lengths = 0;
-inline int sum_vec_lengths_bytes = 0;
-inline float sum_vec_percentage = 0.0;
+inline uint64_t &sum_vec_lengths = default_ctx.sum_vec_lengths;
+inline uint64_t &sum_vec_lengths_bytes = default_ctx.sum_vec_lengths_bytes;
+inline double &sum_vec_percentage = default_ctx.sum_vec_percentage;
 void update_avg_vector_len(Vvproc_top *top);
+void update_avg_vector_len(sim_context *ctx);
+
+/*
+* Vector configuration histogram update.  Bins every vector instruction accepted by the decoder (dec_issue_* signals of vproc_core) by
+* VL, SEW, LMUL and register group occupancy (VL / VLMAX) of the configuration it executes with, per unit type.  Each bin counts
+* instructions and, once the instruction completes (instr_done_* signals), the cycles it was in flight.  Configuration instructions
+* are not binned.
+* ARGS:
+*   - *top          - pointer to verilator top module (or *ctx - simulation context)
+*/
+void update_vector_hist(Vvproc_top *top);
+void update_vector_hist(sim_context *ctx);
+
+/*
+* Write the vector configuration histograms as CSV (unit, histogram, bin, instructions, cycles).  Returns false if error
+* ARGS:
+*   - *ctx          - simulation context (default_ctx if omitted)
+*   - *path         - output file
+*/
+bool write_vector_hist(const char *path);
+bool write_vector_hist(sim_context *ctx, const char *path);
+
+/*
+* Vector pipeline and unit utilization update.  Counts busy, stalled and idle cycles of each unit of each vector pipeline (from the
+* pipe_unit_busy/pipe_unit_stall signals of vproc_core) as well as dispatch and dispatch stall cycles of each pipeline.
+* ARGS:
+*   - *top          - pointer to verilator top module (or *ctx - simulation context)
+*/
+void update_unit_stats(Vvproc_top *top);
+void update_unit_stats(sim_context *ctx);
+
+/*
+* Dispatch stall attribution update.  Counts every cycle under one dispatch stall cause and one offload stall cause (the
+* dispatch_stall_cause and offload_stall_cause signals of vproc_core).  Waiting cycles of the instruction at the head of the queue
+* and refused offloads are charged to the instruction, whose PC is taken from the write-back stage of the scalar core when it retires
+* (vector instructions retire in the order they were accepted, instructions killed by the XIF commit interface never do).
+* ARGS:
+*   - *top          - pointer to verilator top module (or *ctx - simulation context)
+*/
+void update_dispatch_stats(Vvproc_top *top);
+void update_dispatch_stats(sim_context *ctx);
+
+/*
+* Write the stall cycles per PC as CSV (pc, one column per waiting dispatch cause and per offload cause, total), sorted by total.
+* Returns false if error
+* ARGS:
+*   - *ctx          - simulation context (default_ctx if omitted)
+*   - *path         - output file
+*/
+bool write_dispatch_stalls(const char *path);
+bool write_dispatch_stalls(sim_context *ctx, const char *path);
+
+/*
+* Offload latency update.  Follows every vector instruction by its XIF instruction ID through the XIF issue, commit and result
+* transactions, the enqueue into the instruction queue, the dispatch to a pipeline and its completion (dec_issue_*, queue_enq_*,
+* dispatch_stall_*, xif_commit_*, instr_done_* and xif_result_* signals of vproc_core), and bins its latency components (see
+* latency_component) by unit type, SEW and LMUL once it has both completed and returned its result.  Killed instructions are not
+* binned.  Also samples the number of instructions waiting in the instruction queue every cycle.
+* ARGS:
+*   - *top          - pointer to verilator top module (or *ctx - simulation context)
+*/
+void update_offload_latency(Vvproc_top *top);
+void update_offload_latency(sim_context *ctx);
+
+/*
+* Write the offload latency histograms as CSV (group, key, component, bin, count): one row per non-empty bin, group is unit, sew or
+* lmul and bin the lowest latency of the bin in cycles.  The instruction queue occupancy follows as rows (queue, occupancy,
+* instructions, number of queued instructions, cycles).  Returns false if error
+* ARGS:
+*   - *ctx          - simulation context (default_ctx if omitted)
+*   - *path         - output file
+*/
+bool write_offload_latency(const char *path);
+bool write_offload_latency(sim_context *ctx, const char *path);
+
+/*
+* Cycle profiler update.  Charges the current cycle to the PC in the write-back stage of the scalar core (see pc_profile in
+* verilator_profile.h).  Report with prof->report() and prof->write_folded() at the end of the simulation.
+* ARGS:
+*   - *top          - pointer to verilator top module (or *ctx - simulation context)
+*   - *prof         - profiler, constructed with the program_info returned by load_program()
+*/
+void update_profile(Vvproc_top *top, pc_profile *prof);
+void update_profile(sim_context *ctx, pc_profile *prof);
+
+/*
+* Basic-block vector update.  Feeds the PC and instruction in the write-back stage of the scalar core into *bbv, see bbv_profile in
+* verilator_profile.h.
+* ARGS:
+*   - *top          - pointer to verilator top module (or *ctx - simulation context)
+*   - *bbv          - basic-block vector collector
+*/
+void update_bbv(Vvproc_top *top, bbv_profile *bbv);
+void update_bbv(sim_context *ctx, bbv_profile *bbv);
+
+/*
+* Switching-activity update.  Feeds the vector register file write and read ports (vregfile_wr_*_q and vregfile_rd_data of vproc_core)
+* and the busy/stalled units of every pipeline, weighted by the pipeline width (pipe_width), into *pwr, charged to the PC in the
+* write-back stage of the scalar core.  See power_counters in verilator_power.h.
+* ARGS:
+*   - *top          - pointer to verilator top module (or *ctx - simulation context)
+*   - vreg_w        - width of the vector registers
+*   - *pwr          - switching-activity counters, constructed with VPROC_UNIT_CNT, vproc_unit_names and the program_info
+*/
+void update_power(Vvproc_top *top, int vreg_w, power_counters *pwr);
+void update_power(sim_context *ctx, int vreg_w, power_counters *pwr);
+
+/*
+* Vector memory traffic update.  Feeds the vector loads/stores accepted by the decoder and the requests on the vector memory interface
+* (lsu_issue_* and lsu_mem_* signals of vproc_core) into *traffic and advances it by one cycle.
+* ARGS:
+*   - *top          - pointer to verilator top module (or *ctx - simulation context)
+*   - *traffic      - traffic statistics, constructed with the width of the vector memory interface (VMEM_W)
+*/
+void update_mem_traffic(Vvproc_top *top, mem_traffic *traffic);
+void update_mem_traffic(sim_context *ctx, mem_traffic *traffic);
 
 /*
 * Top level function to update all statistics
 * ARGS:
-*   - *top          - pointer to verilator top module
+*   - *top          - pointer to verilator top module (or *ctx - simulation context)
 */
 void update_stats(Vvproc_top *top);
+void update_stats(sim_context *ctx);
 
 /*
 * Report current state of all collected statistics
+* ARGS:
+*   - *ctx          - simulation context (default_ctx if omitted)
 */
 void report_stats();
+void report_stats(sim_context *ctx);
+
+/*
+* Append the summary statistics as one line of space-separated key=value pairs (cycles, instr, cpi, vector_instr, avg_vl, vreg_usage,
+* if_pc, busy/stall percentages of every vector pipeline, percentages of the dispatch and offload stall causes, host_s and host_khz) for collection by scripts, e.g. tools/vicuna_sweep.
+* if_pc is the IF_PC last seen by check_stall() or run_cycles() with RUN_STOP_STALL, i.e. where the program stopped.
+* report_stats() also calls this with the path in the VICUNA_STATS environment variable if it is set.  Returns false if error
+* ARGS:
+*   - *ctx          - simulation context (default_ctx if omitted)
+*   - *path         - output file
+*/
+bool write_stats(const char *path);
+bool write_stats(sim_context *ctx, const char *path);
 
 /*
-* Update .vcd trace file. If end_cycles == 0, output entire trace.
+* Update .vcd (or .fst with TRACE_FST) trace file. If end_cycles == 0, output entire trace.
 * ARGS:
-*   - *tfp          - pointer to verilator vcd trace object
+*   - *ctx          - simulation context (default_ctx if omitted)
+*   - *tfp          - pointer to verilator vcd or fst trace object
 *   - begin_cycles  - cycle count to start trace
 *   - end_cycles    - cycle count to end trace
 */
 void update_vcd(VerilatedTrace_t *tfp, uint32_t begin_cycles, uint32_t end_cycles);
+void update_vcd(sim_context *ctx, VerilatedTrace_t *tfp, uint32_t begin_cycles, uint32_t end_cycles);
+
+
+/*
+* Trace window opened by the PC of the program rather than by cycle numbers.  The window opens when IF_PC (see check_PC()) is
+* within [start_lo, start_hi] and closes when IF_PC is within [stop_lo, stop_hi] or after max_cycles cycles, whichever comes first.
+* A window opens up to max_hits times.
+*/
+struct trace_window {
+    uint32_t start_lo   = 0;
+    uint32_t start_hi   = 0;
+    uint32_t stop_lo    = 1;        // no stop PC while stop_lo > stop_hi
+    uint32_t stop_hi    = 0;
+    uint32_t max_cycles = 0;        // 0 for no limit
+    uint32_t max_hits   = 1;        // 0 for no limit
+
+    uint32_t hits       = 0;        // times the window has opened
+    bool     open       = false;
+    int      opened_at  = 0;        // cycle the window last opened
+};
+
+/*
+* Set of trace windows, evaluated once per cycle by update_trace_trigger().  Tracing is active while any window is open.  The
+* instruction traces keep the last history cycles while inactive and write them when a window opens, waveform traces start with
+* the window as the model state of past cycles is not kept.  update_trace_trigger() records the history once per cycle, and the
+* text and binary instruction traces read it through their own cursors, so both can follow the same trigger.
+*/
+struct trace_trigger {
+    std::vector<trace_window> windows;
+    uint32_t                  history = 0;    // cycles of instruction trace kept before a window opens
+    bool                      active  = false;
+    bool                      dumping = false;    // active in the last call of update_vcd()
+
+    struct history_entry {
+        uint64_t cycle;
+        bool     new_pc;
+        uint32_t instr;
+        uint32_t pc;
+        uint32_t vl;
+        uint32_t vtype;
+    };
+    std::vector<history_entry> ring;          // pre-trigger instruction trace, entry n of the inactive cycles is ring[n % history]
+    uint64_t                   ring_written = 0;  // entries recorded
+    uint64_t                   text_read    = 0;  // entries written by the text instruction trace
+    uint64_t                   log_read     = 0;  // entries written by the binary instruction trace
+};
+
+/*
+* Evaluate the windows of a trace trigger for the current cycle and, while no window is open, record the write-back state in the
+* history.  Should be called once per simulated cycle after update_stats() and before update_vcd() / update_inst_trace().  Returns
+* true if tracing is active in this cycle.
+* ARGS:
+*   - *top          - pointer to verilator top module (or *ctx - simulation context)
+*   - *trig         - trace windows
+*/
+bool update_trace_trigger(Vvproc_top *top, trace_trigger *trig);
+bool update_trace_trigger(sim_context *ctx, trace_trigger *trig);
+
+/*
+* Update waveform trace file while a window of the trace trigger is open.  The trace is flushed when the last window closes.
+* ARGS:
+*   - *ctx          - simulation context (default_ctx if omitted)
+*   - *tfp          - pointer to verilator vcd or fst trace object
+*   - *trig         - trace windows, updated by update_trace_trigger() in this cycle
+*/
+void update_vcd(VerilatedTrace_t *tfp, trace_trigger *trig);
+void update_vcd(sim_context *ctx, VerilatedTrace_t *tfp, trace_trigger *trig);
 
+/*
+* Update instruction trace file while a window of the trace trigger is open, with the history cycles before the window opened.
+* ARGS:
+*   - *top          - pointer to verilator top module (or *ctx - simulation context)
+*   - *inst_trace   - pointer to .txt trace file output
+*   - *trig         - trace windows, updated by update_trace_trigger() in this cycle
+*/
+void update_inst_trace(Vvproc_top *top, FILE *inst_trace, trace_trigger *trig);
+void update_inst_trace(sim_context *ctx, FILE *inst_trace, trace_trigger *trig);
 
 /*
 * Update instruction trace file. If end_cycles == 0, output entire trace.
 * ARGS:
-*   - *top          - pointer to verilator top module
+*   - *top          - pointer to verilator top module (or *ctx - simulation context)
 *   - *inst_trace   - pointer to .txt trace file output
 *   - begin_cycles  - cycle count to start trace
 *   - end_cycles    - cycle count to end trace
 */
 void update_inst_trace(Vvproc_top *top, FILE *inst_trace, uint32_t begin_cycles, uint32_t end_cycles);
+void update_inst_trace(sim_context *ctx, FILE *inst_trace, uint32_t begin_cycles, uint32_t end_cycles);
+
+/*
+* Update a binary instruction trace (verilator_insttrace.h) instead of the text trace.  Records one entry per retirement or change of
+* the write-back state with its PC, cycle and vector CSRs, instead of one line per cycle.  insttrace_decode converts it to the text
+* format.
+* ARGS:
+*   - *top          - pointer to verilator top module (or *ctx - simulation context)
+*   - *log          - binary instruction trace
+*   - *trig         - trace windows, updated by update_trace_trigger() in this cycle
+*   - begin_cycles  - cycle count to start trace
+*   - end_cycles    - cycle count to end trace, 0 traces everything
+*/
+void update_inst_trace(Vvproc_top *top, inst_trace_log *log, trace_trigger *trig);
+void update_inst_trace(sim_context *ctx, inst_trace_log *log, trace_trigger *trig);
+void update_inst_trace(Vvproc_top *top, inst_trace_log *log, uint32_t begin_cycles, uint32_t end_cycles);
+void update_inst_trace(sim_context *ctx, inst_trace_log *log, uint32_t begin_cycles, uint32_t end_cycles);
 
 /*
 * Update xreg commit log dump.  Appends any current commits to provided file.
 * ARGS:
-*   - *top          - pointer to verilator top module
+*   - *top          - pointer to verilator top module (or *ctx - simulation context)
 *   - *commit_log   - pointer to .txt trace file output
 */
 void update_xreg_commit(Vvproc_top *top, FILE *commit_log);
+void update_xreg_commit(sim_context *ctx, FILE *commit_log);
 
 /*
 * Update freg commit log dump.  Appends any current commits to provided file. In case RISCV_F is not enabled, remove references to fp_regfile signals as they don't exist
 * ARGS:
-*   - *top          - pointer to verilator top module
+*   - *top          - pointer to verilator top module (or *ctx - simulation context)
 *   - *commit_log   - pointer to .txt trace file output
 */
 void update_freg_commit(Vvproc_top *top, FILE *commit_log);
+void update_freg_commit(sim_context *ctx, FILE *commit_log);
 
 /*
 * Update vreg commit log dump.  Appends any current commits to provided file. In case RISCV_ZVE32X is not enabled, remove references to vregfile signals as they don't exist
 * ARGS:
-*   - *top          - pointer to verilator top module
+*   - *top          - pointer to verilator top module (or *ctx - simulation context)
 *   - vreg_w        - width of the vector registers
 *   - *commit_log   - pointer to .txt trace file output
 */
 void update_vreg_commit(Vvproc_top *top, int vreg_w, FILE *commit_log);
+void update_vreg_commit(sim_context *ctx, int vreg_w, FILE *commit_log);
+
+/*
+* Binary commit log variants of update_xreg_commit(), update_freg_commit() and update_vreg_commit().  Commits are copied into the
+* asynchronous writer of *log (see verilator_commitlog.h), which is opened with the vector register width.  The binary log is
+* converted to the text format of the functions above with commit_log_to_text() or tools/commitlog_convert.
+* ARGS:
+*   - *top          - pointer to verilator top module (or *ctx - simulation context)
+*   - *log          - open binary commit log
+*/
+void update_xreg_commit(Vvproc_top *top, commit_log *log);
+void update_xreg_commit(sim_context *ctx, commit_log *log);
+void update_freg_commit(Vvproc_top *top, commit_log *log);
+void update_freg_commit(sim_context *ctx, commit_log *log);
+void update_vreg_commit(Vvproc_top *top, commit_log *log);
+void update_vreg_commit(sim_context *ctx, commit_log *log);
+
+/*
+* Function to compare the current xreg, freg and vreg commits against a reference commit log while simulating, see commit_check in
+* verilator_commitlog.h.  Returns false once the commits diverged from the reference, the run can then be stopped and the divergence
+* printed with check->report().  Call check->finish() at the end of the simulation to detect missing commits.
+* ARGS:
+*   - *top          - pointer to verilator top module (or *ctx - simulation context)
+*   - *check        - commit checker opened on the reference log
+*/
+bool update_commit_check(Vvproc_top *top, commit_check *check);
+bool update_commit_check(sim_context *ctx, commit_check *check);
+
+
+/*
+*   Checkpoint Functions.  Save and restore the complete simulation state: the verilated model, the memory image, the state of the given
+*   memory ports and all harness counters (cycles, instr, cycles_stalled, last_WB_PC, ...).  A run restored from a checkpoint continues
+*   exactly where the saved run was, so boot and initialization code only needs to be simulated once.
+*
+*   Requires the model to be verilated with --savable and SIM_CHECKPOINT to be defined, otherwise all functions report an error and return false.
+*   Loads issued through the legacy update_mem_load() queues are not saved, pass the mem_port objects instead if loads may be in flight.
+*/
+
+/*
+* Save a checkpoint.  Only non-zero pages of a flat memory and allocated pages of a paged memory are written.  Returns false if error
+* ARGS:
+*   - *top          - pointer to verilator top module (or *ctx - simulation context)
+*   - *path         - checkpoint file to write
+*   - *mem          - pointer to main memory (flat array with mem_sz bytes, or paged_mem)
+*   - **ports       - memory ports whose in-flight requests are saved.  May be NULL if n_ports == 0
+*   -  n_ports      - number of memory ports
+*/
+bool save_checkpoint(Vvproc_top *top, const char *path, unsigned char *mem, uint32_t mem_sz, mem_port **ports = NULL, int n_ports = 0);
+bool save_checkpoint(sim_context *ctx, const char *path, unsigned char *mem, uint32_t mem_sz, mem_port **ports = NULL, int n_ports = 0);
+bool save_checkpoint(Vvproc_top *top, const char *path, paged_mem *mem, mem_port **ports = NULL, int n_ports = 0);
+bool save_checkpoint(sim_context *ctx, const char *path, paged_mem *mem, mem_port **ports = NULL, int n_ports = 0);
+
+/*
+* Restore a checkpoint written by save_checkpoint().  The model, memory and ports must have the same configuration as when the checkpoint was saved.
+* Memory not contained in the checkpoint is cleared.  Returns false if error
+* ARGS:
+*   - *top          - pointer to verilator top module (or *ctx - simulation context)
+*   - *path         - checkpoint file to read
+*   - *mem          - pointer to main memory (flat array with mem_sz bytes, or paged_mem)
+*   - **ports       - memory ports to restore, in the same order as saved
+*   -  n_ports      - number of memory ports
+*/
+bool restore_checkpoint(Vvproc_top *top, const char *path, unsigned char *mem, uint32_t mem_sz, mem_port **ports = NULL, int n_ports = 0);
+bool restore_checkpoint(sim_context *ctx, const char *path, unsigned char *mem, uint32_t mem_sz, mem_port **ports = NULL, int n_ports = 0);
+bool restore_checkpoint(Vvproc_top *top, const char *path, paged_mem *mem, mem_port **ports = NULL, int n_ports = 0);
+bool restore_checkpoint(sim_context *ctx, const char *path, paged_mem *mem, mem_port **ports = NULL, int n_ports = 0);
+
+/*
+* Condition for taking a checkpoint during a run, checked by update_checkpoint().  The checkpoint is taken once, the first time either
+* IF_PC matches pc (see check_PC()) or the cycle count reaches cycle.
+*/
+struct checkpoint_trigger {
+    bool     at_pc    = false;
+    uint32_t pc       = 0;
+    bool     at_cycle = false;
+    int      cycle    = 0;
+    bool     taken    = false;
+};
+
+/*
+* Take a checkpoint if the trigger condition is met.  Should be called once per simulated cycle after update_stats().  Returns true in the cycle the checkpoint was written.
+* ARGS:
+*   - *top          - pointer to verilator top module (or *ctx - simulation context)
+*   - *trig         - trigger condition
+*   - *path         - checkpoint file to write
+*   - remaining args as save_checkpoint()
+*/
+bool update_checkpoint(Vvproc_top *top, checkpoint_trigger *trig, const char *path, unsigned char *mem, uint32_t mem_sz, mem_port **ports = NULL, int n_ports = 0);
+bool update_checkpoint(sim_context *ctx, checkpoint_trigger *trig, const char *path, unsigned char *mem, uint32_t mem_sz, mem_port **ports = NULL, int n_ports = 0);
+bool update_checkpoint(Vvproc_top *top, checkpoint_trigger *trig, const char *path, paged_mem *mem, mem_port **ports = NULL, int n_ports = 0);
+bool update_checkpoint(sim_context *ctx, checkpoint_trigger *trig, const char *path, paged_mem *mem, mem_port **ports = NULL, int n_ports = 0);
 
 
 #endif
\ No newline at end of file